@@ -0,0 +1,123 @@
+#include "AllocationCounter.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+std::atomic<size_t> s_allocations{0};
+std::atomic<size_t> s_liveBytes{0};
+std::atomic<size_t> s_peakBytes{0};
+
+// each block is prefixed with its size so delete knows how much to take off, the prefix keeps the
+// alignment malloc gives
+constexpr size_t c_prefix = alignof(std::max_align_t);
+
+void *countedAlloc(size_t _size) noexcept
+{
+  auto block = static_cast<char *>(std::malloc(_size + c_prefix));
+  if (block == nullptr)
+  {
+    return nullptr;
+  }
+  *reinterpret_cast<size_t *>(block) = _size;
+  s_allocations.fetch_add(1, std::memory_order_relaxed);
+  const size_t live = s_liveBytes.fetch_add(_size, std::memory_order_relaxed) + _size;
+  size_t peak = s_peakBytes.load(std::memory_order_relaxed);
+  while (live > peak && !s_peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+  {
+  }
+  return block + c_prefix;
+}
+
+void countedFree(void *_ptr) noexcept
+{
+  if (_ptr == nullptr)
+  {
+    return;
+  }
+  auto block = static_cast<char *>(_ptr) - c_prefix;
+  s_liveBytes.fetch_sub(*reinterpret_cast<size_t *>(block), std::memory_order_relaxed);
+  std::free(block);
+}
+
+void *throwingAlloc(size_t _size)
+{
+  void *p = countedAlloc(_size);
+  if (p == nullptr)
+  {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+} // end anonymous namespace
+
+namespace bench
+{
+AllocationStats allocationStats() noexcept
+{
+  AllocationStats stats;
+  stats.m_allocations = s_allocations.load(std::memory_order_relaxed);
+  stats.m_liveBytes = s_liveBytes.load(std::memory_order_relaxed);
+  stats.m_peakBytes = s_peakBytes.load(std::memory_order_relaxed);
+  return stats;
+}
+
+void resetPeakBytes() noexcept
+{
+  s_peakBytes.store(s_liveBytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+} // end namespace bench
+
+// every non aligned form has to be replaced, the library's nothrow new doesn't go through operator new so its
+// blocks would reach our delete without the prefix
+void *operator new(size_t _size)
+{
+  return throwingAlloc(_size);
+}
+
+void *operator new[](size_t _size)
+{
+  return throwingAlloc(_size);
+}
+
+void *operator new(size_t _size, const std::nothrow_t &) noexcept
+{
+  return countedAlloc(_size);
+}
+
+void *operator new[](size_t _size, const std::nothrow_t &) noexcept
+{
+  return countedAlloc(_size);
+}
+
+void operator delete(void *_ptr) noexcept
+{
+  countedFree(_ptr);
+}
+
+void operator delete[](void *_ptr) noexcept
+{
+  countedFree(_ptr);
+}
+
+void operator delete(void *_ptr, size_t) noexcept
+{
+  countedFree(_ptr);
+}
+
+void operator delete[](void *_ptr, size_t) noexcept
+{
+  countedFree(_ptr);
+}
+
+void operator delete(void *_ptr, const std::nothrow_t &) noexcept
+{
+  countedFree(_ptr);
+}
+
+void operator delete[](void *_ptr, const std::nothrow_t &) noexcept
+{
+  countedFree(_ptr);
+}
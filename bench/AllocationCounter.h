@@ -0,0 +1,37 @@
+#ifndef ALLOCATIONCOUNTER_H_
+#define ALLOCATIONCOUNTER_H_
+#include <cstddef>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file AllocationCounter.h
+/// @brief MorphBench replaces the global operator new / delete so every heap allocation in the process is counted,
+/// the harness reads the counts around each iteration to report allocations and peak heap growth per case.
+/// Over-aligned allocations go through the library's own aligned new and are not counted
+//----------------------------------------------------------------------------------------------------------------------
+namespace bench
+{
+struct AllocationStats
+{
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief allocations made since the program started
+  //----------------------------------------------------------------------------------------------------------------------
+  size_t m_allocations = 0;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief bytes currently allocated
+  //----------------------------------------------------------------------------------------------------------------------
+  size_t m_liveBytes = 0;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the most bytes allocated at once since the last resetPeakBytes
+  //----------------------------------------------------------------------------------------------------------------------
+  size_t m_peakBytes = 0;
+};
+
+AllocationStats allocationStats() noexcept;
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief start tracking the peak again from the bytes allocated now
+//----------------------------------------------------------------------------------------------------------------------
+void resetPeakBytes() noexcept;
+
+} // end namespace bench
+
+#endif
@@ -0,0 +1,203 @@
+#ifndef BENCHHARNESS_H_
+#define BENCHHARNESS_H_
+#include "AllocationCounter.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file BenchHarness.h
+/// @brief a very small benchmark harness so MorphBench has no external dependencies. Each case is run until it
+/// has taken at least the minimum time, every iteration is timed individually and the min / median / mean are
+/// reported. The JSON output uses the same field names as Google Benchmark so the same tools can compare runs
+//----------------------------------------------------------------------------------------------------------------------
+namespace bench
+{
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief stop the compiler removing work whose result isn't otherwise used
+//----------------------------------------------------------------------------------------------------------------------
+template <typename T>
+inline void doNotOptimize(const T &_value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+  asm volatile("" : : "r,m"(_value) : "memory");
+#else
+  static volatile const void *sink;
+  sink = &_value;
+#endif
+}
+
+struct Result
+{
+  std::string m_name;
+  size_t m_iterations = 0;
+  double m_minNs = 0.0;
+  double m_medianNs = 0.0;
+  double m_meanNs = 0.0;
+  double m_maxNs = 0.0;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief work done per iteration, 0 if it doesn't make sense for the case
+  //----------------------------------------------------------------------------------------------------------------------
+  double m_bytes = 0.0;
+  double m_items = 0.0;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief mean heap allocations per iteration and the most the heap grew during any one iteration
+  //----------------------------------------------------------------------------------------------------------------------
+  double m_allocations = 0.0;
+  size_t m_peakBytes = 0;
+};
+
+class Harness
+{
+  public:
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @param [in] _minSeconds run each case for at least this long
+    /// @param [in] _filter only run cases whose name contains this
+    //----------------------------------------------------------------------------------------------------------------------
+    Harness(double _minSeconds, std::string _filter) : m_minSeconds(_minSeconds), m_filter(std::move(_filter)) {}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief true if a case would be run, use this to skip expensive setup
+    //----------------------------------------------------------------------------------------------------------------------
+    bool enabled(const std::string &_name) const { return m_filter.empty() || _name.find(m_filter) != std::string::npos; }
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief time a case
+    /// @param [in] _name the case name, / separated from general to specific
+    /// @param [in] _func called once per iteration
+    /// @param [in] _bytes bytes processed per iteration, used for bytes_per_second
+    /// @param [in] _items items (vertices, deltas ...) processed per iteration, used for items_per_second
+    //----------------------------------------------------------------------------------------------------------------------
+    template <typename Func>
+    void run(const std::string &_name, Func &&_func, double _bytes = 0.0, double _items = 0.0)
+    {
+      if (!enabled(_name))
+      {
+        return;
+      }
+      std::vector<double> times;
+      double total = 0.0;
+      size_t allocations = 0;
+      size_t peakBytes = 0;
+      // at least 3 iterations unless a single one already takes longer than the minimum time
+      while (total < m_minSeconds || (times.size() < 3 && total < m_minSeconds * 3.0))
+      {
+        resetPeakBytes();
+        const auto before = allocationStats();
+        auto start = std::chrono::steady_clock::now();
+        _func();
+        auto ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        const auto after = allocationStats();
+        allocations += after.m_allocations - before.m_allocations;
+        peakBytes = std::max(peakBytes, after.m_peakBytes - before.m_liveBytes);
+        times.push_back(ns);
+        total += ns * 1e-9;
+      }
+      Result r;
+      r.m_name = _name;
+      r.m_iterations = times.size();
+      r.m_bytes = _bytes;
+      r.m_items = _items;
+      r.m_meanNs = total * 1e9 / times.size();
+      r.m_allocations = static_cast<double>(allocations) / times.size();
+      r.m_peakBytes = peakBytes;
+      std::sort(times.begin(), times.end());
+      r.m_minNs = times.front();
+      r.m_maxNs = times.back();
+      r.m_medianNs = times[times.size() / 2];
+      std::fprintf(stderr, "%-60s %8zu iter  min %12.0f ns  median %12.0f ns", r.m_name.c_str(), r.m_iterations, r.m_minNs,
+                   r.m_medianNs);
+      if (_bytes > 0.0)
+      {
+        std::fprintf(stderr, "  %9.1f MB/s", _bytes / (r.m_medianNs * 1e-9) / (1024.0 * 1024.0));
+      }
+      if (_items > 0.0)
+      {
+        std::fprintf(stderr, "  %9.2f M items/s", _items / (r.m_medianNs * 1e-9) * 1e-6);
+      }
+      if (r.m_allocations > 0.0)
+      {
+        std::fprintf(stderr, "  %9.0f allocs  %9.2f MB peak", r.m_allocations, r.m_peakBytes / (1024.0 * 1024.0));
+      }
+      std::fprintf(stderr, "\n");
+      m_results.push_back(r);
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief extra key / value pairs for the context block, e.g. thread counts or mesh sizes
+    //----------------------------------------------------------------------------------------------------------------------
+    void addContext(const std::string &_key, const std::string &_value) { m_context.emplace_back(_key, _value); }
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief write all the results as JSON, times use the median as it is the most stable between runs
+    //----------------------------------------------------------------------------------------------------------------------
+    void writeJson(std::ostream &_out) const
+    {
+      const auto precision = _out.precision(12);
+      char date[32];
+      std::time_t now = std::time(nullptr);
+      std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+      _out << "{\n  \"context\": {\n    \"date\": \"" << date << "\",\n";
+      _out << "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n";
+#if defined(NDEBUG)
+      _out << "    \"library_build_type\": \"release\"";
+#else
+      _out << "    \"library_build_type\": \"debug\"";
+#endif
+      for (const auto &c : m_context)
+      {
+        _out << ",\n    \"" << escape(c.first) << "\": \"" << escape(c.second) << '"';
+      }
+      _out << "\n  },\n  \"benchmarks\": [";
+      for (size_t i = 0; i < m_results.size(); ++i)
+      {
+        const auto &r = m_results[i];
+        _out << (i ? ",\n" : "\n") << "    {\n";
+        _out << "      \"name\": \"" << escape(r.m_name) << "\",\n";
+        _out << "      \"iterations\": " << r.m_iterations << ",\n";
+        _out << "      \"real_time\": " << r.m_medianNs << ",\n";
+        _out << "      \"min_time\": " << r.m_minNs << ",\n";
+        _out << "      \"mean_time\": " << r.m_meanNs << ",\n";
+        _out << "      \"max_time\": " << r.m_maxNs << ",\n";
+        _out << "      \"time_unit\": \"ns\"";
+        if (r.m_bytes > 0.0)
+        {
+          _out << ",\n      \"bytes_per_second\": " << r.m_bytes / (r.m_medianNs * 1e-9);
+        }
+        if (r.m_items > 0.0)
+        {
+          _out << ",\n      \"items_per_second\": " << r.m_items / (r.m_medianNs * 1e-9);
+        }
+        _out << ",\n      \"allocs_per_iter\": " << r.m_allocations;
+        _out << ",\n      \"max_bytes_used\": " << r.m_peakBytes;
+        _out << "\n    }";
+      }
+      _out << "\n  ]\n}\n";
+      _out.precision(precision);
+    }
+
+  private:
+    static std::string escape(const std::string &_s)
+    {
+      std::string out;
+      for (char c : _s)
+      {
+        if (c == '"' || c == '\\')
+        {
+          out += '\\';
+        }
+        out += c;
+      }
+      return out;
+    }
+    double m_minSeconds;
+    std::string m_filter;
+    std::vector<Result> m_results;
+    std::vector<std::pair<std::string, std::string>> m_context;
+};
+
+} // end namespace bench
+
+#endif
@@ -0,0 +1,734 @@
+/****************************************************************************
+headless micro benchmarks for morphcore, writes JSON results to stdout (or --out)
+and a readable summary to stderr
+usage : MorphBench [--out results.json] [--filter name] [--min-time seconds]
+                   [--models dir] [--vertices n] [--quick]
+****************************************************************************/
+#include "Arena.h"
+#include "BenchHarness.h"
+#include "CrowdState.h"
+#include "MeshOptimizer.h"
+#include "MorphCache.h"
+#include "MorphLoader.h"
+#include "MorphLod.h"
+#include "MorphMesh.h"
+#include "NormalRecompute.h"
+#include "ObjReader.h"
+#include "PoseLibrary.h"
+#include "PoseValidator.h"
+#include "Profiler.h"
+#include "QuantizedDeltas.h"
+#include "Skeleton.h"
+#include "Skinning.h"
+#include "SoAMorphMesh.h"
+#include "SparseMorphMesh.h"
+#include "TargetRig.h"
+#include "ThreadPool.h"
+#include "WeightAnimation.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+struct Options
+{
+  std::string m_out;
+  std::string m_filter;
+  double m_minTime = 0.5;
+  std::string m_models = "models";
+  size_t m_vertices = 1 << 20;
+};
+
+void usage(const char *_exe)
+{
+  std::cerr << "usage : " << _exe << " [--out results.json] [--filter name] [--min-time seconds] [--models dir]"
+            << " [--vertices n] [--quick]\n";
+}
+
+std::string caseName(const std::string &_base, size_t _verts, size_t _targets)
+{
+  return _base + "/verts:" + std::to_string(_verts) + "/targets:" + std::to_string(_targets);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+// build with a scratch arena that one untimed build has grown and reset() has merged into a single block, so the
+// case times the steady state of a tool building mesh after mesh rather than the arena's first growth. The arena
+// is held between iterations so it isn't in the case's peak, its size is printed and added to the context so the
+// two build cases can be compared fairly
+//----------------------------------------------------------------------------------------------------------------------
+void benchArenaBuild(bench::Harness &_harness, const std::string &_name, morph::MorphMesh &io_mesh,
+                     const std::vector<morph::PoseData> &_poses, double _items)
+{
+  if (!_harness.enabled(_name))
+  {
+    return;
+  }
+  morph::Arena scratch;
+  io_mesh.build(_poses, nullptr, &scratch);
+  scratch.reset();
+  _harness.run(_name, [&]() { io_mesh.build(_poses, nullptr, &scratch); }, 0.0, _items);
+  std::fprintf(stderr, "%-60s held %.2f MB of arena between builds, not counted in its peak\n", _name.c_str(),
+               scratch.capacity() / (1024.0 * 1024.0));
+  _harness.addContext(_name + " arena_bytes", std::to_string(scratch.capacity()));
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+// a square grid of at least _numVerts vertices, each target moves a contiguous run of _density * vertices which
+// is about what a facial blend shape does to a character mesh
+//----------------------------------------------------------------------------------------------------------------------
+morph::MorphMesh syntheticMesh(size_t _numVerts, size_t _numTargets, float _density)
+{
+  const size_t side = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(_numVerts))));
+  const size_t nVerts = side * side;
+  std::vector<morph::Vec3> vertices(nVerts * 2);
+  for (size_t y = 0; y < side; ++y)
+  {
+    for (size_t x = 0; x < side; ++x)
+    {
+      vertices[(y * side + x) * 2] = morph::Vec3(static_cast<float>(x), static_cast<float>(y), 0.0f);
+      vertices[(y * side + x) * 2 + 1] = morph::Vec3(0.0f, 0.0f, 1.0f);
+    }
+  }
+  std::vector<uint32_t> indices;
+  indices.reserve((side - 1) * (side - 1) * 6);
+  for (size_t y = 0; y + 1 < side; ++y)
+  {
+    for (size_t x = 0; x + 1 < side; ++x)
+    {
+      auto i = static_cast<uint32_t>(y * side + x);
+      auto s = static_cast<uint32_t>(side);
+      for (auto idx : {i, i + 1, i + s, i + 1, i + s + 1, i + s})
+      {
+        indices.push_back(idx);
+      }
+    }
+  }
+  const size_t moved = std::max<size_t>(1, static_cast<size_t>(_density * nVerts));
+  std::vector<morph::Vec3> deltas(_numTargets * nVerts * 2);
+  std::vector<std::string> names;
+  for (size_t t = 0; t < _numTargets; ++t)
+  {
+    names.push_back("synthetic" + std::to_string(t));
+    const size_t start = (t * 7919 * side) % nVerts;
+    for (size_t i = 0; i < moved; ++i)
+    {
+      const size_t v = (start + i) % nVerts;
+      const float phase = static_cast<float>(v) * 0.001f + static_cast<float>(t);
+      deltas[(t * nVerts + v) * 2] = morph::Vec3(0.1f * std::sin(phase), 0.1f * std::cos(phase), 0.5f * std::sin(phase * 0.5f));
+      deltas[(t * nVerts + v) * 2 + 1] = morph::Vec3(0.05f * std::cos(phase), 0.05f * std::sin(phase), -0.01f);
+    }
+  }
+  morph::MorphMesh mesh;
+  mesh.assign(vertices.data(), nVerts, std::move(indices), deltas.data(), names);
+  return mesh;
+}
+
+std::vector<morph::ActiveWeight> allActive(size_t _numTargets)
+{
+  std::vector<morph::ActiveWeight> active;
+  for (size_t t = 0; t < _numTargets; ++t)
+  {
+    active.push_back({static_cast<uint32_t>(t), 0.5f});
+  }
+  return active;
+}
+
+// the SoA evaluator with each kernel, on one thread and on the whole pool
+std::vector<std::pair<std::string, std::pair<morph::SimdLevel, bool>>> soaCases(size_t _verts, size_t _targets)
+{
+  std::vector<std::pair<std::string, std::pair<morph::SimdLevel, bool>>> cases;
+  for (auto level : {morph::SimdLevel::SCALAR, morph::SimdLevel::SSE, morph::SimdLevel::AVX2})
+  {
+    for (bool pool : {false, true})
+    {
+      auto name = std::string("eval/soa/") + morph::toString(level) + (pool ? "/threads:pool" : "/threads:1") + "/synthetic";
+      cases.push_back({caseName(name, _verts, _targets), {level, pool}});
+    }
+  }
+  return cases;
+}
+
+void benchSoA(bench::Harness &_harness, const morph::MorphMesh &_mesh, const std::vector<morph::ActiveWeight> &_active)
+{
+  morph::SoAMorphMesh soa;
+  soa.build(_mesh);
+  // check the kernels give exactly the same result as the reference (shader formula) before timing them
+  std::vector<morph::Vec3> refPositions, refNormals, positions, normals;
+  _mesh.evaluate(_active, refPositions, refNormals);
+  morph::SoAVertices out;
+  const auto n = _mesh.numVertices();
+  const auto targets = _mesh.numTargets();
+  for (const auto &c : soaCases(n, targets))
+  {
+    if (!_harness.enabled(c.first))
+    {
+      continue;
+    }
+    soa.setSimdLevel(c.second.first);
+    if (soa.simdLevel() != c.second.first)
+    {
+      std::cerr << "skipping " << c.first << ", not supported on this CPU\n";
+      continue;
+    }
+    morph::ThreadPool *pool = c.second.second ? &morph::ThreadPool::global() : nullptr;
+    soa.evaluate(_active, out, pool);
+    out.toAoS(positions, normals);
+    if (positions != refPositions || normals != refNormals)
+    {
+      std::cerr << c.first << " doesn't match MorphMesh::evaluate\n";
+      std::exit(EXIT_FAILURE);
+    }
+    _harness.run(c.first, [&]() { soa.evaluate(_active, out, pool); },
+                 static_cast<double>(targets * n * 2 * sizeof(morph::Vec3)), static_cast<double>(targets * n));
+  }
+}
+
+// a spine chain bound by distance skinning the morphed mesh, items are vertices
+void benchSkin(bench::Harness &_harness, const std::vector<morph::Vec3> &_positions, const std::vector<morph::Vec3> &_normals)
+{
+  morph::Vec3 lo = _positions[0];
+  morph::Vec3 hi = _positions[0];
+  for (const auto &p : _positions)
+  {
+    lo = {std::min(lo.m_x, p.m_x), std::min(lo.m_y, p.m_y), std::min(lo.m_z, p.m_z)};
+    hi = {std::max(hi.m_x, p.m_x), std::max(hi.m_y, p.m_y), std::max(hi.m_z, p.m_z)};
+  }
+  constexpr size_t numJoints = 8;
+  morph::Skeleton skeleton;
+  skeleton.buildChain({(lo.m_x + hi.m_x) * 0.5f, lo.m_y, (lo.m_z + hi.m_z) * 0.5f},
+                      {(lo.m_x + hi.m_x) * 0.5f, hi.m_y, (lo.m_z + hi.m_z) * 0.5f}, numJoints);
+  std::vector<morph::RigidTransform> local(numJoints);
+  for (size_t j = 0; j < numJoints; ++j)
+  {
+    local[j] = skeleton.bindLocal(j);
+    local[j].m_rotation = morph::Quat::fromAxisAngle({0.0f, 1.0f, 0.0f}, 0.3f);
+  }
+  morph::SkinPalette palette;
+  _harness.run("skin/palette/joints:8", [&]() { skeleton.computePalette(local, palette); }, 0.0, numJoints);
+  skeleton.computePalette(local, palette);
+  const auto n = static_cast<double>(_positions.size());
+  std::vector<morph::Vec3> positions, normals, refPositions, refNormals;
+  for (size_t influences : {4, 8})
+  {
+    morph::SkinWeights weights;
+    weights.reset(_positions.size(), influences);
+    morph::computeDistanceWeights(_positions, skeleton, (hi.m_y - lo.m_y) / (numJoints - 1), weights);
+    for (auto method : {morph::SkinMethod::LINEAR, morph::SkinMethod::DUAL_QUATERNION})
+    {
+      // the SSE kernel sums in a different order so check it against the scalar one to a tolerance
+      morph::skinVertices(weights, palette, method, _positions, _normals, refPositions, refNormals, nullptr,
+                          morph::SimdLevel::SCALAR);
+      for (auto level : {morph::SimdLevel::SCALAR, morph::SimdLevel::SSE})
+      {
+        if (level != morph::SimdLevel::SCALAR && morph::detectSimdLevel() == morph::SimdLevel::SCALAR)
+        {
+          continue;
+        }
+        for (bool pool : {false, true})
+        {
+          const auto name = std::string("skin/") + morph::toString(method) + '/' + morph::toString(level) +
+                            (pool ? "/threads:pool" : "/threads:1") + "/BrucePose:" + std::to_string(influences);
+          if (!_harness.enabled(name))
+          {
+            continue;
+          }
+          morph::ThreadPool *threads = pool ? &morph::ThreadPool::global() : nullptr;
+          morph::skinVertices(weights, palette, method, _positions, _normals, positions, normals, threads, level);
+          for (size_t v = 0; v < positions.size(); ++v)
+          {
+            if ((positions[v] - refPositions[v]).length() > 1e-4f || (normals[v] - refNormals[v]).length() > 1e-4f)
+            {
+              std::cerr << name << " doesn't match the scalar kernel\n";
+              std::exit(EXIT_FAILURE);
+            }
+          }
+          _harness.run(name,
+                       [&]()
+                       { morph::skinVertices(weights, palette, method, _positions, _normals, positions, normals, threads, level); },
+                       static_cast<double>(weights.memoryBytes() + _positions.size() * 4 * sizeof(morph::Vec3)), n);
+        }
+      }
+    }
+  }
+}
+
+void benchBruce(bench::Harness &_harness, const Options &_options)
+{
+  const std::vector<std::string> files = {_options.m_models + "/BrucePose1.obj", _options.m_models + "/BrucePose2.obj",
+                                          _options.m_models + "/BrucePose3.obj"};
+  std::error_code ec;
+  if (!std::filesystem::exists(files[0], ec))
+  {
+    std::cerr << "skipping BrucePose cases, " << files[0] << " not found (use --models)\n";
+    return;
+  }
+  double totalBytes = 0.0;
+  for (const auto &f : files)
+  {
+    totalBytes += static_cast<double>(std::filesystem::file_size(f, ec));
+  }
+
+  morph::PoseData pose;
+  _harness.run("obj/readObj/BrucePose1", [&]() { morph::readObj(files[0], pose); },
+               static_cast<double>(std::filesystem::file_size(files[0], ec)));
+  std::vector<morph::PoseData> poses;
+  _harness.run("obj/readObjs/BrucePose", [&]() { morph::readObjs(files, poses); }, totalBytes);
+  if (!morph::readObjs(files, poses) || !morph::validatePoses(poses))
+  {
+    std::cerr << "skipping BrucePose cases, unable to load the poses\n";
+    return;
+  }
+  _harness.run("validate/validatePoses/BrucePose",
+               [&]()
+               {
+                 auto copy = poses;
+                 bench::doNotOptimize(morph::validatePoses(copy));
+               });
+
+  morph::MorphMesh mesh;
+  _harness.run("build/MorphMesh/BrucePose", [&]() { mesh.build(poses); }, 0.0, static_cast<double>(poses[0].m_faces.size() * 3));
+  benchArenaBuild(_harness, "build/MorphMesh/BrucePose:arena", mesh, poses, static_cast<double>(poses[0].m_faces.size() * 3));
+  // the build case may have been filtered out
+  mesh.build(poses);
+  // the same work createMorphMesh does before the upload
+  _harness.run("pack/createMorphMesh/BrucePose",
+               [&]()
+               {
+                 std::vector<morph::Vec3> vertices, deltas;
+                 mesh.packVertices(vertices);
+                 mesh.packDeltas(deltas);
+                 auto shortIndices = morph::narrowIndices(mesh.indices());
+                 bench::doNotOptimize(vertices.data());
+                 bench::doNotOptimize(deltas.data());
+                 bench::doNotOptimize(shortIndices.data());
+               },
+               0.0, static_cast<double>(mesh.numVertices()));
+
+  std::vector<morph::Vec3> positions, normals;
+  const auto active = allActive(mesh.numTargets());
+  _harness.run(caseName("eval/dense/BrucePose", mesh.numVertices(), mesh.numTargets()),
+               [&]() { mesh.evaluate(active, positions, normals); }, 0.0, static_cast<double>(mesh.numVertices()));
+  // again the eval case may have been filtered out
+  mesh.evaluate(active, positions, normals);
+  morph::NormalRecompute recompute;
+  recompute.build(mesh.indices(), mesh.numVertices());
+  _harness.run("normals/recompute/BrucePose", [&]() { recompute.recompute(positions, normals); }, 0.0,
+               static_cast<double>(mesh.numVertices()));
+  benchSkin(_harness, positions, normals);
+  // the start up cost of --lod when there is no .lod file, items are the triangles of the full mesh
+  morph::MorphLod lod;
+  _harness.run("lod/build/BrucePose:5", [&]() { lod.build(mesh, 5); }, 0.0, static_cast<double>(mesh.indices().size() / 3));
+  // --stream 0 only keeps the target in use, so every request misses and this is the cost of bringing one in
+  morph::PoseLibrary library;
+  if (library.open(files, 0))
+  {
+    library.update();
+    size_t next = 0;
+    _harness.run("stream/poseLibrary/BrucePose",
+                 [&]()
+                 {
+                   const auto target = next++ % library.numTargets();
+                   library.request(target);
+                   library.wait();
+                   bench::doNotOptimize(library.request(target));
+                   library.update();
+                 },
+                 static_cast<double>(library.targetBytes()), 1.0);
+  }
+  // the background load from the objs (there is never an up to date cache with no name), base is how long the first
+  // frame waits and all is the whole mesh
+  _harness.run("load/loaderBase/BrucePose",
+               [&]()
+               {
+                 morph::MorphLoader loader;
+                 loader.start(files, "");
+                 while (loader.update() == morph::MorphLoader::State::LOADING_BASE)
+                 {
+                   std::this_thread::yield();
+                 }
+                 bench::doNotOptimize(loader.vertexData());
+               },
+               totalBytes);
+  _harness.run("load/loaderAll/BrucePose",
+               [&]()
+               {
+                 morph::MorphLoader loader;
+                 loader.start(files, "");
+                 bench::doNotOptimize(loader.wait());
+               },
+               totalBytes);
+  if (_harness.enabled("load/toMorphMesh/BrucePose"))
+  {
+    morph::MorphLoader loader;
+    loader.start(files, "");
+    loader.wait();
+    morph::MorphMesh loaded;
+    _harness.run("load/toMorphMesh/BrucePose", [&]() { loader.toMorphMesh(loaded); }, 0.0,
+                 static_cast<double>(loader.numVertices()));
+  }
+}
+
+void benchSynthetic(bench::Harness &_harness, const Options &_options)
+{
+  // the grid is square so round the size up to match the case names
+  const auto side = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(_options.m_vertices))));
+  const size_t nVerts = side * side;
+  const auto tmpFile = (std::filesystem::temp_directory_path() / "MorphBench.morph").string();
+  for (size_t targets : {1u, 4u, 16u})
+  {
+    for (float density : {1.0f, 0.1f, 0.01f})
+    {
+      const std::string suffix = "/density:" + std::to_string(static_cast<int>(density * 100)) + "%";
+      const auto soa = soaCases(nVerts, targets);
+      // building the mesh takes a while at this size so skip it if none of the cases are going to run
+      if (!_harness.enabled(caseName("eval/dense/synthetic", nVerts, targets)) &&
+          !_harness.enabled(caseName("build/SparseMorphMesh/synthetic", nVerts, targets) + suffix) &&
+          !_harness.enabled(caseName("eval/sparse/synthetic", nVerts, targets) + suffix) &&
+          !_harness.enabled(caseName("eval/sparseIncremental/synthetic", nVerts, targets) + suffix) &&
+          !_harness.enabled(caseName("normals/recompute/synthetic", nVerts, targets)) &&
+          !_harness.enabled(caseName("normals/recomputeIncremental/synthetic", nVerts, targets) + suffix) &&
+          (density != 1.0f || std::none_of(soa.begin(), soa.end(), [&](const auto &_c) { return _harness.enabled(_c.first); })))
+      {
+        continue;
+      }
+      auto mesh = syntheticMesh(nVerts, targets, density);
+      const auto active = allActive(targets);
+      const auto n = mesh.numVertices();
+      std::vector<morph::Vec3> positions, normals;
+      // the dense cost doesn't depend on the density so only time it once
+      if (density == 1.0f)
+      {
+        _harness.run(caseName("eval/dense/synthetic", n, targets), [&]() { mesh.evaluate(active, positions, normals); },
+                     static_cast<double>(targets * n * 2 * sizeof(morph::Vec3)), static_cast<double>(targets * n));
+        benchSoA(_harness, mesh, active);
+      }
+      morph::SparseMorphMesh sparse;
+      _harness.run(caseName("build/SparseMorphMesh/synthetic", n, targets) + suffix, [&]() { sparse.build(mesh); }, 0.0,
+                   static_cast<double>(targets * n));
+      // the build case may have been filtered out
+      if (sparse.numVertices() != n)
+      {
+        sparse.build(mesh);
+      }
+      const double deltas = static_cast<double>(sparse.numDeltas());
+      _harness.run(caseName("eval/sparse/synthetic", n, targets) + suffix, [&]() { sparse.evaluate(active, positions, normals); },
+                   0.0, deltas);
+      morph::SparseEvalState state;
+      sparse.initState(state);
+      bool flip = false;
+      auto incremental = active;
+      _harness.run(caseName("eval/sparseIncremental/synthetic", n, targets) + suffix,
+                   [&]()
+                   {
+                     // alternate the weights so every iteration has real work to do
+                     flip = !flip;
+                     for (auto &a : incremental)
+                     {
+                       a.m_weight = flip ? 0.25f : 0.75f;
+                     }
+                     sparse.evaluate(incremental, state);
+                   },
+                   0.0, deltas);
+      // normals for the blended mesh, the incremental update only touches the region the sparse evaluation wrote
+      morph::NormalRecompute recompute;
+      recompute.build(mesh.indices(), n);
+      std::vector<morph::Vec3> recomputed;
+      if (density == 1.0f)
+      {
+        _harness.run(caseName("normals/recompute/synthetic", n, targets),
+                     [&]() { recompute.recompute(state.m_positions, recomputed); }, 0.0, static_cast<double>(n));
+      }
+      // two poses and the vertices that differ between them, set up outside the timing so the case is only the
+      // normal update and compares directly with the full recompute above (eval/sparseIncremental times the rest)
+      for (auto &a : incremental)
+      {
+        a.m_weight = 0.25f;
+      }
+      sparse.evaluate(incremental, state);
+      const auto low = state.m_positions;
+      for (auto &a : incremental)
+      {
+        a.m_weight = 0.75f;
+      }
+      sparse.evaluate(incremental, state);
+      const auto &high = state.m_positions;
+      const auto &changed = state.m_changed;
+      recompute.recompute(high, recomputed);
+      _harness.run(caseName("normals/recomputeIncremental/synthetic", n, targets) + suffix,
+                   [&]()
+                   {
+                     flip = !flip;
+                     recompute.recompute(changed, flip ? low : high, recomputed);
+                   },
+                   0.0, static_cast<double>(changed.size()));
+    }
+
+    bool needed = false;
+    for (auto c : {"quantize/half", "quantize/int16", "quantize/int8", "cache/write", "cache/open", "cache/openNoChecksum",
+                   "cache/toMorphMesh"})
+    {
+      needed |= _harness.enabled(caseName(std::string(c) + "/synthetic", nVerts, targets));
+    }
+    if (!needed)
+    {
+      continue;
+    }
+    auto mesh = syntheticMesh(nVerts, targets, 0.1f);
+    const auto n = mesh.numVertices();
+    for (auto format : {morph::DeltaFormat::HALF, morph::DeltaFormat::INT16, morph::DeltaFormat::INT8})
+    {
+      morph::QuantizedMorphMesh quantized;
+      _harness.run(caseName(std::string("quantize/") + morph::toString(format) + "/synthetic", n, targets),
+                   [&]() { quantized.build(mesh, format); }, 0.0, static_cast<double>(targets * n));
+    }
+    const double fileBytes = static_cast<double>((n * 2 + targets * n * 2) * sizeof(morph::Vec3) + mesh.indices().size() * 4);
+    _harness.run(caseName("cache/write/synthetic", n, targets), [&]() { morph::MorphCache::write(tmpFile, mesh, 0); }, fileBytes);
+    if (morph::MorphCache::write(tmpFile, mesh, 0))
+    {
+      _harness.run(caseName("cache/open/synthetic", n, targets),
+                   [&]()
+                   {
+                     morph::MorphCache cache;
+                     bench::doNotOptimize(cache.open(tmpFile));
+                   },
+                   fileBytes);
+      _harness.run(caseName("cache/openNoChecksum/synthetic", n, targets),
+                   [&]()
+                   {
+                     morph::MorphCache cache;
+                     bench::doNotOptimize(cache.open(tmpFile, 0, false));
+                   },
+                   fileBytes);
+      morph::MorphCache cache;
+      cache.open(tmpFile);
+      morph::MorphMesh loaded;
+      _harness.run(caseName("cache/toMorphMesh/synthetic", n, targets), [&]() { cache.toMorphMesh(loaded); }, fileBytes);
+    }
+    std::error_code ec;
+    std::filesystem::remove(tmpFile, ec);
+  }
+
+  // the full build path (weld, vertex cache and fetch ordering) on a large mesh
+  if (!_harness.enabled(caseName("build/MorphMesh/synthetic", nVerts, 1)) &&
+      !_harness.enabled(caseName("build/MorphMesh/synthetic", nVerts, 1) + ":arena"))
+  {
+    return;
+  }
+  auto grid = syntheticMesh(nVerts, 1, 0.1f);
+  std::vector<morph::PoseData> poses(2);
+  for (auto &p : poses)
+  {
+    p.m_verts = grid.basePositions();
+    p.m_normals = grid.baseNormals();
+    const auto &idx = grid.indices();
+    for (size_t i = 0; i < idx.size(); i += 3)
+    {
+      p.m_faces.push_back({{{idx[i], idx[i + 1], idx[i + 2]}}, {{idx[i], idx[i + 1], idx[i + 2]}}});
+    }
+  }
+  morph::MorphMesh built;
+  _harness.run(caseName("build/MorphMesh/synthetic", grid.numVertices(), 1), [&]() { built.build(poses); }, 0.0,
+               static_cast<double>(grid.indices().size()));
+  benchArenaBuild(_harness, caseName("build/MorphMesh/synthetic", grid.numVertices(), 1) + ":arena", built, poses,
+                  static_cast<double>(grid.indices().size()));
+}
+
+void benchAnimation(bench::Harness &_harness)
+{
+  // a few shared curves played by many looping channels, each frame moves the clock on by 1/60 s
+  for (size_t channels : {1000u, 100000u})
+  {
+    const auto name = "anim/evaluate/channels:" + std::to_string(channels);
+    if (!_harness.enabled(name))
+    {
+      continue;
+    }
+    morph::WeightAnimation animation;
+    for (int c = 0; c < 8; ++c)
+    {
+      std::vector<morph::Keyframe> keys;
+      for (int k = 0; k <= 16; ++k)
+      {
+        keys.push_back({k * 0.25f, static_cast<float>((k * 7 + c) % 11) / 10.0f});
+      }
+      animation.addCurve(keys, static_cast<morph::Interpolation>(c % 3));
+    }
+    std::vector<float> weights(channels, 0.0f);
+    for (size_t i = 0; i < channels; ++i)
+    {
+      animation.play(animation.addChannel(static_cast<int>(i % 8), i, true), -static_cast<double>(i % 97) * 0.01);
+    }
+    double time = 0.0;
+    _harness.run(name,
+                 [&]()
+                 {
+                   time += 1.0 / 60.0;
+                   bench::doNotOptimize(animation.evaluate(time, weights));
+                 },
+                 0.0, static_cast<double>(channels));
+  }
+  // a face rig sized library, 256 drivers with three in-betweens each plus a corrective for every neighbouring
+  // pair, items are the targets written
+  const size_t drivers = 256;
+  morph::TargetRig rig;
+  for (size_t d = 0; d < drivers; ++d)
+  {
+    rig.addDriver(std::to_string(d));
+    for (size_t i = 0; i < 3; ++i)
+    {
+      rig.addInBetween(d * 3 + i, d, static_cast<float>(i + 1) / 3.0f);
+    }
+  }
+  for (size_t d = 0; d + 1 < drivers; ++d)
+  {
+    rig.addCombination(drivers * 3 + d, {d, d + 1});
+  }
+  const size_t numTargets = drivers * 4 - 1;
+  rig.build(numTargets);
+  std::vector<float> driverWeights(drivers);
+  for (size_t d = 0; d < drivers; ++d)
+  {
+    driverWeights[d] = static_cast<float>(d % 5) * 0.3f;
+  }
+  std::vector<float> targetWeights;
+  _harness.run("anim/rig/drivers:256", [&]() { rig.evaluate(driverWeights, targetWeights); }, 0.0,
+               static_cast<double>(numTargets));
+}
+
+void benchCrowd(bench::Harness &_harness)
+{
+  // the per frame CPU side of --crowd, animate the instances then pack the matrices for upload
+  for (size_t instances : {1000u, 100000u})
+  {
+    const auto name = "crowd/update/instances:" + std::to_string(instances);
+    if (!_harness.enabled(name))
+    {
+      continue;
+    }
+    morph::CrowdState crowd;
+    crowd.spawn(instances, 2, 15.0f);
+    std::vector<float> matrices;
+    double time = 0.0;
+    _harness.run(name,
+                 [&]()
+                 {
+                   time += 1.0 / 60.0;
+                   crowd.update(time);
+                   crowd.packMatrices(matrices);
+                   bench::doNotOptimize(matrices.data());
+                 },
+                 static_cast<double>(instances * (16 + crowd.numTargets()) * sizeof(float)), static_cast<double>(instances));
+  }
+}
+
+void benchProfiler(bench::Harness &_harness)
+{
+  // the cost the instrumentation adds to a frame, eight stages like paintGL with and without a trace capture
+  static const char *stages[] = {"frame", "animation", "normals", "uniforms", "draw", "morph pre-pass", "overlay", "swap"};
+  for (bool trace : {false, true})
+  {
+    const auto name = std::string("profile/scopedTimer/trace:") + (trace ? "on" : "off");
+    if (!_harness.enabled(name))
+    {
+      continue;
+    }
+    morph::Profiler profiler;
+    if (trace)
+    {
+      profiler.startTrace();
+    }
+    _harness.run(name,
+                 [&]()
+                 {
+                   for (const char *stage : stages)
+                   {
+                     morph::ScopedTimer timer(profiler, stage);
+                   }
+                 },
+                 0.0, static_cast<double>(std::size(stages)));
+  }
+}
+
+} // end anonymous namespace
+
+int main(int argc, char **argv)
+{
+  Options options;
+  for (int i = 1; i < argc; ++i)
+  {
+    std::string arg = argv[i];
+    auto next = [&]() -> std::string
+    {
+      if (i + 1 >= argc)
+      {
+        usage(argv[0]);
+        std::exit(EXIT_FAILURE);
+      }
+      return argv[++i];
+    };
+    if (arg == "--out")
+    {
+      options.m_out = next();
+    }
+    else if (arg == "--filter")
+    {
+      options.m_filter = next();
+    }
+    else if (arg == "--min-time")
+    {
+      options.m_minTime = std::atof(next().c_str());
+    }
+    else if (arg == "--models")
+    {
+      options.m_models = next();
+    }
+    else if (arg == "--vertices")
+    {
+      options.m_vertices = static_cast<size_t>(std::atoll(next().c_str()));
+    }
+    else if (arg == "--quick")
+    {
+      options.m_minTime = 0.05;
+      options.m_vertices = 1 << 16;
+    }
+    else
+    {
+      usage(argv[0]);
+      return arg == "-h" || arg == "--help" ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+  }
+
+  bench::Harness harness(options.m_minTime, options.m_filter);
+  harness.addContext("pool_threads", std::to_string(morph::ThreadPool::global().numThreads() + 1));
+  harness.addContext("synthetic_vertices", std::to_string(options.m_vertices));
+  benchBruce(harness, options);
+  benchSynthetic(harness, options);
+  benchAnimation(harness);
+  benchCrowd(harness);
+  benchProfiler(harness);
+
+  if (options.m_out.empty())
+  {
+    harness.writeJson(std::cout);
+  }
+  else
+  {
+    std::ofstream out(options.m_out);
+    harness.writeJson(out);
+    if (!out)
+    {
+      std::cerr << "unable to write " << options.m_out << '\n';
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,105 @@
+#ifndef ARENA_H_
+#define ARENA_H_
+#include "Span.h"
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file Arena.h
+/// @brief a bump allocator for the scratch buffers of a mesh build. Allocation is a pointer increment, nothing is
+/// freed one at a time, the whole arena is rewound to a mark or reset when the build is done. The memory is kept
+/// so a second build of the same size needs no new memory
+/// @class Arena
+/// @brief only trivial types can go in an arena as no destructors are ever run
+//----------------------------------------------------------------------------------------------------------------------
+namespace morph
+{
+class Arena
+{
+  public:
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief a position in the arena to rewind to
+    //----------------------------------------------------------------------------------------------------------------------
+    struct Mark
+    {
+      size_t m_block = 0;
+      size_t m_used = 0;
+      size_t m_inUse = 0;
+    };
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @param [in] _blockBytes the size of the first block, later blocks double until one fits the request
+    //----------------------------------------------------------------------------------------------------------------------
+    explicit Arena(size_t _blockBytes = 64 * 1024) noexcept : m_blockBytes(_blockBytes) {}
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief _bytes of uninitialised memory aligned to _alignment (a power of 2 no larger than max_align_t)
+    //----------------------------------------------------------------------------------------------------------------------
+    void *allocate(size_t _bytes, size_t _alignment = alignof(std::max_align_t));
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief an uninitialised array of _count T
+    //----------------------------------------------------------------------------------------------------------------------
+    template <typename T>
+    Span<T> allocate(size_t _count)
+    {
+      static_assert(std::is_trivially_destructible_v<T>, "arena memory is never destroyed");
+      static_assert(alignof(T) <= alignof(std::max_align_t), "over aligned types aren't supported");
+      return {static_cast<T *>(allocate(_count * sizeof(T), alignof(T))), _count};
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief an array of _count T all set to _value
+    //----------------------------------------------------------------------------------------------------------------------
+    template <typename T>
+    Span<T> allocate(size_t _count, const T &_value)
+    {
+      auto s = allocate<T>(_count);
+      for (auto &v : s)
+      {
+        new (&v) T(_value);
+      }
+      return s;
+    }
+    Mark mark() const noexcept { return {m_current, m_used, m_inUse}; }
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief release everything allocated since _mark, anything pointing into it is now invalid
+    //----------------------------------------------------------------------------------------------------------------------
+    void rewind(const Mark &_mark) noexcept;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief release everything. If the arena grew to more than one block they are replaced by a single block of
+    /// highWater() bytes so the next use of the same size fits in one contiguous block with nothing left over
+    //----------------------------------------------------------------------------------------------------------------------
+    void reset();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief bytes allocated from the heap for the blocks
+    //----------------------------------------------------------------------------------------------------------------------
+    size_t capacity() const noexcept;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the most bytes handed out at once since the arena was made, counting the worst case alignment
+    /// padding of each allocation so a single block of this size holds all of it
+    //----------------------------------------------------------------------------------------------------------------------
+    size_t highWater() const noexcept { return m_highWater; }
+
+  private:
+    struct Block
+    {
+      std::unique_ptr<char[]> m_data;
+      size_t m_size = 0;
+    };
+    std::vector<Block> m_blocks;
+    size_t m_current = 0;
+    size_t m_used = 0;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief bytes handed out across all the blocks, the space left at the end of a block that was moved past isn't
+    /// counted
+    //----------------------------------------------------------------------------------------------------------------------
+    size_t m_inUse = 0;
+    size_t m_blockBytes;
+    size_t m_highWater = 0;
+};
+
+} // end namespace morph
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef CROWDSTATE_H_
+#define CROWDSTATE_H_
+#include "MorphTypes.h"
+#include "ThreadPool.h"
+#include <cstdint>
+#include <vector>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file CrowdState.h
+/// @brief the per instance state of a crowd of morphing characters. Every field is its own array (SoA) so the
+/// per frame update is a set of independent streams, and the weights are stored target major which is also the
+/// layout the instanced shader reads them in (texel t * size() + gl_InstanceID) so they upload as is
+//----------------------------------------------------------------------------------------------------------------------
+namespace morph
+{
+class CrowdState
+{
+  public:
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief place _count characters on a square grid centred on the origin, each gets a random heading and
+    /// animation phase / rate
+    /// @param [in] _count the number of instances
+    /// @param [in] _numTargets the number of morph targets (weights) per instance
+    /// @param [in] _spacing distance between grid points
+    /// @param [in] _seed random seed so runs are repeatable
+    //----------------------------------------------------------------------------------------------------------------------
+    void spawn(size_t _count, size_t _numTargets, float _spacing, uint32_t _seed = 1);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief animate the weights and headings, this is a function of _time only so frames can be evaluated
+    /// in any order
+    //----------------------------------------------------------------------------------------------------------------------
+    void update(double _time, ThreadPool *_pool = &ThreadPool::global());
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief write a column major 4x4 model matrix per instance for upload
+    /// @param [out] o_matrices resized to 16 * size()
+    //----------------------------------------------------------------------------------------------------------------------
+    void packMatrices(std::vector<float> &o_matrices, ThreadPool *_pool = &ThreadPool::global()) const;
+
+    size_t size() const noexcept { return m_x.size(); }
+    size_t numTargets() const noexcept { return m_numTargets; }
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the weight of target t for instance i is weights()[t * size() + i]
+    //----------------------------------------------------------------------------------------------------------------------
+    const std::vector<float> &weights() const noexcept { return m_weights; }
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief where instance _i stands, the origin of its model matrix
+    //----------------------------------------------------------------------------------------------------------------------
+    Vec3 position(size_t _i) const noexcept { return {m_x[_i], m_y[_i], m_z[_i]}; }
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief half the width of the grid, for framing the camera
+    //----------------------------------------------------------------------------------------------------------------------
+    float extent() const noexcept { return m_extent; }
+
+  private:
+    size_t m_numTargets = 0;
+    float m_extent = 0.0f;
+    std::vector<float> m_x;
+    std::vector<float> m_y;
+    std::vector<float> m_z;
+    std::vector<float> m_baseHeading;
+    std::vector<float> m_heading;
+    std::vector<float> m_phase;
+    std::vector<float> m_rate;
+    std::vector<float> m_weights;
+};
+
+} // end namespace morph
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef HEADLESSRUN_H_
+#define HEADLESSRUN_H_
+#include <QSurfaceFormat>
+#include <functional>
+#include <string>
+
+class NGLScene;
+//----------------------------------------------------------------------------------------------------------------------
+/// @file HeadlessRun.h
+/// @brief render a scripted sequence of weights and camera poses into an offscreen framebuffer with no window, for
+/// automated performance runs and image regression tests on machines with no display or GPU (Mesa llvmpipe)
+//----------------------------------------------------------------------------------------------------------------------
+struct HeadlessOptions
+{
+  size_t m_frames = 300;
+  int m_width = 1024;
+  int m_height = 720;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the script time step is 1 / m_fps, it doesn't depend on how fast the frames render
+  //----------------------------------------------------------------------------------------------------------------------
+  double m_fps = 60.0;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief a weight curve file (see readWeightCurves), empty plays a built in loop over the first two targets
+  //----------------------------------------------------------------------------------------------------------------------
+  std::string m_curves;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief how far the camera turns around the model over the run in degrees
+  //----------------------------------------------------------------------------------------------------------------------
+  int m_orbit = 360;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief if set every frame is written as m_dumpDir/frame.0000.png onwards
+  //----------------------------------------------------------------------------------------------------------------------
+  std::string m_dumpDir;
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief create an offscreen context and framebuffer, build the scene in it and render the script, then print the
+/// throughput
+/// @param [in] _options the script and output
+/// @param [in] _format the OpenGL version and profile to ask for
+/// @param [in] _configure applies the command line settings to the scene before it is initialized
+/// @returns EXIT_SUCCESS or EXIT_FAILURE
+//----------------------------------------------------------------------------------------------------------------------
+int runHeadless(const HeadlessOptions &_options, const QSurfaceFormat &_format,
+                const std::function<void(NGLScene &)> &_configure);
+
+#endif
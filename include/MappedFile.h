@@ -0,0 +1,46 @@
+#ifndef MAPPEDFILE_H_
+#define MAPPEDFILE_H_
+#include <cstddef>
+#include <string>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file MappedFile.h
+/// @brief read only memory mapping of a whole file
+/// @class MappedFile
+/// @brief RAII wrapper around mmap (or MapViewOfFile on windows), the mapping is released when the object is
+/// destroyed so any pointers from data() must not outlive it
+//----------------------------------------------------------------------------------------------------------------------
+namespace morph
+{
+class MappedFile
+{
+  public:
+    MappedFile() = default;
+    explicit MappedFile(const std::string &_fname) { open(_fname); }
+    ~MappedFile();
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    MappedFile(MappedFile &&_other) noexcept;
+    MappedFile &operator=(MappedFile &&_other) noexcept;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief map the file, any previous mapping is released
+    /// @returns false if the file can't be opened or mapped
+    //----------------------------------------------------------------------------------------------------------------------
+    bool open(const std::string &_fname);
+    void close() noexcept;
+    bool isOpen() const noexcept { return m_data != nullptr; }
+    const char *data() const noexcept { return m_data; }
+    size_t size() const noexcept { return m_size; }
+
+  private:
+    const char *m_data = nullptr;
+    size_t m_size = 0;
+#if defined(_WIN32)
+    void *m_file = nullptr;
+    void *m_mapping = nullptr;
+#endif
+};
+
+} // end namespace morph
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef MAPPEDRING_H_
+#define MAPPEDRING_H_
+#include <ngl/Types.h>
+#include <cstddef>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file MappedRing.h
+/// @brief a GL buffer split into a few equal regions that the CPU writes in turn while the GPU reads the others.
+/// Each region has a fence placed after the commands that read it so a region is only written again once the GPU
+/// has finished with it, there is no implicit driver sync and no per write allocation. With GL 4.4 (buffer storage)
+/// the whole buffer stays mapped for its lifetime, otherwise each region is mapped unsynchronized as it is acquired
+//----------------------------------------------------------------------------------------------------------------------
+class MappedRing
+{
+  public:
+    MappedRing() = default;
+    ~MappedRing();
+    MappedRing(const MappedRing &) = delete;
+    MappedRing &operator=(const MappedRing &) = delete;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief create the buffer, the GL context must be current
+    /// @param [in] _target the binding the buffer is mapped through, e.g. GL_COPY_READ_BUFFER for staging
+    /// @param [in] _regionBytes the size of each region, rounded up to _alignment
+    /// @param [in] _numRegions how many regions can be in flight, 3 for per frame data
+    /// @param [in] _persistent map once with glBufferStorage, only if the context has GL 4.4
+    /// @param [in] _alignment the region alignment, e.g. GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT for a uniform ring
+    //----------------------------------------------------------------------------------------------------------------------
+    void create(GLenum _target, size_t _regionBytes, size_t _numRegions, bool _persistent, size_t _alignment = 256);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief wait for the next region to be free and return it for writing
+    /// @param [out] o_offset the region's offset in buffer()
+    /// @returns regionBytes() bytes to write, nullptr if the map failed
+    //----------------------------------------------------------------------------------------------------------------------
+    void *acquire(size_t &o_offset);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief finished writing the acquired region, it can be read by GL commands from now on
+    //----------------------------------------------------------------------------------------------------------------------
+    void submit();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief call after the GL commands reading the submitted region, it isn't handed out again until they are done
+    //----------------------------------------------------------------------------------------------------------------------
+    void fence();
+    void release();
+    GLuint buffer() const noexcept { return m_buffer; }
+    size_t regionBytes() const noexcept { return m_regionBytes; }
+    bool persistent() const noexcept { return m_persistent; }
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief how many acquires found the GPU still reading the region, each one is a CPU stall
+    //----------------------------------------------------------------------------------------------------------------------
+    size_t stalls() const noexcept { return m_stalls; }
+    static constexpr size_t c_maxRegions = 8;
+
+  private:
+    GLenum m_target = GL_COPY_READ_BUFFER;
+    GLuint m_buffer = 0;
+    size_t m_regionBytes = 0;
+    size_t m_numRegions = 0;
+    size_t m_current = 0;
+    bool m_persistent = false;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the whole buffer when it is persistently mapped, otherwise the region mapped by acquire
+    //----------------------------------------------------------------------------------------------------------------------
+    char *m_mapped = nullptr;
+    GLsync m_fences[c_maxRegions] = {};
+    size_t m_stalls = 0;
+};
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef MESHOPTIMIZER_H_
+#define MESHOPTIMIZER_H_
+#include "Arena.h"
+#include "MorphTypes.h"
+#include "Span.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file MeshOptimizer.h
+/// @brief functions to turn the obj face list into an indexed mesh and order it so the GPU post transform
+/// cache is used well
+//----------------------------------------------------------------------------------------------------------------------
+namespace morph
+{
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief the obj (vertex, normal) index pair a welded vertex came from
+//----------------------------------------------------------------------------------------------------------------------
+struct CornerKey
+{
+  uint32_t m_vert = 0;
+  uint32_t m_norm = 0;
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief weld the face corners, any corners that share the same (vertex, normal) index pair become one
+/// vertex. As all the poses share the base topology the index pair identifies the same data in every pose
+/// so this is exact and no float compares are needed
+/// @param [in] _faces the triangles
+/// @param [out] o_corners the source index pair for each unique vertex in order of first use
+/// @param [out] o_indices three indices per face into o_corners, this must already be that size
+/// @param [in] _scratch where the per vertex buckets go, it is rewound before returning. If null a temporary
+/// arena is used
+//----------------------------------------------------------------------------------------------------------------------
+void weldCorners(Span<const Face> _faces, std::vector<CornerKey> &o_corners, Span<uint32_t> o_indices,
+                 Arena *_scratch = nullptr);
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief re-order the triangles for the post transform vertex cache using Tom Forsyth's
+/// "Linear-Speed Vertex Cache Optimisation" scoring
+/// @param [in,out] io_indices the triangle list to re-order
+/// @param [in] _numVertices the number of vertices the indices refer to
+/// @param [in] _scratch where the adjacency and scores go, as for weldCorners
+//----------------------------------------------------------------------------------------------------------------------
+void optimizeVertexCache(Span<uint32_t> io_indices, size_t _numVertices, Arena *_scratch = nullptr);
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief re-number the vertices in the order the triangles first use them so vertex fetches walk through
+/// memory linearly
+/// @param [in,out] io_indices the triangle list, re-written with the new numbering
+/// @param [in] _numVertices the number of vertices the indices refer to
+/// @param [in] _scratch the first use table goes here, as for weldCorners
+/// @returns for each new vertex the old vertex it came from, unused vertices are dropped
+//----------------------------------------------------------------------------------------------------------------------
+std::vector<uint32_t> optimizeVertexFetch(Span<uint32_t> io_indices, size_t _numVertices, Arena *_scratch = nullptr);
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief simulate a FIFO post transform cache and return the average number of vertices transformed per
+/// triangle (ACMR), 3.0 is no re-use at all and ~0.5 - 0.7 is about as good as it gets
+//----------------------------------------------------------------------------------------------------------------------
+float averageCacheMissRatio(const std::vector<uint32_t> &_indices, size_t _numVertices, size_t _cacheSize = 16);
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief copy the indices to 16 bit, only valid if every index is < 65535
+//----------------------------------------------------------------------------------------------------------------------
+std::vector<uint16_t> narrowIndices(const std::vector<uint32_t> &_indices);
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief as above into storage the caller already has, e.g. a file or mapped buffer
+/// @param [out] o_indices room for _indices.size() indices
+//----------------------------------------------------------------------------------------------------------------------
+void narrowIndices(Span<const uint32_t> _indices, uint16_t *o_indices);
+
+} // end namespace morph
+
+#endif
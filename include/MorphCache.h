@@ -0,0 +1,116 @@
+#ifndef MORPHCACHE_H_
+#define MORPHCACHE_H_
+#include "MappedFile.h"
+#include "MorphMesh.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file MorphCache.h
+/// @brief a pre-baked binary version of a MorphMesh (.morph) so we don't have to parse the obj files at startup.
+/// The file is a MorphCacheHeader followed by 64 byte aligned sections holding the data in exactly the form
+/// the GPU wants it so it can be mapped and handed straight to glBufferData :
+///   vertices : interleaved position / normal floats (MorphMesh::packVertices)
+///   indices  : the triangle list as 16 or 32 bit values (see m_indexSize)
+///   deltas   : the texture buffer data (MorphMesh::packDeltas)
+///   names    : the target names, each terminated with a 0
+/// All values are little endian.
+//----------------------------------------------------------------------------------------------------------------------
+namespace morph
+{
+struct MorphCacheHeader
+{
+  char m_magic[8];
+  uint32_t m_version;
+  uint32_t m_headerSize;
+  uint64_t m_fileSize;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the sourceStamp of the obj files the cache was baked from, used to spot stale caches
+  //----------------------------------------------------------------------------------------------------------------------
+  uint64_t m_sourceStamp;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief checksum of everything after the header
+  //----------------------------------------------------------------------------------------------------------------------
+  uint64_t m_checksum;
+  uint32_t m_numVertices;
+  uint32_t m_numIndices;
+  uint32_t m_numTargets;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief bytes per index 2 or 4
+  //----------------------------------------------------------------------------------------------------------------------
+  uint32_t m_indexSize;
+  uint64_t m_vertexOffset;
+  uint64_t m_indexOffset;
+  uint64_t m_deltaOffset;
+  uint64_t m_nameOffset;
+  uint64_t m_nameSize;
+};
+// the header is read straight out of the mapping so its layout is part of the file format
+static_assert(sizeof(MorphCacheHeader) == 96, "MorphCacheHeader layout changed, bump c_version");
+static_assert(offsetof(MorphCacheHeader, m_version) == 8 && offsetof(MorphCacheHeader, m_headerSize) == 12 &&
+                  offsetof(MorphCacheHeader, m_fileSize) == 16 && offsetof(MorphCacheHeader, m_sourceStamp) == 24 &&
+                  offsetof(MorphCacheHeader, m_checksum) == 32 && offsetof(MorphCacheHeader, m_numVertices) == 40 &&
+                  offsetof(MorphCacheHeader, m_numIndices) == 44 && offsetof(MorphCacheHeader, m_numTargets) == 48 &&
+                  offsetof(MorphCacheHeader, m_indexSize) == 52 && offsetof(MorphCacheHeader, m_vertexOffset) == 56 &&
+                  offsetof(MorphCacheHeader, m_indexOffset) == 64 && offsetof(MorphCacheHeader, m_deltaOffset) == 72 &&
+                  offsetof(MorphCacheHeader, m_nameOffset) == 80 && offsetof(MorphCacheHeader, m_nameSize) == 88,
+              "MorphCacheHeader layout changed, bump c_version");
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @class MorphCache
+/// @brief writes and reads .morph files, reading maps the file so the data accessors point straight into the
+/// mapping and are only valid while the MorphCache is open
+//----------------------------------------------------------------------------------------------------------------------
+class MorphCache
+{
+  public:
+    static constexpr uint32_t c_version = 1;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief a hash of the file names (without the directory), sizes and modification times of the source files,
+    /// if any of them change the stamp changes and the cache is treated as stale. The directory is left out so the
+    /// same files reached by a relative or absolute path, or from another working directory, give the same stamp
+    //----------------------------------------------------------------------------------------------------------------------
+    static uint64_t sourceStamp(const std::vector<std::string> &_files);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief write a mesh to a .morph file
+    /// @param [in] _fname the file to write
+    /// @param [in] _mesh the mesh to write
+    /// @param [in] _sourceStamp the sourceStamp of the files the mesh was built from
+    //----------------------------------------------------------------------------------------------------------------------
+    static bool write(const std::string &_fname, const MorphMesh &_mesh, uint64_t _sourceStamp);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief map and validate a .morph file
+    /// @param [in] _fname the file to open
+    /// @param [in] _sourceStamp the expected source stamp, 0 to skip the stale check
+    /// @param [in] _verifyChecksum check the payload checksum, this reads the whole file
+    /// @returns false if the file is missing, corrupt, the wrong version or stale
+    //----------------------------------------------------------------------------------------------------------------------
+    bool open(const std::string &_fname, uint64_t _sourceStamp = 0, bool _verifyChecksum = true);
+    void close() noexcept { m_file.close(); }
+    bool isOpen() const noexcept { return m_file.isOpen(); }
+
+    const MorphCacheHeader &header() const noexcept { return *reinterpret_cast<const MorphCacheHeader *>(m_file.data()); }
+    size_t numVertices() const noexcept { return header().m_numVertices; }
+    size_t numIndices() const noexcept { return header().m_numIndices; }
+    size_t numTargets() const noexcept { return header().m_numTargets; }
+    size_t indexSize() const noexcept { return header().m_indexSize; }
+    const float *vertexData() const noexcept { return reinterpret_cast<const float *>(m_file.data() + header().m_vertexOffset); }
+    const void *indexData() const noexcept { return m_file.data() + header().m_indexOffset; }
+    const float *deltaData() const noexcept { return reinterpret_cast<const float *>(m_file.data() + header().m_deltaOffset); }
+    size_t vertexBytes() const noexcept { return numVertices() * 2 * sizeof(Vec3); }
+    size_t deltaBytes() const noexcept { return numTargets() * numVertices() * 2 * sizeof(Vec3); }
+    std::vector<std::string> targetNames() const;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief copy the cache into a MorphMesh for CPU evaluation
+    //----------------------------------------------------------------------------------------------------------------------
+    void toMorphMesh(MorphMesh &o_mesh) const;
+
+  private:
+    MappedFile m_file;
+};
+
+} // end namespace morph
+
+#endif
@@ -0,0 +1,126 @@
+#ifndef MORPHLOADER_H_
+#define MORPHLOADER_H_
+#include "MorphCache.h"
+#include "MorphMesh.h"
+#include "PoseLibrary.h"
+#include "ThreadPool.h"
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file MorphLoader.h
+/// @brief loads a morph mesh in the background so the viewer can draw while it arrives. The base mesh comes first
+/// then the targets one by one, from the .morph cache when it is up to date or else from the obj files through a
+/// PoseLibrary. The reading, parsing and packing all run on the ThreadPool, the owner only polls (update) and
+/// takes the results, so it never blocks on the disk
+//----------------------------------------------------------------------------------------------------------------------
+namespace morph
+{
+class MorphLoader
+{
+  public:
+    enum class State
+    {
+      IDLE,
+      LOADING_BASE,
+      LOADING_TARGETS,
+      DONE,
+      FAILED
+    };
+    MorphLoader() = default;
+    ~MorphLoader();
+    MorphLoader(const MorphLoader &) = delete;
+    MorphLoader &operator=(const MorphLoader &) = delete;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief start loading, returns straight away
+    /// @param [in] _files the base pose then one obj per target
+    /// @param [in] _cacheFile the .morph cache used instead of the objs if its stamp matches them
+    /// @param [in] _pool the pool the loads run on, every target is requested at once
+    //----------------------------------------------------------------------------------------------------------------------
+    void start(const std::vector<std::string> &_files, const std::string &_cacheFile,
+               ThreadPool *_pool = &ThreadPool::global());
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief pick up any finished loads, call once per frame from the thread that owns the loader
+    /// @returns the state after the update
+    //----------------------------------------------------------------------------------------------------------------------
+    State update();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief block until everything is loaded (or failed), for runs that want every frame complete
+    //----------------------------------------------------------------------------------------------------------------------
+    State wait();
+    State state() const noexcept { return m_state; }
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief true if the data came from the cache, otherwise the objs were parsed and a new cache can be written
+    /// once DONE
+    //----------------------------------------------------------------------------------------------------------------------
+    bool fromCache() const noexcept { return m_fromCache; }
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the base mesh, valid from LOADING_TARGETS. The layouts are MorphMesh::packVertices and 16 bit indices
+    /// when indexSize() is 2, the same as a MorphCache
+    //----------------------------------------------------------------------------------------------------------------------
+    const float *vertexData() const noexcept;
+    size_t numVertices() const noexcept { return m_numVertices; }
+    const void *indexData() const noexcept;
+    size_t numIndices() const noexcept { return m_numIndices; }
+    size_t indexSize() const noexcept { return m_indexSize; }
+    size_t numTargets() const noexcept { return m_numTargets; }
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief bytes of one target's packed deltas
+    //----------------------------------------------------------------------------------------------------------------------
+    size_t targetBytes() const noexcept { return m_numVertices * 2 * sizeof(Vec3); }
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief a target's deltas in the MorphMesh::packDeltas layout once it has loaded, nullptr before then
+    //----------------------------------------------------------------------------------------------------------------------
+    const Vec3 *targetDeltas(size_t _target) const noexcept;
+    size_t numTargetsLoaded() const noexcept { return m_numLoaded; }
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the whole mesh once DONE, e.g. to write a cache. Built from the loaded data so it is a copy
+    //----------------------------------------------------------------------------------------------------------------------
+    void toMorphMesh(MorphMesh &o_mesh) const;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief seconds from start to the base and to the last target
+    //----------------------------------------------------------------------------------------------------------------------
+    double baseSeconds() const noexcept { return m_baseSeconds; }
+    double totalSeconds() const noexcept { return m_totalSeconds; }
+
+  private:
+    double elapsed() const noexcept;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief open the cache or load the base pose, runs on the pool
+    //----------------------------------------------------------------------------------------------------------------------
+    bool loadBase();
+
+    State m_state = State::IDLE;
+    std::vector<std::string> m_files;
+    std::string m_cacheFile;
+    ThreadPool *m_pool = nullptr;
+    std::future<bool> m_baseLoad;
+    bool m_fromCache = false;
+    MorphCache m_cache;
+    std::unique_ptr<PoseLibrary> m_library;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the packed base when it comes from the objs, the cache already holds it packed
+    //----------------------------------------------------------------------------------------------------------------------
+    std::vector<Vec3> m_vertices;
+    std::vector<uint16_t> m_shortIndices;
+    size_t m_numVertices = 0;
+    size_t m_numIndices = 0;
+    size_t m_indexSize = 4;
+    size_t m_numTargets = 0;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the targets PoseLibrary has handed back, they stay resident as its budget is unlimited
+    //----------------------------------------------------------------------------------------------------------------------
+    std::vector<const Vec3 *> m_targetDeltas;
+    size_t m_numLoaded = 0;
+    std::chrono::steady_clock::time_point m_startTime;
+    double m_baseSeconds = 0.0;
+    double m_totalSeconds = 0.0;
+};
+
+} // end namespace morph
+
+#endif
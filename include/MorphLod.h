@@ -0,0 +1,99 @@
+#ifndef MORPHLOD_H_
+#define MORPHLOD_H_
+#include "MorphMesh.h"
+#include "ThreadPool.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file MorphLod.h
+/// @brief level of detail for morph meshes. The base mesh is simplified by quadric error (Garland / Heckbert) half
+/// edge collapses, which only ever move a vertex onto one of its neighbours, so every level keeps a subset of the
+/// original vertices and each target's deltas transfer to it exactly by copying
+//----------------------------------------------------------------------------------------------------------------------
+namespace morph
+{
+struct LodLevel
+{
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the full mesh vertices this level keeps, vertex i of the level is full mesh vertex m_vertices[i]
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<uint32_t> m_vertices;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the triangle list, indices into m_vertices
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<uint32_t> m_indices;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the largest deviation of any collapse in object space units (the root mean square distance to the
+  /// planes of the faces merged into the kept vertex), 0 for the full mesh
+  //----------------------------------------------------------------------------------------------------------------------
+  float m_error = 0.0f;
+
+  size_t numTriangles() const noexcept { return m_indices.size() / 3; }
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief simplify a triangle mesh
+/// @param [in] _positions the vertex positions
+/// @param [in] _indices the triangle list
+/// @param [in] _targetTriangles collapse until there are at most this many triangles, or nothing more can go
+/// @param [out] o_level the result, ordered for the vertex cache and fetch (see MeshOptimizer.h)
+/// @note vertices on an open edge are never removed, the normal seams of a welded mesh are open edges in index
+/// space so this also stops the seams tearing apart
+//----------------------------------------------------------------------------------------------------------------------
+void simplifyMesh(const std::vector<Vec3> &_positions, const std::vector<uint32_t> &_indices, size_t _targetTriangles,
+                  LodLevel &o_level);
+
+class MorphLod
+{
+  public:
+    static constexpr uint32_t c_version = 1;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief build the levels, level 0 is the full mesh and each level after aims for _ratio of the triangles of
+    /// the one before. The levels are simplified from the full mesh independently, one job each on the pool
+    /// @param [in] _mesh the full mesh
+    /// @param [in] _numLevels the number of levels including the full mesh
+    /// @param [in] _ratio triangle ratio between levels
+    /// @param [in] _pool pool to build the levels on, nullptr builds them on the calling thread
+    //----------------------------------------------------------------------------------------------------------------------
+    void build(const MorphMesh &_mesh, size_t _numLevels, float _ratio = 0.5f, ThreadPool *_pool = &ThreadPool::global());
+    size_t numLevels() const noexcept { return m_levels.size(); }
+    const LodLevel &level(size_t _level) const noexcept { return m_levels[_level]; }
+    float ratio() const noexcept { return m_ratio; }
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief make a MorphMesh of one level, the base vertices and the deltas of every target are copied from
+    /// the full mesh
+    /// @param [in] _full the mesh the levels were built from
+    //----------------------------------------------------------------------------------------------------------------------
+    void extract(const MorphMesh &_full, size_t _level, MorphMesh &o_mesh) const;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief pick the coarsest level whose error covers no more than _maxPixelError pixels on screen
+    /// @param [in] _distance distance from the eye to the mesh
+    /// @param [in] _pixelsPerUnit the size in pixels of 1 unit at distance 1, viewport height / (2 tan(fovy / 2))
+    /// @param [in] _maxPixelError the largest error allowed in pixels
+    //----------------------------------------------------------------------------------------------------------------------
+    size_t select(float _distance, float _pixelsPerUnit, float _maxPixelError = 1.0f) const noexcept;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief save the levels so they don't need building again
+    /// @param [in] _sourceStamp see MorphCache::sourceStamp
+    //----------------------------------------------------------------------------------------------------------------------
+    bool write(const std::string &_fname, uint64_t _sourceStamp) const;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief load levels written by write
+    /// @param [in] _sourceStamp the expected stamp, the file is stale if it differs
+    /// @param [in] _numVertices the full mesh vertex count, used to validate the file
+    /// @param [in] _numLevels the number of levels wanted
+    /// @param [in] _ratio the triangle ratio wanted
+    /// @returns false if the file is missing, corrupt, stale or was built with other settings
+    //----------------------------------------------------------------------------------------------------------------------
+    bool read(const std::string &_fname, uint64_t _sourceStamp, size_t _numVertices, size_t _numLevels, float _ratio);
+
+  private:
+    std::vector<LodLevel> m_levels;
+    float m_ratio = 0.5f;
+};
+
+} // end namespace morph
+
+#endif
@@ -0,0 +1,144 @@
+#ifndef MORPHMESH_H_
+#define MORPHMESH_H_
+#include "Arena.h"
+#include "MorphTarget.h"
+#include "MorphTypes.h"
+#include "Span.h"
+#include <string>
+#include <vector>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file MorphMesh.h
+/// @brief a headless blend shape mesh, this is the CPU side of the morph used in PerFragASDVert.glsl
+/// @class MorphMesh
+/// @brief holds a base mesh plus N MorphTargets and evaluates base + sum(weight[i] * delta[i]) on the CPU.
+/// The sum is done in target order with a separate multiply and add per term so it matches the shader
+/// evaluation finalP=finalP+(activeWeight[i]*delta) bit for bit (the library is built
+/// with floating point contraction disabled so the compiler can't fuse these into an fma)
+//----------------------------------------------------------------------------------------------------------------------
+namespace morph
+{
+struct CornerKey;
+
+class MorphMesh
+{
+  public:
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief build the morph mesh from a set of poses, pose 0 is the base mesh and every other pose becomes
+    /// a MorphTarget. The face list of the base is used for all poses, face corners with the same
+    /// (vertex, normal) pair are welded into one vertex and the result is an indexed triangle list ordered
+    /// for the post transform cache (see MeshOptimizer.h)
+    /// @param [in] _poses the poses, there must be at least one
+    /// @param [out] o_corners optional, the base (vertex, normal) index pair each vertex was welded from so more
+    /// poses can be turned into targets later without the base (see PoseLibrary)
+    /// @param [in] _scratch optional, the weld and optimise buffers are taken from here and it is rewound after.
+    /// Passing the same arena to repeated builds means they don't allocate any scratch
+    /// @returns false if the poses can't be used
+    //----------------------------------------------------------------------------------------------------------------------
+    bool build(Span<const PoseData> _poses, std::vector<CornerKey> *o_corners = nullptr, Arena *_scratch = nullptr);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief evaluate the blended mesh
+    /// @param [in] _weights one weight per target, missing weights are treated as 0
+    /// @param [out] o_positions the blended positions, resized to numVertices()
+    /// @param [out] o_normals the blended (un-normalized) normals, resized to numVertices()
+    //----------------------------------------------------------------------------------------------------------------------
+    void evaluate(const std::vector<float> &_weights, std::vector<Vec3> &o_positions, std::vector<Vec3> &o_normals) const;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief evaluate the blended mesh using a pre-gathered active list (see gatherActive)
+    //----------------------------------------------------------------------------------------------------------------------
+    void evaluate(const std::vector<ActiveWeight> &_active, std::vector<Vec3> &o_positions, std::vector<Vec3> &o_normals) const;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief build the list of targets with a non zero weight in target order
+    /// @param [in] _weights one weight per target, this must not be larger than the number of targets
+    /// @param [in] _maxActive if more than this many weights are non zero only the largest (by magnitude)
+    /// are kept, this is the limit of the shader uniform arrays
+    //----------------------------------------------------------------------------------------------------------------------
+    static std::vector<ActiveWeight> gatherActive(const std::vector<float> &_weights, size_t _maxActive = ~size_t(0));
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief move the _count largest weights (by magnitude) to the front of io_active, largest first, so a limited
+    /// resource such as the GPU delta slots goes to the targets that matter most. The rest keep no particular order
+    //----------------------------------------------------------------------------------------------------------------------
+    static void strongestFirst(std::vector<ActiveWeight> &io_active, size_t _count);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief pack all the deltas into one array for upload to a texture buffer. The layout is target major
+    /// with the position then normal delta for each vertex, so delta texel for target t, vertex v is
+    /// (t * numVertices() + v) * 2 for the position and +1 for the normal
+    //----------------------------------------------------------------------------------------------------------------------
+    void packDeltas(std::vector<Vec3> &o_deltas) const;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief as above into storage the caller already has (a file image or mapped buffer) so nothing is copied twice
+    /// @param [out] o_deltas room for numTargets() * numVertices() * 2 deltas
+    //----------------------------------------------------------------------------------------------------------------------
+    void packDeltas(Vec3 *o_deltas) const noexcept;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief pack the base mesh as interleaved position, normal pairs ready for the VBO
+    //----------------------------------------------------------------------------------------------------------------------
+    void packVertices(std::vector<Vec3> &o_vertices) const;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief as above into storage the caller already has
+    /// @param [out] o_vertices room for numVertices() * 2 vectors
+    //----------------------------------------------------------------------------------------------------------------------
+    void packVertices(Vec3 *o_vertices) const noexcept;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief set the mesh from already built data, used when loading a baked MorphCache
+    /// @param [in] _vertices interleaved position / normal pairs as written by packVertices
+    /// @param [in] _numVertices number of vertices in _vertices
+    /// @param [in] _indices the triangle list
+    /// @param [in] _deltas packed deltas as written by packDeltas
+    /// @param [in] _names the name of each target, this gives the target count
+    //----------------------------------------------------------------------------------------------------------------------
+    void assign(const Vec3 *_vertices, size_t _numVertices, std::vector<uint32_t> _indices, const Vec3 *_deltas,
+                const std::vector<std::string> &_names);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief as above with each target's packed deltas in its own buffer, e.g. straight from a PoseLibrary
+    /// @param [in] _targetDeltas one pointer per name to that target's numVertices * 2 deltas
+    //----------------------------------------------------------------------------------------------------------------------
+    void assign(const Vec3 *_vertices, size_t _numVertices, std::vector<uint32_t> _indices,
+                Span<const Vec3 *const> _targetDeltas, const std::vector<std::string> &_names);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief evaluate a single vertex, this is the reference implementation of the shader formula
+    //----------------------------------------------------------------------------------------------------------------------
+    Vec3 evaluatePosition(size_t _vertex, const std::vector<float> &_weights) const noexcept;
+    Vec3 evaluateNormal(size_t _vertex, const std::vector<float> &_weights) const noexcept;
+
+    size_t numVertices() const noexcept { return m_basePositions.size(); }
+    size_t numTargets() const noexcept { return m_targets.size(); }
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the triangle list, three indices per face into the vertex arrays
+    //----------------------------------------------------------------------------------------------------------------------
+    const std::vector<uint32_t> &indices() const noexcept { return m_indices; }
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief true if the indices can be stored as GL_UNSIGNED_SHORT (0xffff is left free for restart)
+    //----------------------------------------------------------------------------------------------------------------------
+    bool fitsIn16Bit() const noexcept { return numVertices() < 0xffff; }
+    const std::vector<Vec3> &basePositions() const noexcept { return m_basePositions; }
+    const std::vector<Vec3> &baseNormals() const noexcept { return m_baseNormals; }
+    const MorphTarget &target(size_t _i) const noexcept { return m_targets[_i]; }
+    const std::vector<MorphTarget> &targets() const noexcept { return m_targets; }
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief total bytes used by the base and all the targets
+    //----------------------------------------------------------------------------------------------------------------------
+    size_t memoryBytes() const noexcept;
+
+  private:
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief base mesh positions
+    //----------------------------------------------------------------------------------------------------------------------
+    std::vector<Vec3> m_basePositions;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief base mesh normals
+    //----------------------------------------------------------------------------------------------------------------------
+    std::vector<Vec3> m_baseNormals;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the blend shapes
+    //----------------------------------------------------------------------------------------------------------------------
+    std::vector<MorphTarget> m_targets;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief triangle indices into the vertex arrays
+    //----------------------------------------------------------------------------------------------------------------------
+    std::vector<uint32_t> m_indices;
+};
+
+} // end namespace morph
+
+#endif
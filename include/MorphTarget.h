@@ -0,0 +1,43 @@
+#ifndef MORPHTARGET_H_
+#define MORPHTARGET_H_
+#include "MorphTypes.h"
+#include <string>
+#include <vector>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file MorphTarget.h
+/// @brief a single blend shape stored as per vertex differences from the base mesh
+/// @class MorphTarget
+/// @brief the deltas are in the same vertex order as the owning MorphMesh so target[i] + base[i] gives
+/// the fully weighted pose
+//----------------------------------------------------------------------------------------------------------------------
+namespace morph
+{
+class MorphTarget
+{
+  public:
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the name of the target, by default the index of the pose it came from
+    //----------------------------------------------------------------------------------------------------------------------
+    std::string m_name;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief pose position - base position for each vertex
+    //----------------------------------------------------------------------------------------------------------------------
+    std::vector<Vec3> m_positionDeltas;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief pose normal - base normal for each vertex
+    //----------------------------------------------------------------------------------------------------------------------
+    std::vector<Vec3> m_normalDeltas;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief number of vertices this target covers
+    //----------------------------------------------------------------------------------------------------------------------
+    size_t size() const noexcept { return m_positionDeltas.size(); }
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief bytes used by the delta arrays
+    //----------------------------------------------------------------------------------------------------------------------
+    size_t memoryBytes() const noexcept { return (m_positionDeltas.size() + m_normalDeltas.size()) * sizeof(Vec3); }
+};
+
+} // end namespace morph
+
+#endif
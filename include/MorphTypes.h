@@ -0,0 +1,90 @@
+#ifndef MORPHTYPES_H_
+#define MORPHTYPES_H_
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file MorphTypes.h
+/// @brief basic value types shared by the morph core library, these deliberately have no NGL / Qt dependency
+/// so the core can be built and run on machines without a GL context
+//----------------------------------------------------------------------------------------------------------------------
+namespace morph
+{
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief a simple 3 float vector, the layout matches ngl::Vec3 (3 tightly packed floats) so arrays of these
+/// can be handed straight to OpenGL
+//----------------------------------------------------------------------------------------------------------------------
+struct Vec3
+{
+  float m_x = 0.0f;
+  float m_y = 0.0f;
+  float m_z = 0.0f;
+
+  constexpr Vec3() noexcept = default;
+  constexpr Vec3(float _x, float _y, float _z) noexcept : m_x(_x), m_y(_y), m_z(_z) {}
+
+  constexpr Vec3 operator+(const Vec3 &_v) const noexcept { return {m_x + _v.m_x, m_y + _v.m_y, m_z + _v.m_z}; }
+  constexpr Vec3 operator-(const Vec3 &_v) const noexcept { return {m_x - _v.m_x, m_y - _v.m_y, m_z - _v.m_z}; }
+  constexpr Vec3 operator*(float _s) const noexcept { return {m_x * _s, m_y * _s, m_z * _s}; }
+  Vec3 &operator+=(const Vec3 &_v) noexcept
+  {
+    m_x += _v.m_x;
+    m_y += _v.m_y;
+    m_z += _v.m_z;
+    return *this;
+  }
+  constexpr bool operator==(const Vec3 &_v) const noexcept { return m_x == _v.m_x && m_y == _v.m_y && m_z == _v.m_z; }
+  constexpr bool operator!=(const Vec3 &_v) const noexcept { return !(*this == _v); }
+  constexpr float dot(const Vec3 &_v) const noexcept { return m_x * _v.m_x + m_y * _v.m_y + m_z * _v.m_z; }
+  float length() const noexcept { return std::sqrt(dot(*this)); }
+  constexpr Vec3 cross(const Vec3 &_v) const noexcept
+  {
+    return {m_y * _v.m_z - m_z * _v.m_y, m_z * _v.m_x - m_x * _v.m_z, m_x * _v.m_y - m_y * _v.m_x};
+  }
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief unit length copy, a zero vector is returned unchanged
+  //----------------------------------------------------------------------------------------------------------------------
+  Vec3 normalized() const noexcept
+  {
+    float len = length();
+    return len > 0.0f ? *this * (1.0f / len) : *this;
+  }
+};
+static_assert(sizeof(Vec3) == 3 * sizeof(float), "Vec3 must be tightly packed for GL upload");
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief a triangle, the same layout as an ngl::Face once triangulated, m_vert indexes the vertex list and
+/// m_norm the normal list of the owning pose
+//----------------------------------------------------------------------------------------------------------------------
+struct Face
+{
+  std::array<uint32_t, 3> m_vert = {{0, 0, 0}};
+  std::array<uint32_t, 3> m_norm = {{0, 0, 0}};
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief the raw data for one pose, this is the subset of an obj file we need for morphing
+//----------------------------------------------------------------------------------------------------------------------
+struct PoseData
+{
+  std::vector<Vec3> m_verts;
+  std::vector<Vec3> m_normals;
+  std::vector<Face> m_faces;
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief a non zero weight and the target it applies to, evaluation loops over a list of these so the cost
+/// scales with the number of active targets rather than the total number of targets
+//----------------------------------------------------------------------------------------------------------------------
+struct ActiveWeight
+{
+  uint32_t m_target = 0;
+  float m_weight = 0.0f;
+};
+
+} // end namespace morph
+
+#endif
@@ -1,12 +1,28 @@
 #ifndef NGLSCENE_H_
 #define NGLSCENE_H_
-#include <QTimer>
+#include <QElapsedTimer>
 #include <ngl/AbstractVAO.h>
-#include <ngl/Obj.h>
 #include <ngl/Text.h>
+#include <ngl/Mat3.h>
 #include <ngl/Mat4.h>
+#include <ngl/Vec3.h>
 #include "WindowParams.h"
+#include "MorphMesh.h"
+#include "NormalRecompute.h"
+#include "Profiler.h"
+#include "CrowdState.h"
+#include "MappedRing.h"
+#include "MorphLod.h"
+#include "MorphLoader.h"
+#include "PoseLibrary.h"
+#include "QuantizedDeltas.h"
+#include "Skeleton.h"
+#include "Skinning.h"
+#include "SparseMorphMesh.h"
+#include "TargetRig.h"
+#include "WeightAnimation.h"
 #include <QOpenGLWindow>
+#include <future>
 #include <memory>
 
 //----------------------------------------------------------------------------------------------------------------------
@@ -51,6 +67,99 @@ class NGLScene : public QOpenGLWindow
     void resizeGL(QResizeEvent *_event);
     // Qt 5.x uses this instead! http://doc.qt.io/qt-5/qopenglwindow.html#resizeGL
     void resizeGL(int _w, int _h);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief set how the deltas are stored on the GPU, must be called before the window is shown
+    //----------------------------------------------------------------------------------------------------------------------
+    void setDeltaFormat(morph::DeltaFormat _format) { m_deltaFormat = _format; }
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief where the shading normals come from. BLEND adds the weighted normal deltas in the shader, CPU and
+    /// GPU rebuild them from the blended positions (NormalRecompute / MorphNormalsComp.glsl)
+    //----------------------------------------------------------------------------------------------------------------------
+    enum class NormalMode
+    {
+      BLEND,
+      CPU,
+      GPU
+    };
+    void setNormalMode(NormalMode _mode) { m_normalMode = _mode; }
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief draw a crowd of _count instanced characters instead of the single mesh, they need the float deltas
+    //----------------------------------------------------------------------------------------------------------------------
+    void setCrowdSize(size_t _count) { m_crowdSize = _count; }
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief draw the crowd with _levels levels of detail (including the full mesh) picked per instance by
+    /// screen space error, 0 or 1 draws every instance at full detail
+    //----------------------------------------------------------------------------------------------------------------------
+    void setLodLevels(size_t _levels) { m_lodLevels = _levels; }
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief stream the targets from the obj files with a morph::PoseLibrary rather than loading them all up front,
+    /// this needs the float deltas and blended normals
+    /// @param [in] _cpuBudget bytes of target deltas to keep in memory
+    /// @param [in] _gpuBudget bytes of the delta texture buffer, it holds as many targets as fit (at least one)
+    //----------------------------------------------------------------------------------------------------------------------
+    void setPoseStreaming(size_t _cpuBudget, size_t _gpuBudget)
+    {
+      m_streamPoses = true;
+      m_streamCpuBudget = _cpuBudget;
+      m_streamGpuBudget = _gpuBudget;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief wait for streamed targets to load instead of drawing without them, so headless frames are repeatable
+    //----------------------------------------------------------------------------------------------------------------------
+    void setWaitForPoses(bool _wait) { m_waitForPoses = _wait; }
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief drive the targets through a rig of in-between and combination shapes (see TargetRig.h), the weights
+    /// the keys and animation set are then the rig's drivers
+    //----------------------------------------------------------------------------------------------------------------------
+    void setRigFile(const std::string &_fname) { m_rigFile = _fname; }
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief skin the morphed mesh with a joint chain up its middle, bound by distance as the models have no
+    /// skeleton, this needs the float deltas
+    /// @param [in] _influences joints per vertex, 4 or 8, 0 turns skinning off
+    /// @param [in] _method the skinning to start with, K toggles it
+    //----------------------------------------------------------------------------------------------------------------------
+    void setSkinning(size_t _influences, morph::SkinMethod _method)
+    {
+      m_skinInfluences = _influences;
+      m_skinMethod = _method;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief where the blend is evaluated. SHADER blends in the lighting vertex shader on every draw, FEEDBACK
+    /// blends once into a vertex buffer with a transform feedback pre-pass (only when the weights change) and
+    /// draws that as a static mesh
+    //----------------------------------------------------------------------------------------------------------------------
+    enum class MorphPath
+    {
+      SHADER,
+      FEEDBACK
+    };
+    void setMorphPath(MorphPath _path) { m_morphPath = _path; }
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief capture a Chrome trace of every profiled stage from startup, written to _fname when the window closes
+    //----------------------------------------------------------------------------------------------------------------------
+    void setTraceFile(const std::string &_fname) { m_traceFile = _fname; }
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief show the timing overlay, it is hidden for headless image dumps as the numbers change every run
+    //----------------------------------------------------------------------------------------------------------------------
+    void setProfileVisible(bool _show) { m_showProfile = _show; }
+    const morph::Profiler &profiler() const noexcept { return m_profiler; }
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief scripted control for the headless runs (see HeadlessRun.h), each only marks what it changes dirty,
+    /// the weights are the rig drivers, one per target unless there is a rig file
+    //----------------------------------------------------------------------------------------------------------------------
+    size_t numTargets() const noexcept { return m_weights.size(); }
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief set the first numTargets() weights
+    //----------------------------------------------------------------------------------------------------------------------
+    void setWeights(const std::vector<float> &_weights);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief rotate the model like a mouse drag, in degrees
+    //----------------------------------------------------------------------------------------------------------------------
+    void setCameraRotation(int _spinX, int _spinY);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief stop the wall clock and drive the animation (punches and crowd) from _time so frames are repeatable
+    //----------------------------------------------------------------------------------------------------------------------
+    void setAnimationTime(double _time);
 
 private:
     //----------------------------------------------------------------------------------------------------------------------
@@ -70,62 +179,527 @@ private:
     /// @brief the model position for mouse movement
     //----------------------------------------------------------------------------------------------------------------------
     ngl::Vec3 m_modelPos;
-    enum class Weights{POSE1,POSE2};
     enum class Direction{UP,DOWN};
-    void changeWeight(Weights _w,Direction _d );
+    void changeWeight(size_t _target,Direction _d );
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief set a target weight, only marks the weights dirty if the value actually changes
+    //----------------------------------------------------------------------------------------------------------------------
+    void setWeight(size_t _target, float _weight);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief what has changed since the last frame. A frame is only requested when something has changed and
+    /// paintGL only redoes the work (matrices, CPU evaluation, uniforms) for the dirty parts
+    //----------------------------------------------------------------------------------------------------------------------
+    enum DirtyFlags : unsigned int
+    {
+      DIRTY_NONE = 0,
+      DIRTY_WEIGHTS = 1 << 0,
+      DIRTY_TRANSFORM = 1 << 1,
+      DIRTY_PROJECTION = 1 << 2,
+      DIRTY_NORMAL_MODE = 1 << 3,
+      DIRTY_MORPH_PATH = 1 << 4,
+      DIRTY_SKIN_POSE = 1 << 5,
+      DIRTY_SKIN_METHOD = 1 << 6,
+      DIRTY_ALL = ~0u
+    };
+    unsigned int m_dirty = DIRTY_ALL;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief flag some state as changed and ask Qt for a frame
+    //----------------------------------------------------------------------------------------------------------------------
+    void markDirty(unsigned int _flags);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the matrices derived from the camera and mouse transform, only rebuilt when they are dirty, along with
+    /// m_frameUniforms
+    //----------------------------------------------------------------------------------------------------------------------
+    ngl::Mat4 m_MV;
+    ngl::Mat4 m_MVP;
+    ngl::Mat3 m_normalMatrix;
+    void updateMatrices();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the active targets for the current weights, only gathered when the weights are dirty
+    //----------------------------------------------------------------------------------------------------------------------
+    std::vector<morph::ActiveWeight> m_active;
 
-    inline void toggleAnimation(){m_animation^=true;}
+    void toggleAnimation();
     void punchLeft();
     void punchRight();
     //----------------------------------------------------------------------------------------------------------------------
-    /// @brief our model
+    /// @brief the number of vertices in the morph mesh
     //----------------------------------------------------------------------------------------------------------------------
-    std::vector< std::unique_ptr<ngl::Obj >> m_meshes;
+    size_t m_numVertices = 0;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the index count and type of m_vaoMesh, for the instanced draw
+    //----------------------------------------------------------------------------------------------------------------------
+    size_t m_numIndices = 0;
+    GLenum m_indexType = GL_UNSIGNED_INT;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief far clip plane, pushed out to fit a crowd in
+    //----------------------------------------------------------------------------------------------------------------------
+    float m_farPlane = 350.0f;
     //----------------------------------------------------------------------------------------------------------------------
     /// @brief text for rendering
     //----------------------------------------------------------------------------------------------------------------------
     std::unique_ptr<ngl::Text> m_text;
     //----------------------------------------------------------------------------------------------------------------------
-    /// @brief the weight of pose one
+    /// @brief the rig driver weights the controls set, without a rig file there is one per pose after the base
+    //----------------------------------------------------------------------------------------------------------------------
+    std::vector<ngl::Real> m_weights;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief turns m_weights into m_targetWeights, the weight of each morph target, whenever they change
+    //----------------------------------------------------------------------------------------------------------------------
+    std::string m_rigFile;
+    morph::TargetRig m_rig;
+    std::vector<float> m_targetWeights;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the most targets that can be active at once, must match the shader array size
+    //----------------------------------------------------------------------------------------------------------------------
+    static constexpr size_t MAX_ACTIVE_TARGETS = 64;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the std140 uniform blocks the shaders read instead of named uniforms. The CPU copies are only rebuilt
+    /// when they are dirty, then each frame they are copied into one region of m_frameRing and bound by offset
+    //----------------------------------------------------------------------------------------------------------------------
+    enum UniformBlock : GLuint
+    {
+      FRAME_BLOCK,
+      MORPH_BLOCK,
+      DRAW_BLOCK,
+      NUM_UNIFORM_BLOCKS
+    };
+    struct FrameUniforms
+    {
+      float m_MVP[16];
+      float m_MV[16];
+      float m_P[16];
+      // std140 pads each mat3 column to a vec4
+      float m_normalMatrix[12];
+    };
+    struct MorphUniforms
+    {
+      int32_t m_activeCount;
+      int32_t m_pad[3];
+      // std140 pads array elements to 16 bytes so these are ivec4 / vec4 arrays in the shader
+      int32_t m_activeTarget[MAX_ACTIVE_TARGETS];
+      float m_activeWeight[MAX_ACTIVE_TARGETS];
+      // the compressed deltas' bounds in xyz
+      float m_activeScale[MAX_ACTIVE_TARGETS][4];
+      float m_activeBias[MAX_ACTIVE_TARGETS][4];
+    };
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief what changes between the crowd's draws, each draw binds its own block in the frame's region
+    //----------------------------------------------------------------------------------------------------------------------
+    struct DrawUniforms
+    {
+      int32_t m_numVerts;
+      int32_t m_instanceOffset;
+      int32_t m_useInstanceIndex;
+      int32_t m_pad;
+    };
+    static constexpr size_t c_maxDraws = 16;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief three regions so the CPU writes one frame while the GPU may still be reading the two before
+    //----------------------------------------------------------------------------------------------------------------------
+    static constexpr size_t c_frameRegions = 3;
+    FrameUniforms m_frameUniforms = {};
+    MorphUniforms m_morphUniforms = {};
+    MappedRing m_frameRing;
+    size_t m_morphBlockOffset = 0;
+    size_t m_drawBlockOffset = 0;
+    size_t m_drawBlockStride = 0;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief this frame's region from acquireFrameUniforms until it is fenced after the last draw
+    //----------------------------------------------------------------------------------------------------------------------
+    char *m_frameData = nullptr;
+    size_t m_frameOffset = 0;
+    void createFrameRing();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief rebuild m_morphUniforms from m_active
+    //----------------------------------------------------------------------------------------------------------------------
+    void packMorphUniforms();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief take this frame's region and copy the frame block, and the morph block if _morph, into it
+    /// @returns false if the ring couldn't be mapped
+    //----------------------------------------------------------------------------------------------------------------------
+    bool acquireFrameUniforms(bool _morph);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief write draw _draw's block, between acquireFrameUniforms and submitFrameUniforms
+    //----------------------------------------------------------------------------------------------------------------------
+    void writeDrawUniforms(size_t _draw, const DrawUniforms &_uniforms);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief finish writing the region and bind the frame and morph blocks, draws can read it from here on
+    //----------------------------------------------------------------------------------------------------------------------
+    void submitFrameUniforms();
+    void bindDrawUniforms(size_t _draw);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief texture buffer holding the deltas for every target (see MorphMesh::packDeltas)
+    //----------------------------------------------------------------------------------------------------------------------
+    GLuint m_deltaBuffer = 0;
+    GLuint m_deltaTexture = 0;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief how the deltas are stored, anything but FLOAT32 uses PerFragASDQuantVert.glsl
+    //----------------------------------------------------------------------------------------------------------------------
+    morph::DeltaFormat m_deltaFormat = morph::DeltaFormat::FLOAT32;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the octahedral encoded normals when the deltas are compressed
+    //----------------------------------------------------------------------------------------------------------------------
+    GLuint m_normalBuffer = 0;
+    GLuint m_normalTexture = 0;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief per target decode of the compressed position deltas (see QuantizedMorphMesh::scale)
+    //----------------------------------------------------------------------------------------------------------------------
+    std::vector<morph::Vec3> m_deltaScale;
+    std::vector<morph::Vec3> m_deltaBias;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief normal recomputation, everything is set up the first time a recompute mode is used
+    //----------------------------------------------------------------------------------------------------------------------
+    NormalMode m_normalMode = NormalMode::BLEND;
+    bool m_normalRecomputeReady = false;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the compute shader needs GL 4.3 and the float deltas
+    //----------------------------------------------------------------------------------------------------------------------
+    bool m_gpuNormalsSupported = false;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief CPU recompute, the sparse evaluation tells the recompute which vertices moved each frame
+    //----------------------------------------------------------------------------------------------------------------------
+    morph::SparseMorphMesh m_sparseMesh;
+    morph::SparseEvalState m_sparseState;
+    morph::NormalRecompute m_normalRecompute;
+    std::vector<morph::Vec3> m_recomputedNormals;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief texture buffer the vertex shader reads the recomputed normals from, the compute shader writes it as
+    /// a storage buffer
+    //----------------------------------------------------------------------------------------------------------------------
+    GLuint m_recomputedNormalBuffer = 0;
+    GLuint m_recomputedNormalTexture = 0;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief storage buffers for the compute shader, see the bindings in MorphNormalsComp.glsl
+    //----------------------------------------------------------------------------------------------------------------------
+    enum NormalStorage
+    {
+      POSITIONS,
+      INDICES,
+      FACE_NORMALS,
+      ADJACENCY_OFFSETS,
+      ADJACENT_FACES,
+      NUM_NORMAL_STORAGE
+    };
+    GLuint m_normalStorage[NUM_NORMAL_STORAGE] = {};
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the morph pre-pass, m_vaoMorphed has the same indices as m_vaoMesh and its vertex buffer is
+    /// written by transform feedback
     //----------------------------------------------------------------------------------------------------------------------
-    ngl::Real m_weight1;
+    MorphPath m_morphPath = MorphPath::SHADER;
+    std::unique_ptr<ngl::AbstractVAO> m_vaoMorphed;
     //----------------------------------------------------------------------------------------------------------------------
-    /// @brief the weight of pose two
+    /// @brief the crowd, 0 draws the single mesh
     //----------------------------------------------------------------------------------------------------------------------
-    ngl::Real m_weight2;
+    size_t m_crowdSize = 0;
+    morph::CrowdState m_crowd;
+    std::vector<float> m_crowdMatrices;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief texture buffers the instanced shader reads with gl_InstanceID, the weights are R32F target major
+    /// and the model matrices are 4 RGBA32F texels per instance
+    //----------------------------------------------------------------------------------------------------------------------
+    GLuint m_crowdWeightBuffer = 0;
+    GLuint m_crowdWeightTexture = 0;
+    GLuint m_crowdMatrixBuffer = 0;
+    GLuint m_crowdMatrixTexture = 0;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief frame timing for the crowd benchmark
+    //----------------------------------------------------------------------------------------------------------------------
+    size_t m_crowdFrames = 0;
+    double m_crowdReportTime = 0.0;
+    double m_crowdFrameMs = 0.0;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief crowd level of detail. m_lodDraws has one entry per level, level 0 draws with m_vaoMesh and
+    /// m_deltaTexture so only the coarser levels own a VAO and deltas
+    //----------------------------------------------------------------------------------------------------------------------
+    struct LodDraw
+    {
+      std::unique_ptr<ngl::AbstractVAO> m_vao;
+      GLuint m_deltaBuffer = 0;
+      GLuint m_deltaTexture = 0;
+      size_t m_numVertices = 0;
+      size_t m_numIndices = 0;
+      GLenum m_indexType = GL_UNSIGNED_INT;
+      size_t m_instanceCount = 0;
+      size_t m_instanceOffset = 0;
+    };
+    size_t m_lodLevels = 0;
+    morph::MorphLod m_lod;
+    std::vector<LodDraw> m_lodDraws;
+    std::vector<uint8_t> m_instanceLevel;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the instance ids sorted by level, an R32I texture buffer the shader reads at
+    /// instanceOffset + gl_InstanceID
+    //----------------------------------------------------------------------------------------------------------------------
+    std::vector<GLint> m_lodInstances;
+    GLuint m_lodInstanceBuffer = 0;
+    GLuint m_lodInstanceTexture = 0;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief pose streaming, the library holds the CPU copies of the targets and m_gpuSlots says which target
+    /// is in each slot of m_deltaBuffer. m_streamPending is set while an active target is still loading
+    //----------------------------------------------------------------------------------------------------------------------
+    bool m_streamPoses = false;
+    size_t m_streamCpuBudget = 0;
+    size_t m_streamGpuBudget = 0;
+    std::unique_ptr<morph::PoseLibrary> m_library;
+    morph::SlotCache m_gpuSlots;
+    bool m_waitForPoses = false;
+    bool m_streamPending = false;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the background load of a single float mesh, the other modes load everything in initializeGL. The
+    /// base is drawn with the static program as soon as it arrives, the morph programs and the font follow on the
+    /// next frames and each target is copied into its slot of m_deltaBuffer through m_staging as it finishes
+    //----------------------------------------------------------------------------------------------------------------------
+    enum class LoadStep
+    {
+      BASE,
+      PROGRAMS,
+      TEXT,
+      TARGETS,
+      DONE
+    };
+    LoadStep m_loadStep = LoadStep::DONE;
+    morph::MorphLoader m_loader;
+    std::vector<bool> m_targetUploaded;
+    size_t m_numTargetsUploaded = 0;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief false until PerFragADS and the pre-pass program exist, the base is drawn unmorphed until then
+    //----------------------------------------------------------------------------------------------------------------------
+    bool m_morphReady = false;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the normal mode asked for, the normals are blended until every target has loaded
+    //----------------------------------------------------------------------------------------------------------------------
+    NormalMode m_loadNormalMode = NormalMode::BLEND;
+    double m_loadStart = 0.0;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the .morph cache written from the pool once the objs have loaded
+    //----------------------------------------------------------------------------------------------------------------------
+    std::future<void> m_cacheWrite;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief staging for uploads, persistently mapped when the context has buffer storage (GL 4.4)
+    //----------------------------------------------------------------------------------------------------------------------
+    MappedRing m_staging;
+    bool m_persistentMapping = false;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief skinning after the morph, 0 influences is off. The palette is rebuilt and uploaded once per frame
+    /// the pose changes, the joints and weights are static RGBA8UI / RGBA16 texture buffers
+    //----------------------------------------------------------------------------------------------------------------------
+    size_t m_skinInfluences = 0;
+    morph::SkinMethod m_skinMethod = morph::SkinMethod::LINEAR;
+    morph::Skeleton m_skeleton;
+    morph::SkinWeights m_skinWeights;
+    std::vector<morph::RigidTransform> m_skinLocal;
+    morph::SkinPalette m_skinPalette;
+    double m_skinTime = -1.0;
+    GLuint m_skinPaletteBuffer = 0;
+    GLuint m_skinPaletteTexture = 0;
+    GLuint m_skinJointBuffer = 0;
+    GLuint m_skinJointTexture = 0;
+    GLuint m_skinWeightBuffer = 0;
+    GLuint m_skinWeightTexture = 0;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief CPU stage timings and GPU frame times, shown in the overlay (P toggles it)
+    //----------------------------------------------------------------------------------------------------------------------
+    morph::Profiler m_profiler;
+    bool m_showProfile = true;
+    std::string m_traceFile;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief when the last paintGL finished, the time until frameSwapped is the swap / driver wait
+    //----------------------------------------------------------------------------------------------------------------------
+    double m_paintEnd = -1.0;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief GL_TIME_ELAPSED queries for the GPU time of each frame. Results arrive a few frames late so there is
+    /// a small ring of them and they are only read once available, which never stalls the pipeline
+    //----------------------------------------------------------------------------------------------------------------------
+    static constexpr size_t NUM_GPU_QUERIES = 4;
+    GLuint m_gpuQueries[NUM_GPU_QUERIES] = {};
+    double m_gpuQueryStart[NUM_GPU_QUERIES] = {};
+    bool m_gpuQueryPending[NUM_GPU_QUERIES] = {};
+    size_t m_gpuQueryFrame = 0;
+    void beginGpuTimer();
+    void endGpuTimer();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief record any finished GPU timings into m_profiler
+    //----------------------------------------------------------------------------------------------------------------------
+    void readGpuTimers();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief render the frame time stats and the stage averages
+    /// @param [in] _y the line to start at, they go down the screen from there
+    //----------------------------------------------------------------------------------------------------------------------
+    void drawProfileOverlay(int _y);
     //----------------------------------------------------------------------------------------------------------------------
     /// @brief the mesh with all the data in it
     //----------------------------------------------------------------------------------------------------------------------
     std::unique_ptr<ngl::AbstractVAO> m_vaoMesh;
     //----------------------------------------------------------------------------------------------------------------------
-    /// @brief left animation timer
+    /// @brief the weight curves, evaluated once per frame in paintGL
+    //----------------------------------------------------------------------------------------------------------------------
+    morph::WeightAnimation m_weightAnimation;
     //----------------------------------------------------------------------------------------------------------------------
-    QTimer *m_timerLeft;
+    /// @brief the channels playing the punch curve into weights 0 and 1
     //----------------------------------------------------------------------------------------------------------------------
-    /// @brief right animation timer
+    int m_punchChannel[2] = {-1, -1};
     //----------------------------------------------------------------------------------------------------------------------
-    QTimer *m_timerRight;
+    /// @brief the monotonic clock the animation runs from, m_animationTime only advances while m_animation is set
     //----------------------------------------------------------------------------------------------------------------------
-    /// animation flag for timers
+    QElapsedTimer m_clock;
+    double m_animationTime = 0.0;
+    double m_lastTick = 0.0;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// animation flag, false pauses the animation clock
     //----------------------------------------------------------------------------------------------------------------------
     bool m_animation;
     //----------------------------------------------------------------------------------------------------------------------
-    /// @brief flag to indicate if punching left
+    /// @brief advance the animation clock and evaluate the weight curves for this frame
     //----------------------------------------------------------------------------------------------------------------------
-    bool m_punchLeft;
+    void tickAnimation();
     //----------------------------------------------------------------------------------------------------------------------
-    /// @brief flag to indicate if punching right
+    /// @brief bring m_animationTime up to now, it only moves when a frame is drawn so an input event that starts a
+    /// curve has to catch it up over any idle time first
     //----------------------------------------------------------------------------------------------------------------------
-    bool m_punchRight;
+    void advanceClock();
     //----------------------------------------------------------------------------------------------------------------------
-    /// do our morphing for the 3 meshes
+    /// do our morphing for the 3 meshes, using the .morph cache if it is up to date
     //----------------------------------------------------------------------------------------------------------------------
     void createMorphMesh();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the background load's work for this frame, called from paintGL until m_loadStep is DONE
+    //----------------------------------------------------------------------------------------------------------------------
+    void advanceLoad();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief upload the loaded base mesh and make an empty slot in m_deltaBuffer for every target
+    //----------------------------------------------------------------------------------------------------------------------
+    void showBase();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief copy the targets that have finished loading to the GPU, a frame's worth at a time
+    //----------------------------------------------------------------------------------------------------------------------
+    void uploadLoadedTargets();
+    void finishLoad();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief copy into a buffer through m_staging rather than glBufferSubData, so the driver never has to take a
+    /// copy or wait for the GPU to finish with the destination
+    /// @param [in] _buffer the destination buffer
+    /// @param [in] _offset the byte offset in _buffer
+    //----------------------------------------------------------------------------------------------------------------------
+    void uploadStaged(GLuint _buffer, size_t _offset, const void *_data, size_t _bytes);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the fragment shader and PerFragADSStatic, neither needs the mesh so they compile while it loads and
+    /// the base can be drawn as soon as it arrives
+    //----------------------------------------------------------------------------------------------------------------------
+    void createStaticProgram();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the programs that morph the mesh (or the crowd's) and the compute normals, needs the mesh loaded
+    //----------------------------------------------------------------------------------------------------------------------
+    void createPrograms();
+    void createText();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the key help and status lines then the profile stats
+    //----------------------------------------------------------------------------------------------------------------------
+    void drawOverlay();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief upload the packed base mesh to the VAO
+    /// @param [in] _vertices interleaved base position / normal
+    /// @param [in] _numVertices the number of vertices
+    /// @param [in] _indices the triangle list
+    /// @param [in] _numIndices the number of indices
+    /// @param [in] _indexType GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+    //----------------------------------------------------------------------------------------------------------------------
+    void uploadMorphMesh(const GLfloat *_vertices, size_t _numVertices, const GLvoid *_indices, size_t _numIndices,
+                         GLenum _indexType);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief make an indexed VAO of interleaved position / normal vertices, parameters as uploadMorphMesh
+    /// @param [in] _usage the vertex buffer usage hint
+    //----------------------------------------------------------------------------------------------------------------------
+    std::unique_ptr<ngl::AbstractVAO> createMeshVAO(const GLfloat *_vertices, size_t _numVertices, const GLvoid *_indices,
+                                                    size_t _numIndices, GLenum _indexType, GLenum _usage = GL_STATIC_DRAW);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief create a texture buffer for delta data
+    /// @param [in] _data the data to upload
+    /// @param [in] _bytes size of _data in bytes
+    /// @param [in] _format the texture buffer internal format, GL_RGB32F for MorphMesh::packDeltas
+    /// @param [out] o_buffer the buffer object
+    /// @param [out] o_texture the buffer texture
+    /// @param [in] _usage the buffer usage hint, GL_DYNAMIC_DRAW for data updated every frame
+    //----------------------------------------------------------------------------------------------------------------------
+    void uploadDeltaBuffer(const GLvoid *_data, size_t _bytes, GLenum _format, GLuint &o_buffer, GLuint &o_texture,
+                           GLenum _usage = GL_STATIC_DRAW);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief compress the deltas to m_deltaFormat, report the error and upload them
+    //----------------------------------------------------------------------------------------------------------------------
+    void uploadQuantizedDeltas(const morph::MorphMesh &_mesh);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief open the pose library, upload the base mesh and create the slots for the streamed deltas
+    //----------------------------------------------------------------------------------------------------------------------
+    void createStreamedMesh();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief build the joint chain and weights for the base mesh and create the skinning buffers
+    /// @param [in] _vertices interleaved base position / normal as uploadMorphMesh
+    /// @param [in] _numVertices the number of vertices
+    //----------------------------------------------------------------------------------------------------------------------
+    void createSkin(const GLfloat *_vertices, size_t _numVertices);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief pose the joints for the animation time and upload the palette in the form m_skinMethod uses
+    //----------------------------------------------------------------------------------------------------------------------
+    void updateSkin();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief switch between linear blend and dual quaternion skinning
+    //----------------------------------------------------------------------------------------------------------------------
+    void toggleSkinMethod();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief load the rig, or one driver per target without a rig file, and size the weights to match
+    //----------------------------------------------------------------------------------------------------------------------
+    void setupRig(size_t _numTargets);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief request the active targets from the library, upload any new to the GPU and point m_active at
+    /// their slots
+    //----------------------------------------------------------------------------------------------------------------------
+    void streamActive();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief build the adjacency and buffers for normal recomputation, needs a current context
+    //----------------------------------------------------------------------------------------------------------------------
+    void setupNormalRecompute();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief recompute the normals for this frame's weights using m_normalMode
+    //----------------------------------------------------------------------------------------------------------------------
+    void updateNormals(const std::vector<morph::ActiveWeight> &_active);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief step to the next normal mode the GPU supports
+    //----------------------------------------------------------------------------------------------------------------------
+    void cycleNormalMode();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief create the transform feedback program
+    //----------------------------------------------------------------------------------------------------------------------
+    void createMorphFeedback();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief blend the base mesh into m_vaoMorphed, the textures must already be bound
+    //----------------------------------------------------------------------------------------------------------------------
+    void runMorphFeedback();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief switch between the in shader blend and the pre-pass
+    //----------------------------------------------------------------------------------------------------------------------
+    void toggleMorphPath();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief spawn the crowd, create its buffers and shader
+    //----------------------------------------------------------------------------------------------------------------------
+    void createCrowd();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief update and upload the instance data then draw every character with one instanced draw
+    //----------------------------------------------------------------------------------------------------------------------
+    void drawCrowd();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief load or build the LOD levels and upload the coarse ones
+    //----------------------------------------------------------------------------------------------------------------------
+    void createLods();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief pick each instance's level from its distance to the eye and upload the instance ids sorted by level
+    //----------------------------------------------------------------------------------------------------------------------
+    void selectLods();
 
     //----------------------------------------------------------------------------------------------------------------------
-    /// @brief method to load transform matrices to the shader
+    /// @brief load the uniforms that only change with a setting (normal mode, skinning, morph path) to the shaders,
+    /// only when they are dirty. The matrices and weights go through m_frameRing
     //----------------------------------------------------------------------------------------------------------------------
-    void loadMatricesToShader();
+    void loadSettingsToShader();
     //----------------------------------------------------------------------------------------------------------------------
     /// @brief Qt Event called when a key is pressed
     /// @param [in] _event the Qt event to query for size etc
@@ -157,13 +731,10 @@ private:
     void wheelEvent( QWheelEvent *_event);
   private slots :
     //----------------------------------------------------------------------------------------------------------------------
-    /// @brief the timers are connected to slots to trigger the events
-    //----------------------------------------------------------------------------------------------------------------------
-    void updateLeft();
-    //----------------------------------------------------------------------------------------------------------------------
-    /// @brief the timers are connected to slots to trigger the events
+    /// @brief connected to frameSwapped, asks for the next frame while any curve is playing so the animation
+    /// is stepped once per vsync
     //----------------------------------------------------------------------------------------------------------------------
-    void updateRight();
+    void animate();
 
 
 };
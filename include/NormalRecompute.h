@@ -0,0 +1,84 @@
+#ifndef NORMALRECOMPUTE_H_
+#define NORMALRECOMPUTE_H_
+#include "MorphTypes.h"
+#include "ThreadPool.h"
+#include <vector>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file NormalRecompute.h
+/// @brief rebuilds smooth normals from the morphed positions. Blending the normals linearly (as the shader does)
+/// goes wrong for large deltas and combination shapes, recomputing them is always correct. The vertex / face
+/// adjacency is built once in CSR form (an offset per vertex into one flat face list) so each frame is two
+/// parallel passes with no atomics: area weighted face normals, then each vertex gathers and normalizes the
+/// faces around it. The adjacency is on the welded vertices so a vertex that was split for a hard edge only
+/// sees the faces on its side of the edge and the edge stays hard
+//----------------------------------------------------------------------------------------------------------------------
+namespace morph
+{
+class NormalRecompute
+{
+  public:
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief build the adjacency
+    /// @param [in] _indices the triangle list (MorphMesh::indices)
+    /// @param [in] _numVertices the number of vertices
+    //----------------------------------------------------------------------------------------------------------------------
+    void build(const std::vector<uint32_t> &_indices, size_t _numVertices);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief recompute every normal
+    /// @param [in] _positions the morphed positions
+    /// @param [out] o_normals unit normals, resized to numVertices(). Vertices with no area around them keep
+    /// their existing normal
+    /// @param [in] _pool pool to split the work across, nullptr runs on the calling thread
+    //----------------------------------------------------------------------------------------------------------------------
+    void recompute(const std::vector<Vec3> &_positions, std::vector<Vec3> &o_normals, ThreadPool *_pool = &ThreadPool::global());
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief recompute only the normals affected by some vertices moving, the rest of io_normals must already
+    /// be correct for _positions (e.g. from a full recompute). The faces around each changed vertex and every
+    /// vertex of those faces are updated, if that is most of the mesh a full recompute is done instead
+    /// @param [in] _changed the vertices that moved (SparseEvalState::m_changed)
+    /// @param [in] _positions the morphed positions
+    /// @param [in,out] io_normals the normals to update
+    /// @param [in] _pool pool to split the work across, nullptr runs on the calling thread
+    //----------------------------------------------------------------------------------------------------------------------
+    void recompute(const std::vector<uint32_t> &_changed, const std::vector<Vec3> &_positions, std::vector<Vec3> &io_normals,
+                   ThreadPool *_pool = &ThreadPool::global());
+
+    size_t numVertices() const noexcept { return m_offsets.empty() ? 0 : m_offsets.size() - 1; }
+    size_t numFaces() const noexcept { return m_indices.size() / 3; }
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the CSR adjacency, the faces around vertex v are m_faces[m_offsets[v] .. m_offsets[v + 1]), these
+    /// are uploaded as is for the compute shader version
+    //----------------------------------------------------------------------------------------------------------------------
+    const std::vector<uint32_t> &adjacencyOffsets() const noexcept { return m_offsets; }
+    const std::vector<uint32_t> &adjacentFaces() const noexcept { return m_faces; }
+    const std::vector<uint32_t> &indices() const noexcept { return m_indices; }
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief number of vertices updated by the last incremental recompute, numVertices() if it fell back to a full one
+    //----------------------------------------------------------------------------------------------------------------------
+    size_t lastRegionSize() const noexcept { return m_lastRegionSize; }
+
+  private:
+    void faceNormals(const uint32_t *_faces, size_t _count, const std::vector<Vec3> &_positions, ThreadPool *_pool);
+    void gather(const uint32_t *_vertices, size_t _count, std::vector<Vec3> &io_normals, ThreadPool *_pool) const;
+
+    std::vector<uint32_t> m_indices;
+    std::vector<uint32_t> m_offsets;
+    std::vector<uint32_t> m_faces;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief working storage, the area weighted normal of each face
+    //----------------------------------------------------------------------------------------------------------------------
+    std::vector<Vec3> m_faceNormals;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief working storage for the incremental update, the marks are kept cleared between calls
+    //----------------------------------------------------------------------------------------------------------------------
+    std::vector<uint8_t> m_faceMark;
+    std::vector<uint8_t> m_vertexMark;
+    std::vector<uint32_t> m_dirtyFaces;
+    std::vector<uint32_t> m_dirtyVertices;
+    size_t m_lastRegionSize = 0;
+};
+
+} // end namespace morph
+
+#endif
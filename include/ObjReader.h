@@ -0,0 +1,44 @@
+#ifndef OBJREADER_H_
+#define OBJREADER_H_
+#include "MorphTypes.h"
+#include <string>
+#include <vector>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file ObjReader.h
+/// @brief an obj reader for the v / vn / f subset used by the morph poses, it doesn't need NGL so the offline
+/// tools can use it. The file is memory mapped and split into line aligned chunks which are parsed in parallel
+/// on the ThreadPool then stitched back together in order
+//----------------------------------------------------------------------------------------------------------------------
+namespace morph
+{
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief timings from a read so we can see the parse throughput
+//----------------------------------------------------------------------------------------------------------------------
+struct ObjReadStats
+{
+  size_t m_bytes = 0;
+  double m_seconds = 0.0;
+  double mbPerSecond() const noexcept { return m_seconds > 0.0 ? (m_bytes / (1024.0 * 1024.0)) / m_seconds : 0.0; }
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief read an obj into a PoseData, polygons are triangulated as fans and texture coordinates are ignored
+/// @param [in] _fname the file to read
+/// @param [out] o_pose the pose data
+/// @param [out] o_stats optional timings
+/// @returns false if the file can't be read or has bad indices
+//----------------------------------------------------------------------------------------------------------------------
+bool readObj(const std::string &_fname, PoseData &o_pose, ObjReadStats *o_stats = nullptr);
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief read several obj files at once, the files are loaded in parallel as well as the chunks within them
+/// @param [in] _fnames the files to read
+/// @param [out] o_poses one pose per file
+/// @param [out] o_stats optional timings for the whole batch
+/// @returns false if any file fails
+//----------------------------------------------------------------------------------------------------------------------
+bool readObjs(const std::vector<std::string> &_fnames, std::vector<PoseData> &o_poses, ObjReadStats *o_stats = nullptr);
+
+} // end namespace morph
+
+#endif
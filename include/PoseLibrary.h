@@ -0,0 +1,166 @@
+#ifndef POSELIBRARY_H_
+#define POSELIBRARY_H_
+#include "MeshOptimizer.h"
+#include "MorphMesh.h"
+#include "ThreadPool.h"
+#include <cstdint>
+#include <future>
+#include <string>
+#include <vector>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file PoseLibrary.h
+/// @brief streams morph targets from their obj files on demand. Only the base pose is loaded up front, a target
+/// is read, validated and turned into deltas on the ThreadPool the first time it is requested and the source obj
+/// data is dropped as soon as the deltas are packed. Loaded targets are kept in a byte budget with least recently
+/// used eviction, so a library much larger than memory can be used as long as the working set (the targets with
+/// a non zero weight) fits
+//----------------------------------------------------------------------------------------------------------------------
+namespace morph
+{
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief a fixed number of slots shared by many keys with least recently used replacement, used for the GPU side
+/// of the library where the delta texture buffer has room for a fixed number of targets
+//----------------------------------------------------------------------------------------------------------------------
+class SlotCache
+{
+  public:
+    static constexpr int c_noSlot = -1;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief empty every slot
+    /// @param [in] _numSlots the number of slots
+    /// @param [in] _numKeys keys are 0 to _numKeys - 1
+    //----------------------------------------------------------------------------------------------------------------------
+    void reset(size_t _numSlots, size_t _numKeys);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the slot holding _key, c_noSlot if it isn't in one
+    //----------------------------------------------------------------------------------------------------------------------
+    int find(size_t _key) const noexcept { return m_keySlot[_key]; }
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief get a slot for _key and mark it used at _tick, evicting the least recently used key if they are all
+    /// full. Keys used at _tick are never evicted
+    /// @param [out] o_fresh true if the slot was (re)assigned and needs filling
+    /// @returns the slot, c_noSlot if every slot is already in use this tick
+    //----------------------------------------------------------------------------------------------------------------------
+    int acquire(size_t _key, uint64_t _tick, bool &o_fresh);
+    size_t numSlots() const noexcept { return m_slotKey.size(); }
+    size_t numUsed() const noexcept;
+    size_t evictions() const noexcept { return m_evictions; }
+
+  private:
+    std::vector<int> m_keySlot;
+    std::vector<size_t> m_slotKey;
+    std::vector<uint64_t> m_slotTick;
+    size_t m_evictions = 0;
+};
+
+class PoseLibrary
+{
+  public:
+    enum class State
+    {
+      UNLOADED,
+      LOADING,
+      RESIDENT,
+      FAILED
+    };
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief counters for the overlay and benchmark
+    //----------------------------------------------------------------------------------------------------------------------
+    struct Stats
+    {
+      size_t m_loads = 0;
+      size_t m_evictions = 0;
+      size_t m_hits = 0;
+      size_t m_misses = 0;
+      double m_loadSeconds = 0.0;
+    };
+
+    PoseLibrary() = default;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief waits for any loads still running as they read the base data
+    //----------------------------------------------------------------------------------------------------------------------
+    ~PoseLibrary();
+    PoseLibrary(const PoseLibrary &) = delete;
+    PoseLibrary &operator=(const PoseLibrary &) = delete;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief load the base pose and register the targets, nothing is read for the targets yet
+    /// @param [in] _files the pose obj files, the first is the base and every other is a target
+    /// @param [in] _budget bytes of deltas to keep loaded
+    /// @param [in] _pool the pool the targets load on, nullptr loads them on the calling thread in request
+    /// @returns false if the base can't be loaded
+    //----------------------------------------------------------------------------------------------------------------------
+    bool open(const std::vector<std::string> &_files, size_t _budget, ThreadPool *_pool = &ThreadPool::global());
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the base mesh, it has no targets
+    //----------------------------------------------------------------------------------------------------------------------
+    const MorphMesh &base() const noexcept { return m_base; }
+    size_t numTargets() const noexcept { return m_targets.size(); }
+    size_t numVertices() const noexcept { return m_base.numVertices(); }
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief bytes of deltas for one target, laid out as MorphMesh::packDeltas for a single target
+    //----------------------------------------------------------------------------------------------------------------------
+    size_t targetBytes() const noexcept { return numVertices() * 2 * sizeof(Vec3); }
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief mark _target used this tick and start loading it if it isn't loaded
+    /// @returns the packed deltas (position then normal per vertex) if the target is resident, otherwise nullptr
+    /// and the caller should try again on a later tick. The pointer is valid until the next call to update
+    //----------------------------------------------------------------------------------------------------------------------
+    const Vec3 *request(size_t _target);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief collect finished loads, evict down to the budget and start the next tick, call once per frame.
+    /// Targets requested this tick are never evicted so the budget can be exceeded while they are in use
+    //----------------------------------------------------------------------------------------------------------------------
+    void update();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief block until every started load has finished, used by the headless runs and the benchmark so the
+    /// frames don't depend on load timing
+    //----------------------------------------------------------------------------------------------------------------------
+    void wait();
+    State state(size_t _target) const noexcept { return m_targets[_target].m_state; }
+    uint64_t tick() const noexcept { return m_tick; }
+    size_t budget() const noexcept { return m_budget; }
+    size_t residentBytes() const noexcept { return m_residentBytes; }
+    size_t numResident() const noexcept;
+    size_t numLoading() const noexcept;
+    const Stats &stats() const noexcept { return m_stats; }
+
+  private:
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the result of a load job, empty deltas if it failed
+    //----------------------------------------------------------------------------------------------------------------------
+    struct Loaded
+    {
+      std::vector<Vec3> m_deltas;
+      double m_seconds = 0.0;
+    };
+    struct Target
+    {
+      std::string m_file;
+      State m_state = State::UNLOADED;
+      std::vector<Vec3> m_deltas;
+      std::future<Loaded> m_pending;
+      uint64_t m_lastUse = 0;
+    };
+    Loaded loadDeltas(const std::string &_file) const;
+    void finishLoad(Target &io_target, Loaded _loaded);
+    void evict();
+
+    MorphMesh m_base;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief what is kept of the base obj, its topology is needed to validate the targets and each vertex's
+    /// (vertex, normal) pair to gather their deltas
+    //----------------------------------------------------------------------------------------------------------------------
+    PoseData m_basePose;
+    std::vector<CornerKey> m_corners;
+    std::vector<Target> m_targets;
+    ThreadPool *m_pool = nullptr;
+    size_t m_budget = 0;
+    size_t m_residentBytes = 0;
+    uint64_t m_tick = 1;
+    Stats m_stats;
+};
+
+} // end namespace morph
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef POSEVALIDATOR_H_
+#define POSEVALIDATOR_H_
+#include "MorphTypes.h"
+#include <string>
+#include <vector>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file PoseValidator.h
+/// @brief checks that a pose can be used as a morph target of a base mesh. MorphMesh uses the face list of the
+/// base for every pose so vertex / normal i of a pose must be the same point on the surface as vertex / normal
+/// i of the base. All the checks are O(n) so they can always be left on at load time
+//----------------------------------------------------------------------------------------------------------------------
+namespace morph
+{
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief the result of validating a pose, from cheapest to most work
+//----------------------------------------------------------------------------------------------------------------------
+enum class PoseMatch
+{
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the face lists hash the same
+  //----------------------------------------------------------------------------------------------------------------------
+  IDENTICAL,
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the vertex numbering matches and the only faces with other vertices are quads that were split along
+  /// the other diagonal on export, safe to use as is. If a few corners also use other normal indices and the
+  /// normals can't be remapped m_message says how many faces were affected
+  //----------------------------------------------------------------------------------------------------------------------
+  RETRIANGULATED,
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the pose was exported with a different vertex / normal order and can be used once remapped
+  //----------------------------------------------------------------------------------------------------------------------
+  REMAPPED,
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the pose can't be used with this base
+  //----------------------------------------------------------------------------------------------------------------------
+  MISMATCH
+};
+
+struct ValidationOptions
+{
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief if at least this fraction of faces match exactly, and every face with other vertices is half of a
+  /// quad split along the other diagonal, the pose is treated as RETRIANGULATED
+  //----------------------------------------------------------------------------------------------------------------------
+  float m_minFaceMatch = 0.9f;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief try to remap a pose with a different order by matching vertex positions to the base, this only
+  /// works if the pose vertices are within m_spatialTolerance of the base (small corrective shapes or a
+  /// re-export of the base itself)
+  //----------------------------------------------------------------------------------------------------------------------
+  bool m_spatialRemap = false;
+  float m_spatialTolerance = 1e-4f;
+};
+
+struct PoseValidation
+{
+  PoseMatch m_result = PoseMatch::MISMATCH;
+  std::string m_message;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief fraction of faces that are exactly the same as the base
+  //----------------------------------------------------------------------------------------------------------------------
+  float m_faceMatch = 0.0f;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief for REMAPPED, the pose vertex / normal to use for each base vertex / normal
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<uint32_t> m_vertRemap;
+  std::vector<uint32_t> m_normRemap;
+  bool usable() const noexcept { return m_result != PoseMatch::MISMATCH; }
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief hash of the face vertex and normal indices, two poses with the same hash have the same topology
+//----------------------------------------------------------------------------------------------------------------------
+uint64_t faceIndexHash(const std::vector<Face> &_faces);
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief check a pose against the base
+//----------------------------------------------------------------------------------------------------------------------
+PoseValidation validatePose(const PoseData &_base, const PoseData &_pose, const ValidationOptions &_options = ValidationOptions());
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief re-order a REMAPPED pose so it lines up with the base, the pose then takes the base face list
+//----------------------------------------------------------------------------------------------------------------------
+void applyRemap(const PoseData &_base, PoseData &io_pose, const PoseValidation &_validation);
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief validate every pose against pose 0, remapping any that need it
+/// @param [in,out] io_poses the poses, pose 0 is the base
+/// @param [in] _options validation settings
+/// @returns false if any pose is a MISMATCH, the reason is written to std::cerr
+//----------------------------------------------------------------------------------------------------------------------
+bool validatePoses(std::vector<PoseData> &io_poses, const ValidationOptions &_options = ValidationOptions());
+
+} // end namespace morph
+
+#endif
@@ -0,0 +1,139 @@
+#ifndef PROFILER_H_
+#define PROFILER_H_
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file Profiler.h
+/// @brief lightweight instrumentation, named stages are timed with ScopedTimer (or recorded directly, e.g. from
+/// GL timer queries) into rolling min / average / p99 stats for an overlay, and can be captured as a Chrome trace
+/// (chrome://tracing or https://ui.perfetto.dev) to see where a slow frame went
+//----------------------------------------------------------------------------------------------------------------------
+namespace morph
+{
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief stats over the last _window samples
+//----------------------------------------------------------------------------------------------------------------------
+class RollingStats
+{
+  public:
+    explicit RollingStats(size_t _window = 240);
+    void add(double _value);
+    void clear() noexcept;
+    size_t count() const noexcept { return m_count; }
+    double min() const noexcept;
+    double max() const noexcept;
+    double average() const noexcept;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the nearest rank percentile
+    /// @param [in] _p the percentile as a fraction, 0.99 for p99
+    //----------------------------------------------------------------------------------------------------------------------
+    double percentile(double _p) const;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the most recent sample, 0 if there are none
+    //----------------------------------------------------------------------------------------------------------------------
+    double last() const noexcept;
+
+  private:
+    std::vector<double> m_samples;
+    size_t m_next = 0;
+    size_t m_count = 0;
+};
+
+class Profiler
+{
+  public:
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the tracks events are drawn on in the trace, CPU for anything timed on the calling thread and GPU for
+    /// times read back from timer queries
+    //----------------------------------------------------------------------------------------------------------------------
+    enum Track : uint32_t
+    {
+      CPU = 0,
+      GPU = 1
+    };
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief time in microseconds since the profiler was created, the time base of every event
+    //----------------------------------------------------------------------------------------------------------------------
+    double now() const noexcept;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief add a timed event, this is thread safe
+    /// @param [in] _name the stage name, must stay valid for the life of the profiler (use string literals)
+    /// @param [in] _start start time from now()
+    /// @param [in] _duration duration in microseconds
+    /// @param [in] _track which track the trace shows it on
+    //----------------------------------------------------------------------------------------------------------------------
+    void record(const char *_name, double _start, double _duration, Track _track = CPU);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the stages seen so far in the order they were first recorded, the stats are in milliseconds. These
+    /// aren't locked so only read them from the thread that records
+    //----------------------------------------------------------------------------------------------------------------------
+    size_t numStages() const noexcept { return m_stages.size(); }
+    const char *stageName(size_t _stage) const noexcept { return m_stages[_stage].m_name; }
+    Track stageTrack(size_t _stage) const noexcept { return m_stages[_stage].m_track; }
+    const RollingStats &stageStats(size_t _stage) const noexcept { return m_stages[_stage].m_stats; }
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the stats for a stage by name, nullptr if it hasn't been recorded
+    //----------------------------------------------------------------------------------------------------------------------
+    const RollingStats *findStage(const char *_name, Track _track = CPU) const noexcept;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief keep every event from now on for writeChromeTrace
+    /// @param [in] _maxEvents events past this are dropped so a long capture can't use all the memory
+    //----------------------------------------------------------------------------------------------------------------------
+    void startTrace(size_t _maxEvents = 1 << 20);
+    void stopTrace();
+    bool isTracing() const noexcept { return m_tracing; }
+    size_t numTraceEvents() const noexcept { return m_events.size(); }
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief write the captured events in the Chrome trace event JSON format
+    /// @returns false if the file can't be written
+    //----------------------------------------------------------------------------------------------------------------------
+    bool writeChromeTrace(const std::string &_fname) const;
+
+  private:
+    struct Stage
+    {
+      const char *m_name;
+      Track m_track;
+      RollingStats m_stats;
+    };
+    struct Event
+    {
+      const char *m_name;
+      double m_start;
+      double m_duration;
+      Track m_track;
+    };
+    size_t stageIndex(const char *_name, Track _track);
+
+    std::chrono::steady_clock::time_point m_epoch = std::chrono::steady_clock::now();
+    mutable std::mutex m_mutex;
+    std::vector<Stage> m_stages;
+    std::vector<Event> m_events;
+    size_t m_maxEvents = 0;
+    bool m_tracing = false;
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief times its own lifetime into a profiler stage
+//----------------------------------------------------------------------------------------------------------------------
+class ScopedTimer
+{
+  public:
+    ScopedTimer(Profiler &_profiler, const char *_name) : m_profiler(_profiler), m_name(_name), m_start(_profiler.now()) {}
+    ~ScopedTimer() { m_profiler.record(m_name, m_start, m_profiler.now() - m_start); }
+    ScopedTimer(const ScopedTimer &) = delete;
+    ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+  private:
+    Profiler &m_profiler;
+    const char *m_name;
+    double m_start;
+};
+
+} // end namespace morph
+
+#endif
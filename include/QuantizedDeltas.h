@@ -0,0 +1,129 @@
+#ifndef QUANTIZEDDELTAS_H_
+#define QUANTIZEDDELTAS_H_
+#include "MorphMesh.h"
+#include "MorphTypes.h"
+#include <array>
+#include <string>
+#include <vector>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file QuantizedDeltas.h
+/// @brief compressed storage for the morph target deltas. Position deltas are stored as half floats or as
+/// unsigned normalized 16 / 8 bit values inside the bounding box of each target, normals are stored as the
+/// octahedral encoded target normal in 2x16 bits. The formats are ones a texture buffer can use directly
+/// (RGBA16F, RGBA16, RGBA8 and RG16) so the GPU does the unpacking in texelFetch and PerFragASDQuantVert.glsl
+/// only has to apply the scale / bias and the octahedral decode. Position delta texel for target t, vertex v
+/// is t * numVertices() + v and the normal texel is the same index in the normal buffer
+//----------------------------------------------------------------------------------------------------------------------
+namespace morph
+{
+enum class DeltaFormat
+{
+  FLOAT32,
+  HALF,
+  INT16,
+  INT8
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief the format name as used on the command line (float, half, int16, int8)
+//----------------------------------------------------------------------------------------------------------------------
+const char *toString(DeltaFormat _format) noexcept;
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief parse a name from toString
+/// @returns false if the name isn't a format
+//----------------------------------------------------------------------------------------------------------------------
+bool parseDeltaFormat(const std::string &_name, DeltaFormat &o_format) noexcept;
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief IEEE half float conversion, rounds to nearest even
+//----------------------------------------------------------------------------------------------------------------------
+uint16_t floatToHalf(float _value) noexcept;
+float halfToFloat(uint16_t _value) noexcept;
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief octahedral encoding of a direction into two unsigned normalized 16 bit values
+//----------------------------------------------------------------------------------------------------------------------
+std::array<uint16_t, 2> octEncode(const Vec3 &_n) noexcept;
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief decode a normal from octEncode, the result is unit length
+//----------------------------------------------------------------------------------------------------------------------
+Vec3 octDecode(uint16_t _x, uint16_t _y) noexcept;
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief how far the decoded targets are from the full precision ones (each target at weight 1)
+//----------------------------------------------------------------------------------------------------------------------
+struct QuantizationError
+{
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief largest and root mean square position error in model units
+  //----------------------------------------------------------------------------------------------------------------------
+  float m_maxPosition = 0.0f;
+  float m_rmsPosition = 0.0f;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief largest angle between the decoded and original target normal
+  //----------------------------------------------------------------------------------------------------------------------
+  float m_maxNormalDegrees = 0.0f;
+};
+
+class QuantizedMorphMesh
+{
+  public:
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief compress the targets of a mesh
+    /// @param [in] _mesh the full precision mesh
+    /// @param [in] _format HALF, INT16 or INT8
+    /// @returns false for FLOAT32 which is just the MorphMesh itself
+    //----------------------------------------------------------------------------------------------------------------------
+    bool build(const MorphMesh &_mesh, DeltaFormat _format);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief evaluate the blended mesh from the compressed data, this is the same decode as the shader
+    //----------------------------------------------------------------------------------------------------------------------
+    void evaluate(const std::vector<ActiveWeight> &_active, std::vector<Vec3> &o_positions, std::vector<Vec3> &o_normals) const;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief decode the position delta / normal delta of one vertex of a target
+    //----------------------------------------------------------------------------------------------------------------------
+    Vec3 positionDelta(size_t _target, size_t _vertex) const noexcept;
+    Vec3 normalDelta(size_t _target, size_t _vertex) const noexcept;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief compare against the mesh this was built from
+    //----------------------------------------------------------------------------------------------------------------------
+    QuantizationError measureError(const MorphMesh &_mesh) const;
+
+    DeltaFormat format() const noexcept { return m_format; }
+    size_t numVertices() const noexcept { return m_basePositions.size(); }
+    size_t numTargets() const noexcept { return m_scale.size(); }
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief bytes per position texel, 4 components are stored as RGB isn't a texture buffer format at this size
+    //----------------------------------------------------------------------------------------------------------------------
+    size_t positionTexelBytes() const noexcept { return m_format == DeltaFormat::INT8 ? 4 : 8; }
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief raw texture buffer contents, positions are 4 x (half, uint16 or uint8) per texel and normals 2 x uint16
+    //----------------------------------------------------------------------------------------------------------------------
+    const std::vector<uint8_t> &positionData() const noexcept { return m_positions; }
+    const std::vector<uint16_t> &normalData() const noexcept { return m_normals; }
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the decode for target t is bias[t] + texel * scale[t]
+    //----------------------------------------------------------------------------------------------------------------------
+    const std::vector<Vec3> &scale() const noexcept { return m_scale; }
+    const std::vector<Vec3> &bias() const noexcept { return m_bias; }
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief total bytes of compressed delta data
+    //----------------------------------------------------------------------------------------------------------------------
+    size_t memoryBytes() const noexcept { return m_positions.size() + m_normals.size() * sizeof(uint16_t); }
+
+  private:
+    DeltaFormat m_format = DeltaFormat::FLOAT32;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the base mesh, normals are needed to turn the decoded target normal back into a delta
+    //----------------------------------------------------------------------------------------------------------------------
+    std::vector<Vec3> m_basePositions;
+    std::vector<Vec3> m_baseNormals;
+    std::vector<uint8_t> m_positions;
+    std::vector<uint16_t> m_normals;
+    std::vector<Vec3> m_scale;
+    std::vector<Vec3> m_bias;
+};
+
+} // end namespace morph
+
+#endif
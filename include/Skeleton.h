@@ -0,0 +1,121 @@
+#ifndef SKELETON_H_
+#define SKELETON_H_
+#include "MorphTypes.h"
+#include <string>
+#include <vector>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file Skeleton.h
+/// @brief a joint hierarchy for skinning the morphed mesh. The joints are stored flat with every parent before its
+/// children, so the skinning palette is one forward pass over contiguous arrays with no recursion or pointer chasing.
+/// Joints are rigid (rotation and translation) which is what dual quaternion skinning needs
+//----------------------------------------------------------------------------------------------------------------------
+namespace morph
+{
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief a unit quaternion rotation
+//----------------------------------------------------------------------------------------------------------------------
+struct Quat
+{
+  float m_x = 0.0f;
+  float m_y = 0.0f;
+  float m_z = 0.0f;
+  float m_w = 1.0f;
+
+  constexpr Quat() noexcept = default;
+  constexpr Quat(float _x, float _y, float _z, float _w) noexcept : m_x(_x), m_y(_y), m_z(_z), m_w(_w) {}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief rotation of _radians about the unit vector _axis
+  //----------------------------------------------------------------------------------------------------------------------
+  static Quat fromAxisAngle(const Vec3 &_axis, float _radians) noexcept;
+  Quat operator*(const Quat &_q) const noexcept;
+  constexpr Quat conjugate() const noexcept { return {-m_x, -m_y, -m_z, m_w}; }
+  Vec3 rotate(const Vec3 &_v) const noexcept;
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief a rotation then translation
+//----------------------------------------------------------------------------------------------------------------------
+struct RigidTransform
+{
+  Quat m_rotation;
+  Vec3 m_translation;
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief this after _t, so (a * b).apply(p) == a.apply(b.apply(p))
+  //----------------------------------------------------------------------------------------------------------------------
+  RigidTransform operator*(const RigidTransform &_t) const noexcept;
+  RigidTransform inverse() const noexcept;
+  Vec3 apply(const Vec3 &_p) const noexcept { return m_rotation.rotate(_p) + m_translation; }
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief the per frame joint transforms in the two forms the skinning uses, both go to the GPU as they are
+//----------------------------------------------------------------------------------------------------------------------
+struct SkinPalette
+{
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief 12 floats per joint, the rows of a 3x4 matrix (three RGBA texels)
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<float> m_matrices;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief 8 floats per joint, the real then dual part of a unit dual quaternion as x y z w (two RGBA texels)
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<float> m_dualQuats;
+  size_t numJoints() const noexcept { return m_matrices.size() / 12; }
+};
+
+class Skeleton
+{
+  public:
+    static constexpr int c_noParent = -1;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief add a joint
+    /// @param [in] _name the joint name
+    /// @param [in] _parent an earlier joint or c_noParent for a root
+    /// @param [in] _bindLocal the bind pose relative to the parent
+    /// @returns the joint index, or -1 if the parent isn't an earlier joint
+    //----------------------------------------------------------------------------------------------------------------------
+    int addJoint(const std::string &_name, int _parent, const RigidTransform &_bindLocal);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief replace the joints with an evenly spaced chain from _start to _end, each the child of the one before.
+    /// for a mesh that has no skeleton of its own
+    /// @param [in] _numJoints at least 2
+    //----------------------------------------------------------------------------------------------------------------------
+    void buildChain(const Vec3 &_start, const Vec3 &_end, size_t _numJoints);
+    size_t numJoints() const noexcept { return m_parents.size(); }
+    int parent(size_t _joint) const noexcept { return m_parents[_joint]; }
+    const std::string &name(size_t _joint) const noexcept { return m_names[_joint]; }
+    const RigidTransform &bindLocal(size_t _joint) const noexcept { return m_bindLocal[_joint]; }
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the bind pose in model space
+    //----------------------------------------------------------------------------------------------------------------------
+    const RigidTransform &bindWorld(size_t _joint) const noexcept { return m_bindWorld[_joint]; }
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the model space transforms of a pose in one pass over the joints
+    /// @param [in] _local one transform per joint relative to its parent
+    /// @param [out] o_world resized to numJoints()
+    //----------------------------------------------------------------------------------------------------------------------
+    void worldTransforms(const std::vector<RigidTransform> &_local, std::vector<RigidTransform> &o_world) const;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the skinning transform of every joint (world * inverse bind) for a pose, once per frame
+    /// @param [in] _local one transform per joint relative to its parent
+    /// @param [out] o_palette both forms of the transforms
+    //----------------------------------------------------------------------------------------------------------------------
+    void computePalette(const std::vector<RigidTransform> &_local, SkinPalette &o_palette) const;
+
+  private:
+    std::vector<std::string> m_names;
+    std::vector<int> m_parents;
+    std::vector<RigidTransform> m_bindLocal;
+    std::vector<RigidTransform> m_bindWorld;
+    std::vector<RigidTransform> m_inverseBind;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief scratch for computePalette so a frame doesn't allocate
+    //----------------------------------------------------------------------------------------------------------------------
+    mutable std::vector<RigidTransform> m_world;
+};
+
+} // end namespace morph
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef SKINNING_H_
+#define SKINNING_H_
+#include "MorphTypes.h"
+#include "Skeleton.h"
+#include "SoAMorphMesh.h"
+#include "ThreadPool.h"
+#include <cstdint>
+#include <vector>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file Skinning.h
+/// @brief per vertex joint weights and the skinning that runs after the morph, so a vertex is
+/// skin(base + sum(w[i] * delta[i])). Linear blend skinning sums the joint matrices, dual quaternion skinning sums
+/// the joint dual quaternions and normalises, which keeps the volume at twisting joints. The same formulas are in
+/// PerFragASDVert.glsl
+//----------------------------------------------------------------------------------------------------------------------
+namespace morph
+{
+enum class SkinMethod
+{
+  LINEAR,
+  DUAL_QUATERNION
+};
+
+const char *toString(SkinMethod _method) noexcept;
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief one joint's influence on a vertex
+//----------------------------------------------------------------------------------------------------------------------
+struct JointWeight
+{
+  uint32_t m_joint;
+  float m_weight;
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief a fixed number of influences per vertex packed in 3 bytes each, an 8 bit joint index and a 16 bit unorm
+/// weight. A vertex's weights always sum to exactly 65535 so the blend never scales the mesh. Joints and weights are
+/// separate arrays so they upload as an RGBA8UI and an RGBA16 buffer texture
+//----------------------------------------------------------------------------------------------------------------------
+class SkinWeights
+{
+  public:
+    static constexpr size_t c_maxJoints = 256;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief size for _numVertices vertices, each fully bound to joint 0
+    /// @param [in] _influences 4 or 8
+    /// @returns false for any other number of influences
+    //----------------------------------------------------------------------------------------------------------------------
+    bool reset(size_t _numVertices, size_t _influences);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief set a vertex's weights, only the largest influences() are kept and then renormalised
+    /// @param [in] _weights joints must be under c_maxJoints, weights <= 0 are dropped
+    //----------------------------------------------------------------------------------------------------------------------
+    void setVertex(size_t _vertex, const std::vector<JointWeight> &_weights);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the weights of a vertex as floats, unused slots have weight 0
+    //----------------------------------------------------------------------------------------------------------------------
+    std::vector<JointWeight> vertex(size_t _vertex) const;
+    size_t numVertices() const noexcept { return m_influences == 0 ? 0 : m_joints.size() / m_influences; }
+    size_t influences() const noexcept { return m_influences; }
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief influences() per vertex, vertex v starts at v * influences()
+    //----------------------------------------------------------------------------------------------------------------------
+    const std::vector<uint8_t> &joints() const noexcept { return m_joints; }
+    const std::vector<uint16_t> &weights() const noexcept { return m_weights; }
+    size_t memoryBytes() const noexcept { return m_joints.size() * sizeof(uint8_t) + m_weights.size() * sizeof(uint16_t); }
+
+  private:
+    size_t m_influences = 0;
+    std::vector<uint8_t> m_joints;
+    std::vector<uint16_t> m_weights;
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief bind every vertex to the nearest bones, a stand in for painted weights when a model has none. A joint's
+/// bone runs from the joint to its first child (or is just the joint for a leaf) and the weight falls off as
+/// 1 / (d^2 + _falloff^2)^2 with the distance d to the bone
+/// @param [in] _positions the bind pose vertices
+/// @param [in] _skeleton the joints, at most SkinWeights::c_maxJoints
+/// @param [in] _falloff the distance the weights blend over, about the bone spacing gives smooth bends
+/// @param [out] o_weights must already be reset to the vertex count and influences wanted
+//----------------------------------------------------------------------------------------------------------------------
+void computeDistanceWeights(const std::vector<Vec3> &_positions, const Skeleton &_skeleton, float _falloff,
+                            SkinWeights &o_weights, ThreadPool *_pool = &ThreadPool::global());
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief skin the (already morphed) vertices
+/// @param [in] _weights the per vertex joint weights
+/// @param [in] _palette this frame's joint transforms (Skeleton::computePalette)
+/// @param [in] _method linear blend or dual quaternion
+/// @param [in] _positions the positions to skin, e.g. the output of MorphMesh::evaluate
+/// @param [in] _normals the normals to skin, they come out normalised
+/// @param [out] o_positions resized to the vertex count, may not alias _positions
+/// @param [out] o_normals resized to the vertex count, may not alias _normals
+/// @param [in] _pool pool to split the vertex range across, nullptr runs on the calling thread only
+/// @param [in] _level SSE or AVX2 use the 4 wide kernel, SCALAR the plain one
+//----------------------------------------------------------------------------------------------------------------------
+void skinVertices(const SkinWeights &_weights, const SkinPalette &_palette, SkinMethod _method,
+                  const std::vector<Vec3> &_positions, const std::vector<Vec3> &_normals, std::vector<Vec3> &o_positions,
+                  std::vector<Vec3> &o_normals, ThreadPool *_pool = &ThreadPool::global(),
+                  SimdLevel _level = detectSimdLevel());
+
+} // end namespace morph
+
+#endif
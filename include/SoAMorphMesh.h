@@ -0,0 +1,99 @@
+#ifndef SOAMORPHMESH_H_
+#define SOAMORPHMESH_H_
+#include "MorphMesh.h"
+#include "MorphTypes.h"
+#include "ThreadPool.h"
+#include <vector>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file SoAMorphMesh.h
+/// @brief a CPU blend shape evaluator for simulation, collision and export. The base mesh and every target are
+/// stored as separate x / y / z arrays so the blend base + sum(w[i] * delta[i]) is a run of independent float
+/// streams that vectorise directly. AVX2, SSE or scalar kernels are chosen at runtime and the vertex range is
+/// split across the ThreadPool. Every kernel does a multiply then an add per target in target order (no fma) so
+/// the result is bit for bit the same as MorphMesh::evaluate and the shader
+//----------------------------------------------------------------------------------------------------------------------
+namespace morph
+{
+enum class SimdLevel
+{
+  SCALAR,
+  SSE,
+  AVX2
+};
+
+const char *toString(SimdLevel _level) noexcept;
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief the best kernel the CPU we are running on supports
+//----------------------------------------------------------------------------------------------------------------------
+SimdLevel detectSimdLevel() noexcept;
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief evaluated vertices as separate component arrays
+//----------------------------------------------------------------------------------------------------------------------
+struct SoAVertices
+{
+  std::vector<float> m_px;
+  std::vector<float> m_py;
+  std::vector<float> m_pz;
+  std::vector<float> m_nx;
+  std::vector<float> m_ny;
+  std::vector<float> m_nz;
+
+  size_t size() const noexcept { return m_px.size(); }
+  void resize(size_t _size);
+  Vec3 position(size_t _i) const noexcept { return {m_px[_i], m_py[_i], m_pz[_i]}; }
+  Vec3 normal(size_t _i) const noexcept { return {m_nx[_i], m_ny[_i], m_nz[_i]}; }
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief interleave back into Vec3 arrays, e.g. to compare with MorphMesh::evaluate
+  //----------------------------------------------------------------------------------------------------------------------
+  void toAoS(std::vector<Vec3> &o_positions, std::vector<Vec3> &o_normals) const;
+};
+
+class SoAMorphMesh
+{
+  public:
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief copy a mesh into SoA form
+    //----------------------------------------------------------------------------------------------------------------------
+    void build(const MorphMesh &_mesh);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief evaluate the blended mesh
+    /// @param [in] _active the targets to apply (see MorphMesh::gatherActive)
+    /// @param [out] o_vertices the result, resized to numVertices()
+    /// @param [in] _pool pool to split the vertex range across, nullptr runs on the calling thread only
+    //----------------------------------------------------------------------------------------------------------------------
+    void evaluate(const std::vector<ActiveWeight> &_active, SoAVertices &o_vertices,
+                  ThreadPool *_pool = &ThreadPool::global()) const;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief force a kernel, mainly for testing and benchmarks. Levels the CPU can't run are clamped to the
+    /// best supported one
+    //----------------------------------------------------------------------------------------------------------------------
+    void setSimdLevel(SimdLevel _level) noexcept;
+    SimdLevel simdLevel() const noexcept { return m_simdLevel; }
+
+    size_t numVertices() const noexcept { return m_numVertices; }
+    size_t numTargets() const noexcept { return m_numTargets; }
+    size_t memoryBytes() const noexcept { return (m_base.size() + m_deltas.size()) * sizeof(float); }
+
+  private:
+    size_t m_numVertices = 0;
+    size_t m_numTargets = 0;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief floats between the start of each component stream, numVertices rounded up to a whole SIMD block
+    //----------------------------------------------------------------------------------------------------------------------
+    size_t m_stride = 0;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief px, py, pz, nx, ny, nz streams of the base mesh
+    //----------------------------------------------------------------------------------------------------------------------
+    std::vector<float> m_base;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the same six streams for each target, target t component c starts at (t * 6 + c) * m_stride
+    //----------------------------------------------------------------------------------------------------------------------
+    std::vector<float> m_deltas;
+    SimdLevel m_simdLevel = detectSimdLevel();
+};
+
+} // end namespace morph
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef SPAN_H_
+#define SPAN_H_
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file Span.h
+/// @brief a borrowed view of contiguous elements, a cut down std::span as the library is C++17. A Span never owns
+/// its data so it must not outlive the vector, file mapping or Arena it points into
+//----------------------------------------------------------------------------------------------------------------------
+namespace morph
+{
+template <typename T>
+class Span
+{
+  public:
+    using value_type = std::remove_cv_t<T>;
+    constexpr Span() noexcept = default;
+    constexpr Span(T *_data, size_t _size) noexcept : m_data(_data), m_size(_size) {}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief view a whole vector, a const view can be made from a const vector
+    //----------------------------------------------------------------------------------------------------------------------
+    template <typename Alloc>
+    Span(std::vector<value_type, Alloc> &_v) noexcept : m_data(_v.data()), m_size(_v.size())
+    {
+    }
+    template <typename Alloc, typename U = T, typename = std::enable_if_t<std::is_const_v<U>>>
+    Span(const std::vector<value_type, Alloc> &_v) noexcept : m_data(_v.data()), m_size(_v.size())
+    {
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief Span<T> to Span<const T>
+    //----------------------------------------------------------------------------------------------------------------------
+    template <typename U, typename = std::enable_if_t<std::is_same_v<const U, T> && !std::is_same_v<U, T>>>
+    constexpr Span(const Span<U> &_s) noexcept : m_data(_s.data()), m_size(_s.size())
+    {
+    }
+    constexpr T *data() const noexcept { return m_data; }
+    constexpr size_t size() const noexcept { return m_size; }
+    constexpr bool empty() const noexcept { return m_size == 0; }
+    constexpr T *begin() const noexcept { return m_data; }
+    constexpr T *end() const noexcept { return m_data + m_size; }
+    constexpr T &operator[](size_t _i) const noexcept { return m_data[_i]; }
+    constexpr T &front() const noexcept { return m_data[0]; }
+    constexpr T &back() const noexcept { return m_data[m_size - 1]; }
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief _count elements starting at _offset, the range must be inside this span
+    //----------------------------------------------------------------------------------------------------------------------
+    constexpr Span subspan(size_t _offset, size_t _count) const noexcept { return {m_data + _offset, _count}; }
+
+  private:
+    T *m_data = nullptr;
+    size_t m_size = 0;
+};
+
+} // end namespace morph
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef SPARSEMORPHMESH_H_
+#define SPARSEMORPHMESH_H_
+#include "MorphMesh.h"
+#include "MorphTypes.h"
+#include <string>
+#include <vector>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file SparseMorphMesh.h
+/// @brief sparse storage of morph targets, most blend shapes only move a small part of the mesh so we only
+/// store the vertices that actually change
+//----------------------------------------------------------------------------------------------------------------------
+namespace morph
+{
+//----------------------------------------------------------------------------------------------------------------------
+/// @class SparseMorphTarget
+/// @brief a morph target stored as a sorted list of (vertex index, delta)
+//----------------------------------------------------------------------------------------------------------------------
+class SparseMorphTarget
+{
+  public:
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief build from a dense target keeping any vertex where a position or normal delta component is
+    /// larger than _epsilon
+    //----------------------------------------------------------------------------------------------------------------------
+    static SparseMorphTarget fromDense(const MorphTarget &_target, float _epsilon);
+
+    std::string m_name;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the vertices this target moves in ascending order
+    //----------------------------------------------------------------------------------------------------------------------
+    std::vector<uint32_t> m_indices;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the deltas for each entry in m_indices
+    //----------------------------------------------------------------------------------------------------------------------
+    std::vector<Vec3> m_positionDeltas;
+    std::vector<Vec3> m_normalDeltas;
+
+    size_t size() const noexcept { return m_indices.size(); }
+    size_t memoryBytes() const noexcept
+    {
+      return m_indices.size() * sizeof(uint32_t) + (m_positionDeltas.size() + m_normalDeltas.size()) * sizeof(Vec3);
+    }
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief the working buffers for an incremental sparse evaluation, the positions / normals are the base
+/// mesh except at the vertices in m_touched which were moved by the last evaluation. m_changed is every vertex
+/// the last evaluation wrote (moved by it or by the one before) for things like NormalRecompute that only
+/// want to update what changed
+//----------------------------------------------------------------------------------------------------------------------
+struct SparseEvalState
+{
+  std::vector<Vec3> m_positions;
+  std::vector<Vec3> m_normals;
+  std::vector<uint32_t> m_touched;
+  std::vector<uint32_t> m_changed;
+  std::vector<uint8_t> m_isTouched;
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @class SparseMorphMesh
+/// @brief a base mesh plus SparseMorphTargets, it keeps its own copy of the base so the dense MorphMesh can
+/// be thrown away once this is built
+//----------------------------------------------------------------------------------------------------------------------
+class SparseMorphMesh
+{
+  public:
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief build from a dense mesh
+    /// @param [in] _mesh the dense mesh
+    /// @param [in] _epsilon deltas with every component at or below this are dropped, 0 keeps any vertex that
+    /// moves at all and gives the same values as MorphMesh::evaluate
+    //----------------------------------------------------------------------------------------------------------------------
+    void build(const MorphMesh &_mesh, float _epsilon = 0.0f);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief full evaluation, copies the base then adds the deltas of the active targets to the moved
+    /// vertices only
+    //----------------------------------------------------------------------------------------------------------------------
+    void evaluate(const std::vector<ActiveWeight> &_active, std::vector<Vec3> &o_positions, std::vector<Vec3> &o_normals) const;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief set up a state for incremental evaluation, the buffers start as the base mesh
+    //----------------------------------------------------------------------------------------------------------------------
+    void initState(SparseEvalState &o_state) const;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief incremental evaluation, only the vertices moved by the previous or the current active targets
+    /// are written so the cost is proportional to the number of non zero deltas not the size of the mesh
+    //----------------------------------------------------------------------------------------------------------------------
+    void evaluate(const std::vector<ActiveWeight> &_active, SparseEvalState &io_state) const;
+
+    size_t numVertices() const noexcept { return m_basePositions.size(); }
+    size_t numTargets() const noexcept { return m_targets.size(); }
+    const SparseMorphTarget &target(size_t _i) const noexcept { return m_targets[_i]; }
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief total number of stored (vertex, delta) entries over all targets
+    //----------------------------------------------------------------------------------------------------------------------
+    size_t numDeltas() const noexcept;
+    size_t memoryBytes() const noexcept;
+
+  private:
+    void accumulate(const std::vector<ActiveWeight> &_active, std::vector<Vec3> &io_positions, std::vector<Vec3> &io_normals) const;
+
+    std::vector<Vec3> m_basePositions;
+    std::vector<Vec3> m_baseNormals;
+    std::vector<SparseMorphTarget> m_targets;
+};
+
+} // end namespace morph
+
+#endif
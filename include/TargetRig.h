@@ -0,0 +1,110 @@
+#ifndef TARGETRIG_H_
+#define TARGETRIG_H_
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file TargetRig.h
+/// @brief maps the weights an animator drives (drivers) onto the morph target weights. A target is either an
+/// in-between, fully on when its driver reaches the target's position with the driver's other in-betweens blended
+/// piecewise linearly either side, or a combination (corrective) shape whose weight is the product of its drivers.
+/// A plain target is an in-between at position 1. The rig is flattened into an activation table once, so each frame
+/// is a short pass over the drivers that writes the target weights. After that the mesh is the usual flat weighted
+/// sum of deltas (MorphMesh::evaluate, the shaders), so the per vertex cost doesn't change
+//----------------------------------------------------------------------------------------------------------------------
+namespace morph
+{
+class TargetRig
+{
+  public:
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief one driver per target driving it directly, named by target index. This is the rig when there is no
+    /// rig file and evaluate then copies the weights exactly
+    //----------------------------------------------------------------------------------------------------------------------
+    void setIdentity(size_t _numTargets);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief remove every driver and target
+    //----------------------------------------------------------------------------------------------------------------------
+    void clear();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief add a driver
+    /// @returns its index
+    //----------------------------------------------------------------------------------------------------------------------
+    size_t addDriver(const std::string &_name);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the index of a driver by name, -1 if there isn't one
+    //----------------------------------------------------------------------------------------------------------------------
+    int findDriver(const std::string &_name) const noexcept;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief drive _target by _driver, the target is fully on when the driver is at _position
+    /// @param [in] _position must be > 0 and not used by another target of the same driver
+    //----------------------------------------------------------------------------------------------------------------------
+    void addInBetween(size_t _target, size_t _driver, float _position = 1.0f);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief make _target a corrective that fires at the product of the _drivers weights
+    //----------------------------------------------------------------------------------------------------------------------
+    void addCombination(size_t _target, const std::vector<size_t> &_drivers);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief check the rig and build the activation table, call after adding the targets
+    /// @param [in] _numTargets the number of morph targets
+    /// @returns false if a target is out of range or driven twice, or the in-between positions are bad
+    //----------------------------------------------------------------------------------------------------------------------
+    bool build(size_t _numTargets);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief turn driver weights into target weights. Past the ends the first and last segments are extended, so
+    /// a driver under 0 or over its last position pushes its nearest in-betweens on in a straight line
+    /// @param [in] _drivers one weight per driver, missing weights are treated as 0
+    /// @param [out] o_weights resized to numTargets(), targets no driver uses are 0
+    //----------------------------------------------------------------------------------------------------------------------
+    void evaluate(const std::vector<float> &_drivers, std::vector<float> &o_weights) const;
+    size_t numDrivers() const noexcept { return m_driverNames.size(); }
+    size_t numTargets() const noexcept { return m_numTargets; }
+    const std::string &driverName(size_t _driver) const noexcept { return m_driverNames[_driver]; }
+    size_t numCombinations() const noexcept { return m_comboTargets.size(); }
+
+  private:
+    struct InBetween
+    {
+      uint32_t m_target;
+      uint32_t m_driver;
+      float m_position;
+    };
+    struct Combination
+    {
+      uint32_t m_target;
+      std::vector<uint32_t> m_drivers;
+    };
+    std::vector<std::string> m_driverNames;
+    std::vector<InBetween> m_inBetweens;
+    std::vector<Combination> m_combinations;
+    size_t m_numTargets = 0;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the activation table. Driver d's in-betweens are [m_driverFirst[d], m_driverFirst[d + 1]) of
+    /// m_positions / m_targets sorted by position, and combination c multiplies drivers
+    /// [m_comboFirst[c], m_comboFirst[c + 1]) of m_comboDrivers into m_comboTargets[c]
+    //----------------------------------------------------------------------------------------------------------------------
+    std::vector<uint32_t> m_driverFirst;
+    std::vector<float> m_positions;
+    std::vector<uint32_t> m_targets;
+    std::vector<uint32_t> m_comboFirst;
+    std::vector<uint32_t> m_comboDrivers;
+    std::vector<uint32_t> m_comboTargets;
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief read a rig file, one entry per line
+/// driver <name>
+/// inbetween <target> <driver name> [position]   (position defaults to 1)
+/// combination <target> <driver name> <driver name> [...]
+/// blank lines and anything after a # are ignored, drivers must be declared before they are used
+/// @param [in] _fname the file to read
+/// @param [in] _numTargets the number of morph targets, the rig is built for this many
+/// @param [out] o_rig the rig, cleared first
+/// @returns false if the file can't be read, a line is malformed or the rig doesn't build
+//----------------------------------------------------------------------------------------------------------------------
+bool readTargetRig(const std::string &_fname, size_t _numTargets, TargetRig &o_rig);
+
+} // end namespace morph
+
+#endif
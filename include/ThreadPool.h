@@ -0,0 +1,76 @@
+#ifndef THREADPOOL_H_
+#define THREADPOOL_H_
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file ThreadPool.h
+/// @brief a simple fixed size thread pool used by the morph core for loading and evaluation
+/// @class ThreadPool
+/// @brief workers pull jobs from a single queue. parallelFor has the calling thread work on the range as well
+/// and only waits on chunks that are actually running, so it can be called from inside a job (nested
+/// parallelism) without deadlocking the pool
+//----------------------------------------------------------------------------------------------------------------------
+namespace morph
+{
+class ThreadPool
+{
+  public:
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief create the pool
+    /// @param [in] _numThreads the number of workers, 0 uses one per hardware thread (minus the caller)
+    //----------------------------------------------------------------------------------------------------------------------
+    explicit ThreadPool(size_t _numThreads = 0);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the shared pool used by the library
+    //----------------------------------------------------------------------------------------------------------------------
+    static ThreadPool &global();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief number of worker threads, callers of parallelFor add one more
+    //----------------------------------------------------------------------------------------------------------------------
+    size_t numThreads() const noexcept { return m_workers.size(); }
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief run a job on the pool
+    /// @returns a future for the result of the job
+    //----------------------------------------------------------------------------------------------------------------------
+    template <typename Func>
+    auto submit(Func &&_func) -> std::future<std::invoke_result_t<std::decay_t<Func>>>
+    {
+      using Result = std::invoke_result_t<std::decay_t<Func>>;
+      auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Func>(_func));
+      auto future = task->get_future();
+      enqueue([task]() { (*task)(); });
+      return future;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief call _func(begin, end) over [_begin, _end) split into chunks of about _grain items, returns
+    /// once every chunk is done
+    //----------------------------------------------------------------------------------------------------------------------
+    void parallelFor(size_t _begin, size_t _end, size_t _grain, const std::function<void(size_t, size_t)> &_func);
+
+  private:
+    void enqueue(std::function<void()> _job);
+    void workerLoop();
+
+    std::vector<std::thread> m_workers;
+    std::deque<std::function<void()>> m_jobs;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    bool m_stop = false;
+};
+
+} // end namespace morph
+
+#endif
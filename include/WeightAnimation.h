@@ -0,0 +1,137 @@
+#ifndef WEIGHTANIMATION_H_
+#define WEIGHTANIMATION_H_
+#include "ThreadPool.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file WeightAnimation.h
+/// @brief keyframed weight animation. Curves are shared, a channel plays a curve into one weight slot from a
+/// start time. Everything is evaluated in one batch per frame from a single clock, the keys of all the curves
+/// live in two flat arrays and the channels are stored as parallel arrays so thousands of channels are a
+/// linear walk with no per channel timers or allocations
+//----------------------------------------------------------------------------------------------------------------------
+namespace morph
+{
+enum class Interpolation : uint8_t
+{
+  STEP,
+  LINEAR,
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief ease in and out of every key (smoothstep between the values)
+  //----------------------------------------------------------------------------------------------------------------------
+  SMOOTH
+};
+
+struct Keyframe
+{
+  float m_time;
+  float m_value;
+};
+
+class WeightAnimation
+{
+  public:
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief add a curve
+    /// @param [in] _keys the keys, sorted by time here. Times are relative to when a channel starts playing
+    /// @param [in] _interpolation how to go between the keys
+    /// @returns the curve id, or -1 if there are no keys
+    //----------------------------------------------------------------------------------------------------------------------
+    int addCurve(std::vector<Keyframe> _keys, Interpolation _interpolation = Interpolation::LINEAR);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief add a channel that writes a curve into a weight
+    /// @param [in] _curve the curve from addCurve
+    /// @param [in] _output the index of the weight it drives, each weight should only have one playing channel
+    /// @param [in] _loop wrap around at the end of the curve rather than stopping
+    /// @returns the channel id, or -1 if _curve isn't valid
+    //----------------------------------------------------------------------------------------------------------------------
+    int addChannel(int _curve, size_t _output, bool _loop = false);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief start (or restart) a channel at _time on the clock passed to evaluate
+    //----------------------------------------------------------------------------------------------------------------------
+    void play(int _channel, double _time);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief stop a channel, its weight keeps the last value written
+    //----------------------------------------------------------------------------------------------------------------------
+    void stop(int _channel);
+    bool isPlaying(int _channel) const noexcept;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief number of channels playing, when this is 0 nothing needs evaluating
+    //----------------------------------------------------------------------------------------------------------------------
+    size_t numPlaying() const noexcept { return m_playing.size(); }
+    size_t numCurves() const noexcept { return m_curveFirstKey.size(); }
+    size_t numChannels() const noexcept { return m_channelCurve.size(); }
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the length of a curve, the time of its last key
+    //----------------------------------------------------------------------------------------------------------------------
+    float duration(int _curve) const noexcept;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief evaluate a curve at a time, mainly for offline use (see morphbake)
+    //----------------------------------------------------------------------------------------------------------------------
+    float sample(int _curve, float _time) const noexcept;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief evaluate every playing channel, channels that reach the end of a non looping curve write the last
+    /// key value and stop
+    /// @param [in] _time the current time on the animation clock
+    /// @param [in,out] io_weights the weights to write, must be big enough for every channel output
+    /// @param [in] _pool pool to split large batches across, nullptr runs on the calling thread
+    /// @returns true if any weight changed value
+    //----------------------------------------------------------------------------------------------------------------------
+    bool evaluate(double _time, std::vector<float> &io_weights, ThreadPool *_pool = &ThreadPool::global());
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief sample every channel (playing or not) at _time measured from its start time, with no state
+    /// changes so it can be called for many frames at once from different threads
+    //----------------------------------------------------------------------------------------------------------------------
+    void sampleAll(double _time, std::vector<float> &io_weights) const;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the largest output index driven by a channel plus one, the size io_weights needs to be
+    //----------------------------------------------------------------------------------------------------------------------
+    size_t numOutputs() const noexcept;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the time the last non looping channel finishes
+    //----------------------------------------------------------------------------------------------------------------------
+    double endTime() const noexcept;
+
+  private:
+    float channelValue(int _channel, double _time, uint32_t &io_cursor) const noexcept;
+    float sampleFrom(int _curve, float _time, uint32_t &io_cursor) const noexcept;
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the keys of every curve, curve c is [m_curveFirstKey[c], m_curveFirstKey[c] + m_curveNumKeys[c])
+    //----------------------------------------------------------------------------------------------------------------------
+    std::vector<float> m_keyTimes;
+    std::vector<float> m_keyValues;
+    std::vector<uint32_t> m_curveFirstKey;
+    std::vector<uint32_t> m_curveNumKeys;
+    std::vector<Interpolation> m_curveInterpolation;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the channels, the cursor is the key segment last used so forward playback doesn't search
+    //----------------------------------------------------------------------------------------------------------------------
+    std::vector<int> m_channelCurve;
+    std::vector<uint32_t> m_channelOutput;
+    std::vector<double> m_channelStart;
+    std::vector<uint32_t> m_channelCursor;
+    std::vector<uint8_t> m_channelLoop;
+    std::vector<uint8_t> m_channelPlaying;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the playing channels and, for each, whether it reached the end this evaluation
+    //----------------------------------------------------------------------------------------------------------------------
+    std::vector<int> m_playing;
+    std::vector<uint8_t> m_finished;
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief read a weight curve file, each line is a channel driving one target
+/// <target> <step|linear|smooth> [loop] <time> <value> [<time> <value> ...]
+/// blank lines and anything after a # are ignored, every channel is started at time 0
+/// @param [in] _fname the file to read
+/// @param [out] o_animation the curves and channels are added to this
+/// @returns false if the file can't be read or a line is malformed
+//----------------------------------------------------------------------------------------------------------------------
+bool readWeightCurves(const std::string &_fname, WeightAnimation &o_animation);
+
+} // end namespace morph
+
+#endif
@@ -0,0 +1,56 @@
+#version 330 core
+// the same as MorphFeedbackVert.glsl but the deltas are compressed (see QuantizedDeltas.h and
+// PerFragASDQuantVert.glsl for the decode)
+layout (location =0) in vec3 baseVert;
+layout (location =1) in vec3 baseNormal;
+
+// must match MAX_ACTIVE_TARGETS in NGLScene.h
+const int MAX_ACTIVE_TARGETS=64;
+uniform samplerBuffer deltas;
+uniform samplerBuffer normalDeltas;
+uniform int numVerts;
+// the active targets, the same block as PerFragASDVert.glsl
+layout (std140) uniform Morph
+{
+	int activeCount;
+	ivec4 activeTargets[MAX_ACTIVE_TARGETS/4];
+	vec4 activeWeights[MAX_ACTIVE_TARGETS/4];
+	// the bounding box of each active compressed target, the delta is activeBias+texel*activeScale
+	vec4 activeScale[MAX_ACTIVE_TARGETS];
+	vec4 activeBias[MAX_ACTIVE_TARGETS];
+};
+uniform bool useRecomputedNormals;
+uniform samplerBuffer recomputedNormals;
+out vec3 outPosition;
+out vec3 outNormal;
+
+vec3 octDecode(vec2 e)
+{
+	e=e*2.0-1.0;
+	vec3 n=vec3(e.x,e.y,1.0-abs(e.x)-abs(e.y));
+	float t=max(-n.z,0.0);
+	n.x+=n.x>=0.0 ? -t : t;
+	n.y+=n.y>=0.0 ? -t : t;
+	return normalize(n);
+}
+
+void main()
+{
+	vec3 finalP=baseVert;
+	vec3 finalN=baseNormal;
+	for(int i=0; i<activeCount; ++i)
+	{
+		float weight=activeWeights[i/4][i%4];
+		int texel=activeTargets[i/4][i%4]*numVerts+gl_VertexID;
+		vec3 deltaP=activeBias[i].xyz+texelFetch(deltas,texel).xyz*activeScale[i].xyz;
+		vec3 deltaN=octDecode(texelFetch(normalDeltas,texel).xy)-baseNormal;
+		finalP=finalP+(weight*deltaP);
+		finalN=finalN+(weight*deltaN);
+	}
+	if(useRecomputedNormals)
+	{
+		finalN=texelFetch(recomputedNormals,gl_VertexID).xyz;
+	}
+	outPosition=finalP;
+	outNormal=finalN;
+}
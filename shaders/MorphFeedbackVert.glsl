@@ -0,0 +1,48 @@
+#version 330 core
+// the morph on its own for the transform feedback pre-pass, the blend is the same as PerFragASDVert.glsl but the
+// object space result is captured to a vertex buffer (drawn as points with the rasteriser off) so every later
+// draw can use it as a static mesh with PerFragASDStaticVert.glsl
+layout (location =0) in vec3 baseVert;
+layout (location =1) in vec3 baseNormal;
+
+// must match MAX_ACTIVE_TARGETS in NGLScene.h
+const int MAX_ACTIVE_TARGETS=64;
+// all the pose deltas, for target t and vertex v the position delta is at (t*numVerts+v)*2 and the normal
+// delta is the texel after it (see MorphMesh::packDeltas)
+uniform samplerBuffer deltas;
+uniform int numVerts;
+// the active targets, the same block as PerFragASDVert.glsl
+layout (std140) uniform Morph
+{
+	int activeCount;
+	ivec4 activeTargets[MAX_ACTIVE_TARGETS/4];
+	vec4 activeWeights[MAX_ACTIVE_TARGETS/4];
+	// the bounding box of each active compressed target, the delta is activeBias+texel*activeScale
+	vec4 activeScale[MAX_ACTIVE_TARGETS];
+	vec4 activeBias[MAX_ACTIVE_TARGETS];
+};
+uniform bool useRecomputedNormals;
+uniform samplerBuffer recomputedNormals;
+// captured interleaved in the same layout as the base mesh (position / normal)
+out vec3 outPosition;
+out vec3 outNormal;
+
+void main()
+{
+	vec3 finalP=baseVert;
+	vec3 finalN=baseNormal;
+	for(int i=0; i<activeCount; ++i)
+	{
+		float weight=activeWeights[i/4][i%4];
+		int texel=(activeTargets[i/4][i%4]*numVerts+gl_VertexID)*2;
+		finalP=finalP+(weight*texelFetch(deltas,texel).xyz);
+		finalN=finalN+(weight*texelFetch(deltas,texel+1).xyz);
+	}
+	if(useRecomputedNormals)
+	{
+		finalN=texelFetch(recomputedNormals,gl_VertexID).xyz;
+	}
+	// left unnormalized like the in shader path, the draw normalizes after the normal matrix
+	outPosition=finalP;
+	outNormal=finalN;
+}
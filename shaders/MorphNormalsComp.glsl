@@ -0,0 +1,90 @@
+#version 430 core
+// recomputes the normals of the blended mesh, the GPU version of NormalRecompute. It is dispatched once per
+// stage with a barrier between them
+// stage 0 : one thread per vertex, blend the positions the same way as PerFragASDVert.glsl
+// stage 1 : one thread per face, the area weighted face normal
+// stage 2 : one thread per vertex, sum the faces around it (CSR adjacency) and normalize
+// vec3 arrays are padded to 16 bytes in std430 so everything is stored as plain floats
+layout (local_size_x=64) in;
+
+// must match MAX_ACTIVE_TARGETS in NGLScene.h
+const int MAX_ACTIVE_TARGETS=64;
+uniform samplerBuffer deltas;
+uniform int numVerts;
+// the active targets, the same block as PerFragASDVert.glsl
+layout (std140) uniform Morph
+{
+	int activeCount;
+	ivec4 activeTargets[MAX_ACTIVE_TARGETS/4];
+	vec4 activeWeights[MAX_ACTIVE_TARGETS/4];
+	// the bounding box of each active compressed target, the delta is activeBias+texel*activeScale
+	vec4 activeScale[MAX_ACTIVE_TARGETS];
+	vec4 activeBias[MAX_ACTIVE_TARGETS];
+};
+uniform int stage;
+
+// the VAO vertex buffer, base position then normal for each vertex
+layout (std430, binding=0) readonly buffer BaseVertices { float baseVerts[]; };
+layout (std430, binding=1) buffer Positions { float positions[]; };
+layout (std430, binding=2) readonly buffer Indices { uint indices[]; };
+layout (std430, binding=3) buffer FaceNormals { float faceNormals[]; };
+layout (std430, binding=4) readonly buffer AdjacencyOffsets { uint adjacencyOffsets[]; };
+layout (std430, binding=5) readonly buffer AdjacentFaces { uint adjacentFaces[]; };
+// the recomputedNormals texture buffer read by the vertex shader
+layout (std430, binding=6) buffer Normals { float normals[]; };
+
+vec3 loadPosition(uint v)
+{
+	return vec3(positions[v*3],positions[v*3+1],positions[v*3+2]);
+}
+
+void main()
+{
+	uint id=gl_GlobalInvocationID.x;
+	if(stage==0)
+	{
+		if(id>=uint(numVerts))
+			return;
+		vec3 p=vec3(baseVerts[id*6],baseVerts[id*6+1],baseVerts[id*6+2]);
+		for(int i=0; i<activeCount; ++i)
+		{
+			int texel=(activeTargets[i/4][i%4]*numVerts+int(id))*2;
+			p=p+(activeWeights[i/4][i%4]*texelFetch(deltas,texel).xyz);
+		}
+		positions[id*3]=p.x;
+		positions[id*3+1]=p.y;
+		positions[id*3+2]=p.z;
+	}
+	else if(stage==1)
+	{
+		if(id*3>=uint(indices.length()))
+			return;
+		vec3 p0=loadPosition(indices[id*3]);
+		vec3 p1=loadPosition(indices[id*3+1]);
+		vec3 p2=loadPosition(indices[id*3+2]);
+		// not normalized so bigger faces count for more
+		vec3 n=cross(p1-p0,p2-p0);
+		faceNormals[id*3]=n.x;
+		faceNormals[id*3+1]=n.y;
+		faceNormals[id*3+2]=n.z;
+	}
+	else
+	{
+		if(id>=uint(numVerts))
+			return;
+		vec3 n=vec3(0.0);
+		for(uint a=adjacencyOffsets[id]; a<adjacencyOffsets[id+1]; ++a)
+		{
+			uint f=adjacentFaces[a];
+			n+=vec3(faceNormals[f*3],faceNormals[f*3+1],faceNormals[f*3+2]);
+		}
+		// vertices with no area around them keep the normal they had
+		if(dot(n,n)>0.0)
+		{
+			n=normalize(n);
+			normals[id*3]=n.x;
+			normals[id*3+1]=n.y;
+			normals[id*3+2]=n.z;
+		}
+	}
+}
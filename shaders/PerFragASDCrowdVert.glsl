@@ -0,0 +1,59 @@
+#version 330 core
+// instanced version of PerFragASDVert.glsl, every instance has its own weights and model matrix which are
+// fetched with gl_InstanceID so the whole crowd is one draw call (see CrowdState.h)
+layout (location =0) in vec3 baseVert;
+layout (location =1) in vec3 baseNormal;
+
+// the pose deltas, texel (t*numVerts+v)*2 is the position delta and the next texel the normal delta
+uniform samplerBuffer deltas;
+uniform int numTargets;
+// the weight of target t for instance i is texel t*numInstances+i
+uniform samplerBuffer instanceWeights;
+uniform int numInstances;
+// a column major model matrix per instance, 4 texels each
+uniform samplerBuffer instanceMatrices;
+// with LOD each level is its own draw, the instance ids for it are texels instanceOffset+gl_InstanceID
+uniform isamplerBuffer instanceIndex;
+// what changes from draw to draw, one block per draw in the frame's ring buffer region (see DrawUniforms in
+// NGLScene.h). numVerts is the level's vertex count
+layout (std140) uniform Draw
+{
+	int numVerts;
+	int instanceOffset;
+	bool useInstanceIndex;
+};
+// the same block as PerFragASDVert.glsl, MV is the view with the mouse transform
+layout (std140) uniform Frame
+{
+	mat4 MVP;
+	mat4 MV;
+	mat4 P;
+	mat3 normalMatrix;
+};
+out vec3 position;
+out vec3 normal;
+
+void main()
+{
+	int instance=useInstanceIndex ? texelFetch(instanceIndex,instanceOffset+gl_InstanceID).r : gl_InstanceID;
+	vec3 finalP=baseVert;
+	vec3 finalN=baseNormal;
+	for(int t=0; t<numTargets; ++t)
+	{
+		float w=texelFetch(instanceWeights,t*numInstances+instance).r;
+		if(w!=0.0)
+		{
+			int texel=(t*numVerts+gl_VertexID)*2;
+			finalP=finalP+(w*texelFetch(deltas,texel).xyz);
+			finalN=finalN+(w*texelFetch(deltas,texel+1).xyz);
+		}
+	}
+	int m=instance*4;
+	mat4 model=mat4(texelFetch(instanceMatrices,m),texelFetch(instanceMatrices,m+1),
+	                texelFetch(instanceMatrices,m+2),texelFetch(instanceMatrices,m+3));
+	mat4 modelView=MV*model;
+	// the model matrices are rotation and translation only so the upper 3x3 is fine for the normals
+	normal = normalize(mat3(modelView)*finalN);
+	position = vec3(modelView * vec4(finalP,1.0));
+	gl_Position = P*vec4(position,1.0);
+}
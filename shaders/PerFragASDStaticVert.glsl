@@ -0,0 +1,91 @@
+#version 330 core
+// lighting for a mesh that has already been morphed (the transform feedback pre-pass output), the same outputs
+// as PerFragASDVert.glsl so it shares PerFragASDFrag.glsl
+layout (location =0) in vec3 inVert;
+layout (location =1) in vec3 inNormal;
+
+// the pre-pass only morphs so the skinning is done here (see Skinning.h), skinInfluences is 0 when there is no skeleton
+uniform int skinInfluences;
+uniform bool skinDualQuat;
+// 3 RGBA texels per joint for the rows of its 3x4 matrix, or 2 for its dual quaternion (real then dual)
+uniform samplerBuffer skinPalette;
+// skinInfluences/4 texels per vertex of joint indices and their unorm weights
+uniform usamplerBuffer skinJoints;
+uniform samplerBuffer skinWeights;
+// the same block as PerFragASDVert.glsl
+layout (std140) uniform Frame
+{
+	mat4 MVP;
+	mat4 MV;
+	mat4 P;
+	mat3 normalMatrix;
+};
+out vec3 position;
+out vec3 normal;
+
+// linear blend or dual quaternion skinning, the same as morph::skinVertices
+void skin(inout vec3 io_p, inout vec3 io_n)
+{
+	if(skinInfluences==0)
+	{
+		return;
+	}
+	int texels=skinInfluences/4;
+	if(skinDualQuat)
+	{
+		vec4 real=vec4(0.0);
+		vec4 dual=vec4(0.0);
+		// q and -q are the same rotation, blend every joint in the first one's hemisphere
+		vec4 first=texelFetch(skinPalette,int(texelFetch(skinJoints,gl_VertexID*texels).x)*2);
+		for(int t=0; t<texels; ++t)
+		{
+			uvec4 j=texelFetch(skinJoints,gl_VertexID*texels+t);
+			vec4 w=texelFetch(skinWeights,gl_VertexID*texels+t);
+			for(int i=0; i<4; ++i)
+			{
+				vec4 r=texelFetch(skinPalette,int(j[i])*2);
+				float s=dot(first,r)<0.0 ? -w[i] : w[i];
+				real+=s*r;
+				dual+=s*texelFetch(skinPalette,int(j[i])*2+1);
+			}
+		}
+		float len=length(real);
+		real/=len;
+		dual/=len;
+		vec3 t=2.0*(real.w*dual.xyz-dual.w*real.xyz+cross(real.xyz,dual.xyz));
+		io_p=io_p+2.0*cross(real.xyz,cross(real.xyz,io_p)+real.w*io_p)+t;
+		io_n=io_n+2.0*cross(real.xyz,cross(real.xyz,io_n)+real.w*io_n);
+	}
+	else
+	{
+		vec4 r0=vec4(0.0);
+		vec4 r1=vec4(0.0);
+		vec4 r2=vec4(0.0);
+		for(int t=0; t<texels; ++t)
+		{
+			uvec4 j=texelFetch(skinJoints,gl_VertexID*texels+t);
+			vec4 w=texelFetch(skinWeights,gl_VertexID*texels+t);
+			for(int i=0; i<4; ++i)
+			{
+				int row=int(j[i])*3;
+				r0+=w[i]*texelFetch(skinPalette,row);
+				r1+=w[i]*texelFetch(skinPalette,row+1);
+				r2+=w[i]*texelFetch(skinPalette,row+2);
+			}
+		}
+		vec4 p=vec4(io_p,1.0);
+		vec4 n=vec4(io_n,0.0);
+		io_p=vec3(dot(r0,p),dot(r1,p),dot(r2,p));
+		io_n=vec3(dot(r0,n),dot(r1,n),dot(r2,n));
+	}
+}
+
+void main()
+{
+	vec3 finalP=inVert;
+	vec3 finalN=inNormal;
+	skin(finalP,finalN);
+	normal = normalize( normalMatrix * finalN);
+	position = vec3(MV * vec4(finalP,1.0));
+	gl_Position = MVP*vec4(finalP,1.0);
+}
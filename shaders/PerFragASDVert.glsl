@@ -2,39 +2,127 @@
 // this is base on http://http.developer.nvidia.com/GPUGems3/gpugems3_ch03.html
 layout (location =0) in vec3 baseVert;
 layout (location =1) in vec3 baseNormal;
-layout (location =2) in vec3 poseVert1;
-layout (location =3) in vec3 poseNormal1;
-layout (location =4) in vec3 poseVert2;
-layout (location =5) in vec3 poseNormal2;
 
-// transform matrix values
-uniform mat4 MVP;
-uniform mat3 normalMatrix;
-uniform mat4 MV;
-uniform float weight1;
-uniform float weight2;
+// must match MAX_ACTIVE_TARGETS in NGLScene.h
+const int MAX_ACTIVE_TARGETS=64;
+// all the pose deltas, for target t and vertex v the position delta is at (t*numVerts+v)*2 and the normal
+// delta is the texel after it (see MorphMesh::packDeltas)
+uniform samplerBuffer deltas;
+uniform int numVerts;
+// only the targets with a non zero weight are passed in so the cost is per active target. They are written
+// into the same ring buffer region as the matrices (see MorphUniforms in NGLScene.h), std140 pads every array
+// element to a vec4 so the targets and weights are packed four to one
+layout (std140) uniform Morph
+{
+	int activeCount;
+	ivec4 activeTargets[MAX_ACTIVE_TARGETS/4];
+	vec4 activeWeights[MAX_ACTIVE_TARGETS/4];
+	// the bounding box of each active compressed target, the delta is activeBias+texel*activeScale
+	vec4 activeScale[MAX_ACTIVE_TARGETS];
+	vec4 activeBias[MAX_ACTIVE_TARGETS];
+};
+// normals rebuilt from the blended positions (NormalRecompute / MorphNormalsComp.glsl) used instead of
+// blending the normal deltas when set
+uniform bool useRecomputedNormals;
+uniform samplerBuffer recomputedNormals;
+// skinning after the morph (see Skinning.h), skinInfluences is 0 when there is no skeleton
+uniform int skinInfluences;
+uniform bool skinDualQuat;
+// 3 RGBA texels per joint for the rows of its 3x4 matrix, or 2 for its dual quaternion (real then dual)
+uniform samplerBuffer skinPalette;
+// skinInfluences/4 texels per vertex of joint indices and their unorm weights
+uniform usamplerBuffer skinJoints;
+uniform samplerBuffer skinWeights;
+// the camera matrices, written once a frame into a ring buffer and bound by offset (see FrameUniforms in
+// NGLScene.h)
+layout (std140) uniform Frame
+{
+	mat4 MVP;
+	mat4 MV;
+	mat4 P;
+	mat3 normalMatrix;
+};
 out vec3 position;
 out vec3 normal;
 
+// linear blend or dual quaternion skinning, the same as morph::skinVertices
+void skin(inout vec3 io_p, inout vec3 io_n)
+{
+	if(skinInfluences==0)
+	{
+		return;
+	}
+	int texels=skinInfluences/4;
+	if(skinDualQuat)
+	{
+		vec4 real=vec4(0.0);
+		vec4 dual=vec4(0.0);
+		// q and -q are the same rotation, blend every joint in the first one's hemisphere
+		vec4 first=texelFetch(skinPalette,int(texelFetch(skinJoints,gl_VertexID*texels).x)*2);
+		for(int t=0; t<texels; ++t)
+		{
+			uvec4 j=texelFetch(skinJoints,gl_VertexID*texels+t);
+			vec4 w=texelFetch(skinWeights,gl_VertexID*texels+t);
+			for(int i=0; i<4; ++i)
+			{
+				vec4 r=texelFetch(skinPalette,int(j[i])*2);
+				float s=dot(first,r)<0.0 ? -w[i] : w[i];
+				real+=s*r;
+				dual+=s*texelFetch(skinPalette,int(j[i])*2+1);
+			}
+		}
+		float len=length(real);
+		real/=len;
+		dual/=len;
+		vec3 t=2.0*(real.w*dual.xyz-dual.w*real.xyz+cross(real.xyz,dual.xyz));
+		io_p=io_p+2.0*cross(real.xyz,cross(real.xyz,io_p)+real.w*io_p)+t;
+		io_n=io_n+2.0*cross(real.xyz,cross(real.xyz,io_n)+real.w*io_n);
+	}
+	else
+	{
+		vec4 r0=vec4(0.0);
+		vec4 r1=vec4(0.0);
+		vec4 r2=vec4(0.0);
+		for(int t=0; t<texels; ++t)
+		{
+			uvec4 j=texelFetch(skinJoints,gl_VertexID*texels+t);
+			vec4 w=texelFetch(skinWeights,gl_VertexID*texels+t);
+			for(int i=0; i<4; ++i)
+			{
+				int row=int(j[i])*3;
+				r0+=w[i]*texelFetch(skinPalette,row);
+				r1+=w[i]*texelFetch(skinPalette,row+1);
+				r2+=w[i]*texelFetch(skinPalette,row+2);
+			}
+		}
+		vec4 p=vec4(io_p,1.0);
+		vec4 n=vec4(io_n,0.0);
+		io_p=vec3(dot(r0,p),dot(r1,p),dot(r2,p));
+		io_n=vec3(dot(r0,n),dot(r1,n),dot(r2,n));
+	}
+}
+
 void main()
 {
-	// first we computer the weighted normal
-	vec3  finalN=baseNormal+(weight1*poseNormal1)+(weight2*poseNormal2);
+	vec3 finalP=baseVert;
+	vec3 finalN=baseNormal;
+	// add the weighted deltas to the base mesh
+	for(int i=0; i<activeCount; ++i)
+	{
+		float weight=activeWeights[i/4][i%4];
+		int texel=(activeTargets[i/4][i%4]*numVerts+gl_VertexID)*2;
+		finalP=finalP+(weight*texelFetch(deltas,texel).xyz);
+		finalN=finalN+(weight*texelFetch(deltas,texel+1).xyz);
+	}
+	if(useRecomputedNormals)
+	{
+		finalN=texelFetch(recomputedNormals,gl_VertexID).xyz;
+	}
+	skin(finalP,finalN);
 	// then normalize and mult by normal matrix for shading
 	normal = normalize( normalMatrix * finalN);
 	// now calculate the eye cord position for the frag stage
-	// now calculated the weighted vertices and add to the base mesh
-	vec3  finalP=baseVert+(weight1*poseVert1)+(weight2*poseVert2);
 	position = vec3(MV * vec4(finalP,1.0));
 	// Convert position to clip coordinates and pass along
 	gl_Position = MVP*vec4(finalP,1.0);
 }
-
-
-
-
-
-
-
-
-
@@ -0,0 +1,71 @@
+#include "Arena.h"
+#include <algorithm>
+
+namespace morph
+{
+void *Arena::allocate(size_t _bytes, size_t _alignment)
+{
+  _bytes = std::max<size_t>(_bytes, 1);
+  m_inUse += _bytes + _alignment - 1;
+  m_highWater = std::max(m_highWater, m_inUse);
+  if (!m_blocks.empty())
+  {
+    const size_t offset = (m_used + _alignment - 1) & ~(_alignment - 1);
+    if (offset + _bytes <= m_blocks[m_current].m_size)
+    {
+      m_used = offset + _bytes;
+      return m_blocks[m_current].m_data.get() + offset;
+    }
+  }
+  // the blocks kept after a rewind are tried before making a new one, the block start is max_align_t aligned
+  size_t next = m_blocks.empty() ? 0 : m_current + 1;
+  while (next < m_blocks.size() && m_blocks[next].m_size < _bytes)
+  {
+    ++next;
+  }
+  if (next == m_blocks.size())
+  {
+    Block block;
+    block.m_size = std::max(_bytes, m_blocks.empty() ? m_blockBytes : m_blocks.back().m_size * 2);
+    block.m_data.reset(new char[block.m_size]);
+    m_blocks.push_back(std::move(block));
+  }
+  m_current = next;
+  m_used = _bytes;
+  return m_blocks[m_current].m_data.get();
+}
+
+void Arena::rewind(const Mark &_mark) noexcept
+{
+  m_current = _mark.m_block;
+  m_used = _mark.m_used;
+  m_inUse = _mark.m_inUse;
+}
+
+void Arena::reset()
+{
+  if (m_blocks.size() > 1)
+  {
+    // the blocks are freed before the replacement is made so the peak isn't doubled
+    m_blocks.clear();
+    Block block;
+    block.m_size = m_highWater;
+    block.m_data.reset(new char[m_highWater]);
+    m_blocks.push_back(std::move(block));
+  }
+  m_current = 0;
+  m_used = 0;
+  m_inUse = 0;
+}
+
+size_t Arena::capacity() const noexcept
+{
+  size_t total = 0;
+  for (const auto &b : m_blocks)
+  {
+    total += b.m_size;
+  }
+  return total;
+}
+
+} // end namespace morph
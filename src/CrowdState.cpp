@@ -0,0 +1,91 @@
+#include "CrowdState.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+namespace morph
+{
+namespace
+{
+// instances per parallelFor job
+constexpr size_t c_grain = 4096;
+
+void forRange(ThreadPool *_pool, size_t _count, const std::function<void(size_t, size_t)> &_func)
+{
+  if (_pool != nullptr)
+  {
+    _pool->parallelFor(0, _count, c_grain, _func);
+  }
+  else
+  {
+    _func(0, _count);
+  }
+}
+} // end anonymous namespace
+
+void CrowdState::spawn(size_t _count, size_t _numTargets, float _spacing, uint32_t _seed)
+{
+  m_numTargets = _numTargets;
+  for (auto *v : {&m_x, &m_y, &m_z, &m_baseHeading, &m_heading, &m_phase, &m_rate})
+  {
+    v->resize(_count);
+  }
+  m_weights.assign(_count * _numTargets, 0.0f);
+  const size_t side = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(_count))));
+  m_extent = 0.5f * _spacing * static_cast<float>(side > 0 ? side - 1 : 0);
+  std::mt19937 rng(_seed);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  for (size_t i = 0; i < _count; ++i)
+  {
+    m_x[i] = static_cast<float>(i % side) * _spacing - m_extent;
+    m_y[i] = 0.0f;
+    m_z[i] = static_cast<float>(i / side) * _spacing - m_extent;
+    // mostly facing the camera
+    m_baseHeading[i] = (unit(rng) - 0.5f) * 1.5f;
+    m_heading[i] = m_baseHeading[i];
+    m_phase[i] = unit(rng) * 6.2831853f;
+    m_rate[i] = 1.5f + unit(rng) * 3.0f;
+  }
+}
+
+void CrowdState::update(double _time, ThreadPool *_pool)
+{
+  const size_t n = size();
+  // wrap the clock so the sin arguments stay small enough for float precision
+  const float time = static_cast<float>(std::fmod(_time, 1000.0 * 6.283185307179586));
+  forRange(_pool, n, [&](size_t _begin, size_t _end)
+           {
+             for (size_t i = _begin; i < _end; ++i)
+             {
+               m_heading[i] = m_baseHeading[i] + 0.4f * std::sin(0.3f * time + m_phase[i]);
+             }
+             // each target is a stream of its own, the targets are offset in time so they don't all fire at once
+             for (size_t t = 0; t < m_numTargets; ++t)
+             {
+               float *w = &m_weights[t * n];
+               const float offset = 1.7f * static_cast<float>(t);
+               for (size_t i = _begin; i < _end; ++i)
+               {
+                 w[i] = std::max(0.0f, std::sin(time * m_rate[i] + m_phase[i] + offset));
+               }
+             }
+           });
+}
+
+void CrowdState::packMatrices(std::vector<float> &o_matrices, ThreadPool *_pool) const
+{
+  o_matrices.resize(size() * 16);
+  forRange(_pool, size(), [&](size_t _begin, size_t _end)
+           {
+             for (size_t i = _begin; i < _end; ++i)
+             {
+               // a rotation about y then the translation
+               const float c = std::cos(m_heading[i]);
+               const float s = std::sin(m_heading[i]);
+               const float m[16] = {c, 0.0f, -s, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, s, 0.0f, c, 0.0f, m_x[i], m_y[i], m_z[i], 1.0f};
+               std::copy(m, m + 16, &o_matrices[i * 16]);
+             }
+           });
+}
+
+} // end namespace morph
@@ -0,0 +1,121 @@
+#include "HeadlessRun.h"
+#include "NGLScene.h"
+#include "WeightAnimation.h"
+#include <QDir>
+#include <QImage>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+namespace
+{
+// both punch poses swinging in and out of phase, used when no curve file is given
+void builtInScript(morph::WeightAnimation &o_script)
+{
+  int swing = o_script.addCurve({{0.0f, 0.0f}, {1.0f, 1.0f}, {2.0f, 0.0f}}, morph::Interpolation::SMOOTH);
+  int offset = o_script.addCurve({{0.0f, 1.0f}, {1.0f, 0.0f}, {2.0f, 1.0f}}, morph::Interpolation::SMOOTH);
+  o_script.addChannel(swing, 0, true);
+  o_script.addChannel(offset, 1, true);
+}
+} // end anonymous namespace
+
+int runHeadless(const HeadlessOptions &_options, const QSurfaceFormat &_format,
+                const std::function<void(NGLScene &)> &_configure)
+{
+  QOffscreenSurface surface;
+  surface.setFormat(_format);
+  surface.create();
+  QOpenGLContext context;
+  context.setFormat(_format);
+  if (!surface.isValid() || !context.create() || !context.makeCurrent(&surface))
+  {
+    std::cerr << "Unable to create an offscreen OpenGL context\n";
+    return EXIT_FAILURE;
+  }
+  std::cout << "Headless OpenGL " << context.format().majorVersion() << '.' << context.format().minorVersion() << '\n';
+
+  morph::WeightAnimation script;
+  if (_options.m_curves.empty())
+  {
+    builtInScript(script);
+  }
+  else if (!morph::readWeightCurves(_options.m_curves, script))
+  {
+    return EXIT_FAILURE;
+  }
+  if (!_options.m_dumpDir.empty() && !QDir(".").mkpath(QString::fromStdString(_options.m_dumpDir)))
+  {
+    std::cerr << "Unable to create " << _options.m_dumpDir << '\n';
+    return EXIT_FAILURE;
+  }
+
+  // everything is drawn into this instead of a window, it isn't multisampled so the dumps are repeatable. It is
+  // declared before the scene so the scene's GL objects are released first while the context is still current
+  QOpenGLFramebufferObject fbo(_options.m_width, _options.m_height, QOpenGLFramebufferObject::CombinedDepthStencil);
+  if (!fbo.isValid())
+  {
+    std::cerr << "Unable to create a " << _options.m_width << 'x' << _options.m_height << " framebuffer\n";
+    return EXIT_FAILURE;
+  }
+  NGLScene scene;
+  _configure(scene);
+  // the overlay numbers change every run, as would the frame a streamed target first shows up in
+  scene.setProfileVisible(false);
+  scene.setWaitForPoses(true);
+  scene.resize(_options.m_width, _options.m_height);
+  fbo.bind();
+  scene.initializeGL();
+  scene.resizeGL(_options.m_width, _options.m_height);
+  if (script.numOutputs() > scene.numTargets())
+  {
+    std::cerr << "The script drives target " << script.numOutputs() - 1 << " but there are only " << scene.numTargets()
+              << " targets\n";
+    return EXIT_FAILURE;
+  }
+
+  std::vector<float> weights(scene.numTargets(), 0.0f);
+  const auto start = std::chrono::steady_clock::now();
+  for (size_t frame = 0; frame < _options.m_frames; ++frame)
+  {
+    const double time = static_cast<double>(frame) / _options.m_fps;
+    script.sampleAll(time, weights);
+    scene.setAnimationTime(time);
+    scene.setWeights(weights);
+    scene.setCameraRotation(0, static_cast<int>(static_cast<long long>(_options.m_orbit) * static_cast<long long>(frame) /
+                                                static_cast<long long>(_options.m_frames)));
+    // ngl::Text and the pre-pass may leave other framebuffer state bound
+    fbo.bind();
+    scene.paintGL();
+    if (!_options.m_dumpDir.empty())
+    {
+      char name[32];
+      std::snprintf(name, sizeof(name), "/frame.%04zu.png", frame);
+      const auto fname = _options.m_dumpDir + name;
+      if (!fbo.toImage().save(QString::fromStdString(fname)))
+      {
+        std::cerr << "Unable to write " << fname << '\n';
+        return EXIT_FAILURE;
+      }
+    }
+  }
+  // the frames are only queued until this returns
+  glFinish();
+  const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  const auto &profiler = scene.profiler();
+  std::cout << "Rendered " << _options.m_frames << " frames at " << _options.m_width << 'x' << _options.m_height << " in "
+            << seconds * 1000.0 << " ms (" << _options.m_frames / seconds << " frames/s)\n";
+  for (auto stage : {std::make_pair("frame", morph::Profiler::CPU), std::make_pair("gpu frame", morph::Profiler::GPU)})
+  {
+    if (auto stats = profiler.findStage(stage.first, stage.second))
+    {
+      std::cout << stage.first << " average " << stats->average() << " ms min " << stats->min() << " p99 "
+                << stats->percentile(0.99) << " over the last " << stats->count() << " frames\n";
+    }
+  }
+  fbo.release();
+  return EXIT_SUCCESS;
+}
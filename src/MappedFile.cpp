@@ -0,0 +1,129 @@
+#include "MappedFile.h"
+#include <utility>
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace morph
+{
+MappedFile::~MappedFile()
+{
+  close();
+}
+
+MappedFile::MappedFile(MappedFile &&_other) noexcept
+{
+  *this = std::move(_other);
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&_other) noexcept
+{
+  if (this != &_other)
+  {
+    close();
+    std::swap(m_data, _other.m_data);
+    std::swap(m_size, _other.m_size);
+#if defined(_WIN32)
+    std::swap(m_file, _other.m_file);
+    std::swap(m_mapping, _other.m_mapping);
+#endif
+  }
+  return *this;
+}
+
+#if defined(_WIN32)
+bool MappedFile::open(const std::string &_fname)
+{
+  close();
+  HANDLE file = CreateFileA(_fname.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (file == INVALID_HANDLE_VALUE)
+  {
+    return false;
+  }
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+  {
+    CloseHandle(file);
+    return false;
+  }
+  HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (mapping == nullptr)
+  {
+    CloseHandle(file);
+    return false;
+  }
+  m_data = static_cast<const char *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+  if (m_data == nullptr)
+  {
+    CloseHandle(mapping);
+    CloseHandle(file);
+    return false;
+  }
+  m_file = file;
+  m_mapping = mapping;
+  m_size = static_cast<size_t>(size.QuadPart);
+  return true;
+}
+
+void MappedFile::close() noexcept
+{
+  if (m_data != nullptr)
+  {
+    UnmapViewOfFile(m_data);
+    CloseHandle(m_mapping);
+    CloseHandle(m_file);
+  }
+  m_data = nullptr;
+  m_mapping = nullptr;
+  m_file = nullptr;
+  m_size = 0;
+}
+#else
+bool MappedFile::open(const std::string &_fname)
+{
+  close();
+  int fd = ::open(_fname.c_str(), O_RDONLY);
+  if (fd < 0)
+  {
+    return false;
+  }
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size == 0)
+  {
+    ::close(fd);
+    return false;
+  }
+  void *data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+  // the mapping keeps its own reference to the file
+  ::close(fd);
+  if (data == MAP_FAILED)
+  {
+    return false;
+  }
+  // we always read the whole file front to back
+  madvise(data, static_cast<size_t>(info.st_size), MADV_SEQUENTIAL);
+  m_data = static_cast<const char *>(data);
+  m_size = static_cast<size_t>(info.st_size);
+  return true;
+}
+
+void MappedFile::close() noexcept
+{
+  if (m_data != nullptr)
+  {
+    munmap(const_cast<char *>(m_data), m_size);
+  }
+  m_data = nullptr;
+  m_size = 0;
+}
+#endif
+
+} // end namespace morph
@@ -0,0 +1,117 @@
+#include "MappedRing.h"
+#include <algorithm>
+#include <iostream>
+
+MappedRing::~MappedRing()
+{
+  release();
+}
+
+void MappedRing::create(GLenum _target, size_t _regionBytes, size_t _numRegions, bool _persistent, size_t _alignment)
+{
+  release();
+  m_target = _target;
+  m_regionBytes = (_regionBytes + _alignment - 1) / _alignment * _alignment;
+  m_numRegions = std::clamp<size_t>(_numRegions, 1, c_maxRegions);
+  m_persistent = _persistent;
+  const auto bytes = static_cast<GLsizeiptr>(m_regionBytes * m_numRegions);
+  glGenBuffers(1, &m_buffer);
+  glBindBuffer(m_target, m_buffer);
+  if (m_persistent)
+  {
+    // coherent so a write is visible to the GPU without a flush, the fences stop it being overwritten early
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glBufferStorage(m_target, bytes, nullptr, flags);
+    m_mapped = static_cast<char *>(glMapBufferRange(m_target, 0, bytes, flags));
+    if (m_mapped == nullptr)
+    {
+      std::cerr << "Unable to persistently map a " << bytes << " byte buffer\n";
+    }
+  }
+  else
+  {
+    glBufferData(m_target, bytes, nullptr, GL_STREAM_DRAW);
+  }
+  glBindBuffer(m_target, 0);
+}
+
+void *MappedRing::acquire(size_t &o_offset)
+{
+  if (m_buffer == 0)
+  {
+    return nullptr;
+  }
+  GLsync &fence = m_fences[m_current];
+  if (fence != nullptr)
+  {
+    // the flush bit makes sure the fence is actually submitted or the wait could never finish
+    if (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0) == GL_TIMEOUT_EXPIRED)
+    {
+      ++m_stalls;
+      while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GLuint64(1000000000)) == GL_TIMEOUT_EXPIRED)
+      {
+      }
+    }
+    glDeleteSync(fence);
+    fence = nullptr;
+  }
+  o_offset = m_current * m_regionBytes;
+  if (m_persistent)
+  {
+    return m_mapped == nullptr ? nullptr : m_mapped + o_offset;
+  }
+  // the fence already did the synchronising so the driver doesn't need to
+  glBindBuffer(m_target, m_buffer);
+  m_mapped = static_cast<char *>(glMapBufferRange(
+      m_target, static_cast<GLintptr>(o_offset), static_cast<GLsizeiptr>(m_regionBytes),
+      GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT));
+  return m_mapped;
+}
+
+void MappedRing::submit()
+{
+  if (m_persistent || m_mapped == nullptr)
+  {
+    return;
+  }
+  glBindBuffer(m_target, m_buffer);
+  glUnmapBuffer(m_target);
+  glBindBuffer(m_target, 0);
+  m_mapped = nullptr;
+}
+
+void MappedRing::fence()
+{
+  if (m_buffer == 0)
+  {
+    return;
+  }
+  m_fences[m_current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  m_current = (m_current + 1) % m_numRegions;
+}
+
+void MappedRing::release()
+{
+  if (m_buffer == 0)
+  {
+    return;
+  }
+  for (auto &f : m_fences)
+  {
+    if (f != nullptr)
+    {
+      glDeleteSync(f);
+      f = nullptr;
+    }
+  }
+  if (m_mapped != nullptr)
+  {
+    glBindBuffer(m_target, m_buffer);
+    glUnmapBuffer(m_target);
+    glBindBuffer(m_target, 0);
+    m_mapped = nullptr;
+  }
+  glDeleteBuffers(1, &m_buffer);
+  m_buffer = 0;
+  m_current = 0;
+}
@@ -0,0 +1,314 @@
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cmath>
+
+namespace morph
+{
+void weldCorners(Span<const Face> _faces, std::vector<CornerKey> &o_corners, Span<uint32_t> o_indices, Arena *_scratch)
+{
+  uint32_t numVerts = 0;
+  for (const auto &f : _faces)
+  {
+    numVerts = std::max({numVerts, f.m_vert[0] + 1, f.m_vert[1] + 1, f.m_vert[2] + 1});
+  }
+  Arena local(_scratch != nullptr ? 0 : (numVerts * 2 + 1 + o_indices.size()) * sizeof(uint32_t) + 64);
+  Arena &arena = _scratch != nullptr ? *_scratch : local;
+  const auto mark = arena.mark();
+  // bucket the corners by obj vertex, a vertex only has a handful of corners so finding a normal in its bucket
+  // is a short linear scan with no hashing and no per corner allocation
+  auto bucketStart = arena.allocate<uint32_t>(numVerts + 1, 0u);
+  auto bucketUsed = arena.allocate<uint32_t>(numVerts, 0u);
+  auto bucket = arena.allocate<uint32_t>(o_indices.size());
+  for (const auto &f : _faces)
+  {
+    for (unsigned int j = 0; j < 3; ++j)
+    {
+      ++bucketStart[f.m_vert[j] + 1];
+    }
+  }
+  for (size_t v = 0; v < numVerts; ++v)
+  {
+    bucketStart[v + 1] += bucketStart[v];
+  }
+  // the first pass holds normals in the buckets and only counts the unique corners so o_corners is sized once
+  size_t numCorners = 0;
+  for (const auto &f : _faces)
+  {
+    for (unsigned int j = 0; j < 3; ++j)
+    {
+      uint32_t *first = &bucket[bucketStart[f.m_vert[j]]];
+      uint32_t &used = bucketUsed[f.m_vert[j]];
+      if (std::find(first, first + used, f.m_norm[j]) == first + used)
+      {
+        first[used++] = f.m_norm[j];
+        ++numCorners;
+      }
+    }
+  }
+  // the second holds corner numbers, they are handed out in order of first use
+  o_corners.resize(numCorners);
+  std::fill(bucketUsed.begin(), bucketUsed.end(), 0u);
+  numCorners = 0;
+  size_t i = 0;
+  for (const auto &f : _faces)
+  {
+    for (unsigned int j = 0; j < 3; ++j)
+    {
+      uint32_t *first = &bucket[bucketStart[f.m_vert[j]]];
+      uint32_t &used = bucketUsed[f.m_vert[j]];
+      uint32_t k = 0;
+      while (k < used && o_corners[first[k]].m_norm != f.m_norm[j])
+      {
+        ++k;
+      }
+      if (k == used)
+      {
+        o_corners[numCorners] = {f.m_vert[j], f.m_norm[j]};
+        first[used++] = static_cast<uint32_t>(numCorners++);
+      }
+      o_indices[i++] = first[k];
+    }
+  }
+  arena.rewind(mark);
+}
+
+namespace
+{
+// tuning values from the Forsyth paper
+constexpr int c_cacheSize = 32;
+constexpr float c_cacheDecayPower = 1.5f;
+constexpr float c_lastTriScore = 0.75f;
+constexpr float c_valenceBoostScale = 2.0f;
+constexpr float c_valenceBoostPower = 0.5f;
+
+float vertexScore(int _cachePosition, uint32_t _remainingTris)
+{
+  if (_remainingTris == 0)
+  {
+    // no triangles left so it doesn't matter
+    return -1.0f;
+  }
+  float score = 0.0f;
+  if (_cachePosition >= 0)
+  {
+    if (_cachePosition < 3)
+    {
+      // used by the last triangle, fixed score so we don't favour the triangle we just drew
+      score = c_lastTriScore;
+    }
+    else
+    {
+      const float scaler = 1.0f / (c_cacheSize - 3);
+      score = std::pow(1.0f - (_cachePosition - 3) * scaler, c_cacheDecayPower);
+    }
+  }
+  // boost vertices with few triangles left so we finish them off rather than leave lone triangles
+  score += c_valenceBoostScale * std::pow(static_cast<float>(_remainingTris), -c_valenceBoostPower);
+  return score;
+}
+} // end anonymous namespace
+
+void optimizeVertexCache(Span<uint32_t> io_indices, size_t _numVertices, Arena *_scratch)
+{
+  const size_t numTris = io_indices.size() / 3;
+  if (numTris == 0)
+  {
+    return;
+  }
+  // a temporary arena is sized to hold exactly the scratch below
+  Arena local(_scratch != nullptr ? 0 : _numVertices * 13 + io_indices.size() * 4 + numTris * 9 + 512);
+  Arena &arena = _scratch != nullptr ? *_scratch : local;
+  const auto mark = arena.mark();
+  // vertex -> triangle adjacency in CSR form
+  auto triStart = arena.allocate<uint32_t>(_numVertices + 1, 0u);
+  for (auto v : io_indices)
+  {
+    ++triStart[v + 1];
+  }
+  for (size_t v = 0; v < _numVertices; ++v)
+  {
+    triStart[v + 1] += triStart[v];
+  }
+  auto vertTris = arena.allocate<uint32_t>(io_indices.size());
+  // remaining is the fill position while the adjacency is built, then reset to the triangle counts
+  auto remaining = arena.allocate<uint32_t>(_numVertices, 0u);
+  for (size_t i = 0; i < io_indices.size(); ++i)
+  {
+    const auto v = io_indices[i];
+    vertTris[triStart[v] + remaining[v]++] = static_cast<uint32_t>(i / 3);
+  }
+  auto cachePosition = arena.allocate<int8_t>(_numVertices, -1);
+  auto vScore = arena.allocate<float>(_numVertices);
+  for (size_t v = 0; v < _numVertices; ++v)
+  {
+    remaining[v] = triStart[v + 1] - triStart[v];
+    vScore[v] = vertexScore(-1, remaining[v]);
+  }
+  auto tScore = arena.allocate<float>(numTris);
+  auto added = arena.allocate<uint8_t>(numTris, 0);
+  for (size_t t = 0; t < numTris; ++t)
+  {
+    tScore[t] = vScore[io_indices[t * 3]] + vScore[io_indices[t * 3 + 1]] + vScore[io_indices[t * 3 + 2]];
+  }
+
+  // the draw order is kept rather than the re-ordered indices, they are permuted in place at the end
+  auto order = arena.allocate<uint32_t>(numTris);
+  // the cache is simulated as an LRU list with room for one extra triangle while updating
+  auto cacheBuffer = arena.allocate<uint32_t>(c_cacheSize + 3);
+  auto newCache = arena.allocate<uint32_t>(c_cacheSize + 3);
+  auto cache = cacheBuffer.subspan(0, 0);
+  size_t scanPos = 0;
+  int64_t best = -1;
+
+  for (size_t drawn = 0; drawn < numTris; ++drawn)
+  {
+    if (best < 0)
+    {
+      // nothing in the cache was any good so find the best triangle left anywhere, this is rare so a linear
+      // scan from the last place we found one is fine
+      float bestScore = -1.0f;
+      for (size_t t = scanPos; t < numTris; ++t)
+      {
+        if (!added[t] && tScore[t] > bestScore)
+        {
+          bestScore = tScore[t];
+          best = static_cast<int64_t>(t);
+        }
+      }
+      while (scanPos < numTris && added[scanPos])
+      {
+        ++scanPos;
+      }
+    }
+    const auto tri = static_cast<size_t>(best);
+    added[tri] = 1;
+    order[drawn] = static_cast<uint32_t>(tri);
+    size_t newSize = 0;
+    for (unsigned int j = 0; j < 3; ++j)
+    {
+      auto v = io_indices[tri * 3 + j];
+      newCache[newSize++] = v;
+      // this vertex has one less triangle to go, remove it from the adjacency list
+      auto begin = vertTris.begin() + triStart[v];
+      auto end = begin + remaining[v];
+      auto it = std::find(begin, end, static_cast<uint32_t>(tri));
+      std::iter_swap(it, end - 1);
+      --remaining[v];
+    }
+    for (auto v : cache)
+    {
+      if (v != newCache[0] && v != newCache[1] && v != newCache[2])
+      {
+        newCache[newSize++] = v;
+      }
+    }
+    // anything that fell out of the cache gets its position cleared
+    for (size_t i = c_cacheSize; i < newSize; ++i)
+    {
+      cachePosition[newCache[i]] = -1;
+      vScore[newCache[i]] = vertexScore(-1, remaining[newCache[i]]);
+    }
+    std::swap(cacheBuffer, newCache);
+    cache = cacheBuffer.subspan(0, std::min<size_t>(newSize, c_cacheSize));
+    for (size_t i = 0; i < cache.size(); ++i)
+    {
+      cachePosition[cache[i]] = static_cast<int8_t>(i);
+      vScore[cache[i]] = vertexScore(static_cast<int>(i), remaining[cache[i]]);
+    }
+    // only triangles using vertices that are in the cache or just fell out of it can have changed score, the
+    // evicted ones are still at the end of the buffer after the swap
+    best = -1;
+    float bestScore = -1.0f;
+    for (auto v : cacheBuffer.subspan(0, newSize))
+    {
+      for (uint32_t i = 0; i < remaining[v]; ++i)
+      {
+        auto t = vertTris[triStart[v] + i];
+        tScore[t] = vScore[io_indices[t * 3]] + vScore[io_indices[t * 3 + 1]] + vScore[io_indices[t * 3 + 2]];
+        if (tScore[t] > bestScore)
+        {
+          bestScore = tScore[t];
+          best = t;
+        }
+      }
+    }
+  }
+  // slot k takes triangle order[k], follow each cycle of the permutation with added marking the slots done
+  for (size_t k = 0; k < numTris; ++k)
+  {
+    if (!added[k])
+    {
+      continue;
+    }
+    const uint32_t first[3] = {io_indices[k * 3], io_indices[k * 3 + 1], io_indices[k * 3 + 2]};
+    for (size_t j = k;;)
+    {
+      added[j] = 0;
+      const size_t src = order[j];
+      const uint32_t *from = src == k ? first : &io_indices[src * 3];
+      std::copy(from, from + 3, &io_indices[j * 3]);
+      if (src == k)
+      {
+        break;
+      }
+      j = src;
+    }
+  }
+  arena.rewind(mark);
+}
+
+std::vector<uint32_t> optimizeVertexFetch(Span<uint32_t> io_indices, size_t _numVertices, Arena *_scratch)
+{
+  constexpr uint32_t unused = ~0u;
+  Arena local(_scratch != nullptr ? 0 : _numVertices * sizeof(uint32_t));
+  Arena &arena = _scratch != nullptr ? *_scratch : local;
+  const auto mark = arena.mark();
+  auto newIndex = arena.allocate<uint32_t>(_numVertices, unused);
+  // sized for every vertex being used, dropping unused ones only shrinks it
+  std::vector<uint32_t> remap(_numVertices);
+  uint32_t count = 0;
+  for (auto &i : io_indices)
+  {
+    if (newIndex[i] == unused)
+    {
+      newIndex[i] = count;
+      remap[count++] = i;
+    }
+    i = newIndex[i];
+  }
+  remap.resize(count);
+  arena.rewind(mark);
+  return remap;
+}
+
+float averageCacheMissRatio(const std::vector<uint32_t> &_indices, size_t _numVertices, size_t _cacheSize)
+{
+  if (_indices.size() < 3)
+  {
+    return 0.0f;
+  }
+  // FIFO cache, a vertex is in the cache if it was added within the last _cacheSize misses
+  std::vector<size_t> insertedAt(_numVertices, 0);
+  size_t misses = 0;
+  for (auto v : _indices)
+  {
+    if (insertedAt[v] == 0 || misses - insertedAt[v] + 1 > _cacheSize)
+    {
+      ++misses;
+      insertedAt[v] = misses;
+    }
+  }
+  return static_cast<float>(misses) / static_cast<float>(_indices.size() / 3);
+}
+
+std::vector<uint16_t> narrowIndices(const std::vector<uint32_t> &_indices)
+{
+  return std::vector<uint16_t>(_indices.begin(), _indices.end());
+}
+
+void narrowIndices(Span<const uint32_t> _indices, uint16_t *o_indices)
+{
+  std::copy(_indices.begin(), _indices.end(), o_indices);
+}
+
+} // end namespace morph
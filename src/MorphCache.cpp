@@ -0,0 +1,218 @@
+#include "MorphCache.h"
+#include "MeshOptimizer.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace morph
+{
+namespace
+{
+constexpr char c_magic[8] = {'M', 'O', 'R', 'P', 'H', 'O', 'B', 'J'};
+constexpr size_t c_alignment = 64;
+constexpr uint64_t c_fnvOffset = 14695981039346656037ull;
+constexpr uint64_t c_fnvPrime = 1099511628211ull;
+
+size_t alignUp(size_t _v)
+{
+  return (_v + c_alignment - 1) & ~(c_alignment - 1);
+}
+
+// FNV-1a run over 8 byte words rather than bytes so checking a large cache stays cheap
+uint64_t checksum(const char *_data, size_t _size)
+{
+  uint64_t hash = c_fnvOffset;
+  size_t i = 0;
+  for (; i + sizeof(uint64_t) <= _size; i += sizeof(uint64_t))
+  {
+    uint64_t word;
+    std::memcpy(&word, _data + i, sizeof(uint64_t));
+    hash = (hash ^ word) * c_fnvPrime;
+  }
+  for (; i < _size; ++i)
+  {
+    hash = (hash ^ static_cast<unsigned char>(_data[i])) * c_fnvPrime;
+  }
+  return hash;
+}
+
+uint64_t hashBytes(uint64_t _hash, const void *_data, size_t _size)
+{
+  auto bytes = static_cast<const unsigned char *>(_data);
+  for (size_t i = 0; i < _size; ++i)
+  {
+    _hash = (_hash ^ bytes[i]) * c_fnvPrime;
+  }
+  return _hash;
+}
+} // end anonymous namespace
+
+uint64_t MorphCache::sourceStamp(const std::vector<std::string> &_files)
+{
+  uint64_t hash = c_fnvOffset;
+  for (const auto &f : _files)
+  {
+    std::error_code ec;
+    uint64_t size = std::filesystem::file_size(f, ec);
+    if (ec)
+    {
+      size = 0;
+    }
+    auto time = std::filesystem::last_write_time(f, ec);
+    int64_t ticks = ec ? 0 : static_cast<int64_t>(time.time_since_epoch().count());
+    const auto name = std::filesystem::path(f).filename().string();
+    hash = hashBytes(hash, name.data(), name.size());
+    hash = hashBytes(hash, &size, sizeof(size));
+    hash = hashBytes(hash, &ticks, sizeof(ticks));
+  }
+  return hash;
+}
+
+bool MorphCache::write(const std::string &_fname, const MorphMesh &_mesh, uint64_t _sourceStamp)
+{
+  MorphCacheHeader header;
+  std::memcpy(header.m_magic, c_magic, sizeof(c_magic));
+  header.m_version = c_version;
+  header.m_headerSize = sizeof(MorphCacheHeader);
+  header.m_sourceStamp = _sourceStamp;
+  header.m_numVertices = static_cast<uint32_t>(_mesh.numVertices());
+  header.m_numIndices = static_cast<uint32_t>(_mesh.indices().size());
+  header.m_numTargets = static_cast<uint32_t>(_mesh.numTargets());
+  header.m_indexSize = _mesh.fitsIn16Bit() ? 2 : 4;
+
+  const size_t vertexCount = _mesh.numVertices() * 2;
+  const size_t deltaCount = _mesh.numTargets() * vertexCount;
+  std::string names;
+  for (const auto &t : _mesh.targets())
+  {
+    names += t.m_name;
+    names.push_back('\0');
+  }
+
+  header.m_vertexOffset = alignUp(sizeof(MorphCacheHeader));
+  header.m_indexOffset = alignUp(header.m_vertexOffset + vertexCount * sizeof(Vec3));
+  header.m_deltaOffset = alignUp(header.m_indexOffset + header.m_numIndices * header.m_indexSize);
+  header.m_nameOffset = alignUp(header.m_deltaOffset + deltaCount * sizeof(Vec3));
+  header.m_nameSize = names.size();
+  header.m_fileSize = header.m_nameOffset + names.size();
+
+  // the sections are packed straight into the file image, the offsets are aligned for each type
+  std::vector<char> file(header.m_fileSize, 0);
+  _mesh.packVertices(reinterpret_cast<Vec3 *>(file.data() + header.m_vertexOffset));
+  if (header.m_indexSize == 2)
+  {
+    narrowIndices(_mesh.indices(), reinterpret_cast<uint16_t *>(file.data() + header.m_indexOffset));
+  }
+  else
+  {
+    std::memcpy(file.data() + header.m_indexOffset, _mesh.indices().data(), _mesh.indices().size() * sizeof(uint32_t));
+  }
+  _mesh.packDeltas(reinterpret_cast<Vec3 *>(file.data() + header.m_deltaOffset));
+  std::memcpy(file.data() + header.m_nameOffset, names.data(), names.size());
+  header.m_checksum = checksum(file.data() + sizeof(MorphCacheHeader), file.size() - sizeof(MorphCacheHeader));
+  std::memcpy(file.data(), &header, sizeof(MorphCacheHeader));
+
+  // write to a temporary and rename so a reader never sees a half written cache
+  auto tmpName = _fname + ".tmp";
+  {
+    std::ofstream out(tmpName, std::ios::binary | std::ios::trunc);
+    if (!out.write(file.data(), static_cast<std::streamsize>(file.size())))
+    {
+      std::cerr << "MorphCache::write unable to write " << tmpName << '\n';
+      return false;
+    }
+  }
+  std::error_code ec;
+  std::filesystem::rename(tmpName, _fname, ec);
+  if (ec)
+  {
+    std::cerr << "MorphCache::write unable to rename " << tmpName << " : " << ec.message() << '\n';
+    std::filesystem::remove(tmpName, ec);
+    return false;
+  }
+  return true;
+}
+
+bool MorphCache::open(const std::string &_fname, uint64_t _sourceStamp, bool _verifyChecksum)
+{
+  if (!m_file.open(_fname))
+  {
+    return false;
+  }
+  auto fail = [this, &_fname](const char *_why)
+  {
+    std::cerr << "MorphCache " << _fname << " " << _why << '\n';
+    m_file.close();
+    return false;
+  };
+  if (m_file.size() < sizeof(MorphCacheHeader))
+  {
+    return fail("is too small");
+  }
+  const auto &h = header();
+  if (std::memcmp(h.m_magic, c_magic, sizeof(c_magic)) != 0)
+  {
+    return fail("is not a morph cache");
+  }
+  if (h.m_version != c_version || h.m_headerSize != sizeof(MorphCacheHeader))
+  {
+    return fail("is the wrong version");
+  }
+  if (h.m_fileSize != m_file.size())
+  {
+    return fail("is truncated");
+  }
+  // make sure all the sections are inside the file before anyone reads them
+  auto numVerts = static_cast<uint64_t>(h.m_numVertices);
+  if ((h.m_indexSize != 2 && h.m_indexSize != 4) ||
+      h.m_vertexOffset + numVerts * 2 * sizeof(Vec3) > h.m_fileSize ||
+      h.m_indexOffset + static_cast<uint64_t>(h.m_numIndices) * h.m_indexSize > h.m_fileSize ||
+      h.m_deltaOffset + h.m_numTargets * numVerts * 2 * sizeof(Vec3) > h.m_fileSize ||
+      h.m_nameOffset + h.m_nameSize > h.m_fileSize)
+  {
+    return fail("has bad section offsets");
+  }
+  if (_sourceStamp != 0 && h.m_sourceStamp != _sourceStamp)
+  {
+    return fail("is stale");
+  }
+  if (_verifyChecksum && checksum(m_file.data() + sizeof(MorphCacheHeader), m_file.size() - sizeof(MorphCacheHeader)) != h.m_checksum)
+  {
+    return fail("checksum mismatch");
+  }
+  return true;
+}
+
+std::vector<std::string> MorphCache::targetNames() const
+{
+  std::vector<std::string> names;
+  const char *p = m_file.data() + header().m_nameOffset;
+  const char *end = p + header().m_nameSize;
+  while (p < end && names.size() < numTargets())
+  {
+    names.emplace_back(p);
+    p += names.back().size() + 1;
+  }
+  names.resize(numTargets());
+  return names;
+}
+
+void MorphCache::toMorphMesh(MorphMesh &o_mesh) const
+{
+  std::vector<uint32_t> indices;
+  if (indexSize() == 2)
+  {
+    auto src = static_cast<const uint16_t *>(indexData());
+    indices.assign(src, src + numIndices());
+  }
+  else
+  {
+    auto src = static_cast<const uint32_t *>(indexData());
+    indices.assign(src, src + numIndices());
+  }
+  o_mesh.assign(reinterpret_cast<const Vec3 *>(vertexData()), numVertices(), std::move(indices),
+                reinterpret_cast<const Vec3 *>(deltaData()), targetNames());
+}
+
+} // end namespace morph
@@ -0,0 +1,183 @@
+#include "MorphLoader.h"
+#include <algorithm>
+#include <iostream>
+#include <limits>
+
+namespace morph
+{
+MorphLoader::~MorphLoader()
+{
+  // the base job writes into this object so it has to finish first, the library waits for its own loads
+  if (m_baseLoad.valid())
+  {
+    m_baseLoad.wait();
+  }
+}
+
+void MorphLoader::start(const std::vector<std::string> &_files, const std::string &_cacheFile, ThreadPool *_pool)
+{
+  m_files = _files;
+  m_cacheFile = _cacheFile;
+  m_pool = _pool;
+  m_state = State::LOADING_BASE;
+  m_startTime = std::chrono::steady_clock::now();
+  m_baseLoad = m_pool->submit([this]() { return loadBase(); });
+}
+
+bool MorphLoader::loadBase()
+{
+  if (m_cache.open(m_cacheFile, MorphCache::sourceStamp(m_files)))
+  {
+    m_fromCache = true;
+    m_numVertices = m_cache.numVertices();
+    m_numIndices = m_cache.numIndices();
+    m_indexSize = m_cache.indexSize();
+    m_numTargets = m_cache.numTargets();
+    return true;
+  }
+  // the budget is unlimited so every target stays in memory once loaded
+  m_library = std::make_unique<PoseLibrary>();
+  if (!m_library->open(m_files, std::numeric_limits<size_t>::max(), m_pool))
+  {
+    return false;
+  }
+  const auto &base = m_library->base();
+  base.packVertices(m_vertices);
+  m_numVertices = base.numVertices();
+  m_numIndices = base.indices().size();
+  m_numTargets = m_library->numTargets();
+  if (base.fitsIn16Bit())
+  {
+    m_shortIndices = narrowIndices(base.indices());
+    m_indexSize = 2;
+  }
+  return true;
+}
+
+double MorphLoader::elapsed() const noexcept
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - m_startTime).count();
+}
+
+MorphLoader::State MorphLoader::update()
+{
+  if (m_state == State::LOADING_BASE)
+  {
+    if (m_baseLoad.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+    {
+      return m_state;
+    }
+    if (!m_baseLoad.get())
+    {
+      std::cerr << "MorphLoader unable to load the base pose\n";
+      m_state = State::FAILED;
+      return m_state;
+    }
+    m_baseSeconds = elapsed();
+    m_targetDeltas.assign(m_numTargets, nullptr);
+    m_state = State::LOADING_TARGETS;
+    if (m_fromCache)
+    {
+      // the cache is mapped so every target is there already
+      const auto *deltas = reinterpret_cast<const Vec3 *>(m_cache.deltaData());
+      for (size_t t = 0; t < m_numTargets; ++t)
+      {
+        m_targetDeltas[t] = deltas + t * m_numVertices * 2;
+      }
+      m_numLoaded = m_numTargets;
+    }
+    else
+    {
+      for (size_t t = 0; t < m_numTargets; ++t)
+      {
+        m_library->request(t);
+      }
+    }
+  }
+  if (m_state != State::LOADING_TARGETS)
+  {
+    return m_state;
+  }
+  if (!m_fromCache)
+  {
+    m_library->update();
+    for (size_t t = 0; t < m_numTargets; ++t)
+    {
+      if (m_targetDeltas[t] != nullptr)
+      {
+        continue;
+      }
+      const auto state = m_library->state(t);
+      if (state == PoseLibrary::State::FAILED)
+      {
+        m_state = State::FAILED;
+        return m_state;
+      }
+      if (state == PoseLibrary::State::RESIDENT)
+      {
+        m_targetDeltas[t] = m_library->request(t);
+        ++m_numLoaded;
+      }
+    }
+  }
+  if (m_numLoaded == m_numTargets)
+  {
+    m_totalSeconds = elapsed();
+    m_state = State::DONE;
+  }
+  return m_state;
+}
+
+MorphLoader::State MorphLoader::wait()
+{
+  if (m_state == State::LOADING_BASE)
+  {
+    m_baseLoad.wait();
+  }
+  update();
+  if (m_state == State::LOADING_TARGETS && m_library)
+  {
+    m_library->wait();
+  }
+  return update();
+}
+
+const float *MorphLoader::vertexData() const noexcept
+{
+  return m_fromCache ? m_cache.vertexData() : &m_vertices[0].m_x;
+}
+
+const void *MorphLoader::indexData() const noexcept
+{
+  if (m_fromCache)
+  {
+    return m_cache.indexData();
+  }
+  return m_indexSize == 2 ? static_cast<const void *>(m_shortIndices.data())
+                          : static_cast<const void *>(m_library->base().indices().data());
+}
+
+const Vec3 *MorphLoader::targetDeltas(size_t _target) const noexcept
+{
+  return _target < m_targetDeltas.size() ? m_targetDeltas[_target] : nullptr;
+}
+
+void MorphLoader::toMorphMesh(MorphMesh &o_mesh) const
+{
+  if (m_fromCache)
+  {
+    m_cache.toMorphMesh(o_mesh);
+    return;
+  }
+  // the mesh reads each target from the library's buffer so the deltas are only copied once
+  std::vector<std::string> names(m_numTargets);
+  for (size_t t = 0; t < m_numTargets; ++t)
+  {
+    // the same names MorphMesh::build gives them
+    names[t] = std::to_string(t + 1);
+  }
+  o_mesh.assign(reinterpret_cast<const Vec3 *>(vertexData()), m_numVertices, m_library->base().indices(), m_targetDeltas,
+                names);
+}
+
+} // end namespace morph
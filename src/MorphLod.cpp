@@ -0,0 +1,461 @@
+#include "MorphLod.h"
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <numeric>
+#include <queue>
+#include <unordered_map>
+
+namespace morph
+{
+namespace
+{
+constexpr char c_magic[8] = {'M', 'O', 'R', 'P', 'H', 'L', 'O', 'D'};
+
+struct LodFileHeader
+{
+  char m_magic[8];
+  uint32_t m_version;
+  uint32_t m_numLevels;
+  uint64_t m_sourceStamp;
+  uint32_t m_numVertices;
+  float m_ratio;
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+// the plane quadric of Garland / Heckbert as the 10 unique terms of the symmetric 4x4 matrix, plus the face area
+// that went into it so the error can be turned back into a distance
+//----------------------------------------------------------------------------------------------------------------------
+struct Quadric
+{
+  double m_aa = 0, m_ab = 0, m_ac = 0, m_ad = 0, m_bb = 0, m_bc = 0, m_bd = 0, m_cc = 0, m_cd = 0, m_dd = 0;
+  double m_area = 0;
+
+  void addPlane(double _a, double _b, double _c, double _d, double _weight) noexcept
+  {
+    m_aa += _weight * _a * _a;
+    m_ab += _weight * _a * _b;
+    m_ac += _weight * _a * _c;
+    m_ad += _weight * _a * _d;
+    m_bb += _weight * _b * _b;
+    m_bc += _weight * _b * _c;
+    m_bd += _weight * _b * _d;
+    m_cc += _weight * _c * _c;
+    m_cd += _weight * _c * _d;
+    m_dd += _weight * _d * _d;
+    m_area += _weight;
+  }
+  Quadric operator+(const Quadric &_q) const noexcept
+  {
+    Quadric r;
+    r.m_aa = m_aa + _q.m_aa;
+    r.m_ab = m_ab + _q.m_ab;
+    r.m_ac = m_ac + _q.m_ac;
+    r.m_ad = m_ad + _q.m_ad;
+    r.m_bb = m_bb + _q.m_bb;
+    r.m_bc = m_bc + _q.m_bc;
+    r.m_bd = m_bd + _q.m_bd;
+    r.m_cc = m_cc + _q.m_cc;
+    r.m_cd = m_cd + _q.m_cd;
+    r.m_dd = m_dd + _q.m_dd;
+    r.m_area = m_area + _q.m_area;
+    return r;
+  }
+  // the area weighted sum of squared distances from _p to the planes
+  double error(const Vec3 &_p) const noexcept
+  {
+    const double x = _p.m_x, y = _p.m_y, z = _p.m_z;
+    const double e = m_aa * x * x + 2 * m_ab * x * y + 2 * m_ac * x * z + 2 * m_ad * x + m_bb * y * y + 2 * m_bc * y * z +
+                     2 * m_bd * y + m_cc * z * z + 2 * m_cd * z + m_dd;
+    return std::max(e, 0.0);
+  }
+};
+
+struct Collapse
+{
+  double m_cost;
+  uint32_t m_from;
+  uint32_t m_to;
+  uint32_t m_fromVersion;
+  uint32_t m_toVersion;
+  bool operator>(const Collapse &_c) const noexcept { return m_cost > _c.m_cost; }
+};
+
+uint64_t edgeKey(uint32_t _a, uint32_t _b)
+{
+  return _a < _b ? (static_cast<uint64_t>(_a) << 32) | _b : (static_cast<uint64_t>(_b) << 32) | _a;
+}
+} // end anonymous namespace
+
+void simplifyMesh(const std::vector<Vec3> &_positions, const std::vector<uint32_t> &_indices, size_t _targetTriangles,
+                  LodLevel &o_level)
+{
+  const size_t numVerts = _positions.size();
+  const size_t numFaces = _indices.size() / 3;
+  std::vector<uint32_t> faces(_indices.begin(), _indices.begin() + numFaces * 3);
+  std::vector<uint8_t> faceAlive(numFaces, 1);
+  std::vector<std::vector<uint32_t>> vertexFaces(numVerts);
+  std::vector<Quadric> quadrics(numVerts);
+  std::unordered_map<uint64_t, uint32_t> edgeUses;
+  edgeUses.reserve(numFaces * 2);
+  for (uint32_t f = 0; f < numFaces; ++f)
+  {
+    const uint32_t *v = &faces[f * 3];
+    const Vec3 n = (_positions[v[1]] - _positions[v[0]]).cross(_positions[v[2]] - _positions[v[0]]);
+    const double len = n.length();
+    for (unsigned int j = 0; j < 3; ++j)
+    {
+      vertexFaces[v[j]].push_back(f);
+      ++edgeUses[edgeKey(v[j], v[(j + 1) % 3])];
+    }
+    if (len > 0.0)
+    {
+      const double a = n.m_x / len, b = n.m_y / len, c = n.m_z / len;
+      const double d = -(a * _positions[v[0]].m_x + b * _positions[v[0]].m_y + c * _positions[v[0]].m_z);
+      for (unsigned int j = 0; j < 3; ++j)
+      {
+        quadrics[v[j]].addPlane(a, b, c, d, 0.5 * len);
+      }
+    }
+  }
+  // anything on an open or non manifold edge stays where it is
+  std::vector<uint8_t> locked(numVerts, 0);
+  for (const auto &e : edgeUses)
+  {
+    if (e.second != 2)
+    {
+      locked[e.first >> 32] = 1;
+      locked[e.first & 0xffffffffu] = 1;
+    }
+  }
+  edgeUses.clear();
+
+  std::vector<uint32_t> version(numVerts, 0);
+  std::vector<uint8_t> removed(numVerts, 0);
+  std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> heap;
+  auto push = [&](uint32_t _from, uint32_t _to)
+  {
+    if (!locked[_from])
+    {
+      heap.push({(quadrics[_from] + quadrics[_to]).error(_positions[_to]), _from, _to, version[_from], version[_to]});
+    }
+  };
+  for (uint32_t f = 0; f < numFaces; ++f)
+  {
+    for (unsigned int j = 0; j < 3; ++j)
+    {
+      push(faces[f * 3 + j], faces[f * 3 + (j + 1) % 3]);
+      push(faces[f * 3 + (j + 1) % 3], faces[f * 3 + j]);
+    }
+  }
+
+  size_t liveFaces = numFaces;
+  double maxError = 0.0;
+  std::vector<uint32_t> ringFrom;
+  std::vector<uint32_t> ringTo;
+  auto gatherRing = [&](uint32_t _v, std::vector<uint32_t> &o_ring)
+  {
+    o_ring.clear();
+    for (auto f : vertexFaces[_v])
+    {
+      if (faceAlive[f])
+      {
+        o_ring.insert(o_ring.end(), &faces[f * 3], &faces[f * 3] + 3);
+      }
+    }
+    std::sort(o_ring.begin(), o_ring.end());
+    o_ring.erase(std::unique(o_ring.begin(), o_ring.end()), o_ring.end());
+  };
+  while (liveFaces > _targetTriangles && !heap.empty())
+  {
+    const Collapse c = heap.top();
+    heap.pop();
+    const uint32_t u = c.m_from;
+    const uint32_t v = c.m_to;
+    if (removed[u] || removed[v] || c.m_fromVersion != version[u] || c.m_toVersion != version[v])
+    {
+      continue;
+    }
+    // link condition, the only vertices u and v share must be the third corners of the faces on the edge or the
+    // collapse makes the surface non manifold
+    size_t shared = 0;
+    for (auto f : vertexFaces[u])
+    {
+      if (faceAlive[f] && (faces[f * 3] == v || faces[f * 3 + 1] == v || faces[f * 3 + 2] == v))
+      {
+        ++shared;
+      }
+    }
+    if (shared == 0)
+    {
+      continue;
+    }
+    gatherRing(u, ringFrom);
+    gatherRing(v, ringTo);
+    size_t common = 0;
+    for (size_t i = 0, j = 0; i < ringFrom.size() && j < ringTo.size();)
+    {
+      if (ringFrom[i] < ringTo[j])
+      {
+        ++i;
+      }
+      else if (ringTo[j] < ringFrom[i])
+      {
+        ++j;
+      }
+      else
+      {
+        common += (ringFrom[i] != u && ringFrom[i] != v) ? 1 : 0;
+        ++i;
+        ++j;
+      }
+    }
+    if (common != shared)
+    {
+      continue;
+    }
+    // moving u onto v mustn't flip any of the faces that survive
+    bool flips = false;
+    for (auto f : vertexFaces[u])
+    {
+      const uint32_t *fv = &faces[f * 3];
+      if (!faceAlive[f] || fv[0] == v || fv[1] == v || fv[2] == v)
+      {
+        continue;
+      }
+      Vec3 p[3] = {_positions[fv[0]], _positions[fv[1]], _positions[fv[2]]};
+      const Vec3 before = (p[1] - p[0]).cross(p[2] - p[0]);
+      for (unsigned int j = 0; j < 3; ++j)
+      {
+        if (fv[j] == u)
+        {
+          p[j] = _positions[v];
+        }
+      }
+      const Vec3 after = (p[1] - p[0]).cross(p[2] - p[0]);
+      if (after.dot(before) <= 0.0f)
+      {
+        flips = true;
+        break;
+      }
+    }
+    if (flips)
+    {
+      continue;
+    }
+
+    // collapse, the faces on the edge go and the rest of u's faces move to v
+    for (auto f : vertexFaces[u])
+    {
+      if (!faceAlive[f])
+      {
+        continue;
+      }
+      uint32_t *fv = &faces[f * 3];
+      if (fv[0] == v || fv[1] == v || fv[2] == v)
+      {
+        faceAlive[f] = 0;
+        --liveFaces;
+        continue;
+      }
+      for (unsigned int j = 0; j < 3; ++j)
+      {
+        if (fv[j] == u)
+        {
+          fv[j] = v;
+        }
+      }
+      vertexFaces[v].push_back(f);
+    }
+    vertexFaces[u].clear();
+    auto &vf = vertexFaces[v];
+    vf.erase(std::remove_if(vf.begin(), vf.end(), [&](uint32_t _f) { return !faceAlive[_f]; }), vf.end());
+    removed[u] = 1;
+    quadrics[v] = quadrics[v] + quadrics[u];
+    if (quadrics[v].m_area > 0.0)
+    {
+      maxError = std::max(maxError, c.m_cost / quadrics[v].m_area);
+    }
+    // every collapse cost involving v is now out of date
+    ++version[v];
+    gatherRing(v, ringTo);
+    for (auto w : ringTo)
+    {
+      if (w != v)
+      {
+        push(w, v);
+        push(v, w);
+      }
+    }
+  }
+
+  o_level.m_indices.clear();
+  o_level.m_indices.reserve(liveFaces * 3);
+  for (uint32_t f = 0; f < numFaces; ++f)
+  {
+    if (faceAlive[f])
+    {
+      o_level.m_indices.insert(o_level.m_indices.end(), &faces[f * 3], &faces[f * 3] + 3);
+    }
+  }
+  optimizeVertexCache(o_level.m_indices, numVerts);
+  o_level.m_vertices = optimizeVertexFetch(o_level.m_indices, numVerts);
+  o_level.m_error = static_cast<float>(std::sqrt(maxError));
+}
+
+void MorphLod::build(const MorphMesh &_mesh, size_t _numLevels, float _ratio, ThreadPool *_pool)
+{
+  m_ratio = _ratio;
+  m_levels.assign(std::max<size_t>(_numLevels, 1), LodLevel());
+  auto &full = m_levels[0];
+  full.m_vertices.resize(_mesh.numVertices());
+  std::iota(full.m_vertices.begin(), full.m_vertices.end(), 0u);
+  full.m_indices = _mesh.indices();
+  // every level is simplified from the full mesh so they are independent jobs
+  std::vector<std::future<void>> jobs;
+  for (size_t l = 1; l < m_levels.size(); ++l)
+  {
+    const size_t target = static_cast<size_t>(static_cast<double>(full.numTriangles()) * std::pow(_ratio, static_cast<double>(l)));
+    auto job = [this, &_mesh, l, target]() { simplifyMesh(_mesh.basePositions(), _mesh.indices(), target, m_levels[l]); };
+    if (_pool != nullptr)
+    {
+      jobs.push_back(_pool->submit(job));
+    }
+    else
+    {
+      job();
+    }
+  }
+  for (auto &j : jobs)
+  {
+    j.get();
+  }
+}
+
+void MorphLod::extract(const MorphMesh &_full, size_t _level, MorphMesh &o_mesh) const
+{
+  const auto &level = m_levels[_level];
+  const size_t numVerts = level.m_vertices.size();
+  std::vector<Vec3> vertices(numVerts * 2);
+  for (size_t i = 0; i < numVerts; ++i)
+  {
+    vertices[i * 2] = _full.basePositions()[level.m_vertices[i]];
+    vertices[i * 2 + 1] = _full.baseNormals()[level.m_vertices[i]];
+  }
+  std::vector<Vec3> deltas(_full.numTargets() * numVerts * 2);
+  std::vector<std::string> names;
+  for (size_t t = 0; t < _full.numTargets(); ++t)
+  {
+    const auto &target = _full.target(t);
+    names.push_back(target.m_name);
+    Vec3 *out = &deltas[t * numVerts * 2];
+    for (size_t i = 0; i < numVerts; ++i)
+    {
+      const auto src = level.m_vertices[i];
+      out[i * 2] = target.m_positionDeltas[src];
+      out[i * 2 + 1] = target.m_normalDeltas.empty() ? Vec3() : target.m_normalDeltas[src];
+    }
+  }
+  o_mesh.assign(vertices.data(), numVerts, level.m_indices, deltas.data(), names);
+}
+
+size_t MorphLod::select(float _distance, float _pixelsPerUnit, float _maxPixelError) const noexcept
+{
+  if (_distance <= 0.0f)
+  {
+    return 0;
+  }
+  // the errors grow with the level so walk down from the coarsest
+  for (size_t l = m_levels.size(); l-- > 1;)
+  {
+    if (m_levels[l].m_error * _pixelsPerUnit / _distance <= _maxPixelError)
+    {
+      return l;
+    }
+  }
+  return 0;
+}
+
+bool MorphLod::write(const std::string &_fname, uint64_t _sourceStamp) const
+{
+  LodFileHeader header;
+  std::memcpy(header.m_magic, c_magic, sizeof(c_magic));
+  header.m_version = c_version;
+  header.m_numLevels = static_cast<uint32_t>(m_levels.size());
+  header.m_sourceStamp = _sourceStamp;
+  header.m_numVertices = m_levels.empty() ? 0 : static_cast<uint32_t>(m_levels[0].m_vertices.size());
+  header.m_ratio = m_ratio;
+  // write to a temporary and rename so a reader never sees a half written file
+  auto tmpName = _fname + ".tmp";
+  {
+    std::ofstream out(tmpName, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    for (const auto &l : m_levels)
+    {
+      const uint32_t counts[2] = {static_cast<uint32_t>(l.m_vertices.size()), static_cast<uint32_t>(l.m_indices.size())};
+      out.write(reinterpret_cast<const char *>(counts), sizeof(counts));
+      out.write(reinterpret_cast<const char *>(&l.m_error), sizeof(l.m_error));
+      out.write(reinterpret_cast<const char *>(l.m_vertices.data()), static_cast<std::streamsize>(l.m_vertices.size() * sizeof(uint32_t)));
+      out.write(reinterpret_cast<const char *>(l.m_indices.data()), static_cast<std::streamsize>(l.m_indices.size() * sizeof(uint32_t)));
+    }
+    if (!out)
+    {
+      std::cerr << "MorphLod::write unable to write " << tmpName << '\n';
+      return false;
+    }
+  }
+  std::error_code ec;
+  std::filesystem::rename(tmpName, _fname, ec);
+  if (ec)
+  {
+    std::cerr << "MorphLod::write unable to rename " << tmpName << " : " << ec.message() << '\n';
+    std::filesystem::remove(tmpName, ec);
+    return false;
+  }
+  return true;
+}
+
+bool MorphLod::read(const std::string &_fname, uint64_t _sourceStamp, size_t _numVertices, size_t _numLevels, float _ratio)
+{
+  std::ifstream in(_fname, std::ios::binary);
+  LodFileHeader header;
+  if (!in.read(reinterpret_cast<char *>(&header), sizeof(header)) || std::memcmp(header.m_magic, c_magic, sizeof(c_magic)) != 0 ||
+      header.m_version != c_version || header.m_sourceStamp != _sourceStamp || header.m_numVertices != _numVertices ||
+      header.m_numLevels != _numLevels || header.m_ratio != _ratio)
+  {
+    return false;
+  }
+  std::vector<LodLevel> levels(header.m_numLevels);
+  for (auto &l : levels)
+  {
+    uint32_t counts[2];
+    if (!in.read(reinterpret_cast<char *>(counts), sizeof(counts)) || counts[0] > _numVertices || counts[1] % 3 != 0 ||
+        !in.read(reinterpret_cast<char *>(&l.m_error), sizeof(l.m_error)))
+    {
+      return false;
+    }
+    l.m_vertices.resize(counts[0]);
+    l.m_indices.resize(counts[1]);
+    if (!in.read(reinterpret_cast<char *>(l.m_vertices.data()), static_cast<std::streamsize>(counts[0] * sizeof(uint32_t))) ||
+        !in.read(reinterpret_cast<char *>(l.m_indices.data()), static_cast<std::streamsize>(counts[1] * sizeof(uint32_t))))
+    {
+      return false;
+    }
+    // a corrupt file mustn't be able to index outside the mesh
+    if (std::any_of(l.m_vertices.begin(), l.m_vertices.end(), [&](uint32_t _v) { return _v >= _numVertices; }) ||
+        std::any_of(l.m_indices.begin(), l.m_indices.end(), [&](uint32_t _i) { return _i >= counts[0]; }))
+    {
+      return false;
+    }
+  }
+  m_levels = std::move(levels);
+  m_ratio = _ratio;
+  return true;
+}
+
+} // end namespace morph
@@ -0,0 +1,241 @@
+#include "MorphMesh.h"
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <utility>
+
+namespace morph
+{
+bool MorphMesh::build(Span<const PoseData> _poses, std::vector<CornerKey> *o_corners, Arena *_scratch)
+{
+  if (_poses.empty())
+  {
+    std::cerr << "MorphMesh::build needs at least a base pose\n";
+    return false;
+  }
+  const auto &base = _poses[0];
+  // the base face list is used for every pose so make sure each pose can actually be indexed by it
+  for (size_t p = 1; p < _poses.size(); ++p)
+  {
+    if (_poses[p].m_verts.size() != base.m_verts.size() || _poses[p].m_normals.size() != base.m_normals.size())
+    {
+      std::cerr << "MorphMesh::build pose " << p << " doesn't match the base mesh vertex / normal count\n";
+      return false;
+    }
+  }
+  for (const auto &f : base.m_faces)
+  {
+    for (unsigned int j = 0; j < 3; ++j)
+    {
+      if (f.m_vert[j] >= base.m_verts.size() || f.m_norm[j] >= base.m_normals.size())
+      {
+        std::cerr << "MorphMesh::build face index out of range\n";
+        return false;
+      }
+    }
+  }
+
+  // weld the face corners into unique vertices, then order the triangles for the vertex cache and the
+  // vertices for fetch locality. Each step sizes its output exactly and keeps its working buffers in the
+  // arena, or in one exactly sized for it when there isn't one
+  m_indices.resize(base.m_faces.size() * 3);
+  std::vector<CornerKey> corners;
+  weldCorners(base.m_faces, corners, m_indices, _scratch);
+  optimizeVertexCache(m_indices, corners.size(), _scratch);
+  auto remap = optimizeVertexFetch(m_indices, corners.size(), _scratch);
+
+  // every output is sized exactly once, resizing rather than clearing keeps the capacity of a previous build
+  auto nVerts = remap.size();
+  m_basePositions.resize(nVerts);
+  m_baseNormals.resize(nVerts);
+  m_targets.resize(_poses.size() - 1);
+  for (size_t t = 0; t < m_targets.size(); ++t)
+  {
+    m_targets[t].m_name = std::to_string(t + 1);
+    m_targets[t].m_positionDeltas.resize(nVerts);
+    m_targets[t].m_normalDeltas.resize(nVerts);
+  }
+
+  for (size_t v = 0; v < nVerts; ++v)
+  {
+    const auto &c = corners[remap[v]];
+    m_basePositions[v] = base.m_verts[c.m_vert];
+    m_baseNormals[v] = base.m_normals[c.m_norm];
+    // the blend meshes are just the differences so we subtract the base mesh from the current one
+    for (size_t t = 0; t < m_targets.size(); ++t)
+    {
+      const auto &pose = _poses[t + 1];
+      m_targets[t].m_positionDeltas[v] = pose.m_verts[c.m_vert] - m_basePositions[v];
+      m_targets[t].m_normalDeltas[v] = pose.m_normals[c.m_norm] - m_baseNormals[v];
+    }
+  }
+  if (o_corners != nullptr)
+  {
+    o_corners->resize(nVerts);
+    for (size_t v = 0; v < nVerts; ++v)
+    {
+      (*o_corners)[v] = corners[remap[v]];
+    }
+  }
+  return true;
+}
+
+Vec3 MorphMesh::evaluatePosition(size_t _vertex, const std::vector<float> &_weights) const noexcept
+{
+  Vec3 p = m_basePositions[_vertex];
+  auto n = std::min(_weights.size(), m_targets.size());
+  for (size_t t = 0; t < n; ++t)
+  {
+    p += m_targets[t].m_positionDeltas[_vertex] * _weights[t];
+  }
+  return p;
+}
+
+Vec3 MorphMesh::evaluateNormal(size_t _vertex, const std::vector<float> &_weights) const noexcept
+{
+  Vec3 n = m_baseNormals[_vertex];
+  auto nt = std::min(_weights.size(), m_targets.size());
+  for (size_t t = 0; t < nt; ++t)
+  {
+    n += m_targets[t].m_normalDeltas[_vertex] * _weights[t];
+  }
+  return n;
+}
+
+std::vector<ActiveWeight> MorphMesh::gatherActive(const std::vector<float> &_weights, size_t _maxActive)
+{
+  std::vector<ActiveWeight> active;
+  for (size_t t = 0; t < _weights.size(); ++t)
+  {
+    if (_weights[t] != 0.0f)
+    {
+      active.push_back({static_cast<uint32_t>(t), _weights[t]});
+    }
+  }
+  if (active.size() > _maxActive)
+  {
+    // keep the most significant weights then put them back in target order so the sum order is stable
+    std::nth_element(active.begin(), active.begin() + _maxActive, active.end(), [](const ActiveWeight &_a, const ActiveWeight &_b)
+                     { return std::abs(_a.m_weight) > std::abs(_b.m_weight); });
+    active.resize(_maxActive);
+    std::sort(active.begin(), active.end(), [](const ActiveWeight &_a, const ActiveWeight &_b)
+              { return _a.m_target < _b.m_target; });
+  }
+  return active;
+}
+
+void MorphMesh::strongestFirst(std::vector<ActiveWeight> &io_active, size_t _count)
+{
+  _count = std::min(_count, io_active.size());
+  std::partial_sort(io_active.begin(), io_active.begin() + static_cast<std::ptrdiff_t>(_count), io_active.end(),
+                    [](const ActiveWeight &_a, const ActiveWeight &_b) { return std::abs(_a.m_weight) > std::abs(_b.m_weight); });
+}
+
+void MorphMesh::evaluate(const std::vector<float> &_weights, std::vector<Vec3> &o_positions, std::vector<Vec3> &o_normals) const
+{
+  evaluate(gatherActive(_weights), o_positions, o_normals);
+}
+
+void MorphMesh::evaluate(const std::vector<ActiveWeight> &_active, std::vector<Vec3> &o_positions, std::vector<Vec3> &o_normals) const
+{
+  o_positions = m_basePositions;
+  o_normals = m_baseNormals;
+  // accumulate one target at a time so each pass streams through memory linearly, the order of the
+  // adds per vertex is still base + w0*d0 + w1*d1 ... as in the shader
+  for (const auto &a : _active)
+  {
+    const float w = a.m_weight;
+    const auto &target = m_targets[a.m_target];
+    for (size_t v = 0; v < o_positions.size(); ++v)
+    {
+      o_positions[v] += target.m_positionDeltas[v] * w;
+      o_normals[v] += target.m_normalDeltas[v] * w;
+    }
+  }
+}
+
+void MorphMesh::packDeltas(std::vector<Vec3> &o_deltas) const
+{
+  o_deltas.resize(m_targets.size() * numVertices() * 2);
+  packDeltas(o_deltas.data());
+}
+
+void MorphMesh::packDeltas(Vec3 *o_deltas) const noexcept
+{
+  auto nVerts = numVertices();
+  for (const auto &t : m_targets)
+  {
+    for (size_t v = 0; v < nVerts; ++v)
+    {
+      *o_deltas++ = t.m_positionDeltas[v];
+      *o_deltas++ = t.m_normalDeltas[v];
+    }
+  }
+}
+
+void MorphMesh::packVertices(std::vector<Vec3> &o_vertices) const
+{
+  o_vertices.resize(numVertices() * 2);
+  packVertices(o_vertices.data());
+}
+
+void MorphMesh::packVertices(Vec3 *o_vertices) const noexcept
+{
+  for (size_t v = 0; v < numVertices(); ++v)
+  {
+    o_vertices[v * 2] = m_basePositions[v];
+    o_vertices[v * 2 + 1] = m_baseNormals[v];
+  }
+}
+
+void MorphMesh::assign(const Vec3 *_vertices, size_t _numVertices, std::vector<uint32_t> _indices, const Vec3 *_deltas,
+                       const std::vector<std::string> &_names)
+{
+  std::vector<const Vec3 *> targetDeltas(_names.size());
+  for (size_t t = 0; t < _names.size(); ++t)
+  {
+    targetDeltas[t] = _deltas + t * _numVertices * 2;
+  }
+  assign(_vertices, _numVertices, std::move(_indices), targetDeltas, _names);
+}
+
+void MorphMesh::assign(const Vec3 *_vertices, size_t _numVertices, std::vector<uint32_t> _indices,
+                       Span<const Vec3 *const> _targetDeltas, const std::vector<std::string> &_names)
+{
+  m_basePositions.resize(_numVertices);
+  m_baseNormals.resize(_numVertices);
+  for (size_t v = 0; v < _numVertices; ++v)
+  {
+    m_basePositions[v] = _vertices[v * 2];
+    m_baseNormals[v] = _vertices[v * 2 + 1];
+  }
+  m_indices = std::move(_indices);
+  m_targets.resize(_names.size());
+  for (size_t t = 0; t < _names.size(); ++t)
+  {
+    auto &target = m_targets[t];
+    target.m_name = _names[t];
+    target.m_positionDeltas.resize(_numVertices);
+    target.m_normalDeltas.resize(_numVertices);
+    const Vec3 *d = _targetDeltas[t];
+    for (size_t v = 0; v < _numVertices; ++v)
+    {
+      target.m_positionDeltas[v] = d[v * 2];
+      target.m_normalDeltas[v] = d[v * 2 + 1];
+    }
+  }
+}
+
+size_t MorphMesh::memoryBytes() const noexcept
+{
+  size_t bytes = (m_basePositions.size() + m_baseNormals.size()) * sizeof(Vec3) + m_indices.size() * sizeof(uint32_t);
+  for (const auto &t : m_targets)
+  {
+    bytes += t.memoryBytes();
+  }
+  return bytes;
+}
+
+} // end namespace morph
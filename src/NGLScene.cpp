@@ -1,215 +1,160 @@
 #include <QMouseEvent>
 #include <QGuiApplication>
+#include <QOpenGLContext>
 
 #include "NGLScene.h"
+#include "MeshOptimizer.h"
+#include "MorphCache.h"
+#include "MorphLod.h"
+#include "PoseLibrary.h"
+#include "ObjReader.h"
+#include "PoseValidator.h"
 #include <ngl/NGLInit.h>
 #include <ngl/SimpleVAO.h>
+#include <ngl/SimpleIndexVAO.h>
 #include <ngl/VAOPrimitives.h>
 #include <ngl/VAOFactory.h>
 #include <ngl/ShaderLib.h>
 #include <ngl/Transformation.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <iostream>
 NGLScene::NGLScene()
 {
   setTitle("Morph Mesh Demo");
-  m_weight1 = 0.0;
-  m_weight2 = 0.0;
   m_animation = true;
-  m_punchLeft = false;
-  m_punchRight = false;
-  m_timerLeft = new QTimer();
-  m_timerRight = new QTimer();
-  connect(m_timerLeft, SIGNAL(timeout()), this, SLOT(updateLeft()));
-  connect(m_timerRight, SIGNAL(timeout()), this, SLOT(updateRight()));
+  // a punch snaps out past the pose and eases back
+  int punch = m_weightAnimation.addCurve({{0.0f, 0.0f}, {0.1f, 1.2f}, {0.25f, 0.0f}}, morph::Interpolation::SMOOTH);
+  m_punchChannel[0] = m_weightAnimation.addChannel(punch, 0);
+  m_punchChannel[1] = m_weightAnimation.addChannel(punch, 1);
+  m_clock.start();
+  connect(this, SIGNAL(frameSwapped()), this, SLOT(animate()));
 }
 void NGLScene::punchLeft()
 {
-  if (m_punchLeft != true)
+  if (m_weights.size() > 0 && !m_weightAnimation.isPlaying(m_punchChannel[0]))
   {
-    m_weight1 = 0.0;
-    m_timerLeft->start(4);
-    m_punchLeft = true;
+    advanceClock();
+    m_weightAnimation.play(m_punchChannel[0], m_animationTime);
+    update();
   }
 }
 
 void NGLScene::punchRight()
 {
-  if (m_punchRight != true)
+  if (m_weights.size() > 1 && !m_weightAnimation.isPlaying(m_punchChannel[1]))
   {
-    m_weight2 = 0.0;
-    m_timerRight->start(4);
-    m_punchRight = true;
+    advanceClock();
+    m_weightAnimation.play(m_punchChannel[1], m_animationTime);
+    update();
   }
 }
 
-// a simple structure to hold our vertex data
-struct vertData
-{
-  ngl::Vec3 p1;
-  ngl::Vec3 n1;
-  ngl::Vec3 p2;
-  ngl::Vec3 n2;
-  ngl::Vec3 p3;
-  ngl::Vec3 n3;
-};
-void NGLScene::createMorphMesh()
+void NGLScene::toggleAnimation()
 {
-
-  // base pose is mesh 1 stored in m_meshes[0]
-  // get the obj data so we can process it locally
-  std::vector<ngl::Vec3> verts1 = m_meshes[0]->getVertexList();
-  // should really check to see if the poses match if we were doing this properly
-  std::vector<ngl::Vec3> verts2 = m_meshes[1]->getVertexList();
-  std::vector<ngl::Vec3> verts3 = m_meshes[2]->getVertexList();
-  // faces will be the same for each mesh so only need one
-  std::vector<ngl::Face> faces = m_meshes[0]->getFaceList();
-  // now get the normals
-  std::vector<ngl::Vec3> normals1 = m_meshes[0]->getNormalList();
-  std::vector<ngl::Vec3> normals2 = m_meshes[1]->getNormalList();
-  std::vector<ngl::Vec3> normals3 = m_meshes[2]->getNormalList();
-
-  // now we are going to process and pack the mesh into an ngl::VertexArrayObject
-  std::vector<vertData> vboMesh;
-  vertData d;
-  auto nFaces = faces.size();
-  // loop for each of the faces
-  for (unsigned int i = 0; i < nFaces; ++i)
-  {
-    // now for each triangle in the face (remember we ensured tri above)
-    for (unsigned int j = 0; j < 3; ++j)
-    {
-      // pack in the vertex data first
-
-      d.p1 = verts1[faces[i].m_vert[j]];
-      // the blend meshes are just the differences so we subtract the base mesh
-      // from the current one (could do this on GPU but this saves processing time)
-      d.p2 = verts2[faces[i].m_vert[j]] - d.p1;
-      d.p3 = verts3[faces[i].m_vert[j]] - d.p1;
-
-      // now do the normals
-      d.n1 = normals1[faces[i].m_norm[j]];
-      // again we only need the differences so subtract base mesh value from pose values
-      d.n2 = normals2[faces[i].m_norm[j]] - d.n1;
-      d.n3 = normals3[faces[i].m_norm[j]] - d.n1;
-
-      // finally add it to our mesh VAO structure
-      vboMesh.push_back(d);
-    }
-  }
-  // first we grab an instance of our VOA class as a TRIANGLE_STRIP
-  m_vaoMesh = ngl::VAOFactory::createVAO("simpleVAO", GL_TRIANGLES);
-  // next we bind it so it's active for setting data
-  m_vaoMesh->bind();
-  auto meshSize = vboMesh.size();
-  // now we have our data add it to the VAO, we need to tell the VAO the following
-  // how much (in bytes) data we are copying
-  // a pointer to the first element of data (in this case the address of the first element of the
-  // std::vector
-  m_vaoMesh->setData(ngl::AbstractVAO::VertexData(meshSize * sizeof(vertData), vboMesh[0].p1.m_x));
-
-  // so data is Vert / Normal for each mesh
-  m_vaoMesh->setVertexAttributePointer(0, 3, GL_FLOAT, sizeof(vertData), 0);
-  m_vaoMesh->setVertexAttributePointer(1, 3, GL_FLOAT, sizeof(vertData), 3);
-
-  m_vaoMesh->setVertexAttributePointer(2, 3, GL_FLOAT, sizeof(vertData), 6);
-  m_vaoMesh->setVertexAttributePointer(3, 3, GL_FLOAT, sizeof(vertData), 9);
-
-  m_vaoMesh->setVertexAttributePointer(4, 3, GL_FLOAT, sizeof(vertData), 12);
-  m_vaoMesh->setVertexAttributePointer(5, 3, GL_FLOAT, sizeof(vertData), 15);
-
-  m_vaoMesh->setNumIndices(meshSize);
-  // finally we have finished for now so time to unbind the VAO
-  m_vaoMesh->unbind();
+  m_animation ^= true;
+  if (m_weightAnimation.numPlaying() > 0 || m_crowdSize > 0 || m_skinInfluences > 0)
+  {
+    update();
+  }
 }
 
-void NGLScene::changeWeight(Weights _w, Direction _d)
+void NGLScene::advanceClock()
 {
-
-  switch (_w)
+  const double now = m_clock.nsecsElapsed() * 1e-9;
+  if (m_animation)
   {
-  case Weights::POSE1:
-    if (_d == Direction::UP)
-      m_weight1 += 0.1;
-    else
-      m_weight1 -= 0.1;
-    break;
-
-  case Weights::POSE2:
-    if (_d == Direction::UP)
-      m_weight2 += 0.1;
-    else
-      m_weight2 -= 0.1;
-    break;
+    m_animationTime += now - m_lastTick;
   }
-  // clamp to 0.0 -> 1.0 range
-  m_weight1 = std::min(1.0f, std::max(0.0f, m_weight1));
-  m_weight2 = std::min(1.0f, std::max(0.0f, m_weight2));
+  m_lastTick = now;
 }
 
-NGLScene::~NGLScene()
+void NGLScene::tickAnimation()
 {
-  std::cout << "Shutting down NGL, removing VAO's and Shaders\n";
+  advanceClock();
+  if (m_weightAnimation.evaluate(m_animationTime, m_weights))
+  {
+    m_dirty |= DIRTY_WEIGHTS;
+  }
+  // the skeleton is posed from the same clock
+  if (m_skinInfluences > 0 && m_animationTime != m_skinTime)
+  {
+    m_dirty |= DIRTY_SKIN_POSE;
+  }
 }
 
-void NGLScene::resizeGL(int _w, int _h)
+void NGLScene::animate()
 {
-  m_project = ngl::perspective(45.0f, static_cast<float>(_w) / _h, 0.05f, 350.0f);
-  m_win.width = static_cast<int>(_w * devicePixelRatio());
-  m_win.height = static_cast<int>(_h * devicePixelRatio());
+  if (m_paintEnd >= 0.0)
+  {
+    m_profiler.record("swap", m_paintEnd, m_profiler.now() - m_paintEnd);
+    m_paintEnd = -1.0;
+  }
+  // keep drawing while streamed targets or the background load are still arriving so they show up straight away
+  if ((m_animation && (m_weightAnimation.numPlaying() > 0 || m_crowdSize > 0 || m_skinInfluences > 0)) || m_streamPending ||
+      m_loadStep != LoadStep::DONE)
+  {
+    update();
+  }
 }
 
-void NGLScene::initializeGL()
+// a simple structure to hold our vertex data, the pose deltas live in a texture buffer
+struct vertData
 {
-  // we must call this first before any other GL commands to load and link the
-  // gl commands from the lib, if this is not done program will crash
-  ngl::NGLInit::initialize();
-
-  glClearColor(0.4f, 0.4f, 0.4f, 1.0f); // Grey Background
-  // enable depth testing for drawing
-  glEnable(GL_DEPTH_TEST);
-  // enable multisampling for smoother drawing
-  glEnable(GL_MULTISAMPLE);
-  // Now we will create a basic Camera from the graphics library
-  // This is a static camera so it only needs to be set once
-  // First create Values for the camera position
-  ngl::Vec3 from(0, 10, 40);
-  ngl::Vec3 to(0, 10, 0);
-  ngl::Vec3 up(0, 1, 0);
-
-  // first we create a mesh from an obj passing in the obj file and texture
-  std::unique_ptr<ngl::Obj> mesh1(new ngl::Obj("models/BrucePose1.obj"));
-  m_meshes.push_back(std::move(mesh1));
-
-  std::unique_ptr<ngl::Obj> mesh2(new ngl::Obj("models/BrucePose2.obj"));
-  m_meshes.push_back(std::move(mesh2));
+  ngl::Vec3 p1;
+  ngl::Vec3 n1;
+};
+// the cache and MorphMesh::packVertices write the vertices in this layout
+static_assert(sizeof(vertData) == 2 * sizeof(morph::Vec3), "vertData must match the packed morph vertices");
 
-  std::unique_ptr<ngl::Obj> mesh3(new ngl::Obj("models/BrucePose3.obj"));
-  m_meshes.push_back(std::move(mesh3));
-  createMorphMesh();
+// the first file is the base pose, every other file becomes a morph target
+static const std::vector<std::string> s_poseFiles = {"models/BrucePose1.obj", "models/BrucePose2.obj", "models/BrucePose3.obj"};
+// the pre-baked version of the poses, see tools/MorphCacheBaker.cpp
+static const std::string s_cacheFile = "models/BrucePose.morph";
+// the crowd LOD levels built from it, see morph::MorphLod
+static const std::string s_lodFile = "models/BrucePose.lod";
+// each LOD level has half the triangles of the one before
+static constexpr float c_lodRatio = 0.5f;
+// the vertical field of view in degrees
+static constexpr float c_fovy = 45.0f;
+// the joints in the skinning chain, enough for 8 influences to be used
+static constexpr size_t c_skinJoints = 8;
+// the staging ring uploads go through and how much of the background load is uploaded per frame
+static constexpr size_t c_stagingBytes = 1024 * 1024;
+static constexpr size_t c_stagingRegions = 4;
+static constexpr size_t c_uploadBudget = 16 * 1024 * 1024;
 
-  m_view = ngl::lookAt(from, to, up);
-  // set the shape using FOV 45 Aspect Ratio based on Width and Height
-  // The final two are near and far clipping planes of 0.5 and 10
-  m_project = ngl::perspective(45, 720.0f / 576.0f, 0.05f, 350);
-  // we are creating a shader called PerFragADS
-  ngl::ShaderLib::createShaderProgram("PerFragADS");
-  // now we are going to create empty shaders for Frag and Vert
-  ngl::ShaderLib::attachShader("PerFragADSVertex", ngl::ShaderType::VERTEX);
-  ngl::ShaderLib::attachShader("PerFragADSFragment", ngl::ShaderType::FRAGMENT);
-  // attach the source
-  ngl::ShaderLib::loadShaderSource("PerFragADSVertex", "shaders/PerFragASDVert.glsl");
-  ngl::ShaderLib::loadShaderSource("PerFragADSFragment", "shaders/PerFragASDFrag.glsl");
-  // compile the shaders
-  ngl::ShaderLib::compileShader("PerFragADSVertex");
-  ngl::ShaderLib::compileShader("PerFragADSFragment");
-  // add them to the program
-  ngl::ShaderLib::attachShaderToProgram("PerFragADS", "PerFragADSVertex");
-  ngl::ShaderLib::attachShaderToProgram("PerFragADS", "PerFragADSFragment");
+// build the morph mesh from s_poseFiles, exits if they can't be used
+static void buildFromObjs(morph::MorphMesh &o_mesh)
+{
+  // parse the obj files, these are all loaded in parallel, base pose is poses[0]
+  std::vector<morph::PoseData> poses;
+  morph::ObjReadStats stats;
+  if (!morph::readObjs(s_poseFiles, poses, &stats))
+  {
+    std::cerr << "Unable to load the pose obj files\n";
+    exit(EXIT_FAILURE);
+  }
+  std::cout << fmt::format("Loaded {} poses {:.2f} MB in {:.2f} ms ({:.1f} MB/s)\n", poses.size(),
+                           stats.m_bytes / (1024.0 * 1024.0), stats.m_seconds * 1000.0, stats.mbPerSecond());
+  // every pose uses the base face list so make sure the exports line up before building the deltas
+  if (!morph::validatePoses(poses))
+  {
+    std::cerr << "The pose obj files don't share the same topology\n";
+    exit(EXIT_FAILURE);
+  }
+  // the deltas are calculated by morphcore, this is the same data the CPU evaluator uses
+  if (!o_mesh.build(poses))
+  {
+    std::cerr << "Unable to build morph mesh from the poses\n";
+    exit(EXIT_FAILURE);
+  }
+}
 
-  // now we have associated this data we can link the shader
-  ngl::ShaderLib::linkProgramObject("PerFragADS");
-  // and make it active ready to load values
-  ngl::ShaderLib::use("PerFragADS");
+// the material and light used by both the single mesh and crowd shaders, the current program is set
+static void loadLightingToShader()
+{
   // now we need to set the material and light values
   /*
    *struct MaterialInfo
@@ -245,152 +190,1694 @@ void NGLScene::initializeGL()
   ngl::ShaderLib::setUniform("light.La", 0.1f, 0.1f, 0.1f);
   ngl::ShaderLib::setUniform("light.Ld", 1.0f, 1.0f, 1.0f);
   ngl::ShaderLib::setUniform("light.Ls", 0.9f, 0.9f, 0.9f);
-
-  glEnable(GL_DEPTH_TEST); // for removal of hidden surfaces
-
-  // as re-size is not explicitly called we need to do this.
-  glViewport(0, 0, width(), height());
-  m_text = std::make_unique<ngl::Text>("fonts/Arial.ttf", 16);
-  m_text->setScreenSize(width(), height());
 }
 
-void NGLScene::loadMatricesToShader()
+// point a program's uniform blocks at the binding points m_frameRing's ranges are bound to, in UniformBlock order.
+// GLSL 3.3 has no binding layout qualifier so it is done here after linking
+static void bindUniformBlocks(const char *_program)
 {
-  ngl::ShaderLib::use("PerFragADS");
-  ngl::Mat4 MV;
-  ngl::Mat4 MVP;
-  ngl::Mat3 normalMatrix;
-  MV = m_view * m_mouseGlobalTX;
-  MVP = m_project * MV;
-  normalMatrix = MV;
-  normalMatrix.inverse().transpose();
-  ngl::ShaderLib::setUniform("MVP", MVP);
-  ngl::ShaderLib::setUniform("MV", MV);
-  ngl::ShaderLib::setUniform("normalMatrix", normalMatrix);
-  ngl::ShaderLib::setUniform("weight1", m_weight1);
-  ngl::ShaderLib::setUniform("weight2", m_weight2);
+  const GLuint id = ngl::ShaderLib::getProgramID(_program);
+  const char *blocks[] = {"Frame", "Morph", "Draw"};
+  for (GLuint b = 0; b < 3; ++b)
+  {
+    const GLuint index = glGetUniformBlockIndex(id, blocks[b]);
+    if (index != GL_INVALID_INDEX)
+    {
+      glUniformBlockBinding(id, index, b);
+    }
+  }
 }
 
-void NGLScene::paintGL()
+void NGLScene::createMorphMesh()
 {
-  // clear the screen and depth buffer
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-  // Rotation based on the mouse position for our global transform
-  ngl::Transformation trans;
-  auto rotX = ngl::Mat4::rotateX(m_win.spinXFace);
-  auto rotY = ngl::Mat4::rotateY(m_win.spinYFace);
-  // multiply the rotations
-  m_mouseGlobalTX = rotY * rotX;
-  // add the translations
-  m_mouseGlobalTX.m_m[3][0] = m_modelPos.m_x;
-  m_mouseGlobalTX.m_m[3][1] = m_modelPos.m_y;
-  m_mouseGlobalTX.m_m[3][2] = m_modelPos.m_z;
+  morph::ScopedTimer timer(m_profiler, "load");
+  if (m_streamPoses)
+  {
+    createStreamedMesh();
+    return;
+  }
+  auto stamp = morph::MorphCache::sourceStamp(s_poseFiles);
+  morph::MorphCache cache;
+  morph::MorphMesh mesh;
+  const bool useCache = cache.open(s_cacheFile, stamp);
+  if (useCache)
+  {
+    std::cout << "Using morph cache " << s_cacheFile << '\n';
+    // if the deltas are full precision the data can go straight from the mapped file to the GPU
+    if (m_deltaFormat == morph::DeltaFormat::FLOAT32)
+    {
+      setupRig(cache.numTargets());
+      uploadMorphMesh(cache.vertexData(), cache.numVertices(), cache.indexData(), cache.numIndices(),
+                      cache.indexSize() == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT);
+      uploadDeltaBuffer(cache.deltaData(), cache.deltaBytes(), GL_RGB32F, m_deltaBuffer, m_deltaTexture);
+      return;
+    }
+    // otherwise they are compressed from the cached ones
+    cache.toMorphMesh(mesh);
+  }
+  else
+  {
+    morph::ScopedTimer buildTimer(m_profiler, "load build");
+    buildFromObjs(mesh);
+  }
+  if (mesh.numTargets() < 2)
+  {
+    std::cerr << "The morph mesh needs at least two targets\n";
+    exit(EXIT_FAILURE);
+  }
+  setupRig(mesh.numTargets());
 
-  loadMatricesToShader();
-  // draw the mesh
-  m_vaoMesh->bind();
-  m_vaoMesh->draw();
-  m_vaoMesh->unbind();
-  m_text->setColour(1.0f, 1.0f, 1.0f);
+  std::vector<morph::Vec3> vertices;
+  mesh.packVertices(vertices);
+  const auto &indices = mesh.indices();
+  // use 16 bit indices when the mesh is small enough
+  if (mesh.fitsIn16Bit())
+  {
+    auto shortIndices = morph::narrowIndices(indices);
+    uploadMorphMesh(&vertices[0].m_x, mesh.numVertices(), shortIndices.data(), shortIndices.size(), GL_UNSIGNED_SHORT);
+  }
+  else
+  {
+    uploadMorphMesh(&vertices[0].m_x, mesh.numVertices(), indices.data(), indices.size(), GL_UNSIGNED_INT);
+  }
+  if (m_deltaFormat == morph::DeltaFormat::FLOAT32)
+  {
+    std::vector<morph::Vec3> deltas;
+    mesh.packDeltas(deltas);
+    uploadDeltaBuffer(deltas.data(), deltas.size() * sizeof(morph::Vec3), GL_RGB32F, m_deltaBuffer, m_deltaTexture);
+  }
+  else
+  {
+    uploadQuantizedDeltas(mesh);
+  }
+  if (useCache)
+  {
+    return;
+  }
+  std::cout << "Morph mesh " << mesh.numVertices() << " vertices " << indices.size() / 3 << " triangles ACMR "
+            << morph::averageCacheMissRatio(indices, mesh.numVertices()) << '\n';
+  // save the cache for next time, this is allowed to fail if the models directory isn't writable
+  if (morph::MorphCache::write(s_cacheFile, mesh, stamp))
+  {
+    std::cout << "Wrote morph cache " << s_cacheFile << '\n';
+  }
+}
 
-  m_text->renderText(10, 700, fmt::format("Q-W change Pose one weight {:0.2f}", m_weight1));
-  m_text->renderText(10, 680, fmt::format("A-S change Pose one weight {:0.2f}", m_weight2));
+void NGLScene::uploadMorphMesh(const GLfloat *_vertices, size_t _numVertices, const GLvoid *_indices, size_t _numIndices,
+                               GLenum _indexType)
+{
+  morph::ScopedTimer timer(m_profiler, "load mesh upload");
+  m_numVertices = _numVertices;
+  m_numIndices = _numIndices;
+  m_indexType = _indexType;
+  m_vaoMesh = createMeshVAO(_vertices, _numVertices, _indices, _numIndices, _indexType);
+  if (m_crowdSize > 0)
+  {
+    return;
+  }
+  // the same again for the pre-pass output, the vertex data is overwritten by transform feedback so it is only
+  // there to size the buffer
+  m_vaoMorphed = createMeshVAO(_vertices, _numVertices, _indices, _numIndices, _indexType, GL_DYNAMIC_COPY);
+  if (m_skinInfluences > 0)
+  {
+    createSkin(_vertices, _numVertices);
+  }
 }
 
-//----------------------------------------------------------------------------------------------------------------------
+void NGLScene::createSkin(const GLfloat *_vertices, size_t _numVertices)
+{
+  // the chain runs up the middle of the bounding box with each bone's falloff about one bone long
+  std::vector<morph::Vec3> positions(_numVertices);
+  for (size_t v = 0; v < _numVertices; ++v)
+  {
+    positions[v] = {_vertices[v * 6], _vertices[v * 6 + 1], _vertices[v * 6 + 2]};
+  }
+  morph::Vec3 lo = positions[0];
+  morph::Vec3 hi = positions[0];
+  for (const auto &p : positions)
+  {
+    lo = {std::min(lo.m_x, p.m_x), std::min(lo.m_y, p.m_y), std::min(lo.m_z, p.m_z)};
+    hi = {std::max(hi.m_x, p.m_x), std::max(hi.m_y, p.m_y), std::max(hi.m_z, p.m_z)};
+  }
+  const float x = (lo.m_x + hi.m_x) * 0.5f;
+  const float z = (lo.m_z + hi.m_z) * 0.5f;
+  m_skeleton.buildChain({x, lo.m_y, z}, {x, hi.m_y, z}, c_skinJoints);
+  m_skinWeights.reset(_numVertices, m_skinInfluences);
+  morph::computeDistanceWeights(positions, m_skeleton, (hi.m_y - lo.m_y) / (c_skinJoints - 1), m_skinWeights);
+  m_skinLocal.resize(m_skeleton.numJoints());
+  for (size_t j = 0; j < m_skinLocal.size(); ++j)
+  {
+    m_skinLocal[j] = m_skeleton.bindLocal(j);
+  }
+  const auto &joints = m_skinWeights.joints();
+  const auto &weights = m_skinWeights.weights();
+  uploadDeltaBuffer(joints.data(), joints.size() * sizeof(uint8_t), GL_RGBA8UI, m_skinJointBuffer, m_skinJointTexture);
+  uploadDeltaBuffer(weights.data(), weights.size() * sizeof(uint16_t), GL_RGBA16, m_skinWeightBuffer, m_skinWeightTexture);
+  // sized for the matrices, the dual quaternions are smaller
+  uploadDeltaBuffer(nullptr, m_skeleton.numJoints() * 12 * sizeof(float), GL_RGBA32F, m_skinPaletteBuffer,
+                    m_skinPaletteTexture, GL_DYNAMIC_DRAW);
+  std::cout << fmt::format("Skin {} joints {} influences {:.2f} MB of weights\n", m_skeleton.numJoints(),
+                           m_skinInfluences, m_skinWeights.memoryBytes() / (1024.0 * 1024.0));
+}
 
-void NGLScene::keyPressEvent(QKeyEvent *_event)
+void NGLScene::updateSkin()
 {
-  // this method is called every time the main window recives a key event.
-  // we then switch on the key value and set the camera in the GLWindow
-  switch (_event->key())
+  // each joint sways and twists a little behind the one below so the motion runs up the chain
+  const float time = static_cast<float>(m_animationTime);
+  for (size_t j = 1; j < m_skinLocal.size(); ++j)
   {
-  // escape key to quite
-  case Qt::Key_Escape:
-    QGuiApplication::exit(EXIT_SUCCESS);
-    break;
-  // show full screen
-  case Qt::Key_F:
-    showFullScreen();
-    break;
-  // show windowed
-  case Qt::Key_N:
-    showNormal();
-    break;
-  case Qt::Key_Q:
-    changeWeight(Weights::POSE1, Direction::DOWN);
-    break;
-  case Qt::Key_W:
-    changeWeight(Weights::POSE1, Direction::UP);
-    break;
+    const float phase = time * 2.0f - 0.6f * static_cast<float>(j);
+    m_skinLocal[j].m_rotation = morph::Quat::fromAxisAngle({0.0f, 0.0f, 1.0f}, 0.12f * std::sin(phase)) *
+                                morph::Quat::fromAxisAngle({0.0f, 1.0f, 0.0f}, 0.25f * std::sin(phase * 0.5f));
+  }
+  m_skeleton.computePalette(m_skinLocal, m_skinPalette);
+  const auto &palette =
+      m_skinMethod == morph::SkinMethod::DUAL_QUATERNION ? m_skinPalette.m_dualQuats : m_skinPalette.m_matrices;
+  glBindBuffer(GL_TEXTURE_BUFFER, m_skinPaletteBuffer);
+  glBufferSubData(GL_TEXTURE_BUFFER, 0, static_cast<GLsizeiptr>(palette.size() * sizeof(float)), palette.data());
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+  m_skinTime = m_animationTime;
+}
 
-  case Qt::Key_A:
-    changeWeight(Weights::POSE2, Direction::DOWN);
-    break;
-  case Qt::Key_S:
-    changeWeight(Weights::POSE2, Direction::UP);
-    break;
-  case Qt::Key_Space:
-    toggleAnimation();
-    break;
-  case Qt::Key_Z:
-    punchLeft();
-    break;
-  case Qt::Key_X:
-    punchRight();
-    break;
+void NGLScene::toggleSkinMethod()
+{
+  if (m_skinInfluences == 0)
+  {
+    return;
+  }
+  m_skinMethod = m_skinMethod == morph::SkinMethod::LINEAR ? morph::SkinMethod::DUAL_QUATERNION : morph::SkinMethod::LINEAR;
+  // the palette goes up in the other form as well as the uniform changing
+  markDirty(DIRTY_SKIN_POSE | DIRTY_SKIN_METHOD);
+}
 
-  default:
-    break;
+void NGLScene::createStreamedMesh()
+{
+  // only the base is loaded now, the targets come in as their weights become non zero
+  m_library = std::make_unique<morph::PoseLibrary>();
+  if (!m_library->open(s_poseFiles, m_streamCpuBudget))
+  {
+    exit(EXIT_FAILURE);
   }
-  // finally update the GLWindow and re-draw
-  // if (isExposed())
-  update();
+  if (m_library->numTargets() < 2)
+  {
+    std::cerr << "The morph mesh needs at least two targets\n";
+    exit(EXIT_FAILURE);
+  }
+  const auto &base = m_library->base();
+  setupRig(m_library->numTargets());
+  std::vector<morph::Vec3> vertices;
+  base.packVertices(vertices);
+  if (base.fitsIn16Bit())
+  {
+    auto shortIndices = morph::narrowIndices(base.indices());
+    uploadMorphMesh(&vertices[0].m_x, base.numVertices(), shortIndices.data(), shortIndices.size(), GL_UNSIGNED_SHORT);
+  }
+  else
+  {
+    uploadMorphMesh(&vertices[0].m_x, base.numVertices(), base.indices().data(), base.indices().size(), GL_UNSIGNED_INT);
+  }
+  // the delta texture buffer is a fixed number of target sized slots, the shader is given slots rather than
+  // targets in activeTargets so it is unchanged
+  const size_t bytes = m_library->targetBytes();
+  const size_t numSlots = std::clamp<size_t>(m_streamGpuBudget / bytes, 1, m_library->numTargets());
+  m_gpuSlots.reset(numSlots, m_library->numTargets());
+  uploadDeltaBuffer(nullptr, numSlots * bytes, GL_RGB32F, m_deltaBuffer, m_deltaTexture, GL_DYNAMIC_DRAW);
+  std::cout << fmt::format("Streaming {} targets of {:.2f} MB, {:.1f} MB in memory and {} on the GPU\n",
+                           m_library->numTargets(), bytes / (1024.0 * 1024.0), m_streamCpuBudget / (1024.0 * 1024.0),
+                           numSlots);
 }
 
-void NGLScene::updateLeft()
+void NGLScene::setupRig(size_t _numTargets)
 {
-  static Direction left = Direction::UP;
-  if (left == Direction::UP)
+  if (m_rigFile.empty())
   {
-    m_weight1 += 0.2f;
-    if (m_weight1 > 1.1f)
-      left = Direction::DOWN;
+    m_rig.setIdentity(_numTargets);
   }
-  else if (left == Direction::DOWN)
+  else if (!morph::readTargetRig(m_rigFile, _numTargets, m_rig))
   {
-    m_weight1 -= 0.2f;
-    if (m_weight1 <= 0.0f)
-    {
-      m_weight1 = 0.0f;
+    exit(EXIT_FAILURE);
+  }
+  else
+  {
+    std::cout << "Rig " << m_rigFile << ' ' << m_rig.numDrivers() << " drivers " << m_rig.numCombinations()
+              << " combination targets\n";
+  }
+  // the punch keys and overlay drive the first two
+  if (m_rig.numDrivers() < 2)
+  {
+    std::cerr << "The rig needs at least two drivers\n";
+    exit(EXIT_FAILURE);
+  }
+  m_weights.assign(m_rig.numDrivers(), 0.0f);
+}
 
-      m_timerLeft->stop();
-      left = Direction::UP;
-      m_punchLeft = false;
+void NGLScene::streamActive()
+{
+  // m_active has target ids, swap them for the GPU slot holding each target. A target still loading is left out
+  // of this frame and the weights are gathered again until it arrives
+  const size_t bytes = m_library->targetBytes();
+  const auto tick = m_library->tick();
+  m_streamPending = false;
+  // m_active is in target order, the slots are handed out largest weight first so when more targets are active
+  // than there are slots it is the smallest weights that lose out
+  auto byWeight = m_active;
+  morph::MorphMesh::strongestFirst(byWeight, m_gpuSlots.numSlots());
+  glBindBuffer(GL_TEXTURE_BUFFER, m_deltaBuffer);
+  for (const auto &a : byWeight)
+  {
+    // a target already on the GPU doesn't need its CPU copy
+    const morph::Vec3 *deltas = nullptr;
+    if (m_gpuSlots.find(a.m_target) == morph::SlotCache::c_noSlot)
+    {
+      deltas = m_library->request(a.m_target);
+      if (deltas == nullptr && m_waitForPoses)
+      {
+        m_library->wait();
+        deltas = m_library->request(a.m_target);
+      }
+      if (deltas == nullptr)
+      {
+        // a target that failed to load is dropped for good
+        m_streamPending |= m_library->state(a.m_target) == morph::PoseLibrary::State::LOADING;
+        continue;
+      }
+    }
+    bool fresh = false;
+    const int slot = m_gpuSlots.acquire(a.m_target, tick, fresh);
+    if (slot == morph::SlotCache::c_noSlot)
+    {
+      // every slot holds a larger weight this frame
+      continue;
+    }
+    if (fresh)
+    {
+      glBufferSubData(GL_TEXTURE_BUFFER, static_cast<GLintptr>(static_cast<size_t>(slot) * bytes),
+                      static_cast<GLsizeiptr>(bytes), deltas);
     }
   }
-  update();
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+  // back in target order so the shader sums in the same order as before, every target holding a slot now got it
+  // this frame or was already resident
+  std::vector<morph::ActiveWeight> resident;
+  resident.reserve(m_active.size());
+  for (const auto &a : m_active)
+  {
+    const int slot = m_gpuSlots.find(a.m_target);
+    if (slot != morph::SlotCache::c_noSlot)
+    {
+      resident.push_back({static_cast<uint32_t>(slot), a.m_weight});
+    }
+  }
+  m_active = std::move(resident);
+}
+
+std::unique_ptr<ngl::AbstractVAO> NGLScene::createMeshVAO(const GLfloat *_vertices, size_t _numVertices,
+                                                          const GLvoid *_indices, size_t _numIndices, GLenum _indexType,
+                                                          GLenum _usage)
+{
+  // first we grab an instance of our indexed VOA class as GL_TRIANGLES
+  auto vao = ngl::VAOFactory::createVAO("simpleIndexVAO", GL_TRIANGLES);
+  // next we bind it so it's active for setting data
+  vao->bind();
+  // now we have our data add it to the VAO, we need to tell the VAO the following
+  // how much (in bytes) data we are copying
+  // a pointer to the first element of data and the index buffer
+  vao->setData(ngl::SimpleIndexVAO::VertexData(_numVertices * sizeof(vertData), *_vertices,
+                                               static_cast<unsigned int>(_numIndices), _indices, _indexType, _usage));
+
+  // so data is Vert / Normal for the base mesh
+  vao->setVertexAttributePointer(0, 3, GL_FLOAT, sizeof(vertData), 0);
+  vao->setVertexAttributePointer(1, 3, GL_FLOAT, sizeof(vertData), 3);
+
+  vao->setNumIndices(_numIndices);
+  // finally we have finished for now so time to unbind the VAO
+  vao->unbind();
+  return vao;
+}
+
+void NGLScene::uploadDeltaBuffer(const GLvoid *_data, size_t _bytes, GLenum _format, GLuint &o_buffer, GLuint &o_texture,
+                                 GLenum _usage)
+{
+  morph::ScopedTimer timer(m_profiler, "load delta upload");
+  // all of the pose deltas go into one texture buffer indexed by target and gl_VertexID so any number of
+  // targets can be used without changing the vertex format
+  glGenBuffers(1, &o_buffer);
+  glBindBuffer(GL_TEXTURE_BUFFER, o_buffer);
+  glBufferData(GL_TEXTURE_BUFFER, static_cast<GLsizeiptr>(_bytes), _data, _usage);
+  glGenTextures(1, &o_texture);
+  glBindTexture(GL_TEXTURE_BUFFER, o_texture);
+  glTexBuffer(GL_TEXTURE_BUFFER, _format, o_buffer);
+  glBindTexture(GL_TEXTURE_BUFFER, 0);
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void NGLScene::uploadQuantizedDeltas(const morph::MorphMesh &_mesh)
+{
+  morph::QuantizedMorphMesh quantized;
+  quantized.build(_mesh, m_deltaFormat);
+  auto error = quantized.measureError(_mesh);
+  const size_t floatBytes = _mesh.numTargets() * _mesh.numVertices() * 2 * sizeof(morph::Vec3);
+  std::cout << fmt::format("{} deltas {:.2f} MB ({:.1f}x smaller than float) max position error {:.6f} rms {:.6f} "
+                           "max normal error {:.4f} degrees\n",
+                           morph::toString(m_deltaFormat), quantized.memoryBytes() / (1024.0 * 1024.0),
+                           static_cast<double>(floatBytes) / quantized.memoryBytes(), error.m_maxPosition,
+                           error.m_rmsPosition, error.m_maxNormalDegrees);
+  // the unsigned normalized formats are unpacked to [0,1] by texelFetch, there are no snorm buffer formats
+  GLenum positionFormat = GL_RGBA8;
+  if (m_deltaFormat == morph::DeltaFormat::HALF)
+  {
+    positionFormat = GL_RGBA16F;
+  }
+  else if (m_deltaFormat == morph::DeltaFormat::INT16)
+  {
+    positionFormat = GL_RGBA16;
+  }
+  uploadDeltaBuffer(quantized.positionData().data(), quantized.positionData().size(), positionFormat, m_deltaBuffer,
+                    m_deltaTexture);
+  uploadDeltaBuffer(quantized.normalData().data(), quantized.normalData().size() * sizeof(uint16_t), GL_RG16,
+                    m_normalBuffer, m_normalTexture);
+  m_deltaScale = quantized.scale();
+  m_deltaBias = quantized.bias();
 }
 
-void NGLScene::updateRight()
+void NGLScene::setupNormalRecompute()
 {
-  static Direction right = Direction::UP;
-  if (right == Direction::UP)
+  // the GPU only has the deltas and a possibly 16 bit index buffer, so start from a full MorphMesh
+  morph::MorphCache cache;
+  morph::MorphMesh mesh;
+  if (m_loader.state() == morph::MorphLoader::State::DONE)
+  {
+    m_loader.toMorphMesh(mesh);
+  }
+  else if (cache.open(s_cacheFile, morph::MorphCache::sourceStamp(s_poseFiles)))
+  {
+    cache.toMorphMesh(mesh);
+  }
+  else
   {
-    m_weight2 += 0.2f;
-    if (m_weight2 > 1.1f)
-      right = Direction::DOWN;
+    buildFromObjs(mesh);
   }
-  else if (right == Direction::DOWN)
+  m_normalRecompute.build(mesh.indices(), mesh.numVertices());
+  m_sparseMesh.build(mesh);
+  m_sparseMesh.initState(m_sparseState);
+  // start from the recomputed base so the incremental updates only ever have to fix up what moves
+  m_recomputedNormals = mesh.baseNormals();
+  m_normalRecompute.recompute(m_sparseState.m_positions, m_recomputedNormals);
+  uploadDeltaBuffer(m_recomputedNormals.data(), m_recomputedNormals.size() * sizeof(morph::Vec3), GL_RGB32F,
+                    m_recomputedNormalBuffer, m_recomputedNormalTexture, GL_DYNAMIC_DRAW);
+  if (m_gpuNormalsSupported)
   {
-    m_weight2 -= 0.2f;
-    if (m_weight2 <= 0.0f)
+    auto storage = [this](NormalStorage _id, const GLvoid *_data, size_t _bytes)
     {
-      m_weight2 = 0.0f;
-      m_timerRight->stop();
-      right = Direction::UP;
-      m_punchRight = false;
-    }
+      glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_normalStorage[_id]);
+      glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<GLsizeiptr>(_bytes), _data,
+                   _data != nullptr ? GL_STATIC_DRAW : GL_DYNAMIC_COPY);
+    };
+    glGenBuffers(NUM_NORMAL_STORAGE, m_normalStorage);
+    const auto &indices = m_normalRecompute.indices();
+    const auto &offsets = m_normalRecompute.adjacencyOffsets();
+    const auto &faces = m_normalRecompute.adjacentFaces();
+    storage(POSITIONS, nullptr, mesh.numVertices() * sizeof(morph::Vec3));
+    storage(INDICES, indices.data(), indices.size() * sizeof(uint32_t));
+    storage(FACE_NORMALS, nullptr, m_normalRecompute.numFaces() * sizeof(morph::Vec3));
+    storage(ADJACENCY_OFFSETS, offsets.data(), offsets.size() * sizeof(uint32_t));
+    storage(ADJACENT_FACES, faces.data(), faces.size() * sizeof(uint32_t));
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
   }
-  update();
+  std::cout << "Normal recompute " << m_normalRecompute.numFaces() << " faces "
+            << m_normalRecompute.adjacentFaces().size() << " adjacency entries\n";
+  m_normalRecomputeReady = true;
+}
+
+void NGLScene::updateNormals(const std::vector<morph::ActiveWeight> &_active)
+{
+  if (m_normalMode == NormalMode::BLEND)
+  {
+    return;
+  }
+  if (!m_normalRecomputeReady)
+  {
+    setupNormalRecompute();
+  }
+  if (m_normalMode == NormalMode::CPU)
+  {
+    // only the vertices the sparse evaluation wrote, and the faces around them, are recomputed
+    m_sparseMesh.evaluate(_active, m_sparseState);
+    m_normalRecompute.recompute(m_sparseState.m_changed, m_sparseState.m_positions, m_recomputedNormals);
+    glBindBuffer(GL_TEXTURE_BUFFER, m_recomputedNormalBuffer);
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, static_cast<GLsizeiptr>(m_recomputedNormals.size() * sizeof(morph::Vec3)),
+                    m_recomputedNormals.data());
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    return;
+  }
+  // GPU, morph the positions then the same two passes as NormalRecompute, each stage is a dispatch
+  // the weights are in the frame's morph block
+  ngl::ShaderLib::use("MorphNormals");
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_vaoMesh->getBufferID(0));
+  for (GLuint i = 0; i < NUM_NORMAL_STORAGE; ++i)
+  {
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, i + 1, m_normalStorage[i]);
+  }
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, NUM_NORMAL_STORAGE + 1, m_recomputedNormalBuffer);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_BUFFER, m_deltaTexture);
+  // must match local_size_x in MorphNormalsComp.glsl
+  constexpr GLuint groupSize = 64;
+  const size_t counts[3] = {m_numVertices, m_normalRecompute.numFaces(), m_numVertices};
+  for (int stage = 0; stage < 3; ++stage)
+  {
+    ngl::ShaderLib::setUniform("stage", stage);
+    glDispatchCompute(static_cast<GLuint>((counts[stage] + groupSize - 1) / groupSize), 1, 1);
+    glMemoryBarrier(stage < 2 ? GL_SHADER_STORAGE_BARRIER_BIT : GL_TEXTURE_FETCH_BARRIER_BIT);
+  }
+  for (GLuint i = 0; i <= NUM_NORMAL_STORAGE + 1; ++i)
+  {
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, i, 0);
+  }
+}
+
+void NGLScene::cycleNormalMode()
+{
+  // recomputing needs every target in a MorphMesh which is what streaming avoids, and the background load hasn't
+  // got them all yet
+  if (m_library || m_loadStep != LoadStep::DONE)
+  {
+    return;
+  }
+  switch (m_normalMode)
+  {
+  case NormalMode::BLEND:
+    m_normalMode = NormalMode::CPU;
+    break;
+  case NormalMode::CPU:
+    m_normalMode = m_gpuNormalsSupported ? NormalMode::GPU : NormalMode::BLEND;
+    break;
+  default:
+    m_normalMode = NormalMode::BLEND;
+    break;
+  }
+  markDirty(DIRTY_NORMAL_MODE);
+}
+
+void NGLScene::createMorphFeedback()
+{
+  ngl::ShaderLib::createShaderProgram("MorphFeedback");
+  ngl::ShaderLib::attachShader("MorphFeedbackVertex", ngl::ShaderType::VERTEX);
+  ngl::ShaderLib::loadShaderSource("MorphFeedbackVertex", m_deltaFormat == morph::DeltaFormat::FLOAT32
+                                                              ? "shaders/MorphFeedbackVert.glsl"
+                                                              : "shaders/MorphFeedbackQuantVert.glsl");
+  ngl::ShaderLib::compileShader("MorphFeedbackVertex");
+  ngl::ShaderLib::attachShaderToProgram("MorphFeedback", "MorphFeedbackVertex");
+  // the captured outputs have to be named before linking, interleaved they are the vertData layout
+  const GLchar *varyings[] = {"outPosition", "outNormal"};
+  glTransformFeedbackVaryings(ngl::ShaderLib::getProgramID("MorphFeedback"), 2, varyings, GL_INTERLEAVED_ATTRIBS);
+  ngl::ShaderLib::linkProgramObject("MorphFeedback");
+  bindUniformBlocks("MorphFeedback");
+  ngl::ShaderLib::use("MorphFeedback");
+  // the same texture units as PerFragADS
+  ngl::ShaderLib::setUniform("deltas", 0);
+  if (m_deltaFormat != morph::DeltaFormat::FLOAT32)
+  {
+    ngl::ShaderLib::setUniform("normalDeltas", 1);
+  }
+  ngl::ShaderLib::setUniform("numVerts", static_cast<int>(m_numVertices));
+  ngl::ShaderLib::setUniform("recomputedNormals", 2);
+}
+
+void NGLScene::createStaticProgram()
+{
+  ngl::ShaderLib::attachShader("PerFragADSFragment", ngl::ShaderType::FRAGMENT);
+  ngl::ShaderLib::loadShaderSource("PerFragADSFragment", "shaders/PerFragASDFrag.glsl");
+  ngl::ShaderLib::compileShader("PerFragADSFragment");
+  if (m_crowdSize > 0)
+  {
+    return;
+  }
+  ngl::ShaderLib::createShaderProgram("PerFragADSStatic");
+  ngl::ShaderLib::attachShader("PerFragADSStaticVertex", ngl::ShaderType::VERTEX);
+  ngl::ShaderLib::loadShaderSource("PerFragADSStaticVertex", "shaders/PerFragASDStaticVert.glsl");
+  ngl::ShaderLib::compileShader("PerFragADSStaticVertex");
+  ngl::ShaderLib::attachShaderToProgram("PerFragADSStatic", "PerFragADSStaticVertex");
+  ngl::ShaderLib::attachShaderToProgram("PerFragADSStatic", "PerFragADSFragment");
+  ngl::ShaderLib::linkProgramObject("PerFragADSStatic");
+  bindUniformBlocks("PerFragADSStatic");
+  ngl::ShaderLib::use("PerFragADSStatic");
+  loadLightingToShader();
+}
+
+void NGLScene::runMorphFeedback()
+{
+  ngl::ShaderLib::use("MorphFeedback");
+  // one point per vertex straight into the other VAO's vertex buffer, nothing needs rasterising
+  glEnable(GL_RASTERIZER_DISCARD);
+  glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, m_vaoMorphed->getBufferID(0));
+  m_vaoMesh->bind();
+  glBeginTransformFeedback(GL_POINTS);
+  glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(m_numVertices));
+  glEndTransformFeedback();
+  m_vaoMesh->unbind();
+  glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+  glDisable(GL_RASTERIZER_DISCARD);
+}
+
+void NGLScene::toggleMorphPath()
+{
+  // the crowd always blends in its own shader
+  if (m_crowdSize > 0)
+  {
+    return;
+  }
+  m_morphPath = m_morphPath == MorphPath::SHADER ? MorphPath::FEEDBACK : MorphPath::SHADER;
+  markDirty(DIRTY_MORPH_PATH);
+}
+
+void NGLScene::createCrowd()
+{
+  // characters are about 20 units tall so space them so they don't overlap when turning
+  m_crowd.spawn(m_crowdSize, m_rig.numTargets(), 15.0f);
+  m_crowd.update(0.0);
+  m_crowd.packMatrices(m_crowdMatrices);
+  uploadDeltaBuffer(m_crowd.weights().data(), m_crowd.weights().size() * sizeof(float), GL_R32F, m_crowdWeightBuffer,
+                    m_crowdWeightTexture, GL_DYNAMIC_DRAW);
+  uploadDeltaBuffer(m_crowdMatrices.data(), m_crowdMatrices.size() * sizeof(float), GL_RGBA32F, m_crowdMatrixBuffer,
+                    m_crowdMatrixTexture, GL_DYNAMIC_DRAW);
+  ngl::ShaderLib::createShaderProgram("Crowd");
+  ngl::ShaderLib::attachShader("CrowdVertex", ngl::ShaderType::VERTEX);
+  ngl::ShaderLib::loadShaderSource("CrowdVertex", "shaders/PerFragASDCrowdVert.glsl");
+  ngl::ShaderLib::compileShader("CrowdVertex");
+  ngl::ShaderLib::attachShaderToProgram("Crowd", "CrowdVertex");
+  ngl::ShaderLib::attachShaderToProgram("Crowd", "PerFragADSFragment");
+  ngl::ShaderLib::linkProgramObject("Crowd");
+  bindUniformBlocks("Crowd");
+  ngl::ShaderLib::use("Crowd");
+  ngl::ShaderLib::setUniform("deltas", 0);
+  ngl::ShaderLib::setUniform("instanceWeights", 3);
+  ngl::ShaderLib::setUniform("instanceMatrices", 4);
+  ngl::ShaderLib::setUniform("numTargets", static_cast<int>(m_crowd.numTargets()));
+  ngl::ShaderLib::setUniform("numInstances", static_cast<int>(m_crowd.size()));
+  ngl::ShaderLib::setUniform("instanceIndex", 5);
+  loadLightingToShader();
+  if (m_lodLevels > 1)
+  {
+    createLods();
+  }
+  // pull the camera back to see the whole grid
+  m_modelPos.m_z = -1.5f * m_crowd.extent();
+  m_farPlane = std::max(m_farPlane, 4.0f * m_crowd.extent() + 100.0f);
+  m_project = ngl::perspective(c_fovy, static_cast<float>(width()) / height(), 0.05f, m_farPlane);
+  std::cout << "Crowd of " << m_crowd.size() << " instances " << m_crowd.size() * m_numIndices / 3
+            << " triangles per frame\n";
+}
+
+void NGLScene::createLods()
+{
+  morph::ScopedTimer timer(m_profiler, "load lod");
+  // the levels are made from the full MorphMesh, which is in the cache unless it couldn't be written
+  morph::MorphMesh full;
+  const auto stamp = morph::MorphCache::sourceStamp(s_poseFiles);
+  morph::MorphCache cache;
+  if (cache.open(s_cacheFile, stamp))
+  {
+    cache.toMorphMesh(full);
+  }
+  else
+  {
+    buildFromObjs(full);
+  }
+  if (m_lod.read(s_lodFile, stamp, full.numVertices(), m_lodLevels, c_lodRatio))
+  {
+    std::cout << "Using LOD cache " << s_lodFile << '\n';
+  }
+  else
+  {
+    morph::ScopedTimer buildTimer(m_profiler, "load lod build");
+    m_lod.build(full, m_lodLevels, c_lodRatio);
+    if (m_lod.write(s_lodFile, stamp))
+    {
+      std::cout << "Wrote LOD cache " << s_lodFile << '\n';
+    }
+  }
+  // level 0 is the mesh already uploaded, the others get their own VAO and deltas
+  m_lodDraws.clear();
+  m_lodDraws.resize(m_lod.numLevels());
+  m_lodDraws[0].m_numVertices = m_numVertices;
+  m_lodDraws[0].m_numIndices = m_numIndices;
+  m_lodDraws[0].m_indexType = m_indexType;
+  for (size_t l = 1; l < m_lod.numLevels(); ++l)
+  {
+    morph::MorphMesh mesh;
+    m_lod.extract(full, l, mesh);
+    std::vector<morph::Vec3> vertices;
+    std::vector<morph::Vec3> deltas;
+    mesh.packVertices(vertices);
+    mesh.packDeltas(deltas);
+    auto &draw = m_lodDraws[l];
+    draw.m_numVertices = mesh.numVertices();
+    draw.m_numIndices = mesh.indices().size();
+    if (mesh.fitsIn16Bit())
+    {
+      auto shortIndices = morph::narrowIndices(mesh.indices());
+      draw.m_vao = createMeshVAO(&vertices[0].m_x, mesh.numVertices(), shortIndices.data(), shortIndices.size(),
+                                 GL_UNSIGNED_SHORT);
+      draw.m_indexType = GL_UNSIGNED_SHORT;
+    }
+    else
+    {
+      draw.m_vao = createMeshVAO(&vertices[0].m_x, mesh.numVertices(), mesh.indices().data(), mesh.indices().size(),
+                                 GL_UNSIGNED_INT);
+    }
+    uploadDeltaBuffer(deltas.data(), deltas.size() * sizeof(morph::Vec3), GL_RGB32F, draw.m_deltaBuffer,
+                      draw.m_deltaTexture);
+  }
+  for (size_t l = 0; l < m_lod.numLevels(); ++l)
+  {
+    std::cout << fmt::format("LOD {} {} vertices {} triangles error {:.4f}\n", l, m_lod.level(l).m_vertices.size(),
+                             m_lod.level(l).numTriangles(), m_lod.level(l).m_error);
+  }
+  m_lodInstances.resize(m_crowd.size());
+  m_instanceLevel.resize(m_crowd.size());
+  uploadDeltaBuffer(m_lodInstances.data(), m_lodInstances.size() * sizeof(GLint), GL_R32I, m_lodInstanceBuffer,
+                    m_lodInstanceTexture, GL_DYNAMIC_DRAW);
+}
+
+void NGLScene::selectLods()
+{
+  // the level comes from the distance to the eye, the instance's eye space position is MV * its origin
+  const float pixelsPerUnit = static_cast<float>(m_win.height) / (2.0f * std::tan(c_fovy * 0.5f * 3.14159265f / 180.0f));
+  const auto &m = m_MV.m_m;
+  for (auto &d : m_lodDraws)
+  {
+    d.m_instanceCount = 0;
+  }
+  for (size_t i = 0; i < m_crowd.size(); ++i)
+  {
+    const auto p = m_crowd.position(i);
+    const float x = m[0][0] * p.m_x + m[1][0] * p.m_y + m[2][0] * p.m_z + m[3][0];
+    const float y = m[0][1] * p.m_x + m[1][1] * p.m_y + m[2][1] * p.m_z + m[3][1];
+    const float z = m[0][2] * p.m_x + m[1][2] * p.m_y + m[2][2] * p.m_z + m[3][2];
+    const auto level = static_cast<uint8_t>(m_lod.select(std::sqrt(x * x + y * y + z * z), pixelsPerUnit));
+    m_instanceLevel[i] = level;
+    ++m_lodDraws[level].m_instanceCount;
+  }
+  // counting sort so each level's instances are a contiguous run the draw reads from m_instanceOffset
+  size_t offset = 0;
+  for (auto &d : m_lodDraws)
+  {
+    d.m_instanceOffset = offset;
+    offset += d.m_instanceCount;
+  }
+  std::vector<size_t> fill(m_lodDraws.size());
+  for (size_t l = 0; l < m_lodDraws.size(); ++l)
+  {
+    fill[l] = m_lodDraws[l].m_instanceOffset;
+  }
+  for (size_t i = 0; i < m_crowd.size(); ++i)
+  {
+    m_lodInstances[fill[m_instanceLevel[i]]++] = static_cast<GLint>(i);
+  }
+  glBindBuffer(GL_TEXTURE_BUFFER, m_lodInstanceBuffer);
+  glBufferSubData(GL_TEXTURE_BUFFER, 0, static_cast<GLsizeiptr>(m_lodInstances.size() * sizeof(GLint)),
+                  m_lodInstances.data());
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void NGLScene::drawCrowd()
+{
+  // the crowd is always moving so there is no dirty check on the instance data
+  {
+    morph::ScopedTimer timer(m_profiler, "crowd update");
+    m_crowd.update(m_animationTime);
+    m_crowd.packMatrices(m_crowdMatrices);
+  }
+  morph::ScopedTimer timer(m_profiler, "draw");
+  glBindBuffer(GL_TEXTURE_BUFFER, m_crowdWeightBuffer);
+  glBufferSubData(GL_TEXTURE_BUFFER, 0, static_cast<GLsizeiptr>(m_crowd.weights().size() * sizeof(float)),
+                  m_crowd.weights().data());
+  glBindBuffer(GL_TEXTURE_BUFFER, m_crowdMatrixBuffer);
+  glBufferSubData(GL_TEXTURE_BUFFER, 0, static_cast<GLsizeiptr>(m_crowdMatrices.size() * sizeof(float)),
+                  m_crowdMatrices.data());
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+  if (!m_lodDraws.empty())
+  {
+    morph::ScopedTimer lodTimer(m_profiler, "crowd lod select");
+    selectLods();
+  }
+  // the draws' blocks all go in this frame's region with the matrices, each draw then just binds its own range
+  if (!acquireFrameUniforms(false))
+  {
+    return;
+  }
+  if (m_lodDraws.empty())
+  {
+    writeDrawUniforms(0, {static_cast<int32_t>(m_numVertices), 0, 0, 0});
+  }
+  for (size_t l = 0; l < std::min(m_lodDraws.size(), c_maxDraws); ++l)
+  {
+    const auto &d = m_lodDraws[l];
+    writeDrawUniforms(l, {static_cast<int32_t>(d.m_numVertices), static_cast<int32_t>(d.m_instanceOffset), 1, 0});
+  }
+  submitFrameUniforms();
+  ngl::ShaderLib::use("Crowd");
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_BUFFER, m_deltaTexture);
+  glActiveTexture(GL_TEXTURE3);
+  glBindTexture(GL_TEXTURE_BUFFER, m_crowdWeightTexture);
+  glActiveTexture(GL_TEXTURE4);
+  glBindTexture(GL_TEXTURE_BUFFER, m_crowdMatrixTexture);
+  glActiveTexture(GL_TEXTURE0);
+  if (m_lodDraws.empty())
+  {
+    // one draw for every character
+    bindDrawUniforms(0);
+    m_vaoMesh->bind();
+    glDrawElementsInstanced(GL_TRIANGLES, static_cast<GLsizei>(m_numIndices), m_indexType, nullptr,
+                            static_cast<GLsizei>(m_crowd.size()));
+    m_vaoMesh->unbind();
+  }
+  else
+  {
+    // one draw per level, each reads its instance ids from the sorted list
+    glActiveTexture(GL_TEXTURE5);
+    glBindTexture(GL_TEXTURE_BUFFER, m_lodInstanceTexture);
+    glActiveTexture(GL_TEXTURE0);
+    for (size_t l = 0; l < std::min(m_lodDraws.size(), c_maxDraws); ++l)
+    {
+      const auto &d = m_lodDraws[l];
+      if (d.m_instanceCount == 0)
+      {
+        continue;
+      }
+      ngl::AbstractVAO *vao = l == 0 ? m_vaoMesh.get() : d.m_vao.get();
+      glBindTexture(GL_TEXTURE_BUFFER, l == 0 ? m_deltaTexture : d.m_deltaTexture);
+      bindDrawUniforms(l);
+      vao->bind();
+      glDrawElementsInstanced(GL_TRIANGLES, static_cast<GLsizei>(d.m_numIndices), d.m_indexType, nullptr,
+                              static_cast<GLsizei>(d.m_instanceCount));
+      vao->unbind();
+    }
+  }
+  // report the average frame time once a second
+  ++m_crowdFrames;
+  const double now = m_clock.nsecsElapsed() * 1e-9;
+  if (now - m_crowdReportTime >= 1.0)
+  {
+    m_crowdFrameMs = (now - m_crowdReportTime) * 1000.0 / m_crowdFrames;
+    std::cout << fmt::format("crowd {} instances {:.2f} ms/frame\n", m_crowd.size(), m_crowdFrameMs);
+    m_crowdReportTime = now;
+    m_crowdFrames = 0;
+  }
+}
+
+void NGLScene::changeWeight(size_t _target, Direction _d)
+{
+  if (_target >= m_weights.size())
+  {
+    return;
+  }
+  float w = m_weights[_target];
+  if (_d == Direction::UP)
+    w += 0.1f;
+  else
+    w -= 0.1f;
+  // clamp to 0.0 -> 1.0 range
+  setWeight(_target, std::min(1.0f, std::max(0.0f, w)));
+}
+
+void NGLScene::setWeight(size_t _target, float _weight)
+{
+  if (_target < m_weights.size() && m_weights[_target] != _weight)
+  {
+    m_weights[_target] = _weight;
+    markDirty(DIRTY_WEIGHTS);
+  }
+}
+
+void NGLScene::setWeights(const std::vector<float> &_weights)
+{
+  for (size_t i = 0; i < std::min(_weights.size(), m_weights.size()); ++i)
+  {
+    setWeight(i, _weights[i]);
+  }
+}
+
+void NGLScene::setCameraRotation(int _spinX, int _spinY)
+{
+  if (_spinX != m_win.spinXFace || _spinY != m_win.spinYFace)
+  {
+    m_win.spinXFace = _spinX;
+    m_win.spinYFace = _spinY;
+    markDirty(DIRTY_TRANSFORM);
+  }
+}
+
+void NGLScene::setAnimationTime(double _time)
+{
+  m_animation = false;
+  m_animationTime = _time;
+  update();
+}
+
+void NGLScene::markDirty(unsigned int _flags)
+{
+  m_dirty |= _flags;
+  update();
+}
+
+NGLScene::~NGLScene()
+{
+  std::cout << "Shutting down NGL, removing VAO's and Shaders\n";
+  // the cache is written from m_loader
+  if (m_cacheWrite.valid())
+  {
+    m_cacheWrite.wait();
+  }
+  makeCurrent();
+  m_staging.release();
+  m_frameRing.release();
+  glDeleteTextures(1, &m_deltaTexture);
+  glDeleteBuffers(1, &m_deltaBuffer);
+  glDeleteTextures(1, &m_normalTexture);
+  glDeleteBuffers(1, &m_normalBuffer);
+  glDeleteTextures(1, &m_recomputedNormalTexture);
+  glDeleteBuffers(1, &m_recomputedNormalBuffer);
+  glDeleteBuffers(NUM_NORMAL_STORAGE, m_normalStorage);
+  glDeleteTextures(1, &m_crowdWeightTexture);
+  glDeleteBuffers(1, &m_crowdWeightBuffer);
+  glDeleteTextures(1, &m_crowdMatrixTexture);
+  glDeleteBuffers(1, &m_crowdMatrixBuffer);
+  glDeleteTextures(1, &m_skinPaletteTexture);
+  glDeleteBuffers(1, &m_skinPaletteBuffer);
+  glDeleteTextures(1, &m_skinJointTexture);
+  glDeleteBuffers(1, &m_skinJointBuffer);
+  glDeleteTextures(1, &m_skinWeightTexture);
+  glDeleteBuffers(1, &m_skinWeightBuffer);
+  glDeleteQueries(NUM_GPU_QUERIES, m_gpuQueries);
+  for (auto &d : m_lodDraws)
+  {
+    glDeleteTextures(1, &d.m_deltaTexture);
+    glDeleteBuffers(1, &d.m_deltaBuffer);
+  }
+  glDeleteTextures(1, &m_lodInstanceTexture);
+  glDeleteBuffers(1, &m_lodInstanceBuffer);
+  if (!m_traceFile.empty() && m_profiler.writeChromeTrace(m_traceFile))
+  {
+    std::cout << "Wrote " << m_profiler.numTraceEvents() << " trace events to " << m_traceFile << '\n';
+  }
+}
+
+void NGLScene::resizeGL(int _w, int _h)
+{
+  m_project = ngl::perspective(c_fovy, static_cast<float>(_w) / _h, 0.05f, m_farPlane);
+  // Qt always repaints after a resize so there is no need to ask for a frame
+  m_dirty |= DIRTY_PROJECTION;
+  m_win.width = static_cast<int>(_w * devicePixelRatio());
+  m_win.height = static_cast<int>(_h * devicePixelRatio());
+}
+
+void NGLScene::initializeGL()
+{
+  // we must call this first before any other GL commands to load and link the
+  // gl commands from the lib, if this is not done program will crash
+  ngl::NGLInit::initialize();
+  // the current context rather than context() as a headless run renders with its own
+  const auto glContext = QOpenGLContext::currentContext();
+  const auto glFormat = glContext->format();
+  const auto hasVersion = [&glFormat](int _major, int _minor)
+  { return glFormat.majorVersion() > _major || (glFormat.majorVersion() == _major && glFormat.minorVersion() >= _minor); };
+  // the float deltas and recomputed normals are packed Vec3 texture buffers (GL_RGB32F) so the cache can be mapped
+  // straight into them, three component buffer formats are core in 4.0 and an extension before that
+  if (!hasVersion(4, 0) && !glContext->hasExtension("GL_ARB_texture_buffer_object_rgb32"))
+  {
+    std::cerr << "MorphObj needs OpenGL 4.0 or GL_ARB_texture_buffer_object_rgb32, the context is "
+              << glFormat.majorVersion() << '.' << glFormat.minorVersion() << '\n';
+    exit(EXIT_FAILURE);
+  }
+  if (!m_traceFile.empty())
+  {
+    m_profiler.startTrace();
+  }
+  m_loadStart = m_profiler.now();
+  // a single float mesh loads in the background while the rest of this runs, the other modes need all of the
+  // targets up front
+  const bool background = m_crowdSize == 0 && !m_streamPoses && m_deltaFormat == morph::DeltaFormat::FLOAT32;
+  if (background)
+  {
+    m_loader.start(s_poseFiles, s_cacheFile);
+  }
+  glGenQueries(NUM_GPU_QUERIES, m_gpuQueries);
+
+  glClearColor(0.4f, 0.4f, 0.4f, 1.0f); // Grey Background
+  // enable depth testing for drawing
+  glEnable(GL_DEPTH_TEST);
+  // enable multisampling for smoother drawing
+  glEnable(GL_MULTISAMPLE);
+  // Now we will create a basic Camera from the graphics library
+  // This is a static camera so it only needs to be set once
+  // First create Values for the camera position
+  ngl::Vec3 from(0, 10, 40);
+  ngl::Vec3 to(0, 10, 0);
+  ngl::Vec3 up(0, 1, 0);
+  m_view = ngl::lookAt(from, to, up);
+  // set the shape using FOV 45 Aspect Ratio based on Width and Height
+  // The final two are near and far clipping planes of 0.5 and 10
+  m_project = ngl::perspective(c_fovy, 720.0f / 576.0f, 0.05f, m_farPlane);
+  // as re-size is not explicitly called we need to do this.
+  glViewport(0, 0, width(), height());
+
+  // buffer storage is core in 4.4, below that the staging is mapped a region at a time
+  m_persistentMapping = hasVersion(4, 4);
+  createFrameRing();
+#if !defined(__APPLE__)
+  // compute shaders are core in 4.3, the pass reads the float deltas directly so it can't be used with the
+  // compressed ones
+  m_gpuNormalsSupported = hasVersion(4, 3) && m_deltaFormat == morph::DeltaFormat::FLOAT32;
+#endif
+  if (m_normalMode == NormalMode::GPU && !m_gpuNormalsSupported)
+  {
+    std::cerr << "GPU normal recompute needs OpenGL 4.3 and float deltas, using the CPU\n";
+    m_normalMode = NormalMode::CPU;
+  }
+  if (background)
+  {
+    // the program for the base compiles while it loads, everything else waits for advanceLoad
+    createStaticProgram();
+    m_loadNormalMode = m_normalMode;
+    m_normalMode = NormalMode::BLEND;
+    m_loadStep = LoadStep::BASE;
+    if (m_waitForPoses)
+    {
+      // every frame has to be complete, so finish the load now
+      m_loader.wait();
+      while (m_loadStep != LoadStep::DONE)
+      {
+        advanceLoad();
+      }
+    }
+    return;
+  }
+  // first we create a mesh from an obj passing in the obj file and texture
+  // load the poses, either from the cache or the obj files
+  createMorphMesh();
+  createStaticProgram();
+  createPrograms();
+  createText();
+}
+
+void NGLScene::createPrograms()
+{
+  morph::ScopedTimer timer(m_profiler, "load shaders");
+  // we are creating a shader called PerFragADS
+  ngl::ShaderLib::createShaderProgram("PerFragADS");
+  // now we are going to create an empty vertex shader, the fragment shader is already compiled
+  ngl::ShaderLib::attachShader("PerFragADSVertex", ngl::ShaderType::VERTEX);
+  // attach the source
+  // compressed deltas need their own decode
+  ngl::ShaderLib::loadShaderSource("PerFragADSVertex", m_deltaFormat == morph::DeltaFormat::FLOAT32
+                                                           ? "shaders/PerFragASDVert.glsl"
+                                                           : "shaders/PerFragASDQuantVert.glsl");
+  // compile the shader
+  ngl::ShaderLib::compileShader("PerFragADSVertex");
+  // add them to the program
+  ngl::ShaderLib::attachShaderToProgram("PerFragADS", "PerFragADSVertex");
+  ngl::ShaderLib::attachShaderToProgram("PerFragADS", "PerFragADSFragment");
+
+  // now we have associated this data we can link the shader
+  ngl::ShaderLib::linkProgramObject("PerFragADS");
+  bindUniformBlocks("PerFragADS");
+  // and make it active ready to load values
+  ngl::ShaderLib::use("PerFragADS");
+  // the deltas are always bound to texture unit 0
+  ngl::ShaderLib::setUniform("deltas", 0);
+  if (m_deltaFormat != morph::DeltaFormat::FLOAT32)
+  {
+    ngl::ShaderLib::setUniform("normalDeltas", 1);
+  }
+  ngl::ShaderLib::setUniform("numVerts", static_cast<int>(m_numVertices));
+  // recomputed normals are on unit 2 as unit 1 may hold the compressed normals
+  ngl::ShaderLib::setUniform("recomputedNormals", 2);
+  loadLightingToShader();
+  if (m_crowdSize > 0)
+  {
+    createCrowd();
+  }
+  else
+  {
+    createMorphFeedback();
+  }
+  if (m_gpuNormalsSupported)
+  {
+    ngl::ShaderLib::createShaderProgram("MorphNormals");
+    ngl::ShaderLib::attachShader("MorphNormalsCompute", ngl::ShaderType::COMPUTE);
+    ngl::ShaderLib::loadShaderSource("MorphNormalsCompute", "shaders/MorphNormalsComp.glsl");
+    ngl::ShaderLib::compileShader("MorphNormalsCompute");
+    ngl::ShaderLib::attachShaderToProgram("MorphNormals", "MorphNormalsCompute");
+    ngl::ShaderLib::linkProgramObject("MorphNormals");
+    bindUniformBlocks("MorphNormals");
+    ngl::ShaderLib::use("MorphNormals");
+    ngl::ShaderLib::setUniform("deltas", 0);
+    ngl::ShaderLib::setUniform("numVerts", static_cast<int>(m_numVertices));
+  }
+  m_morphReady = true;
+}
+
+void NGLScene::createText()
+{
+  morph::ScopedTimer timer(m_profiler, "load font");
+  m_text = std::make_unique<ngl::Text>("fonts/Arial.ttf", 16);
+  m_text->setScreenSize(width(), height());
+}
+
+void NGLScene::advanceLoad()
+{
+  const auto state = m_loader.update();
+  if (state == morph::MorphLoader::State::FAILED)
+  {
+    std::cerr << "Unable to load the morph mesh\n";
+    exit(EXIT_FAILURE);
+  }
+  // at most one slow GL step a frame so the window keeps drawing, targets are copied in alongside as they arrive
+  switch (m_loadStep)
+  {
+  case LoadStep::BASE:
+    if (state == morph::MorphLoader::State::LOADING_BASE)
+    {
+      return;
+    }
+    showBase();
+    m_loadStep = LoadStep::PROGRAMS;
+    break;
+  case LoadStep::PROGRAMS:
+    createPrograms();
+    // none of the new programs' uniforms are set
+    m_dirty = DIRTY_ALL;
+    m_loadStep = LoadStep::TEXT;
+    break;
+  case LoadStep::TEXT:
+    createText();
+    m_loadStep = LoadStep::TARGETS;
+    break;
+  default:
+    break;
+  }
+  uploadLoadedTargets();
+  if (m_loadStep == LoadStep::TARGETS && m_numTargetsUploaded == m_targetUploaded.size())
+  {
+    finishLoad();
+  }
+}
+
+void NGLScene::showBase()
+{
+  if (m_loader.numTargets() < 2)
+  {
+    std::cerr << "The morph mesh needs at least two targets\n";
+    exit(EXIT_FAILURE);
+  }
+  setupRig(m_loader.numTargets());
+  uploadMorphMesh(m_loader.vertexData(), m_loader.numVertices(), m_loader.indexData(), m_loader.numIndices(),
+                  m_loader.indexSize() == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT);
+  // the slots are laid out as if every target were there, the shader only reads the loaded ones
+  uploadDeltaBuffer(nullptr, m_loader.numTargets() * m_loader.targetBytes(), GL_RGB32F, m_deltaBuffer, m_deltaTexture);
+  m_targetUploaded.assign(m_loader.numTargets(), false);
+  m_staging.create(GL_COPY_READ_BUFFER, c_stagingBytes, c_stagingRegions, m_persistentMapping);
+  // the frames so far drew nothing so none of the static program's uniforms are set
+  m_dirty = DIRTY_ALL;
+  m_profiler.record("load base", m_loadStart, m_profiler.now() - m_loadStart);
+  std::cout << fmt::format("Base mesh {} vertices from the {} after {:.1f} ms\n", m_loader.numVertices(),
+                           m_loader.fromCache() ? "cache" : "objs", m_loader.baseSeconds() * 1000.0);
+}
+
+void NGLScene::uploadLoadedTargets()
+{
+  const size_t bytes = m_loader.targetBytes();
+  size_t uploaded = 0;
+  for (size_t t = 0; t < m_targetUploaded.size(); ++t)
+  {
+    const auto *deltas = m_loader.targetDeltas(t);
+    if (m_targetUploaded[t] || deltas == nullptr)
+    {
+      continue;
+    }
+    // whatever doesn't fit in this frame's budget goes up next frame
+    if (uploaded >= c_uploadBudget && !m_waitForPoses)
+    {
+      break;
+    }
+    uploadStaged(m_deltaBuffer, t * bytes, deltas, bytes);
+    m_targetUploaded[t] = true;
+    ++m_numTargetsUploaded;
+    uploaded += bytes;
+  }
+  if (uploaded > 0)
+  {
+    // the new targets join the blend this frame
+    m_dirty |= DIRTY_WEIGHTS;
+  }
+}
+
+void NGLScene::finishLoad()
+{
+  m_loadStep = LoadStep::DONE;
+  m_profiler.record("load", m_loadStart, m_profiler.now() - m_loadStart);
+  std::cout << fmt::format("Loaded {} targets in the background in {:.1f} ms, {} staging stalls\n",
+                           m_loader.numTargets(), m_loader.totalSeconds() * 1000.0, m_staging.stalls());
+  // everything is there to recompute from now
+  if (m_loadNormalMode != NormalMode::BLEND)
+  {
+    m_normalMode = m_loadNormalMode;
+    m_dirty |= DIRTY_NORMAL_MODE;
+  }
+  if (m_loader.fromCache())
+  {
+    return;
+  }
+  // the loader doesn't change again so the cache can be built from it off the GL thread
+  m_cacheWrite = morph::ThreadPool::global().submit(
+      [this]()
+      {
+        morph::MorphMesh mesh;
+        m_loader.toMorphMesh(mesh);
+        std::cout << "Morph mesh " << mesh.numVertices() << " vertices " << mesh.indices().size() / 3
+                  << " triangles ACMR " << morph::averageCacheMissRatio(mesh.indices(), mesh.numVertices()) << '\n';
+        // save the cache for next time, this is allowed to fail if the models directory isn't writable
+        if (morph::MorphCache::write(s_cacheFile, mesh, morph::MorphCache::sourceStamp(s_poseFiles)))
+        {
+          std::cout << "Wrote morph cache " << s_cacheFile << '\n';
+        }
+      });
+}
+
+void NGLScene::uploadStaged(GLuint _buffer, size_t _offset, const void *_data, size_t _bytes)
+{
+  const auto *src = static_cast<const char *>(_data);
+  for (size_t done = 0; done < _bytes;)
+  {
+    size_t offset = 0;
+    void *staging = m_staging.acquire(offset);
+    if (staging == nullptr)
+    {
+      // the map failed, let the driver do the copy
+      glBindBuffer(GL_COPY_WRITE_BUFFER, _buffer);
+      glBufferSubData(GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(_offset + done),
+                      static_cast<GLsizeiptr>(_bytes - done), src + done);
+      break;
+    }
+    const size_t chunk = std::min(_bytes - done, m_staging.regionBytes());
+    std::memcpy(staging, src + done, chunk);
+    m_staging.submit();
+    glBindBuffer(GL_COPY_READ_BUFFER, m_staging.buffer());
+    glBindBuffer(GL_COPY_WRITE_BUFFER, _buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(offset),
+                        static_cast<GLintptr>(_offset + done), static_cast<GLsizeiptr>(chunk));
+    m_staging.fence();
+    done += chunk;
+  }
+  glBindBuffer(GL_COPY_READ_BUFFER, 0);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void NGLScene::packMorphUniforms()
+{
+  auto &u = m_morphUniforms;
+  u.m_activeCount = static_cast<int32_t>(m_active.size());
+  for (size_t i = 0; i < m_active.size(); ++i)
+  {
+    u.m_activeTarget[i] = static_cast<int32_t>(m_active[i].m_target);
+    u.m_activeWeight[i] = m_active[i].m_weight;
+  }
+  if (m_deltaFormat == morph::DeltaFormat::FLOAT32)
+  {
+    return;
+  }
+  for (size_t i = 0; i < m_active.size(); ++i)
+  {
+    const auto &scale = m_deltaScale[m_active[i].m_target];
+    const auto &bias = m_deltaBias[m_active[i].m_target];
+    std::memcpy(u.m_activeScale[i], &scale.m_x, sizeof(morph::Vec3));
+    std::memcpy(u.m_activeBias[i], &bias.m_x, sizeof(morph::Vec3));
+  }
+}
+
+void NGLScene::createFrameRing()
+{
+  // the offsets std140 gives the blocks in the shaders
+  static_assert(sizeof(FrameUniforms) == 240, "FrameUniforms must match the Frame block");
+  static_assert(sizeof(MorphUniforms) == 16 + MAX_ACTIVE_TARGETS * 40, "MorphUniforms must match the Morph block");
+  static_assert(sizeof(DrawUniforms) == 16, "DrawUniforms must match the Draw block");
+  GLint alignment = 256;
+  glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+  const auto align = [alignment](size_t _bytes)
+  { return (_bytes + static_cast<size_t>(alignment) - 1) / static_cast<size_t>(alignment) * static_cast<size_t>(alignment); };
+  m_morphBlockOffset = align(sizeof(FrameUniforms));
+  m_drawBlockOffset = m_morphBlockOffset + align(sizeof(MorphUniforms));
+  m_drawBlockStride = align(sizeof(DrawUniforms));
+  m_frameRing.create(GL_UNIFORM_BUFFER, m_drawBlockOffset + c_maxDraws * m_drawBlockStride, c_frameRegions,
+                     m_persistentMapping, static_cast<size_t>(alignment));
+}
+
+bool NGLScene::acquireFrameUniforms(bool _morph)
+{
+  m_frameData = static_cast<char *>(m_frameRing.acquire(m_frameOffset));
+  if (m_frameData == nullptr)
+  {
+    return false;
+  }
+  std::memcpy(m_frameData, &m_frameUniforms, sizeof(FrameUniforms));
+  if (_morph)
+  {
+    // only the active entries of the arrays are read
+    const size_t count = static_cast<size_t>(m_morphUniforms.m_activeCount);
+    auto *block = reinterpret_cast<MorphUniforms *>(m_frameData + m_morphBlockOffset);
+    block->m_activeCount = m_morphUniforms.m_activeCount;
+    std::memcpy(block->m_activeTarget, m_morphUniforms.m_activeTarget, count * sizeof(int32_t));
+    std::memcpy(block->m_activeWeight, m_morphUniforms.m_activeWeight, count * sizeof(float));
+    if (m_deltaFormat != morph::DeltaFormat::FLOAT32)
+    {
+      std::memcpy(block->m_activeScale, m_morphUniforms.m_activeScale, count * sizeof(float) * 4);
+      std::memcpy(block->m_activeBias, m_morphUniforms.m_activeBias, count * sizeof(float) * 4);
+    }
+  }
+  return true;
+}
+
+void NGLScene::writeDrawUniforms(size_t _draw, const DrawUniforms &_uniforms)
+{
+  std::memcpy(m_frameData + m_drawBlockOffset + _draw * m_drawBlockStride, &_uniforms, sizeof(DrawUniforms));
+}
+
+void NGLScene::submitFrameUniforms()
+{
+  m_frameRing.submit();
+  const GLuint buffer = m_frameRing.buffer();
+  glBindBufferRange(GL_UNIFORM_BUFFER, FRAME_BLOCK, buffer, static_cast<GLintptr>(m_frameOffset),
+                    static_cast<GLsizeiptr>(sizeof(FrameUniforms)));
+  glBindBufferRange(GL_UNIFORM_BUFFER, MORPH_BLOCK, buffer, static_cast<GLintptr>(m_frameOffset + m_morphBlockOffset),
+                    static_cast<GLsizeiptr>(sizeof(MorphUniforms)));
+}
+
+void NGLScene::bindDrawUniforms(size_t _draw)
+{
+  glBindBufferRange(GL_UNIFORM_BUFFER, DRAW_BLOCK, m_frameRing.buffer(),
+                    static_cast<GLintptr>(m_frameOffset + m_drawBlockOffset + _draw * m_drawBlockStride),
+                    static_cast<GLsizeiptr>(sizeof(DrawUniforms)));
+}
+
+void NGLScene::updateMatrices()
+{
+  // Rotation based on the mouse position for our global transform
+  auto rotX = ngl::Mat4::rotateX(m_win.spinXFace);
+  auto rotY = ngl::Mat4::rotateY(m_win.spinYFace);
+  // multiply the rotations
+  m_mouseGlobalTX = rotY * rotX;
+  // add the translations
+  m_mouseGlobalTX.m_m[3][0] = m_modelPos.m_x;
+  m_mouseGlobalTX.m_m[3][1] = m_modelPos.m_y;
+  m_mouseGlobalTX.m_m[3][2] = m_modelPos.m_z;
+  m_MV = m_view * m_mouseGlobalTX;
+  m_MVP = m_project * m_MV;
+  // the inverse only depends on the model view so a projection change doesn't need it
+  if (m_dirty & DIRTY_TRANSFORM)
+  {
+    m_normalMatrix = m_MV;
+    m_normalMatrix.inverse().transpose();
+  }
+  // ngl's matrices are column major like std140
+  auto &u = m_frameUniforms;
+  std::memcpy(u.m_MVP, &m_MVP.m_m[0][0], sizeof(u.m_MVP));
+  std::memcpy(u.m_MV, &m_MV.m_m[0][0], sizeof(u.m_MV));
+  std::memcpy(u.m_P, &m_project.m_m[0][0], sizeof(u.m_P));
+  for (int c = 0; c < 3; ++c)
+  {
+    std::memcpy(&u.m_normalMatrix[c * 4], &m_normalMatrix.m_m[c][0], 3 * sizeof(float));
+  }
+}
+
+void NGLScene::loadSettingsToShader()
+{
+  // switching path sends everything as the newly used programs may hold values from before the last switch
+  const bool feedback = m_morphPath == MorphPath::FEEDBACK;
+  if (m_skinInfluences > 0 && (m_dirty & (DIRTY_SKIN_METHOD | DIRTY_MORPH_PATH)))
+  {
+    // until the morph programs have loaded the base is drawn with the static one
+    ngl::ShaderLib::use(feedback || !m_morphReady ? "PerFragADSStatic" : "PerFragADS");
+    // the joint data is on units 6 to 8, clear of the delta, normal, crowd and LOD units
+    ngl::ShaderLib::setUniform("skinPalette", 6);
+    ngl::ShaderLib::setUniform("skinJoints", 7);
+    ngl::ShaderLib::setUniform("skinWeights", 8);
+    ngl::ShaderLib::setUniform("skinInfluences", static_cast<int>(m_skinInfluences));
+    ngl::ShaderLib::setUniform("skinDualQuat", m_skinMethod == morph::SkinMethod::DUAL_QUATERNION ? 1 : 0);
+  }
+  if (m_morphReady && (m_dirty & (DIRTY_NORMAL_MODE | DIRTY_MORPH_PATH)))
+  {
+    ngl::ShaderLib::use(feedback ? "MorphFeedback" : "PerFragADS");
+    ngl::ShaderLib::setUniform("useRecomputedNormals", m_normalMode != NormalMode::BLEND ? 1 : 0);
+  }
+}
+
+void NGLScene::paintGL()
+{
+  // paintGL is also called by Qt for exposes and resizes so the frame is always drawn in full, only the
+  // derived state is cached
+  morph::ScopedTimer frameTimer(m_profiler, "frame");
+  readGpuTimers();
+  beginGpuTimer();
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  if (m_loadStep != LoadStep::DONE)
+  {
+    morph::ScopedTimer timer(m_profiler, "load step");
+    advanceLoad();
+  }
+  {
+    morph::ScopedTimer timer(m_profiler, "animation");
+    tickAnimation();
+  }
+  if (m_dirty & (DIRTY_TRANSFORM | DIRTY_PROJECTION))
+  {
+    updateMatrices();
+  }
+  if (m_crowdSize > 0)
+  {
+    drawCrowd();
+  }
+  // there is nothing to draw until the base has loaded
+  else if (m_vaoMesh)
+  {
+    if (m_streamPending)
+    {
+      m_dirty |= DIRTY_WEIGHTS;
+    }
+    if (m_dirty & DIRTY_WEIGHTS)
+    {
+      // only send the targets that are actually contributing, the in-betweens and combinations are resolved here
+      // once a frame so the shader is still one weighted sum
+      m_rig.evaluate(m_weights, m_targetWeights);
+      m_active = morph::MorphMesh::gatherActive(m_targetWeights, MAX_ACTIVE_TARGETS);
+      if (m_numTargetsUploaded < m_targetUploaded.size())
+      {
+        // a target still loading has an empty slot so it is left out until it arrives
+        m_active.erase(std::remove_if(m_active.begin(), m_active.end(),
+                                      [this](const morph::ActiveWeight &_a) { return !m_targetUploaded[_a.m_target]; }),
+                       m_active.end());
+      }
+      if (m_library)
+      {
+        morph::ScopedTimer timer(m_profiler, "pose streaming");
+        streamActive();
+      }
+      packMorphUniforms();
+    }
+    {
+      morph::ScopedTimer timer(m_profiler, "uniforms");
+      // one copy of the matrices and weights a frame, everything drawn or dispatched below reads it
+      if (acquireFrameUniforms(true))
+      {
+        submitFrameUniforms();
+      }
+      loadSettingsToShader();
+    }
+    if (m_dirty & (DIRTY_WEIGHTS | DIRTY_NORMAL_MODE))
+    {
+      morph::ScopedTimer timer(m_profiler, "normals");
+      updateNormals(m_active);
+    }
+    if (m_skinInfluences > 0 && (m_dirty & DIRTY_SKIN_POSE))
+    {
+      morph::ScopedTimer timer(m_profiler, "skin palette");
+      updateSkin();
+    }
+    morph::ScopedTimer timer(m_profiler, "draw");
+    // draw the mesh
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_BUFFER, m_deltaTexture);
+    if (m_deltaFormat != morph::DeltaFormat::FLOAT32)
+    {
+      glActiveTexture(GL_TEXTURE1);
+      glBindTexture(GL_TEXTURE_BUFFER, m_normalTexture);
+    }
+    if (m_normalMode != NormalMode::BLEND)
+    {
+      glActiveTexture(GL_TEXTURE2);
+      glBindTexture(GL_TEXTURE_BUFFER, m_recomputedNormalTexture);
+    }
+    if (m_skinInfluences > 0)
+    {
+      glActiveTexture(GL_TEXTURE6);
+      glBindTexture(GL_TEXTURE_BUFFER, m_skinPaletteTexture);
+      glActiveTexture(GL_TEXTURE7);
+      glBindTexture(GL_TEXTURE_BUFFER, m_skinJointTexture);
+      glActiveTexture(GL_TEXTURE8);
+      glBindTexture(GL_TEXTURE_BUFFER, m_skinWeightTexture);
+    }
+    // ngl::Text expects unit 0 to be active
+    glActiveTexture(GL_TEXTURE0);
+    if (!m_morphReady)
+    {
+      ngl::ShaderLib::use("PerFragADSStatic");
+      m_vaoMesh->bind();
+      m_vaoMesh->draw();
+      m_vaoMesh->unbind();
+    }
+    else if (m_morphPath == MorphPath::FEEDBACK)
+    {
+      // the blend only reruns when its inputs change, a camera move just redraws the captured mesh
+      if (m_dirty & (DIRTY_WEIGHTS | DIRTY_NORMAL_MODE | DIRTY_MORPH_PATH))
+      {
+        morph::ScopedTimer prepassTimer(m_profiler, "morph pre-pass");
+        runMorphFeedback();
+      }
+      ngl::ShaderLib::use("PerFragADSStatic");
+      m_vaoMorphed->bind();
+      m_vaoMorphed->draw();
+      m_vaoMorphed->unbind();
+    }
+    else
+    {
+      ngl::ShaderLib::use("PerFragADS");
+      m_vaoMesh->bind();
+      m_vaoMesh->draw();
+      m_vaoMesh->unbind();
+    }
+    if (m_library)
+    {
+      // finished loads are picked up and anything over budget not drawn this frame is evicted
+      m_library->update();
+    }
+  }
+  if (m_frameData != nullptr)
+  {
+    // the region isn't handed out again until the GPU has finished the draws that read it
+    m_frameRing.fence();
+    m_frameData = nullptr;
+  }
+  endGpuTimer();
+  m_dirty = DIRTY_NONE;
+  // the font is the last thing the background load creates
+  if (m_text)
+  {
+    morph::ScopedTimer overlayTimer(m_profiler, "overlay");
+    drawOverlay();
+  }
+  m_paintEnd = m_profiler.now();
+}
+
+void NGLScene::drawOverlay()
+{
+  m_text->setColour(1.0f, 1.0f, 1.0f);
+
+  m_text->renderText(10, 700, fmt::format("Q-W change Pose one weight {:0.2f}", m_weights[0]));
+  m_text->renderText(10, 680, fmt::format("A-S change Pose two weight {:0.2f}", m_weights[1]));
+  static const char *modeNames[] = {"blended", "recomputed on the CPU", "recomputed on the GPU"};
+  m_text->renderText(10, 660, fmt::format("R normals {}", modeNames[static_cast<int>(m_normalMode)]));
+  if (m_crowdSize == 0)
+  {
+    m_text->renderText(10, 640, fmt::format("M morph {}", m_morphPath == MorphPath::SHADER
+                                                            ? "in the vertex shader"
+                                                            : "in a transform feedback pre-pass"));
+  }
+  // the optional status lines go above the profile stats
+  int y = 620;
+  if (m_skinInfluences > 0)
+  {
+    m_text->renderText(10, y, fmt::format("K skin {} {} joints {} influences",
+                                          m_skinMethod == morph::SkinMethod::LINEAR ? "linear blend" : "dual quaternion",
+                                          m_skeleton.numJoints(), m_skinInfluences));
+    y -= 20;
+  }
+  if (m_crowdSize > 0 && m_showProfile)
+  {
+    m_text->renderText(10, 640, fmt::format("crowd {} instances {:.2f} ms/frame", m_crowd.size(), m_crowdFrameMs));
+    if (!m_lodDraws.empty())
+    {
+      std::string counts;
+      size_t triangles = 0;
+      for (const auto &d : m_lodDraws)
+      {
+        counts += fmt::format(" {}", d.m_instanceCount);
+        triangles += d.m_instanceCount * d.m_numIndices / 3;
+      }
+      m_text->renderText(10, y, fmt::format("lod instances{} {} triangles", counts, triangles));
+      y -= 20;
+    }
+  }
+  if (m_library && m_showProfile)
+  {
+    const auto &stats = m_library->stats();
+    m_text->renderText(10, y, fmt::format("poses {}/{} in memory {:.1f}/{:.1f} MB {}/{} on the GPU {} loads {} evictions",
+                                          m_library->numResident(), m_library->numTargets(),
+                                          m_library->residentBytes() / (1024.0 * 1024.0),
+                                          m_library->budget() / (1024.0 * 1024.0), m_gpuSlots.numUsed(),
+                                          m_gpuSlots.numSlots(), stats.m_loads, stats.m_evictions + m_gpuSlots.evictions()));
+    y -= 20;
+  }
+  if (m_loadStep != LoadStep::DONE)
+  {
+    m_text->renderText(10, y, fmt::format("loading targets {}/{}", m_numTargetsUploaded, m_targetUploaded.size()));
+    y -= 20;
+  }
+  if (m_showProfile)
+  {
+    drawProfileOverlay(y);
+  }
+}
+
+void NGLScene::beginGpuTimer()
+{
+  const size_t slot = m_gpuQueryFrame % NUM_GPU_QUERIES;
+  // a query that still hasn't finished is dropped rather than waited for
+  m_gpuQueryPending[slot] = false;
+  m_gpuQueryStart[slot] = m_profiler.now();
+  glBeginQuery(GL_TIME_ELAPSED, m_gpuQueries[slot]);
+}
+
+void NGLScene::endGpuTimer()
+{
+  glEndQuery(GL_TIME_ELAPSED);
+  m_gpuQueryPending[m_gpuQueryFrame % NUM_GPU_QUERIES] = true;
+  ++m_gpuQueryFrame;
+}
+
+void NGLScene::readGpuTimers()
+{
+  // oldest first so the GPU track stays in order
+  for (size_t i = 0; i < NUM_GPU_QUERIES; ++i)
+  {
+    const size_t slot = (m_gpuQueryFrame + i) % NUM_GPU_QUERIES;
+    if (!m_gpuQueryPending[slot])
+    {
+      continue;
+    }
+    GLint available = 0;
+    glGetQueryObjectiv(m_gpuQueries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available)
+    {
+      continue;
+    }
+    GLuint64 nanoseconds = 0;
+    glGetQueryObjectui64v(m_gpuQueries[slot], GL_QUERY_RESULT, &nanoseconds);
+    // the GPU has no shared clock with the CPU so the event is placed where the frame was submitted
+    m_profiler.record("gpu frame", m_gpuQueryStart[slot], nanoseconds * 0.001, morph::Profiler::GPU);
+    m_gpuQueryPending[slot] = false;
+  }
+}
+
+void NGLScene::drawProfileOverlay(int _y)
+{
+  // the stats of the last 240 frames drawn, frames are only drawn when something changes
+  int y = _y;
+  auto statLine = [&](const char *_label, const morph::RollingStats *_stats)
+  {
+    if (_stats != nullptr && _stats->count() > 0)
+    {
+      m_text->renderText(10, y, fmt::format("{} {:.2f} ms min {:.2f} p99 {:.2f}", _label, _stats->average(),
+                                            _stats->min(), _stats->percentile(0.99)));
+      y -= 20;
+    }
+  };
+  m_text->setColour(1.0f, 1.0f, 0.0f);
+  statLine("P frame cpu", m_profiler.findStage("frame"));
+  statLine("gpu", m_profiler.findStage("gpu frame", morph::Profiler::GPU));
+  statLine("swap", m_profiler.findStage("swap"));
+  if (auto load = m_profiler.findStage("load"))
+  {
+    // a background load also has the time until the base was first drawn
+    const auto *base = m_profiler.findStage("load base");
+    m_text->renderText(10, y, base != nullptr ? fmt::format("load {:.1f} ms base {:.1f} ms", load->last(), base->last())
+                                              : fmt::format("load {:.1f} ms", load->last()));
+    y -= 20;
+  }
+  for (size_t i = 0; i < m_profiler.numStages(); ++i)
+  {
+    const char *name = m_profiler.stageName(i);
+    const auto &stats = m_profiler.stageStats(i);
+    // the lines above and the one off load stages aren't shown per stage
+    if (std::strcmp(name, "frame") == 0 || std::strcmp(name, "swap") == 0 ||
+        m_profiler.stageTrack(i) == morph::Profiler::GPU || std::strncmp(name, "load", 4) == 0)
+    {
+      continue;
+    }
+    m_text->renderText(20, y, fmt::format("{} {:.3f} ms p99 {:.3f}", name, stats.average(), stats.percentile(0.99)));
+    y -= 20;
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void NGLScene::keyPressEvent(QKeyEvent *_event)
+{
+  // this method is called every time the main window recives a key event.
+  // we then switch on the key value and set the camera in the GLWindow
+  switch (_event->key())
+  {
+  // escape key to quite
+  case Qt::Key_Escape:
+    QGuiApplication::exit(EXIT_SUCCESS);
+    break;
+  // show full screen
+  case Qt::Key_F:
+    showFullScreen();
+    break;
+  // show windowed
+  case Qt::Key_N:
+    showNormal();
+    break;
+  case Qt::Key_Q:
+    changeWeight(0, Direction::DOWN);
+    break;
+  case Qt::Key_W:
+    changeWeight(0, Direction::UP);
+    break;
+
+  case Qt::Key_A:
+    changeWeight(1, Direction::DOWN);
+    break;
+  case Qt::Key_S:
+    changeWeight(1, Direction::UP);
+    break;
+  case Qt::Key_Space:
+    toggleAnimation();
+    break;
+  case Qt::Key_Z:
+    punchLeft();
+    break;
+  case Qt::Key_X:
+    punchRight();
+    break;
+  case Qt::Key_R:
+    cycleNormalMode();
+    break;
+  case Qt::Key_M:
+    toggleMorphPath();
+    break;
+  case Qt::Key_K:
+    toggleSkinMethod();
+    break;
+  case Qt::Key_P:
+    m_showProfile ^= true;
+    update();
+    break;
+
+  default:
+    break;
+  }
+  // the cases above ask for a redraw themselves (markDirty) only when something they change is visible
 }
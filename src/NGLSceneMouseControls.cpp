@@ -16,11 +16,17 @@ void NGLScene::mouseMoveEvent(QMouseEvent *_event)
   {
     int diffx = position.x() - m_win.origX;
     int diffy = position.y() - m_win.origY;
-    m_win.spinXFace += static_cast<int>(0.5f * diffy);
-    m_win.spinYFace += static_cast<int>(0.5f * diffx);
+    const int spinX = m_win.spinXFace + static_cast<int>(0.5f * diffy);
+    const int spinY = m_win.spinYFace + static_cast<int>(0.5f * diffx);
     m_win.origX = position.x();
     m_win.origY = position.y();
-    update();
+    // small moves round to no rotation at all
+    if (spinX != m_win.spinXFace || spinY != m_win.spinYFace)
+    {
+      m_win.spinXFace = spinX;
+      m_win.spinYFace = spinY;
+      markDirty(DIRTY_TRANSFORM);
+    }
   }
   // right mouse translate code
   else if (m_win.translate && _event->buttons() == Qt::RightButton)
@@ -31,7 +37,10 @@ void NGLScene::mouseMoveEvent(QMouseEvent *_event)
     m_win.origYPos = position.y();
     m_modelPos.m_x += INCREMENT * diffX;
     m_modelPos.m_y -= INCREMENT * diffY;
-    update();
+    if (diffX != 0 || diffY != 0)
+    {
+      markDirty(DIRTY_TRANSFORM);
+    }
   }
 }
 
@@ -91,5 +100,9 @@ void NGLScene::wheelEvent(QWheelEvent *_event)
   {
     m_modelPos.m_z -= ZOOM;
   }
-  update();
+  else
+  {
+    return;
+  }
+  markDirty(DIRTY_TRANSFORM);
 }
@@ -0,0 +1,148 @@
+#include "NormalRecompute.h"
+#include <algorithm>
+
+namespace morph
+{
+namespace
+{
+// faces / vertices per parallelFor job
+constexpr size_t c_grain = 8192;
+// above this fraction of the mesh an incremental update costs more than just doing everything
+constexpr float c_fullRecomputeFraction = 0.5f;
+
+void forRange(ThreadPool *_pool, size_t _count, const std::function<void(size_t, size_t)> &_func)
+{
+  if (_pool != nullptr)
+  {
+    _pool->parallelFor(0, _count, c_grain, _func);
+  }
+  else
+  {
+    _func(0, _count);
+  }
+}
+} // end anonymous namespace
+
+void NormalRecompute::build(const std::vector<uint32_t> &_indices, size_t _numVertices)
+{
+  m_indices = _indices;
+  // count the faces on each vertex then turn the counts into offsets
+  m_offsets.assign(_numVertices + 1, 0);
+  for (auto i : m_indices)
+  {
+    ++m_offsets[i + 1];
+  }
+  for (size_t v = 0; v < _numVertices; ++v)
+  {
+    m_offsets[v + 1] += m_offsets[v];
+  }
+  m_faces.resize(m_indices.size());
+  std::vector<uint32_t> fill(m_offsets.begin(), m_offsets.end() - 1);
+  for (size_t i = 0; i < m_indices.size(); ++i)
+  {
+    m_faces[fill[m_indices[i]]++] = static_cast<uint32_t>(i / 3);
+  }
+  m_faceNormals.assign(numFaces(), Vec3());
+  m_faceMark.assign(numFaces(), 0);
+  m_vertexMark.assign(_numVertices, 0);
+  m_dirtyFaces.clear();
+  m_dirtyVertices.clear();
+  m_lastRegionSize = 0;
+}
+
+void NormalRecompute::faceNormals(const uint32_t *_faces, size_t _count, const std::vector<Vec3> &_positions, ThreadPool *_pool)
+{
+  forRange(_pool, _count, [&](size_t _begin, size_t _end)
+           {
+             for (size_t i = _begin; i < _end; ++i)
+             {
+               const size_t f = _faces ? _faces[i] : i;
+               const auto &p0 = _positions[m_indices[f * 3]];
+               const auto &p1 = _positions[m_indices[f * 3 + 1]];
+               const auto &p2 = _positions[m_indices[f * 3 + 2]];
+               // not normalized so bigger faces count for more
+               m_faceNormals[f] = (p1 - p0).cross(p2 - p0);
+             }
+           });
+}
+
+void NormalRecompute::gather(const uint32_t *_vertices, size_t _count, std::vector<Vec3> &io_normals, ThreadPool *_pool) const
+{
+  forRange(_pool, _count, [&](size_t _begin, size_t _end)
+           {
+             for (size_t i = _begin; i < _end; ++i)
+             {
+               const size_t v = _vertices ? _vertices[i] : i;
+               Vec3 n;
+               for (uint32_t a = m_offsets[v]; a < m_offsets[v + 1]; ++a)
+               {
+                 n += m_faceNormals[m_faces[a]];
+               }
+               if (n.dot(n) > 0.0f)
+               {
+                 io_normals[v] = n.normalized();
+               }
+             }
+           });
+}
+
+void NormalRecompute::recompute(const std::vector<Vec3> &_positions, std::vector<Vec3> &o_normals, ThreadPool *_pool)
+{
+  o_normals.resize(numVertices());
+  faceNormals(nullptr, numFaces(), _positions, _pool);
+  gather(nullptr, numVertices(), o_normals, _pool);
+}
+
+void NormalRecompute::recompute(const std::vector<uint32_t> &_changed, const std::vector<Vec3> &_positions,
+                                std::vector<Vec3> &io_normals, ThreadPool *_pool)
+{
+  m_dirtyFaces.clear();
+  m_dirtyVertices.clear();
+  // every changed vertex is in the region so this many can go straight to the full pass without walking anything
+  const auto limit = static_cast<size_t>(c_fullRecomputeFraction * numVertices());
+  bool full = _changed.size() > limit;
+  // every face touching a moved vertex changes and so does every vertex of those faces, marked in one pass so
+  // it can stop as soon as the region is too big rather than after walking all of it
+  for (size_t i = 0; i < _changed.size() && !full; ++i)
+  {
+    const auto v = _changed[i];
+    for (uint32_t a = m_offsets[v]; a < m_offsets[v + 1]; ++a)
+    {
+      const auto f = m_faces[a];
+      if (m_faceMark[f])
+      {
+        continue;
+      }
+      m_faceMark[f] = 1;
+      m_dirtyFaces.push_back(f);
+      for (unsigned int j = 0; j < 3; ++j)
+      {
+        const auto u = m_indices[f * 3 + j];
+        if (!m_vertexMark[u])
+        {
+          m_vertexMark[u] = 1;
+          m_dirtyVertices.push_back(u);
+        }
+      }
+    }
+    full = m_dirtyVertices.size() > limit;
+  }
+  for (auto f : m_dirtyFaces)
+  {
+    m_faceMark[f] = 0;
+  }
+  for (auto v : m_dirtyVertices)
+  {
+    m_vertexMark[v] = 0;
+  }
+  m_lastRegionSize = full ? numVertices() : m_dirtyVertices.size();
+  if (full)
+  {
+    recompute(_positions, io_normals, _pool);
+    return;
+  }
+  faceNormals(m_dirtyFaces.data(), m_dirtyFaces.size(), _positions, _pool);
+  gather(m_dirtyVertices.data(), m_dirtyVertices.size(), io_normals, _pool);
+}
+
+} // end namespace morph
@@ -0,0 +1,382 @@
+#include "ObjReader.h"
+#include "MappedFile.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+namespace morph
+{
+namespace
+{
+// aim for chunks of about this many bytes, big enough that the per chunk overhead doesn't matter
+constexpr size_t c_chunkSize = 256 * 1024;
+// a face index that can never be in range
+constexpr uint32_t c_badIndex = ~0u;
+
+// a corner that used a negative (relative) index, these can only be resolved once we know how many
+// vertices / normals the earlier chunks hold
+struct Fixup
+{
+  size_t m_face;
+  unsigned int m_corner;
+  bool m_isNormal;
+  // count in this chunk + the negative index, may be negative if it points into an earlier chunk
+  int64_t m_relative;
+};
+
+struct Chunk
+{
+  std::vector<Vec3> m_verts;
+  std::vector<Vec3> m_normals;
+  std::vector<Face> m_faces;
+  std::vector<Fixup> m_fixups;
+  bool m_ok = true;
+};
+
+inline bool isSpace(char _c)
+{
+  return _c == ' ' || _c == '\t' || _c == '\r';
+}
+
+const char *parseFloat(const char *_p, const char *_end, float &o_value)
+{
+  while (_p < _end && isSpace(*_p))
+  {
+    ++_p;
+  }
+  if (_p < _end && *_p == '+')
+  {
+    ++_p;
+  }
+#if defined(__cpp_lib_to_chars)
+  auto result = std::from_chars(_p, _end, o_value);
+  if (result.ec != std::errc())
+  {
+    return nullptr;
+  }
+  return result.ptr;
+#else
+  // no floating point from_chars (older libc++) so copy the token so strtof can't run off the mapping
+  char buffer[64];
+  size_t len = 0;
+  while (_p + len < _end && len < sizeof(buffer) - 1 && !isSpace(_p[len]) && _p[len] != '\n')
+  {
+    buffer[len] = _p[len];
+    ++len;
+  }
+  buffer[len] = '\0';
+  char *end;
+  o_value = std::strtof(buffer, &end);
+  if (end == buffer)
+  {
+    return nullptr;
+  }
+  return _p + (end - buffer);
+#endif
+}
+
+// parse a possibly negative integer, returns nullptr if there are no digits
+const char *parseInt(const char *_p, const char *_end, int64_t &o_value)
+{
+  bool negative = false;
+  if (_p < _end && *_p == '-')
+  {
+    negative = true;
+    ++_p;
+  }
+  const char *start = _p;
+  int64_t value = 0;
+  while (_p < _end && *_p >= '0' && *_p <= '9')
+  {
+    value = value * 10 + (*_p - '0');
+    ++_p;
+  }
+  if (_p == start)
+  {
+    return nullptr;
+  }
+  o_value = negative ? -value : value;
+  return _p;
+}
+
+const char *parseVec3(const char *_p, const char *_end, Vec3 &o_v)
+{
+  _p = parseFloat(_p, _end, o_v.m_x);
+  _p = _p ? parseFloat(_p, _end, o_v.m_y) : nullptr;
+  return _p ? parseFloat(_p, _end, o_v.m_z) : nullptr;
+}
+
+// parse a face line (after the "f") and triangulate it as a fan
+bool parseFace(const char *_p, const char *_end, Chunk &io_chunk)
+{
+  // faces with more than this many sides are very unlikely so they are treated as a parse error
+  constexpr size_t c_maxCorners = 64;
+  int64_t verts[c_maxCorners];
+  int64_t norms[c_maxCorners];
+  bool hasNorm[c_maxCorners];
+  size_t count = 0;
+  while (_p < _end)
+  {
+    while (_p < _end && isSpace(*_p))
+    {
+      ++_p;
+    }
+    if (_p == _end)
+    {
+      break;
+    }
+    int64_t v, n = 0;
+    bool normal = false;
+    if (!(_p = parseInt(_p, _end, v)))
+    {
+      return false;
+    }
+    if (_p < _end && *_p == '/')
+    {
+      ++_p;
+      // skip the texture coordinate
+      int64_t uv;
+      if (_p < _end && *_p != '/')
+      {
+        if (!(_p = parseInt(_p, _end, uv)))
+        {
+          return false;
+        }
+      }
+      if (_p < _end && *_p == '/')
+      {
+        ++_p;
+        if (!(_p = parseInt(_p, _end, n)))
+        {
+          return false;
+        }
+        normal = true;
+      }
+    }
+    if (count == c_maxCorners)
+    {
+      return false;
+    }
+    verts[count] = v;
+    norms[count] = n;
+    hasNorm[count] = normal;
+    ++count;
+  }
+
+  // an index that can't be valid is set to c_badIndex so readObj reports it with the other out of range indices
+  auto resolve = [&io_chunk](int64_t _index, bool _given, int64_t _localCount, bool _isNormal, unsigned int _corner) -> uint32_t
+  {
+    if (_index > 0)
+    {
+      return static_cast<uint32_t>(_index - 1);
+    }
+    if (_index == 0)
+    {
+      // faces without normals use normal 0, readObj rejects files with no normals at all. An index written as 0
+      // is an error as obj indices start at 1
+      return _isNormal && !_given ? 0 : c_badIndex;
+    }
+    io_chunk.m_fixups.push_back({io_chunk.m_faces.size(), _corner, _isNormal, _localCount + _index});
+    return 0;
+  };
+  const auto nv = static_cast<int64_t>(io_chunk.m_verts.size());
+  const auto nn = static_cast<int64_t>(io_chunk.m_normals.size());
+  for (size_t i = 2; i < count; ++i)
+  {
+    const size_t corners[3] = {0, i - 1, i};
+    Face f;
+    for (unsigned int j = 0; j < 3; ++j)
+    {
+      f.m_vert[j] = resolve(verts[corners[j]], true, nv, false, j);
+      f.m_norm[j] = resolve(norms[corners[j]], hasNorm[corners[j]], nn, true, j);
+    }
+    io_chunk.m_faces.push_back(f);
+  }
+  return count >= 3;
+}
+
+void parseChunk(const char *_p, const char *_end, Chunk &o_chunk)
+{
+  while (_p < _end)
+  {
+    const char *eol = static_cast<const char *>(std::memchr(_p, '\n', static_cast<size_t>(_end - _p)));
+    if (eol == nullptr)
+    {
+      eol = _end;
+    }
+    if (_p[0] == 'v' && _p + 1 < eol && _p[1] == ' ')
+    {
+      Vec3 v;
+      if (!parseVec3(_p + 2, eol, v))
+      {
+        o_chunk.m_ok = false;
+        return;
+      }
+      o_chunk.m_verts.push_back(v);
+    }
+    else if (_p[0] == 'v' && _p + 2 < eol && _p[1] == 'n' && _p[2] == ' ')
+    {
+      Vec3 n;
+      if (!parseVec3(_p + 3, eol, n))
+      {
+        o_chunk.m_ok = false;
+        return;
+      }
+      o_chunk.m_normals.push_back(n);
+    }
+    else if (_p[0] == 'f' && _p + 1 < eol && _p[1] == ' ')
+    {
+      if (!parseFace(_p + 2, eol, o_chunk))
+      {
+        o_chunk.m_ok = false;
+        return;
+      }
+    }
+    _p = eol + 1;
+  }
+}
+
+} // end anonymous namespace
+
+bool readObj(const std::string &_fname, PoseData &o_pose, ObjReadStats *o_stats)
+{
+  auto start = std::chrono::steady_clock::now();
+  MappedFile file;
+  if (!file.open(_fname))
+  {
+    std::cerr << "readObj unable to open " << _fname << '\n';
+    return false;
+  }
+  const char *data = file.data();
+  const size_t size = file.size();
+  // split into chunks that start at the beginning of a line
+  std::vector<size_t> splits = {0};
+  for (size_t pos = c_chunkSize; pos < size; pos += c_chunkSize)
+  {
+    auto eol = static_cast<const char *>(std::memchr(data + pos, '\n', size - pos));
+    if (eol == nullptr)
+    {
+      break;
+    }
+    pos = static_cast<size_t>(eol - data) + 1;
+    if (pos >= size)
+    {
+      break;
+    }
+    splits.push_back(pos);
+  }
+  splits.push_back(size);
+  std::vector<Chunk> chunks(splits.size() - 1);
+  ThreadPool::global().parallelFor(0, chunks.size(), 1, [&](size_t _begin, size_t _end)
+                                   {
+                                     for (size_t c = _begin; c < _end; ++c)
+                                     {
+                                       parseChunk(data + splits[c], data + splits[c + 1], chunks[c]);
+                                     }
+                                   });
+
+  // stitch the chunks back together in file order
+  size_t numVerts = 0, numNormals = 0, numFaces = 0;
+  for (const auto &c : chunks)
+  {
+    if (!c.m_ok)
+    {
+      std::cerr << "readObj parse error in " << _fname << '\n';
+      return false;
+    }
+    numVerts += c.m_verts.size();
+    numNormals += c.m_normals.size();
+    numFaces += c.m_faces.size();
+  }
+  if (chunks.size() == 1)
+  {
+    // a small file is one chunk already in file order, with no earlier chunks the relative indices resolve
+    // against 0 below so the arrays can be moved into the pose rather than copied
+    o_pose.m_verts = std::move(chunks[0].m_verts);
+    o_pose.m_normals = std::move(chunks[0].m_normals);
+    o_pose.m_faces = std::move(chunks[0].m_faces);
+  }
+  else
+  {
+    o_pose.m_verts.resize(numVerts);
+    o_pose.m_normals.resize(numNormals);
+    o_pose.m_faces.resize(numFaces);
+  }
+  size_t vertOffset = 0, normalOffset = 0, faceOffset = 0;
+  for (const auto &c : chunks)
+  {
+    if (chunks.size() > 1)
+    {
+      std::copy(c.m_verts.begin(), c.m_verts.end(), o_pose.m_verts.begin() + vertOffset);
+      std::copy(c.m_normals.begin(), c.m_normals.end(), o_pose.m_normals.begin() + normalOffset);
+      std::copy(c.m_faces.begin(), c.m_faces.end(), o_pose.m_faces.begin() + faceOffset);
+    }
+    for (const auto &f : c.m_fixups)
+    {
+      auto base = static_cast<int64_t>(f.m_isNormal ? normalOffset : vertOffset);
+      // a relative index reaching back past the first vertex fails the range check below
+      const int64_t absolute = base + f.m_relative;
+      auto index = absolute < 0 ? c_badIndex : static_cast<uint32_t>(absolute);
+      auto &face = o_pose.m_faces[faceOffset + f.m_face];
+      (f.m_isNormal ? face.m_norm : face.m_vert)[f.m_corner] = index;
+    }
+    vertOffset += c.m_verts.size();
+    normalOffset += c.m_normals.size();
+    faceOffset += c.m_faces.size();
+  }
+
+  if (o_pose.m_normals.empty())
+  {
+    std::cerr << "readObj " << _fname << " has no normals\n";
+    return false;
+  }
+  for (const auto &f : o_pose.m_faces)
+  {
+    for (unsigned int j = 0; j < 3; ++j)
+    {
+      if (f.m_vert[j] >= numVerts || f.m_norm[j] >= numNormals)
+      {
+        std::cerr << "readObj face index out of range in " << _fname << '\n';
+        return false;
+      }
+    }
+  }
+  if (o_stats != nullptr)
+  {
+    o_stats->m_bytes = size;
+    o_stats->m_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  }
+  return true;
+}
+
+bool readObjs(const std::vector<std::string> &_fnames, std::vector<PoseData> &o_poses, ObjReadStats *o_stats)
+{
+  auto start = std::chrono::steady_clock::now();
+  o_poses.resize(_fnames.size());
+  std::vector<ObjReadStats> stats(_fnames.size());
+  std::vector<char> ok(_fnames.size(), 0);
+  // one file per job, each file then splits its own chunks across the pool as well
+  ThreadPool::global().parallelFor(0, _fnames.size(), 1, [&](size_t _begin, size_t _end)
+                                   {
+                                     for (size_t i = _begin; i < _end; ++i)
+                                     {
+                                       ok[i] = readObj(_fnames[i], o_poses[i], &stats[i]);
+                                     }
+                                   });
+  if (o_stats != nullptr)
+  {
+    o_stats->m_bytes = 0;
+    for (const auto &s : stats)
+    {
+      o_stats->m_bytes += s.m_bytes;
+    }
+    o_stats->m_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  }
+  return std::all_of(ok.begin(), ok.end(), [](char _ok) { return _ok != 0; });
+}
+
+} // end namespace morph
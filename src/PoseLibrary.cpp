@@ -0,0 +1,226 @@
+#include "PoseLibrary.h"
+#include "ObjReader.h"
+#include "PoseValidator.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <limits>
+#include <utility>
+
+namespace morph
+{
+void SlotCache::reset(size_t _numSlots, size_t _numKeys)
+{
+  m_keySlot.assign(_numKeys, c_noSlot);
+  m_slotKey.assign(_numSlots, std::numeric_limits<size_t>::max());
+  m_slotTick.assign(_numSlots, 0);
+  m_evictions = 0;
+}
+
+int SlotCache::acquire(size_t _key, uint64_t _tick, bool &o_fresh)
+{
+  o_fresh = false;
+  int slot = m_keySlot[_key];
+  if (slot == c_noSlot)
+  {
+    // an empty slot has tick 0 so it is always picked before any used one
+    size_t oldest = 0;
+    for (size_t s = 1; s < m_slotTick.size(); ++s)
+    {
+      if (m_slotTick[s] < m_slotTick[oldest])
+      {
+        oldest = s;
+      }
+    }
+    if (m_slotTick.empty() || m_slotTick[oldest] == _tick)
+    {
+      return c_noSlot;
+    }
+    if (m_slotKey[oldest] < m_keySlot.size())
+    {
+      m_keySlot[m_slotKey[oldest]] = c_noSlot;
+      ++m_evictions;
+    }
+    slot = static_cast<int>(oldest);
+    m_slotKey[oldest] = _key;
+    m_keySlot[_key] = slot;
+    o_fresh = true;
+  }
+  m_slotTick[static_cast<size_t>(slot)] = _tick;
+  return slot;
+}
+
+size_t SlotCache::numUsed() const noexcept
+{
+  return static_cast<size_t>(std::count_if(m_slotKey.begin(), m_slotKey.end(),
+                                           [this](size_t _key) { return _key < m_keySlot.size(); }));
+}
+
+PoseLibrary::~PoseLibrary()
+{
+  wait();
+}
+
+bool PoseLibrary::open(const std::vector<std::string> &_files, size_t _budget, ThreadPool *_pool)
+{
+  wait();
+  m_targets.clear();
+  m_residentBytes = 0;
+  m_stats = Stats();
+  if (_files.empty())
+  {
+    std::cerr << "PoseLibrary::open needs at least a base pose\n";
+    return false;
+  }
+  PoseData base;
+  if (!readObj(_files[0], base) || !m_base.build({&base, 1}, &m_corners))
+  {
+    std::cerr << "PoseLibrary::open unable to load the base pose " << _files[0] << '\n';
+    return false;
+  }
+  m_basePose = std::move(base);
+  m_targets.resize(_files.size() - 1);
+  for (size_t t = 0; t < m_targets.size(); ++t)
+  {
+    m_targets[t].m_file = _files[t + 1];
+  }
+  m_pool = _pool;
+  m_budget = _budget;
+  return true;
+}
+
+PoseLibrary::Loaded PoseLibrary::loadDeltas(const std::string &_file) const
+{
+  // this runs on the pool so it only reads the base data, which doesn't change until every load has finished
+  const auto start = std::chrono::steady_clock::now();
+  Loaded loaded;
+  PoseData pose;
+  if (!readObj(_file, pose))
+  {
+    std::cerr << "PoseLibrary unable to read " << _file << '\n';
+    return loaded;
+  }
+  auto validation = validatePose(m_basePose, pose);
+  if (!validation.usable())
+  {
+    std::cerr << "PoseLibrary " << _file << " doesn't match the base pose, " << validation.m_message << '\n';
+    return loaded;
+  }
+  if (validation.m_result == PoseMatch::REMAPPED)
+  {
+    applyRemap(m_basePose, pose, validation);
+  }
+  // the same differences MorphMesh::build takes, interleaved as packDeltas writes them
+  const auto &positions = m_base.basePositions();
+  const auto &normals = m_base.baseNormals();
+  loaded.m_deltas.resize(m_corners.size() * 2);
+  for (size_t v = 0; v < m_corners.size(); ++v)
+  {
+    loaded.m_deltas[v * 2] = pose.m_verts[m_corners[v].m_vert] - positions[v];
+    loaded.m_deltas[v * 2 + 1] = pose.m_normals[m_corners[v].m_norm] - normals[v];
+  }
+  loaded.m_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return loaded;
+}
+
+void PoseLibrary::finishLoad(Target &io_target, Loaded _loaded)
+{
+  m_stats.m_loadSeconds += _loaded.m_seconds;
+  if (_loaded.m_deltas.empty())
+  {
+    io_target.m_state = State::FAILED;
+    return;
+  }
+  io_target.m_deltas = std::move(_loaded.m_deltas);
+  io_target.m_state = State::RESIDENT;
+  m_residentBytes += targetBytes();
+  ++m_stats.m_loads;
+}
+
+const Vec3 *PoseLibrary::request(size_t _target)
+{
+  auto &target = m_targets[_target];
+  target.m_lastUse = m_tick;
+  if (target.m_state == State::RESIDENT)
+  {
+    ++m_stats.m_hits;
+    return target.m_deltas.data();
+  }
+  ++m_stats.m_misses;
+  if (target.m_state == State::UNLOADED)
+  {
+    target.m_state = State::LOADING;
+    const auto &file = target.m_file;
+    if (m_pool == nullptr)
+    {
+      finishLoad(target, loadDeltas(file));
+      return target.m_state == State::RESIDENT ? target.m_deltas.data() : nullptr;
+    }
+    target.m_pending = m_pool->submit([this, file]() { return loadDeltas(file); });
+  }
+  return nullptr;
+}
+
+void PoseLibrary::update()
+{
+  for (auto &t : m_targets)
+  {
+    if (t.m_state == State::LOADING && t.m_pending.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+    {
+      finishLoad(t, t.m_pending.get());
+    }
+  }
+  evict();
+  ++m_tick;
+}
+
+void PoseLibrary::wait()
+{
+  for (auto &t : m_targets)
+  {
+    if (t.m_state == State::LOADING)
+    {
+      finishLoad(t, t.m_pending.get());
+    }
+  }
+}
+
+void PoseLibrary::evict()
+{
+  while (m_residentBytes > m_budget)
+  {
+    // the library only ever holds a few targets over budget so a scan is cheaper than keeping a list ordered
+    Target *oldest = nullptr;
+    for (auto &t : m_targets)
+    {
+      if (t.m_state == State::RESIDENT && t.m_lastUse != m_tick && (oldest == nullptr || t.m_lastUse < oldest->m_lastUse))
+      {
+        oldest = &t;
+      }
+    }
+    if (oldest == nullptr)
+    {
+      // everything left is in use this tick
+      return;
+    }
+    // swap rather than clear so the memory really goes
+    std::vector<Vec3>().swap(oldest->m_deltas);
+    oldest->m_state = State::UNLOADED;
+    m_residentBytes -= targetBytes();
+    ++m_stats.m_evictions;
+  }
+}
+
+size_t PoseLibrary::numResident() const noexcept
+{
+  return static_cast<size_t>(std::count_if(m_targets.begin(), m_targets.end(),
+                                           [](const Target &_t) { return _t.m_state == State::RESIDENT; }));
+}
+
+size_t PoseLibrary::numLoading() const noexcept
+{
+  return static_cast<size_t>(std::count_if(m_targets.begin(), m_targets.end(),
+                                           [](const Target &_t) { return _t.m_state == State::LOADING; }));
+}
+
+} // end namespace morph
@@ -0,0 +1,483 @@
+#include "PoseValidator.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iostream>
+#include <unordered_map>
+
+namespace morph
+{
+namespace
+{
+constexpr uint32_t c_unset = ~0u;
+constexpr uint64_t c_fnvOffset = 14695981039346656037ull;
+constexpr uint64_t c_fnvPrime = 1099511628211ull;
+
+uint64_t mix(uint64_t _hash, uint64_t _value)
+{
+  return (_hash ^ _value) * c_fnvPrime;
+}
+
+// build a one to one map from base index to pose index, _pairs gives (base, pose) pairs that must agree
+// with each other. Indices that no face uses are paired up in order so the map is always a permutation
+template <typename Pairs>
+bool buildPermutation(size_t _size, Pairs &&_pairs, std::vector<uint32_t> &o_map)
+{
+  o_map.assign(_size, c_unset);
+  std::vector<uint32_t> reverse(_size, c_unset);
+  bool ok = _pairs([&](uint32_t _base, uint32_t _pose)
+                   {
+                     if (o_map[_base] == c_unset && reverse[_pose] == c_unset)
+                     {
+                       o_map[_base] = _pose;
+                       reverse[_pose] = _base;
+                       return true;
+                     }
+                     return o_map[_base] == _pose;
+                   });
+  if (!ok)
+  {
+    return false;
+  }
+  uint32_t freePose = 0;
+  for (auto &m : o_map)
+  {
+    if (m == c_unset)
+    {
+      while (reverse[freePose] != c_unset)
+      {
+        ++freePose;
+      }
+      m = freePose;
+      reverse[freePose] = 0;
+    }
+  }
+  return true;
+}
+
+uint64_t cornerKey(uint32_t _vert, uint32_t _norm)
+{
+  return (static_cast<uint64_t>(_vert) << 32) | _norm;
+}
+
+// the four vertices of two triangles that are the halves of a quad, sorted so two splits of the same quad give
+// the same vertices. False if the faces don't share exactly one edge
+bool quadVerts(const Face &_a, const Face &_b, std::array<uint32_t, 4> &o_verts)
+{
+  std::array<uint32_t, 6> all;
+  for (const auto &f : {_a, _b})
+  {
+    if (f.m_vert[0] == f.m_vert[1] || f.m_vert[1] == f.m_vert[2] || f.m_vert[0] == f.m_vert[2])
+    {
+      return false;
+    }
+  }
+  std::copy(_a.m_vert.begin(), _a.m_vert.end(), all.begin());
+  std::copy(_b.m_vert.begin(), _b.m_vert.end(), all.begin() + 3);
+  std::sort(all.begin(), all.end());
+  if (std::unique(all.begin(), all.end()) - all.begin() != 4)
+  {
+    return false;
+  }
+  std::copy(all.begin(), all.begin() + 4, o_verts.begin());
+  return true;
+}
+
+// as quadVerts but the (vertex, normal) corners, false if a vertex of the quad has two normals
+bool quadCorners(const Face &_a, const Face &_b, std::array<uint64_t, 4> &o_corners)
+{
+  std::array<uint32_t, 4> verts;
+  if (!quadVerts(_a, _b, verts))
+  {
+    return false;
+  }
+  std::array<uint64_t, 6> all;
+  for (unsigned int j = 0; j < 3; ++j)
+  {
+    all[j] = cornerKey(_a.m_vert[j], _a.m_norm[j]);
+    all[j + 3] = cornerKey(_b.m_vert[j], _b.m_norm[j]);
+  }
+  std::sort(all.begin(), all.end());
+  if (std::unique(all.begin(), all.end()) - all.begin() != 4)
+  {
+    return false;
+  }
+  std::copy(all.begin(), all.begin() + 4, o_corners.begin());
+  return true;
+}
+
+// the corner of _b that shares a vertex with each corner of _a, a renumbering keeps this but splitting the quad
+// along the other diagonal changes it
+std::array<int, 3> sharedCorners(const Face &_a, const Face &_b)
+{
+  std::array<int, 3> shared = {{-1, -1, -1}};
+  for (unsigned int i = 0; i < 3; ++i)
+  {
+    for (unsigned int j = 0; j < 3; ++j)
+    {
+      if (_a.m_vert[i] == _b.m_vert[j])
+      {
+        shared[i] = static_cast<int>(j);
+      }
+    }
+  }
+  return shared;
+}
+
+// true if every face whose vertices differ from the base is half of a quad that the pose splits along the other
+// diagonal, the quad being the face and the face before or after it. Faces that keep their vertices (or their
+// quad) but use other normal indices are counted in o_normalFaces
+bool onlyResplitQuads(const PoseData &_base, const PoseData &_pose, size_t &o_normalFaces)
+{
+  const auto &bf = _base.m_faces;
+  const auto &pf = _pose.m_faces;
+  auto vertsDiffer = [&](size_t _f) { return bf[_f].m_vert != pf[_f].m_vert; };
+  auto sameQuad = [&](size_t _f, size_t _g)
+  {
+    std::array<uint32_t, 4> baseVerts, poseVerts;
+    return vertsDiffer(_g) && quadVerts(bf[_f], bf[_g], baseVerts) && quadVerts(pf[_f], pf[_g], poseVerts) &&
+           baseVerts == poseVerts;
+  };
+  auto sameCorners = [&](size_t _f, size_t _g)
+  {
+    std::array<uint64_t, 4> baseCorners, poseCorners;
+    return quadCorners(bf[_f], bf[_g], baseCorners) && quadCorners(pf[_f], pf[_g], poseCorners) &&
+           baseCorners == poseCorners;
+  };
+  o_normalFaces = 0;
+  for (size_t f = 0; f < bf.size(); ++f)
+  {
+    if (!vertsDiffer(f))
+    {
+      o_normalFaces += bf[f].m_norm != pf[f].m_norm;
+      continue;
+    }
+    size_t g = bf.size();
+    if (f > 0 && sameQuad(f, f - 1))
+    {
+      g = f - 1;
+    }
+    else if (f + 1 < bf.size() && sameQuad(f, f + 1))
+    {
+      g = f + 1;
+    }
+    if (g == bf.size())
+    {
+      return false;
+    }
+    o_normalFaces += !sameCorners(f, g);
+  }
+  return true;
+}
+
+// the pose has the same face order as the base but the vertices / normals are numbered differently
+bool topologicalRemap(const PoseData &_base, const PoseData &_pose, PoseValidation &io_result)
+{
+  const auto &bf = _base.m_faces;
+  const auto &pf = _pose.m_faces;
+  // quads split along the other diagonal don't line up corner for corner, they are left out of the permutation
+  // and checked once the rest of the mesh has fixed their vertices
+  std::vector<size_t> resplit;
+  std::vector<char> skip(bf.size(), 0);
+  std::array<uint64_t, 4> corners;
+  for (size_t f = 0; f + 1 < bf.size(); ++f)
+  {
+    if (sharedCorners(bf[f], bf[f + 1]) != sharedCorners(pf[f], pf[f + 1]) &&
+        quadCorners(bf[f], bf[f + 1], corners) && quadCorners(pf[f], pf[f + 1], corners))
+    {
+      resplit.push_back(f);
+      skip[f] = skip[f + 1] = 1;
+    }
+  }
+  auto pairs = [&](bool _normals)
+  {
+    return [&, _normals](auto &&_pair)
+    {
+      for (size_t f = 0; f < bf.size(); ++f)
+      {
+        if (skip[f])
+        {
+          continue;
+        }
+        for (unsigned int j = 0; j < 3; ++j)
+        {
+          const auto &b = _normals ? bf[f].m_norm : bf[f].m_vert;
+          const auto &p = _normals ? pf[f].m_norm : pf[f].m_vert;
+          if (!_pair(b[j], p[j]))
+          {
+            return false;
+          }
+        }
+      }
+      return true;
+    };
+  };
+  if (!buildPermutation(_base.m_verts.size(), pairs(false), io_result.m_vertRemap) ||
+      !buildPermutation(_base.m_normals.size(), pairs(true), io_result.m_normRemap))
+  {
+    return false;
+  }
+  const auto &vertRemap = io_result.m_vertRemap;
+  const auto &normRemap = io_result.m_normRemap;
+  std::vector<char> covered(bf.size(), 0);
+  for (auto f : resplit)
+  {
+    std::array<uint64_t, 4> baseCorners, poseCorners;
+    quadCorners(bf[f], bf[f + 1], baseCorners);
+    quadCorners(pf[f], pf[f + 1], poseCorners);
+    for (auto &c : baseCorners)
+    {
+      c = cornerKey(vertRemap[c >> 32], normRemap[c & 0xffffffffu]);
+    }
+    std::sort(baseCorners.begin(), baseCorners.end());
+    if (baseCorners == poseCorners)
+    {
+      covered[f] = covered[f + 1] = 1;
+    }
+  }
+  // a skipped face that isn't half of a re-split quad must still match corner for corner
+  for (size_t f = 0; f < bf.size(); ++f)
+  {
+    if (!skip[f] || covered[f])
+    {
+      continue;
+    }
+    for (unsigned int j = 0; j < 3; ++j)
+    {
+      if (vertRemap[bf[f].m_vert[j]] != pf[f].m_vert[j] || normRemap[bf[f].m_norm[j]] != pf[f].m_norm[j])
+      {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// match each pose vertex to the closest base vertex within the tolerance using a hash grid, then use the
+// faces to line up the normals
+bool spatialRemap(const PoseData &_base, const PoseData &_pose, float _tolerance, PoseValidation &io_result)
+{
+  const float cell = std::max(_tolerance, 1e-12f);
+  auto cellKey = [cell](int64_t _x, int64_t _y, int64_t _z)
+  {
+    return mix(mix(mix(c_fnvOffset, static_cast<uint64_t>(_x)), static_cast<uint64_t>(_y)), static_cast<uint64_t>(_z));
+  };
+  auto cellOf = [cell](float _v) { return static_cast<int64_t>(std::floor(_v / cell)); };
+  std::unordered_multimap<uint64_t, uint32_t> grid;
+  grid.reserve(_base.m_verts.size());
+  for (uint32_t i = 0; i < _base.m_verts.size(); ++i)
+  {
+    const auto &v = _base.m_verts[i];
+    grid.emplace(cellKey(cellOf(v.m_x), cellOf(v.m_y), cellOf(v.m_z)), i);
+  }
+  const float tol2 = _tolerance * _tolerance;
+  auto vertPairs = [&](auto &&_pair)
+  {
+    for (uint32_t p = 0; p < _pose.m_verts.size(); ++p)
+    {
+      const auto &v = _pose.m_verts[p];
+      auto cx = cellOf(v.m_x), cy = cellOf(v.m_y), cz = cellOf(v.m_z);
+      uint32_t best = c_unset;
+      float bestDist = tol2;
+      for (int64_t x = cx - 1; x <= cx + 1; ++x)
+        for (int64_t y = cy - 1; y <= cy + 1; ++y)
+          for (int64_t z = cz - 1; z <= cz + 1; ++z)
+          {
+            auto range = grid.equal_range(cellKey(x, y, z));
+            for (auto it = range.first; it != range.second; ++it)
+            {
+              auto d = _base.m_verts[it->second] - v;
+              float dist = d.m_x * d.m_x + d.m_y * d.m_y + d.m_z * d.m_z;
+              if (dist <= bestDist)
+              {
+                bestDist = dist;
+                best = it->second;
+              }
+            }
+          }
+      if (best == c_unset || !_pair(best, p))
+      {
+        return false;
+      }
+    }
+    return true;
+  };
+  if (!buildPermutation(_base.m_verts.size(), vertPairs, io_result.m_vertRemap))
+  {
+    return false;
+  }
+  // now the vertices line up find each pose face in the base to pair up the normals
+  std::vector<uint32_t> poseToBase(_pose.m_verts.size());
+  for (uint32_t b = 0; b < io_result.m_vertRemap.size(); ++b)
+  {
+    poseToBase[io_result.m_vertRemap[b]] = b;
+  }
+  auto faceKey = [](std::array<uint32_t, 3> _v)
+  {
+    std::sort(_v.begin(), _v.end());
+    return mix(mix(mix(c_fnvOffset, _v[0]), _v[1]), _v[2]);
+  };
+  std::unordered_map<uint64_t, uint32_t> baseFaces;
+  baseFaces.reserve(_base.m_faces.size());
+  for (uint32_t f = 0; f < _base.m_faces.size(); ++f)
+  {
+    baseFaces.emplace(faceKey(_base.m_faces[f].m_vert), f);
+  }
+  auto normPairs = [&](auto &&_pair)
+  {
+    for (const auto &pf : _pose.m_faces)
+    {
+      std::array<uint32_t, 3> verts = {{poseToBase[pf.m_vert[0]], poseToBase[pf.m_vert[1]], poseToBase[pf.m_vert[2]]}};
+      auto it = baseFaces.find(faceKey(verts));
+      if (it == baseFaces.end())
+      {
+        // a retriangulated quad, the other faces will pair its normals up
+        continue;
+      }
+      const auto &bf = _base.m_faces[it->second];
+      for (unsigned int j = 0; j < 3; ++j)
+      {
+        auto corner = std::find(bf.m_vert.begin(), bf.m_vert.end(), verts[j]) - bf.m_vert.begin();
+        if (corner == 3 || !_pair(bf.m_norm[static_cast<size_t>(corner)], pf.m_norm[j]))
+        {
+          return false;
+        }
+      }
+    }
+    return true;
+  };
+  return buildPermutation(_base.m_normals.size(), normPairs, io_result.m_normRemap);
+}
+
+PoseValidation validate(const PoseData &_base, uint64_t _baseHash, const PoseData &_pose, const ValidationOptions &_options)
+{
+  PoseValidation result;
+  if (_pose.m_verts.size() != _base.m_verts.size() || _pose.m_normals.size() != _base.m_normals.size() ||
+      _pose.m_faces.size() != _base.m_faces.size())
+  {
+    result.m_message = "vertex, normal or face count doesn't match the base";
+    return result;
+  }
+  if (faceIndexHash(_pose.m_faces) == _baseHash)
+  {
+    result.m_result = PoseMatch::IDENTICAL;
+    result.m_faceMatch = 1.0f;
+    return result;
+  }
+  size_t matches = 0;
+  for (size_t f = 0; f < _base.m_faces.size(); ++f)
+  {
+    matches += (_base.m_faces[f].m_vert == _pose.m_faces[f].m_vert && _base.m_faces[f].m_norm == _pose.m_faces[f].m_norm);
+  }
+  result.m_faceMatch = _base.m_faces.empty() ? 1.0f : static_cast<float>(matches) / _base.m_faces.size();
+  size_t normalFaces = 0;
+  const bool resplit = result.m_faceMatch >= _options.m_minFaceMatch && onlyResplitQuads(_base, _pose, normalFaces);
+  if (resplit && normalFaces == 0)
+  {
+    result.m_result = PoseMatch::RETRIANGULATED;
+    return result;
+  }
+  if (topologicalRemap(_base, _pose, result))
+  {
+    result.m_result = PoseMatch::REMAPPED;
+    result.m_message = "vertex order differs from the base, remapped using the face list";
+    return result;
+  }
+  if (resplit)
+  {
+    // exporters sometimes pick a different normal index at a few corners without renumbering the rest, the
+    // vertices all line up so the pose is usable with the base normal numbering
+    result.m_vertRemap.clear();
+    result.m_normRemap.clear();
+    result.m_result = PoseMatch::RETRIANGULATED;
+    result.m_message = std::to_string(normalFaces) + " faces use other normal indices than the base, the base numbering is used";
+    return result;
+  }
+  if (_options.m_spatialRemap && spatialRemap(_base, _pose, _options.m_spatialTolerance, result))
+  {
+    result.m_result = PoseMatch::REMAPPED;
+    result.m_message = "vertex order differs from the base, remapped by position";
+    return result;
+  }
+  result.m_vertRemap.clear();
+  result.m_normRemap.clear();
+  result.m_message = "face list doesn't match the base and the pose can't be remapped";
+  return result;
+}
+
+} // end anonymous namespace
+
+uint64_t faceIndexHash(const std::vector<Face> &_faces)
+{
+  uint64_t hash = c_fnvOffset;
+  for (const auto &f : _faces)
+  {
+    for (unsigned int j = 0; j < 3; ++j)
+    {
+      hash = mix(hash, (static_cast<uint64_t>(f.m_vert[j]) << 32) | f.m_norm[j]);
+    }
+  }
+  return hash;
+}
+
+PoseValidation validatePose(const PoseData &_base, const PoseData &_pose, const ValidationOptions &_options)
+{
+  return validate(_base, faceIndexHash(_base.m_faces), _pose, _options);
+}
+
+void applyRemap(const PoseData &_base, PoseData &io_pose, const PoseValidation &_validation)
+{
+  if (_validation.m_result != PoseMatch::REMAPPED)
+  {
+    return;
+  }
+  PoseData remapped;
+  remapped.m_verts.resize(_validation.m_vertRemap.size());
+  remapped.m_normals.resize(_validation.m_normRemap.size());
+  for (size_t i = 0; i < remapped.m_verts.size(); ++i)
+  {
+    remapped.m_verts[i] = io_pose.m_verts[_validation.m_vertRemap[i]];
+  }
+  for (size_t i = 0; i < remapped.m_normals.size(); ++i)
+  {
+    remapped.m_normals[i] = io_pose.m_normals[_validation.m_normRemap[i]];
+  }
+  remapped.m_faces = _base.m_faces;
+  io_pose = std::move(remapped);
+}
+
+bool validatePoses(std::vector<PoseData> &io_poses, const ValidationOptions &_options)
+{
+  if (io_poses.size() < 2)
+  {
+    return true;
+  }
+  const auto &base = io_poses[0];
+  const auto baseHash = faceIndexHash(base.m_faces);
+  std::vector<PoseValidation> results(io_poses.size());
+  ThreadPool::global().parallelFor(1, io_poses.size(), 1, [&](size_t _begin, size_t _end)
+                                   {
+                                     for (size_t p = _begin; p < _end; ++p)
+                                     {
+                                       results[p] = validate(base, baseHash, io_poses[p], _options);
+                                       applyRemap(base, io_poses[p], results[p]);
+                                     }
+                                   });
+  bool ok = true;
+  for (size_t p = 1; p < io_poses.size(); ++p)
+  {
+    if (!results[p].usable())
+    {
+      std::cerr << "pose " << p << " rejected : " << results[p].m_message << '\n';
+      ok = false;
+    }
+    else if (!results[p].m_message.empty())
+    {
+      std::cerr << "pose " << p << " : " << results[p].m_message << '\n';
+    }
+  }
+  return ok;
+}
+
+} // end namespace morph
@@ -0,0 +1,144 @@
+#include "Profiler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+namespace morph
+{
+RollingStats::RollingStats(size_t _window) : m_samples(std::max<size_t>(_window, 1))
+{
+}
+
+void RollingStats::add(double _value)
+{
+  m_samples[m_next] = _value;
+  m_next = (m_next + 1) % m_samples.size();
+  m_count = std::min(m_count + 1, m_samples.size());
+}
+
+void RollingStats::clear() noexcept
+{
+  m_next = 0;
+  m_count = 0;
+}
+
+double RollingStats::min() const noexcept
+{
+  return m_count == 0 ? 0.0 : *std::min_element(m_samples.begin(), m_samples.begin() + m_count);
+}
+
+double RollingStats::max() const noexcept
+{
+  return m_count == 0 ? 0.0 : *std::max_element(m_samples.begin(), m_samples.begin() + m_count);
+}
+
+double RollingStats::average() const noexcept
+{
+  double sum = 0.0;
+  for (size_t i = 0; i < m_count; ++i)
+  {
+    sum += m_samples[i];
+  }
+  return m_count == 0 ? 0.0 : sum / m_count;
+}
+
+double RollingStats::percentile(double _p) const
+{
+  if (m_count == 0)
+  {
+    return 0.0;
+  }
+  std::vector<double> sorted(m_samples.begin(), m_samples.begin() + m_count);
+  const size_t rank = static_cast<size_t>(std::ceil(std::clamp(_p, 0.0, 1.0) * m_count));
+  const size_t n = rank > 0 ? rank - 1 : 0;
+  std::nth_element(sorted.begin(), sorted.begin() + n, sorted.end());
+  return sorted[n];
+}
+
+double RollingStats::last() const noexcept
+{
+  return m_count == 0 ? 0.0 : m_samples[(m_next + m_samples.size() - 1) % m_samples.size()];
+}
+
+double Profiler::now() const noexcept
+{
+  return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - m_epoch).count();
+}
+
+size_t Profiler::stageIndex(const char *_name, Track _track)
+{
+  // there are only ever a handful of stages so a linear search is fine
+  for (size_t i = 0; i < m_stages.size(); ++i)
+  {
+    if (m_stages[i].m_track == _track && (m_stages[i].m_name == _name || std::strcmp(m_stages[i].m_name, _name) == 0))
+    {
+      return i;
+    }
+  }
+  m_stages.push_back({_name, _track, RollingStats()});
+  return m_stages.size() - 1;
+}
+
+void Profiler::record(const char *_name, double _start, double _duration, Track _track)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_stages[stageIndex(_name, _track)].m_stats.add(_duration * 0.001);
+  if (m_tracing && m_events.size() < m_maxEvents)
+  {
+    m_events.push_back({_name, _start, _duration, _track});
+  }
+}
+
+const RollingStats *Profiler::findStage(const char *_name, Track _track) const noexcept
+{
+  for (const auto &s : m_stages)
+  {
+    if (s.m_track == _track && std::strcmp(s.m_name, _name) == 0)
+    {
+      return &s.m_stats;
+    }
+  }
+  return nullptr;
+}
+
+void Profiler::startTrace(size_t _maxEvents)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_events.clear();
+  m_events.reserve(std::min<size_t>(_maxEvents, 1 << 16));
+  m_maxEvents = _maxEvents;
+  m_tracing = true;
+}
+
+void Profiler::stopTrace()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_tracing = false;
+}
+
+bool Profiler::writeChromeTrace(const std::string &_fname) const
+{
+  FILE *out = std::fopen(_fname.c_str(), "w");
+  if (out == nullptr)
+  {
+    std::cerr << "unable to write trace " << _fname << '\n';
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(m_mutex);
+  // complete ("X") events in microseconds, plus metadata naming the two tracks
+  std::fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  std::fprintf(out, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"CPU\"}},\n", CPU);
+  std::fprintf(out, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"GPU\"}}", GPU);
+  for (const auto &e : m_events)
+  {
+    std::fprintf(out, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", e.m_name, e.m_track,
+                 e.m_start, e.m_duration);
+  }
+  std::fprintf(out, "\n]}\n");
+  const bool ok = std::ferror(out) == 0;
+  return std::fclose(out) == 0 && ok;
+}
+
+} // end namespace morph
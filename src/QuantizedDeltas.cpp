@@ -0,0 +1,310 @@
+#include "QuantizedDeltas.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+namespace morph
+{
+namespace
+{
+// vertices per parallelFor job when encoding
+constexpr size_t c_encodeGrain = 16384;
+
+uint32_t quantize(float _value, float _bias, float _scale, uint32_t _max)
+{
+  if (_scale <= 0.0f)
+  {
+    return 0;
+  }
+  float q = (_value - _bias) / _scale * static_cast<float>(_max);
+  return static_cast<uint32_t>(std::lround(std::min(std::max(q, 0.0f), static_cast<float>(_max))));
+}
+
+} // end anonymous namespace
+
+const char *toString(DeltaFormat _format) noexcept
+{
+  switch (_format)
+  {
+  case DeltaFormat::HALF:
+    return "half";
+  case DeltaFormat::INT16:
+    return "int16";
+  case DeltaFormat::INT8:
+    return "int8";
+  default:
+    return "float";
+  }
+}
+
+bool parseDeltaFormat(const std::string &_name, DeltaFormat &o_format) noexcept
+{
+  for (auto f : {DeltaFormat::FLOAT32, DeltaFormat::HALF, DeltaFormat::INT16, DeltaFormat::INT8})
+  {
+    if (_name == toString(f))
+    {
+      o_format = f;
+      return true;
+    }
+  }
+  return false;
+}
+
+uint16_t floatToHalf(float _value) noexcept
+{
+  uint32_t bits;
+  std::memcpy(&bits, &_value, sizeof(bits));
+  const uint32_t sign = (bits >> 16) & 0x8000u;
+  const uint32_t exponent = (bits >> 23) & 0xffu;
+  uint32_t mantissa = bits & 0x7fffffu;
+  // inf / nan
+  if (exponent == 0xffu)
+  {
+    return static_cast<uint16_t>(sign | 0x7c00u | (mantissa != 0 ? 0x200u : 0u));
+  }
+  const int32_t e = static_cast<int32_t>(exponent) - 127 + 15;
+  if (e >= 0x1f)
+  {
+    return static_cast<uint16_t>(sign | 0x7c00u);
+  }
+  uint32_t half, remainder, midpoint;
+  if (e <= 0)
+  {
+    // denormal half, too small values flush to zero
+    if (e < -10)
+    {
+      return static_cast<uint16_t>(sign);
+    }
+    mantissa |= 0x800000u;
+    const uint32_t shift = static_cast<uint32_t>(14 - e);
+    half = mantissa >> shift;
+    remainder = mantissa & ((1u << shift) - 1u);
+    midpoint = 1u << (shift - 1u);
+  }
+  else
+  {
+    half = (static_cast<uint32_t>(e) << 10) | (mantissa >> 13);
+    remainder = mantissa & 0x1fffu;
+    midpoint = 0x1000u;
+  }
+  // round to nearest even, a carry out of the mantissa correctly bumps the exponent
+  if (remainder > midpoint || (remainder == midpoint && (half & 1u)))
+  {
+    ++half;
+  }
+  return static_cast<uint16_t>(sign | half);
+}
+
+float halfToFloat(uint16_t _value) noexcept
+{
+  const uint32_t sign = (static_cast<uint32_t>(_value) & 0x8000u) << 16;
+  const uint32_t exponent = (_value >> 10) & 0x1fu;
+  const uint32_t mantissa = _value & 0x3ffu;
+  uint32_t bits;
+  if (exponent == 0)
+  {
+    float f = std::ldexp(static_cast<float>(mantissa), -24);
+    return sign ? -f : f;
+  }
+  else if (exponent == 0x1f)
+  {
+    bits = sign | 0x7f800000u | (mantissa << 13);
+  }
+  else
+  {
+    bits = sign | ((exponent + 112u) << 23) | (mantissa << 13);
+  }
+  float f;
+  std::memcpy(&f, &bits, sizeof(f));
+  return f;
+}
+
+std::array<uint16_t, 2> octEncode(const Vec3 &_n) noexcept
+{
+  const float l1 = std::abs(_n.m_x) + std::abs(_n.m_y) + std::abs(_n.m_z);
+  float x = 0.0f, y = 0.0f;
+  if (l1 > 0.0f)
+  {
+    x = _n.m_x / l1;
+    y = _n.m_y / l1;
+    // fold the lower hemisphere over the diagonals
+    if (_n.m_z < 0.0f)
+    {
+      float fx = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+      float fy = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+      x = fx;
+      y = fy;
+    }
+  }
+  auto toUnorm = [](float _v)
+  { return static_cast<uint16_t>(std::lround(std::min(std::max(_v * 0.5f + 0.5f, 0.0f), 1.0f) * 65535.0f)); };
+  return {{toUnorm(x), toUnorm(y)}};
+}
+
+Vec3 octDecode(uint16_t _x, uint16_t _y) noexcept
+{
+  // written the same way as octDecode in PerFragASDQuantVert.glsl
+  const float x = (_x / 65535.0f) * 2.0f - 1.0f;
+  const float y = (_y / 65535.0f) * 2.0f - 1.0f;
+  Vec3 n(x, y, 1.0f - std::abs(x) - std::abs(y));
+  const float t = std::max(-n.m_z, 0.0f);
+  n.m_x += n.m_x >= 0.0f ? -t : t;
+  n.m_y += n.m_y >= 0.0f ? -t : t;
+  return n.normalized();
+}
+
+bool QuantizedMorphMesh::build(const MorphMesh &_mesh, DeltaFormat _format)
+{
+  if (_format == DeltaFormat::FLOAT32)
+  {
+    std::cerr << "QuantizedMorphMesh::build FLOAT32 isn't a compressed format\n";
+    return false;
+  }
+  m_format = _format;
+  m_basePositions = _mesh.basePositions();
+  m_baseNormals = _mesh.baseNormals();
+  const size_t nVerts = _mesh.numVertices();
+  const size_t nTargets = _mesh.numTargets();
+  m_scale.assign(nTargets, Vec3(1.0f, 1.0f, 1.0f));
+  m_bias.assign(nTargets, Vec3());
+  // the bounding box of each target's deltas, half floats don't need one
+  if (m_format != DeltaFormat::HALF)
+  {
+    for (size_t t = 0; t < nTargets; ++t)
+    {
+      constexpr float big = std::numeric_limits<float>::max();
+      Vec3 lo(big, big, big), hi(-big, -big, -big);
+      for (const auto &d : _mesh.target(t).m_positionDeltas)
+      {
+        lo = Vec3(std::min(lo.m_x, d.m_x), std::min(lo.m_y, d.m_y), std::min(lo.m_z, d.m_z));
+        hi = Vec3(std::max(hi.m_x, d.m_x), std::max(hi.m_y, d.m_y), std::max(hi.m_z, d.m_z));
+      }
+      if (nVerts == 0)
+      {
+        lo = hi = Vec3();
+      }
+      m_bias[t] = lo;
+      m_scale[t] = hi - lo;
+    }
+  }
+
+  const size_t texelBytes = positionTexelBytes();
+  m_positions.assign(nTargets * nVerts * texelBytes, 0);
+  m_normals.assign(nTargets * nVerts * 2, 0);
+  ThreadPool::global().parallelFor(0, nTargets * nVerts, c_encodeGrain, [&](size_t _begin, size_t _end)
+                                   {
+                                     for (size_t i = _begin; i < _end; ++i)
+                                     {
+                                       const size_t t = i / nVerts;
+                                       const size_t v = i % nVerts;
+                                       const auto &target = _mesh.target(t);
+                                       const auto &d = target.m_positionDeltas[v];
+                                       const auto &scale = m_scale[t];
+                                       const auto &bias = m_bias[t];
+                                       uint8_t *texel = &m_positions[i * texelBytes];
+                                       if (m_format == DeltaFormat::HALF)
+                                       {
+                                         const uint16_t h[4] = {floatToHalf(d.m_x), floatToHalf(d.m_y), floatToHalf(d.m_z), 0};
+                                         std::memcpy(texel, h, sizeof(h));
+                                       }
+                                       else if (m_format == DeltaFormat::INT16)
+                                       {
+                                         const uint16_t q[4] = {static_cast<uint16_t>(quantize(d.m_x, bias.m_x, scale.m_x, 0xffff)),
+                                                                static_cast<uint16_t>(quantize(d.m_y, bias.m_y, scale.m_y, 0xffff)),
+                                                                static_cast<uint16_t>(quantize(d.m_z, bias.m_z, scale.m_z, 0xffff)), 0};
+                                         std::memcpy(texel, q, sizeof(q));
+                                       }
+                                       else
+                                       {
+                                         texel[0] = static_cast<uint8_t>(quantize(d.m_x, bias.m_x, scale.m_x, 0xff));
+                                         texel[1] = static_cast<uint8_t>(quantize(d.m_y, bias.m_y, scale.m_y, 0xff));
+                                         texel[2] = static_cast<uint8_t>(quantize(d.m_z, bias.m_z, scale.m_z, 0xff));
+                                       }
+                                       // the normal is stored as the full target normal as a delta isn't unit length
+                                       auto oct = octEncode(m_baseNormals[v] + target.m_normalDeltas[v]);
+                                       m_normals[i * 2] = oct[0];
+                                       m_normals[i * 2 + 1] = oct[1];
+                                     }
+                                   });
+  return true;
+}
+
+Vec3 QuantizedMorphMesh::positionDelta(size_t _target, size_t _vertex) const noexcept
+{
+  const size_t i = _target * numVertices() + _vertex;
+  const uint8_t *texel = &m_positions[i * positionTexelBytes()];
+  Vec3 value;
+  if (m_format == DeltaFormat::HALF)
+  {
+    uint16_t h[3];
+    std::memcpy(h, texel, sizeof(h));
+    value = Vec3(halfToFloat(h[0]), halfToFloat(h[1]), halfToFloat(h[2]));
+  }
+  else if (m_format == DeltaFormat::INT16)
+  {
+    uint16_t q[3];
+    std::memcpy(q, texel, sizeof(q));
+    value = Vec3(q[0] / 65535.0f, q[1] / 65535.0f, q[2] / 65535.0f);
+  }
+  else
+  {
+    value = Vec3(texel[0] / 255.0f, texel[1] / 255.0f, texel[2] / 255.0f);
+  }
+  // bias + texel * scale as in the shader
+  const auto &s = m_scale[_target];
+  const auto &b = m_bias[_target];
+  return Vec3(b.m_x + value.m_x * s.m_x, b.m_y + value.m_y * s.m_y, b.m_z + value.m_z * s.m_z);
+}
+
+Vec3 QuantizedMorphMesh::normalDelta(size_t _target, size_t _vertex) const noexcept
+{
+  const size_t i = _target * numVertices() + _vertex;
+  return octDecode(m_normals[i * 2], m_normals[i * 2 + 1]) - m_baseNormals[_vertex];
+}
+
+void QuantizedMorphMesh::evaluate(const std::vector<ActiveWeight> &_active, std::vector<Vec3> &o_positions,
+                                  std::vector<Vec3> &o_normals) const
+{
+  o_positions = m_basePositions;
+  o_normals = m_baseNormals;
+  for (const auto &a : _active)
+  {
+    const float w = a.m_weight;
+    for (size_t v = 0; v < o_positions.size(); ++v)
+    {
+      o_positions[v] += positionDelta(a.m_target, v) * w;
+      o_normals[v] += normalDelta(a.m_target, v) * w;
+    }
+  }
+}
+
+QuantizationError QuantizedMorphMesh::measureError(const MorphMesh &_mesh) const
+{
+  QuantizationError error;
+  double sumSq = 0.0;
+  float minCos = 1.0f;
+  for (size_t t = 0; t < numTargets(); ++t)
+  {
+    const auto &target = _mesh.target(t);
+    for (size_t v = 0; v < numVertices(); ++v)
+    {
+      const float e = (positionDelta(t, v) - target.m_positionDeltas[v]).length();
+      error.m_maxPosition = std::max(error.m_maxPosition, e);
+      sumSq += static_cast<double>(e) * e;
+      const auto original = m_baseNormals[v] + target.m_normalDeltas[v];
+      if (original.length() > 0.0f)
+      {
+        minCos = std::min(minCos, original.normalized().dot((m_baseNormals[v] + normalDelta(t, v)).normalized()));
+      }
+    }
+  }
+  const size_t count = numTargets() * numVertices();
+  error.m_rmsPosition = count ? static_cast<float>(std::sqrt(sumSq / count)) : 0.0f;
+  error.m_maxNormalDegrees = std::acos(std::min(std::max(minCos, -1.0f), 1.0f)) * 57.29577951f;
+  return error;
+}
+
+} // end namespace morph
@@ -0,0 +1,115 @@
+#include "Skeleton.h"
+#include <algorithm>
+#include <cmath>
+
+namespace morph
+{
+Quat Quat::fromAxisAngle(const Vec3 &_axis, float _radians) noexcept
+{
+  const float s = std::sin(_radians * 0.5f);
+  return {_axis.m_x * s, _axis.m_y * s, _axis.m_z * s, std::cos(_radians * 0.5f)};
+}
+
+Quat Quat::operator*(const Quat &_q) const noexcept
+{
+  return {m_w * _q.m_x + m_x * _q.m_w + m_y * _q.m_z - m_z * _q.m_y,
+          m_w * _q.m_y - m_x * _q.m_z + m_y * _q.m_w + m_z * _q.m_x,
+          m_w * _q.m_z + m_x * _q.m_y - m_y * _q.m_x + m_z * _q.m_w,
+          m_w * _q.m_w - m_x * _q.m_x - m_y * _q.m_y - m_z * _q.m_z};
+}
+
+Vec3 Quat::rotate(const Vec3 &_v) const noexcept
+{
+  // v + 2w (u x v) + 2 u x (u x v)
+  const Vec3 u(m_x, m_y, m_z);
+  const Vec3 t = u.cross(_v) * 2.0f;
+  return _v + t * m_w + u.cross(t);
+}
+
+RigidTransform RigidTransform::operator*(const RigidTransform &_t) const noexcept
+{
+  return {m_rotation * _t.m_rotation, m_rotation.rotate(_t.m_translation) + m_translation};
+}
+
+RigidTransform RigidTransform::inverse() const noexcept
+{
+  const Quat r = m_rotation.conjugate();
+  return {r, r.rotate(m_translation) * -1.0f};
+}
+
+int Skeleton::addJoint(const std::string &_name, int _parent, const RigidTransform &_bindLocal)
+{
+  if (_parent != c_noParent && (_parent < 0 || static_cast<size_t>(_parent) >= numJoints()))
+  {
+    return -1;
+  }
+  m_names.push_back(_name);
+  m_parents.push_back(_parent);
+  m_bindLocal.push_back(_bindLocal);
+  m_bindWorld.push_back(_parent == c_noParent ? _bindLocal : m_bindWorld[static_cast<size_t>(_parent)] * _bindLocal);
+  m_inverseBind.push_back(m_bindWorld.back().inverse());
+  return static_cast<int>(numJoints() - 1);
+}
+
+void Skeleton::buildChain(const Vec3 &_start, const Vec3 &_end, size_t _numJoints)
+{
+  *this = Skeleton();
+  const Vec3 step = (_end - _start) * (1.0f / static_cast<float>(std::max<size_t>(_numJoints, 2) - 1));
+  int parent = c_noParent;
+  for (size_t j = 0; j < _numJoints; ++j)
+  {
+    RigidTransform bind;
+    bind.m_translation = j == 0 ? _start : step;
+    parent = addJoint("joint" + std::to_string(j), parent, bind);
+  }
+}
+
+void Skeleton::worldTransforms(const std::vector<RigidTransform> &_local, std::vector<RigidTransform> &o_world) const
+{
+  o_world.resize(numJoints());
+  // parents always come first so their world transform is already done
+  for (size_t j = 0; j < numJoints(); ++j)
+  {
+    const int p = m_parents[j];
+    o_world[j] = p == c_noParent ? _local[j] : o_world[static_cast<size_t>(p)] * _local[j];
+  }
+}
+
+void Skeleton::computePalette(const std::vector<RigidTransform> &_local, SkinPalette &o_palette) const
+{
+  worldTransforms(_local, m_world);
+  o_palette.m_matrices.resize(numJoints() * 12);
+  o_palette.m_dualQuats.resize(numJoints() * 8);
+  for (size_t j = 0; j < numJoints(); ++j)
+  {
+    const RigidTransform skin = m_world[j] * m_inverseBind[j];
+    const Quat &q = skin.m_rotation;
+    const Vec3 &t = skin.m_translation;
+    float *m = &o_palette.m_matrices[j * 12];
+    m[0] = 1.0f - 2.0f * (q.m_y * q.m_y + q.m_z * q.m_z);
+    m[1] = 2.0f * (q.m_x * q.m_y - q.m_w * q.m_z);
+    m[2] = 2.0f * (q.m_x * q.m_z + q.m_w * q.m_y);
+    m[3] = t.m_x;
+    m[4] = 2.0f * (q.m_x * q.m_y + q.m_w * q.m_z);
+    m[5] = 1.0f - 2.0f * (q.m_x * q.m_x + q.m_z * q.m_z);
+    m[6] = 2.0f * (q.m_y * q.m_z - q.m_w * q.m_x);
+    m[7] = t.m_y;
+    m[8] = 2.0f * (q.m_x * q.m_z - q.m_w * q.m_y);
+    m[9] = 2.0f * (q.m_y * q.m_z + q.m_w * q.m_x);
+    m[10] = 1.0f - 2.0f * (q.m_x * q.m_x + q.m_y * q.m_y);
+    m[11] = t.m_z;
+    // the dual part is half the translation (as a pure quaternion) times the rotation
+    const Quat d = Quat(t.m_x * 0.5f, t.m_y * 0.5f, t.m_z * 0.5f, 0.0f) * q;
+    float *dq = &o_palette.m_dualQuats[j * 8];
+    dq[0] = q.m_x;
+    dq[1] = q.m_y;
+    dq[2] = q.m_z;
+    dq[3] = q.m_w;
+    dq[4] = d.m_x;
+    dq[5] = d.m_y;
+    dq[6] = d.m_z;
+    dq[7] = d.m_w;
+  }
+}
+
+} // end namespace morph
@@ -0,0 +1,368 @@
+#include "Skinning.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define MORPH_X86 1
+#include <immintrin.h>
+#endif
+
+namespace morph
+{
+namespace
+{
+// vertices per parallelFor job, the palette is small and stays in L1 so this only has to amortise the job cost
+constexpr size_t c_grain = 2048;
+constexpr size_t c_maxInfluences = 8;
+constexpr float c_unorm16 = 1.0f / 65535.0f;
+
+// the arguments shared by every kernel, vertices [m_begin, m_end)
+struct SkinJob
+{
+  const uint8_t *m_joints;
+  const uint16_t *m_weights;
+  size_t m_influences;
+  const float *m_palette;
+  const Vec3 *m_positions;
+  const Vec3 *m_normals;
+  Vec3 *m_outPositions;
+  Vec3 *m_outNormals;
+  size_t m_begin;
+  size_t m_end;
+};
+
+Vec3 normalizedOrZero(const Vec3 &_v) noexcept
+{
+  const float len = _v.length();
+  return len > 0.0f ? _v * (1.0f / len) : _v;
+}
+
+// the rotation and translation of a blended dual quaternion, normalised by the real part's length
+void applyDualQuat(const float *_real, const float *_dual, const Vec3 &_p, const Vec3 &_n, Vec3 &o_p, Vec3 &o_n) noexcept
+{
+  const float len = std::sqrt(_real[0] * _real[0] + _real[1] * _real[1] + _real[2] * _real[2] + _real[3] * _real[3]);
+  const float inv = len > 0.0f ? 1.0f / len : 0.0f;
+  const Quat r(_real[0] * inv, _real[1] * inv, _real[2] * inv, _real[3] * inv);
+  const Vec3 rv(r.m_x, r.m_y, r.m_z);
+  const Vec3 dv(_dual[0] * inv, _dual[1] * inv, _dual[2] * inv);
+  const float dw = _dual[3] * inv;
+  // translation = 2 * dual * conjugate(real)
+  const Vec3 t = (dv * r.m_w - rv * dw + rv.cross(dv)) * 2.0f;
+  o_p = r.rotate(_p) + t;
+  o_n = normalizedOrZero(r.rotate(_n));
+}
+
+void scalarLinear(const SkinJob &_job)
+{
+  for (size_t v = _job.m_begin; v < _job.m_end; ++v)
+  {
+    float m[12] = {};
+    for (size_t i = 0; i < _job.m_influences; ++i)
+    {
+      const uint16_t q = _job.m_weights[v * _job.m_influences + i];
+      if (q == 0)
+      {
+        continue;
+      }
+      const float w = q * c_unorm16;
+      const float *joint = _job.m_palette + _job.m_joints[v * _job.m_influences + i] * 12;
+      for (size_t k = 0; k < 12; ++k)
+      {
+        m[k] += w * joint[k];
+      }
+    }
+    const Vec3 &p = _job.m_positions[v];
+    const Vec3 &n = _job.m_normals[v];
+    _job.m_outPositions[v] = {m[0] * p.m_x + m[1] * p.m_y + m[2] * p.m_z + m[3],
+                              m[4] * p.m_x + m[5] * p.m_y + m[6] * p.m_z + m[7],
+                              m[8] * p.m_x + m[9] * p.m_y + m[10] * p.m_z + m[11]};
+    // the blended matrix is close enough to a rotation that its inverse transpose isn't worth the cost
+    _job.m_outNormals[v] = normalizedOrZero({m[0] * n.m_x + m[1] * n.m_y + m[2] * n.m_z,
+                                             m[4] * n.m_x + m[5] * n.m_y + m[6] * n.m_z,
+                                             m[8] * n.m_x + m[9] * n.m_y + m[10] * n.m_z});
+  }
+}
+
+void scalarDualQuat(const SkinJob &_job)
+{
+  for (size_t v = _job.m_begin; v < _job.m_end; ++v)
+  {
+    float real[4] = {};
+    float dual[4] = {};
+    const float *first = _job.m_palette + _job.m_joints[v * _job.m_influences] * 8;
+    for (size_t i = 0; i < _job.m_influences; ++i)
+    {
+      const uint16_t q = _job.m_weights[v * _job.m_influences + i];
+      if (q == 0)
+      {
+        continue;
+      }
+      const float *joint = _job.m_palette + _job.m_joints[v * _job.m_influences + i] * 8;
+      // q and -q are the same rotation, blend every joint in the first one's hemisphere
+      const float hemisphere = first[0] * joint[0] + first[1] * joint[1] + first[2] * joint[2] + first[3] * joint[3];
+      const float w = hemisphere < 0.0f ? -(q * c_unorm16) : q * c_unorm16;
+      for (size_t k = 0; k < 4; ++k)
+      {
+        real[k] += w * joint[k];
+        dual[k] += w * joint[k + 4];
+      }
+    }
+    applyDualQuat(real, dual, _job.m_positions[v], _job.m_normals[v], _job.m_outPositions[v], _job.m_outNormals[v]);
+  }
+}
+
+#if defined(MORPH_X86)
+// a 3x4 matrix row is one register so the blend is three multiply adds per influence
+void sseLinear(const SkinJob &_job)
+{
+  for (size_t v = _job.m_begin; v < _job.m_end; ++v)
+  {
+    __m128 r0 = _mm_setzero_ps();
+    __m128 r1 = _mm_setzero_ps();
+    __m128 r2 = _mm_setzero_ps();
+    for (size_t i = 0; i < _job.m_influences; ++i)
+    {
+      const uint16_t q = _job.m_weights[v * _job.m_influences + i];
+      if (q == 0)
+      {
+        continue;
+      }
+      const __m128 w = _mm_set1_ps(q * c_unorm16);
+      const float *joint = _job.m_palette + _job.m_joints[v * _job.m_influences + i] * 12;
+      r0 = _mm_add_ps(r0, _mm_mul_ps(w, _mm_loadu_ps(joint)));
+      r1 = _mm_add_ps(r1, _mm_mul_ps(w, _mm_loadu_ps(joint + 4)));
+      r2 = _mm_add_ps(r2, _mm_mul_ps(w, _mm_loadu_ps(joint + 8)));
+    }
+    // multiply each row by the point then transpose so summing the rows gives the three dot products at once
+    const Vec3 &p = _job.m_positions[v];
+    const __m128 p4 = _mm_setr_ps(p.m_x, p.m_y, p.m_z, 1.0f);
+    __m128 a = _mm_mul_ps(r0, p4);
+    __m128 b = _mm_mul_ps(r1, p4);
+    __m128 c = _mm_mul_ps(r2, p4);
+    __m128 d = _mm_setzero_ps();
+    _MM_TRANSPOSE4_PS(a, b, c, d);
+    alignas(16) float out[4];
+    _mm_store_ps(out, _mm_add_ps(_mm_add_ps(a, b), _mm_add_ps(c, d)));
+    _job.m_outPositions[v] = {out[0], out[1], out[2]};
+
+    const Vec3 &n = _job.m_normals[v];
+    const __m128 n4 = _mm_setr_ps(n.m_x, n.m_y, n.m_z, 0.0f);
+    a = _mm_mul_ps(r0, n4);
+    b = _mm_mul_ps(r1, n4);
+    c = _mm_mul_ps(r2, n4);
+    d = _mm_setzero_ps();
+    _MM_TRANSPOSE4_PS(a, b, c, d);
+    _mm_store_ps(out, _mm_add_ps(_mm_add_ps(a, b), _mm_add_ps(c, d)));
+    _job.m_outNormals[v] = normalizedOrZero({out[0], out[1], out[2]});
+  }
+}
+
+void sseDualQuat(const SkinJob &_job)
+{
+  for (size_t v = _job.m_begin; v < _job.m_end; ++v)
+  {
+    __m128 real = _mm_setzero_ps();
+    __m128 dual = _mm_setzero_ps();
+    const __m128 first = _mm_loadu_ps(_job.m_palette + _job.m_joints[v * _job.m_influences] * 8);
+    for (size_t i = 0; i < _job.m_influences; ++i)
+    {
+      const uint16_t q = _job.m_weights[v * _job.m_influences + i];
+      if (q == 0)
+      {
+        continue;
+      }
+      const float *joint = _job.m_palette + _job.m_joints[v * _job.m_influences + i] * 8;
+      const __m128 jr = _mm_loadu_ps(joint);
+      alignas(16) float dot[4];
+      _mm_store_ps(dot, _mm_mul_ps(first, jr));
+      const float hemisphere = dot[0] + dot[1] + dot[2] + dot[3];
+      const __m128 w = _mm_set1_ps(hemisphere < 0.0f ? -(q * c_unorm16) : q * c_unorm16);
+      real = _mm_add_ps(real, _mm_mul_ps(w, jr));
+      dual = _mm_add_ps(dual, _mm_mul_ps(w, _mm_loadu_ps(joint + 4)));
+    }
+    alignas(16) float r[4];
+    alignas(16) float d[4];
+    _mm_store_ps(r, real);
+    _mm_store_ps(d, dual);
+    applyDualQuat(r, d, _job.m_positions[v], _job.m_normals[v], _job.m_outPositions[v], _job.m_outNormals[v]);
+  }
+}
+#endif
+
+// squared distance from _p to the segment _a _b
+float segmentDistance2(const Vec3 &_p, const Vec3 &_a, const Vec3 &_b) noexcept
+{
+  const Vec3 ab = _b - _a;
+  const float len2 = ab.dot(ab);
+  const float s = len2 > 0.0f ? std::clamp((_p - _a).dot(ab) / len2, 0.0f, 1.0f) : 0.0f;
+  const Vec3 d = _p - (_a + ab * s);
+  return d.dot(d);
+}
+
+} // end anonymous namespace
+
+const char *toString(SkinMethod _method) noexcept
+{
+  return _method == SkinMethod::DUAL_QUATERNION ? "dqs" : "lbs";
+}
+
+bool SkinWeights::reset(size_t _numVertices, size_t _influences)
+{
+  if (_influences != 4 && _influences != 8)
+  {
+    return false;
+  }
+  m_influences = _influences;
+  m_joints.assign(_numVertices * _influences, 0);
+  m_weights.assign(_numVertices * _influences, 0);
+  for (size_t v = 0; v < _numVertices; ++v)
+  {
+    m_weights[v * _influences] = 65535;
+  }
+  return true;
+}
+
+void SkinWeights::setVertex(size_t _vertex, const std::vector<JointWeight> &_weights)
+{
+  // keep the largest influences() weights, sorted largest first, without allocating
+  JointWeight best[c_maxInfluences];
+  size_t count = 0;
+  for (const auto &w : _weights)
+  {
+    if (!(w.m_weight > 0.0f) || w.m_joint >= c_maxJoints)
+    {
+      continue;
+    }
+    if (count == m_influences && w.m_weight <= best[count - 1].m_weight)
+    {
+      continue;
+    }
+    size_t i = count < m_influences ? count++ : count - 1;
+    for (; i > 0 && best[i - 1].m_weight < w.m_weight; --i)
+    {
+      best[i] = best[i - 1];
+    }
+    best[i] = w;
+  }
+  uint8_t *joints = &m_joints[_vertex * m_influences];
+  uint16_t *weights = &m_weights[_vertex * m_influences];
+  std::fill(joints, joints + m_influences, 0);
+  std::fill(weights, weights + m_influences, 0);
+  if (count == 0)
+  {
+    weights[0] = 65535;
+    return;
+  }
+  float sum = 0.0f;
+  for (size_t i = 0; i < count; ++i)
+  {
+    sum += best[i].m_weight;
+  }
+  int total = 0;
+  for (size_t i = 0; i < count; ++i)
+  {
+    joints[i] = static_cast<uint8_t>(best[i].m_joint);
+    weights[i] = static_cast<uint16_t>(std::lround(best[i].m_weight / sum * 65535.0f));
+    total += weights[i];
+  }
+  // rounding leaves the sum a few units out, the largest weight takes the difference
+  weights[0] = static_cast<uint16_t>(weights[0] + (65535 - total));
+}
+
+std::vector<JointWeight> SkinWeights::vertex(size_t _vertex) const
+{
+  std::vector<JointWeight> out(m_influences);
+  for (size_t i = 0; i < m_influences; ++i)
+  {
+    out[i] = {m_joints[_vertex * m_influences + i], m_weights[_vertex * m_influences + i] * c_unorm16};
+  }
+  return out;
+}
+
+void computeDistanceWeights(const std::vector<Vec3> &_positions, const Skeleton &_skeleton, float _falloff,
+                            SkinWeights &o_weights, ThreadPool *_pool)
+{
+  const size_t numJoints = std::min(_skeleton.numJoints(), SkinWeights::c_maxJoints);
+  // each joint's bone as a segment in the bind pose
+  std::vector<Vec3> boneStart(numJoints);
+  std::vector<Vec3> boneEnd(numJoints);
+  for (size_t j = 0; j < numJoints; ++j)
+  {
+    boneStart[j] = boneEnd[j] = _skeleton.bindWorld(j).m_translation;
+  }
+  for (size_t j = numJoints; j-- > 0;)
+  {
+    const int p = _skeleton.parent(j);
+    if (p != Skeleton::c_noParent)
+    {
+      // walking backwards leaves the first child's end
+      boneEnd[static_cast<size_t>(p)] = boneStart[j];
+    }
+  }
+  const float f2 = _falloff * _falloff;
+  auto range = [&](size_t _begin, size_t _end)
+  {
+    std::vector<JointWeight> weights(numJoints);
+    for (size_t v = _begin; v < _end; ++v)
+    {
+      for (size_t j = 0; j < numJoints; ++j)
+      {
+        const float s = segmentDistance2(_positions[v], boneStart[j], boneEnd[j]) + f2;
+        weights[j] = {static_cast<uint32_t>(j), 1.0f / (s * s)};
+      }
+      o_weights.setVertex(v, weights);
+    }
+  };
+  if (_pool != nullptr)
+  {
+    _pool->parallelFor(0, _positions.size(), c_grain, range);
+  }
+  else
+  {
+    range(0, _positions.size());
+  }
+}
+
+void skinVertices(const SkinWeights &_weights, const SkinPalette &_palette, SkinMethod _method,
+                  const std::vector<Vec3> &_positions, const std::vector<Vec3> &_normals, std::vector<Vec3> &o_positions,
+                  std::vector<Vec3> &o_normals, ThreadPool *_pool, SimdLevel _level)
+{
+  const size_t numVertices = std::min(_weights.numVertices(), _positions.size());
+  o_positions.resize(numVertices);
+  o_normals.resize(numVertices);
+  const bool dualQuat = _method == SkinMethod::DUAL_QUATERNION;
+  void (*kernel)(const SkinJob &) = dualQuat ? scalarDualQuat : scalarLinear;
+#if defined(MORPH_X86)
+  if (_level != SimdLevel::SCALAR)
+  {
+    kernel = dualQuat ? sseDualQuat : sseLinear;
+  }
+#else
+  (void)_level;
+#endif
+  auto range = [&](size_t _begin, size_t _end)
+  {
+    SkinJob job;
+    job.m_joints = _weights.joints().data();
+    job.m_weights = _weights.weights().data();
+    job.m_influences = _weights.influences();
+    job.m_palette = dualQuat ? _palette.m_dualQuats.data() : _palette.m_matrices.data();
+    job.m_positions = _positions.data();
+    job.m_normals = _normals.data();
+    job.m_outPositions = o_positions.data();
+    job.m_outNormals = o_normals.data();
+    job.m_begin = _begin;
+    job.m_end = _end;
+    kernel(job);
+  };
+  if (_pool != nullptr)
+  {
+    _pool->parallelFor(0, numVertices, c_grain, range);
+  }
+  else
+  {
+    range(0, numVertices);
+  }
+}
+
+} // end namespace morph
@@ -0,0 +1,251 @@
+#include "SoAMorphMesh.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define MORPH_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+namespace morph
+{
+namespace
+{
+// vertices per parallelFor job, small enough that one component stream of a job stays in L1 while every
+// active target is added to it
+constexpr size_t c_grain = 4096;
+// the widest SIMD block, streams are padded to this many floats
+constexpr size_t c_block = 8;
+
+// the arguments shared by every kernel, one component stream over [m_begin, m_end)
+struct StreamJob
+{
+  const float *m_base;
+  const float *m_deltas;
+  size_t m_targetStride;
+  const ActiveWeight *m_active;
+  size_t m_numActive;
+  float *m_out;
+  size_t m_begin;
+  size_t m_end;
+};
+
+void scalarKernel(const StreamJob &_job)
+{
+  std::memcpy(_job.m_out + _job.m_begin, _job.m_base + _job.m_begin, (_job.m_end - _job.m_begin) * sizeof(float));
+  for (size_t a = 0; a < _job.m_numActive; ++a)
+  {
+    const float w = _job.m_active[a].m_weight;
+    const float *d = _job.m_deltas + _job.m_active[a].m_target * _job.m_targetStride;
+    for (size_t i = _job.m_begin; i < _job.m_end; ++i)
+    {
+      _job.m_out[i] = _job.m_out[i] + w * d[i];
+    }
+  }
+}
+
+#if defined(MORPH_X86)
+void sseKernel(const StreamJob &_job)
+{
+  std::memcpy(_job.m_out + _job.m_begin, _job.m_base + _job.m_begin, (_job.m_end - _job.m_begin) * sizeof(float));
+  for (size_t a = 0; a < _job.m_numActive; ++a)
+  {
+    const float w = _job.m_active[a].m_weight;
+    const __m128 w4 = _mm_set1_ps(w);
+    const float *d = _job.m_deltas + _job.m_active[a].m_target * _job.m_targetStride;
+    size_t i = _job.m_begin;
+    for (; i + 4 <= _job.m_end; i += 4)
+    {
+      _mm_storeu_ps(_job.m_out + i, _mm_add_ps(_mm_loadu_ps(_job.m_out + i), _mm_mul_ps(w4, _mm_loadu_ps(d + i))));
+    }
+    for (; i < _job.m_end; ++i)
+    {
+      _job.m_out[i] = _job.m_out[i] + w * d[i];
+    }
+  }
+}
+
+// only avx2 is enabled (not fma) so the compiler can't fuse the multiply and add
+#if defined(__GNUC__) || defined(__clang__)
+__attribute__((target("avx2")))
+#endif
+void avx2Kernel(const StreamJob &_job)
+{
+  std::memcpy(_job.m_out + _job.m_begin, _job.m_base + _job.m_begin, (_job.m_end - _job.m_begin) * sizeof(float));
+  for (size_t a = 0; a < _job.m_numActive; ++a)
+  {
+    const float w = _job.m_active[a].m_weight;
+    const __m256 w8 = _mm256_set1_ps(w);
+    const float *d = _job.m_deltas + _job.m_active[a].m_target * _job.m_targetStride;
+    size_t i = _job.m_begin;
+    for (; i + 8 <= _job.m_end; i += 8)
+    {
+      _mm256_storeu_ps(_job.m_out + i, _mm256_add_ps(_mm256_loadu_ps(_job.m_out + i), _mm256_mul_ps(w8, _mm256_loadu_ps(d + i))));
+    }
+    for (; i < _job.m_end; ++i)
+    {
+      _job.m_out[i] = _job.m_out[i] + w * d[i];
+    }
+  }
+}
+#endif
+
+bool supported(SimdLevel _level) noexcept
+{
+  if (_level == SimdLevel::SCALAR)
+  {
+    return true;
+  }
+#if defined(MORPH_X86)
+  if (_level == SimdLevel::SSE)
+  {
+    // SSE2 is part of x86_64
+    return true;
+  }
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_cpu_supports("avx2");
+#elif defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 1);
+  // the OS has to save the ymm registers as well as the CPU supporting the instructions
+  const bool osxsave = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+  __cpuidex(info, 7, 0);
+  return osxsave && (info[1] & (1 << 5)) != 0;
+#else
+  return false;
+#endif
+#else
+  return false;
+#endif
+}
+
+} // end anonymous namespace
+
+const char *toString(SimdLevel _level) noexcept
+{
+  switch (_level)
+  {
+  case SimdLevel::AVX2:
+    return "avx2";
+  case SimdLevel::SSE:
+    return "sse";
+  default:
+    return "scalar";
+  }
+}
+
+SimdLevel detectSimdLevel() noexcept
+{
+  for (auto level : {SimdLevel::AVX2, SimdLevel::SSE})
+  {
+    if (supported(level))
+    {
+      return level;
+    }
+  }
+  return SimdLevel::SCALAR;
+}
+
+void SoAVertices::resize(size_t _size)
+{
+  for (auto *v : {&m_px, &m_py, &m_pz, &m_nx, &m_ny, &m_nz})
+  {
+    v->resize(_size);
+  }
+}
+
+void SoAVertices::toAoS(std::vector<Vec3> &o_positions, std::vector<Vec3> &o_normals) const
+{
+  o_positions.resize(size());
+  o_normals.resize(size());
+  for (size_t i = 0; i < size(); ++i)
+  {
+    o_positions[i] = position(i);
+    o_normals[i] = normal(i);
+  }
+}
+
+void SoAMorphMesh::build(const MorphMesh &_mesh)
+{
+  m_numVertices = _mesh.numVertices();
+  m_numTargets = _mesh.numTargets();
+  m_stride = (m_numVertices + c_block - 1) / c_block * c_block;
+  // split a Vec3 array into three streams starting at _out
+  auto split = [this](const std::vector<Vec3> &_in, float *_out)
+  {
+    for (size_t v = 0; v < _in.size(); ++v)
+    {
+      _out[v] = _in[v].m_x;
+      _out[m_stride + v] = _in[v].m_y;
+      _out[2 * m_stride + v] = _in[v].m_z;
+    }
+  };
+  m_base.assign(6 * m_stride, 0.0f);
+  split(_mesh.basePositions(), &m_base[0]);
+  split(_mesh.baseNormals(), &m_base[3 * m_stride]);
+  m_deltas.assign(m_numTargets * 6 * m_stride, 0.0f);
+  ThreadPool::global().parallelFor(0, m_numTargets, 1, [&](size_t _begin, size_t _end)
+                                   {
+                                     for (size_t t = _begin; t < _end; ++t)
+                                     {
+                                       split(_mesh.target(t).m_positionDeltas, &m_deltas[t * 6 * m_stride]);
+                                       split(_mesh.target(t).m_normalDeltas, &m_deltas[(t * 6 + 3) * m_stride]);
+                                     }
+                                   });
+}
+
+void SoAMorphMesh::setSimdLevel(SimdLevel _level) noexcept
+{
+  m_simdLevel = supported(_level) ? _level : detectSimdLevel();
+}
+
+void SoAMorphMesh::evaluate(const std::vector<ActiveWeight> &_active, SoAVertices &o_vertices, ThreadPool *_pool) const
+{
+  o_vertices.resize(m_numVertices);
+  void (*kernel)(const StreamJob &) = scalarKernel;
+#if defined(MORPH_X86)
+  if (m_simdLevel == SimdLevel::AVX2)
+  {
+    kernel = avx2Kernel;
+  }
+  else if (m_simdLevel == SimdLevel::SSE)
+  {
+    kernel = sseKernel;
+  }
+#endif
+  float *out[6] = {o_vertices.m_px.data(), o_vertices.m_py.data(), o_vertices.m_pz.data(),
+                   o_vertices.m_nx.data(), o_vertices.m_ny.data(), o_vertices.m_nz.data()};
+  auto range = [&](size_t _begin, size_t _end)
+  {
+    for (size_t c = 0; c < 6; ++c)
+    {
+      StreamJob job;
+      job.m_base = &m_base[c * m_stride];
+      job.m_deltas = m_deltas.data() + c * m_stride;
+      job.m_targetStride = 6 * m_stride;
+      job.m_active = _active.data();
+      job.m_numActive = _active.size();
+      job.m_out = out[c];
+      job.m_begin = _begin;
+      job.m_end = _end;
+      kernel(job);
+    }
+  };
+  if (_pool != nullptr)
+  {
+    _pool->parallelFor(0, m_numVertices, c_grain, range);
+  }
+  else
+  {
+    // still go a chunk at a time so the output stays in cache across the targets
+    for (size_t b = 0; b < m_numVertices; b += c_grain)
+    {
+      range(b, std::min(b + c_grain, m_numVertices));
+    }
+  }
+}
+
+} // end namespace morph
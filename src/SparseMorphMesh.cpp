@@ -0,0 +1,131 @@
+#include "SparseMorphMesh.h"
+#include <cmath>
+
+namespace morph
+{
+static bool exceeds(const Vec3 &_v, float _epsilon) noexcept
+{
+  return std::abs(_v.m_x) > _epsilon || std::abs(_v.m_y) > _epsilon || std::abs(_v.m_z) > _epsilon;
+}
+
+SparseMorphTarget SparseMorphTarget::fromDense(const MorphTarget &_target, float _epsilon)
+{
+  SparseMorphTarget sparse;
+  sparse.m_name = _target.m_name;
+  for (size_t v = 0; v < _target.size(); ++v)
+  {
+    if (exceeds(_target.m_positionDeltas[v], _epsilon) || exceeds(_target.m_normalDeltas[v], _epsilon))
+    {
+      sparse.m_indices.push_back(static_cast<uint32_t>(v));
+      sparse.m_positionDeltas.push_back(_target.m_positionDeltas[v]);
+      sparse.m_normalDeltas.push_back(_target.m_normalDeltas[v]);
+    }
+  }
+  // push_back growth can leave up to twice the capacity we need so give the slack back
+  sparse.m_indices.shrink_to_fit();
+  sparse.m_positionDeltas.shrink_to_fit();
+  sparse.m_normalDeltas.shrink_to_fit();
+  return sparse;
+}
+
+void SparseMorphMesh::build(const MorphMesh &_mesh, float _epsilon)
+{
+  m_basePositions = _mesh.basePositions();
+  m_baseNormals = _mesh.baseNormals();
+  m_targets.clear();
+  m_targets.reserve(_mesh.numTargets());
+  for (const auto &t : _mesh.targets())
+  {
+    m_targets.push_back(SparseMorphTarget::fromDense(t, _epsilon));
+  }
+}
+
+void SparseMorphMesh::accumulate(const std::vector<ActiveWeight> &_active, std::vector<Vec3> &io_positions, std::vector<Vec3> &io_normals) const
+{
+  // targets are processed in the active (target) order so each vertex gets its deltas added in the same
+  // order as the dense evaluation
+  for (const auto &a : _active)
+  {
+    const auto &t = m_targets[a.m_target];
+    const float w = a.m_weight;
+    for (size_t i = 0; i < t.m_indices.size(); ++i)
+    {
+      auto v = t.m_indices[i];
+      io_positions[v] += t.m_positionDeltas[i] * w;
+      io_normals[v] += t.m_normalDeltas[i] * w;
+    }
+  }
+}
+
+void SparseMorphMesh::evaluate(const std::vector<ActiveWeight> &_active, std::vector<Vec3> &o_positions, std::vector<Vec3> &o_normals) const
+{
+  o_positions = m_basePositions;
+  o_normals = m_baseNormals;
+  accumulate(_active, o_positions, o_normals);
+}
+
+void SparseMorphMesh::initState(SparseEvalState &o_state) const
+{
+  o_state.m_positions = m_basePositions;
+  o_state.m_normals = m_baseNormals;
+  o_state.m_touched.clear();
+  o_state.m_changed.clear();
+  o_state.m_isTouched.assign(m_basePositions.size(), 0);
+}
+
+void SparseMorphMesh::evaluate(const std::vector<ActiveWeight> &_active, SparseEvalState &io_state) const
+{
+  // m_isTouched bit 0 is moved by this evaluation, bit 1 is already in m_changed
+  // put back the vertices the last evaluation moved, they have all changed
+  io_state.m_changed.swap(io_state.m_touched);
+  for (auto v : io_state.m_changed)
+  {
+    io_state.m_positions[v] = m_basePositions[v];
+    io_state.m_normals[v] = m_baseNormals[v];
+    io_state.m_isTouched[v] = 2;
+  }
+  io_state.m_touched.clear();
+  // and record what this one moves so the next call can undo it
+  for (const auto &a : _active)
+  {
+    for (auto v : m_targets[a.m_target].m_indices)
+    {
+      if (!(io_state.m_isTouched[v] & 1))
+      {
+        if (!io_state.m_isTouched[v])
+        {
+          io_state.m_changed.push_back(v);
+        }
+        io_state.m_isTouched[v] |= 1;
+        io_state.m_touched.push_back(v);
+      }
+    }
+  }
+  for (auto v : io_state.m_changed)
+  {
+    io_state.m_isTouched[v] &= 1;
+  }
+  accumulate(_active, io_state.m_positions, io_state.m_normals);
+}
+
+size_t SparseMorphMesh::numDeltas() const noexcept
+{
+  size_t count = 0;
+  for (const auto &t : m_targets)
+  {
+    count += t.size();
+  }
+  return count;
+}
+
+size_t SparseMorphMesh::memoryBytes() const noexcept
+{
+  size_t bytes = (m_basePositions.size() + m_baseNormals.size()) * sizeof(Vec3);
+  for (const auto &t : m_targets)
+  {
+    bytes += t.memoryBytes();
+  }
+  return bytes;
+}
+
+} // end namespace morph
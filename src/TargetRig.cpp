@@ -0,0 +1,261 @@
+#include "TargetRig.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace morph
+{
+void TargetRig::setIdentity(size_t _numTargets)
+{
+  clear();
+  for (size_t t = 0; t < _numTargets; ++t)
+  {
+    addInBetween(t, addDriver(std::to_string(t)));
+  }
+  build(_numTargets);
+}
+
+void TargetRig::clear()
+{
+  m_driverNames.clear();
+  m_inBetweens.clear();
+  m_combinations.clear();
+  m_numTargets = 0;
+  m_driverFirst.assign(1, 0);
+  m_positions.clear();
+  m_targets.clear();
+  m_comboFirst.assign(1, 0);
+  m_comboDrivers.clear();
+  m_comboTargets.clear();
+}
+
+size_t TargetRig::addDriver(const std::string &_name)
+{
+  m_driverNames.push_back(_name);
+  return m_driverNames.size() - 1;
+}
+
+int TargetRig::findDriver(const std::string &_name) const noexcept
+{
+  auto it = std::find(m_driverNames.begin(), m_driverNames.end(), _name);
+  return it == m_driverNames.end() ? -1 : static_cast<int>(it - m_driverNames.begin());
+}
+
+void TargetRig::addInBetween(size_t _target, size_t _driver, float _position)
+{
+  m_inBetweens.push_back({static_cast<uint32_t>(_target), static_cast<uint32_t>(_driver), _position});
+}
+
+void TargetRig::addCombination(size_t _target, const std::vector<size_t> &_drivers)
+{
+  m_combinations.push_back({static_cast<uint32_t>(_target), std::vector<uint32_t>(_drivers.begin(), _drivers.end())});
+}
+
+bool TargetRig::build(size_t _numTargets)
+{
+  std::vector<uint8_t> used(_numTargets, 0);
+  auto claim = [&](uint32_t _target)
+  {
+    if (_target >= _numTargets)
+    {
+      std::cerr << "TargetRig target " << _target << " is out of range, there are " << _numTargets << " targets\n";
+      return false;
+    }
+    if (used[_target] != 0)
+    {
+      std::cerr << "TargetRig target " << _target << " is driven more than once\n";
+      return false;
+    }
+    used[_target] = 1;
+    return true;
+  };
+  for (const auto &s : m_inBetweens)
+  {
+    if (!claim(s.m_target))
+    {
+      return false;
+    }
+    if (s.m_driver >= numDrivers() || !(s.m_position > 0.0f))
+    {
+      std::cerr << "TargetRig in-between for target " << s.m_target << " needs a driver and a position above 0\n";
+      return false;
+    }
+  }
+  for (const auto &c : m_combinations)
+  {
+    if (!claim(c.m_target))
+    {
+      return false;
+    }
+    if (c.m_drivers.empty() ||
+        std::any_of(c.m_drivers.begin(), c.m_drivers.end(), [this](uint32_t _d) { return _d >= numDrivers(); }))
+    {
+      std::cerr << "TargetRig combination for target " << c.m_target << " needs at least one valid driver\n";
+      return false;
+    }
+  }
+
+  // group the in-betweens by driver in position order so evaluate only walks each driver's own run
+  auto sorted = m_inBetweens;
+  std::stable_sort(sorted.begin(), sorted.end(), [](const InBetween &_a, const InBetween &_b)
+                   { return _a.m_driver != _b.m_driver ? _a.m_driver < _b.m_driver : _a.m_position < _b.m_position; });
+  m_driverFirst.assign(numDrivers() + 1, 0);
+  m_positions.clear();
+  m_targets.clear();
+  for (size_t i = 0; i < sorted.size(); ++i)
+  {
+    if (i > 0 && sorted[i].m_driver == sorted[i - 1].m_driver && sorted[i].m_position == sorted[i - 1].m_position)
+    {
+      std::cerr << "TargetRig driver " << m_driverNames[sorted[i].m_driver] << " has two in-betweens at "
+                << sorted[i].m_position << '\n';
+      return false;
+    }
+    ++m_driverFirst[sorted[i].m_driver + 1];
+    m_positions.push_back(sorted[i].m_position);
+    m_targets.push_back(sorted[i].m_target);
+  }
+  for (size_t d = 0; d < numDrivers(); ++d)
+  {
+    m_driverFirst[d + 1] += m_driverFirst[d];
+  }
+  m_comboFirst.assign(1, 0);
+  m_comboDrivers.clear();
+  m_comboTargets.clear();
+  for (const auto &c : m_combinations)
+  {
+    m_comboDrivers.insert(m_comboDrivers.end(), c.m_drivers.begin(), c.m_drivers.end());
+    m_comboFirst.push_back(static_cast<uint32_t>(m_comboDrivers.size()));
+    m_comboTargets.push_back(c.m_target);
+  }
+  m_numTargets = _numTargets;
+  return true;
+}
+
+void TargetRig::evaluate(const std::vector<float> &_drivers, std::vector<float> &o_weights) const
+{
+  o_weights.assign(m_numTargets, 0.0f);
+  const size_t numDriven = std::min(_drivers.size(), numDrivers());
+  for (size_t d = 0; d < numDriven; ++d)
+  {
+    const float w = _drivers[d];
+    const uint32_t first = m_driverFirst[d];
+    const uint32_t count = m_driverFirst[d + 1] - first;
+    if (count == 0 || w == 0.0f)
+    {
+      continue;
+    }
+    const float *p = &m_positions[first];
+    const uint32_t *t = &m_targets[first];
+    if (count == 1 || w <= p[0])
+    {
+      // between the base and the first in-between, for a plain target at 1 this is the weight itself
+      o_weights[t[0]] = w / p[0];
+      continue;
+    }
+    // the segment w is in, the last one carries on past the end
+    uint32_t k = 0;
+    while (k + 2 < count && w > p[k + 1])
+    {
+      ++k;
+    }
+    const float s = (w - p[k]) / (p[k + 1] - p[k]);
+    o_weights[t[k]] = 1.0f - s;
+    o_weights[t[k + 1]] = s;
+  }
+  for (size_t c = 0; c < m_comboTargets.size(); ++c)
+  {
+    float w = 1.0f;
+    for (uint32_t i = m_comboFirst[c]; i < m_comboFirst[c + 1]; ++i)
+    {
+      const uint32_t d = m_comboDrivers[i];
+      w *= d < _drivers.size() ? _drivers[d] : 0.0f;
+    }
+    o_weights[m_comboTargets[c]] = w;
+  }
+}
+
+bool readTargetRig(const std::string &_fname, size_t _numTargets, TargetRig &o_rig)
+{
+  std::ifstream in(_fname);
+  if (!in)
+  {
+    std::cerr << "readTargetRig unable to open " << _fname << '\n';
+    return false;
+  }
+  o_rig.clear();
+  std::string line;
+  size_t lineNumber = 0;
+  while (std::getline(in, line))
+  {
+    ++lineNumber;
+    line = line.substr(0, line.find('#'));
+    std::istringstream tokens(line);
+    std::string kind;
+    if (!(tokens >> kind))
+    {
+      continue;
+    }
+    if (kind == "driver")
+    {
+      std::string name;
+      if (!(tokens >> name) || o_rig.findDriver(name) >= 0)
+      {
+        std::cerr << _fname << ':' << lineNumber << " expected driver <name> with a new name\n";
+        return false;
+      }
+      o_rig.addDriver(name);
+      continue;
+    }
+    int target = -1;
+    tokens >> target;
+    std::vector<std::string> rest;
+    for (std::string token; tokens >> token;)
+    {
+      rest.push_back(token);
+    }
+    if (kind == "inbetween" && target >= 0 && (rest.size() == 1 || rest.size() == 2))
+    {
+      const int driver = o_rig.findDriver(rest[0]);
+      float position = 1.0f;
+      try
+      {
+        position = rest.size() == 2 ? std::stof(rest[1]) : 1.0f;
+      }
+      catch (const std::exception &)
+      {
+        position = 0.0f;
+      }
+      if (driver >= 0)
+      {
+        o_rig.addInBetween(static_cast<size_t>(target), static_cast<size_t>(driver), position);
+        continue;
+      }
+    }
+    else if (kind == "combination" && target >= 0 && !rest.empty())
+    {
+      std::vector<size_t> drivers;
+      for (const auto &name : rest)
+      {
+        const int driver = o_rig.findDriver(name);
+        if (driver < 0)
+        {
+          break;
+        }
+        drivers.push_back(static_cast<size_t>(driver));
+      }
+      if (drivers.size() == rest.size())
+      {
+        o_rig.addCombination(static_cast<size_t>(target), drivers);
+        continue;
+      }
+    }
+    std::cerr << _fname << ':' << lineNumber
+              << " expected inbetween <target> <driver> [position] or combination <target> <driver> ..."
+                 " with declared drivers\n";
+    return false;
+  }
+  return o_rig.build(_numTargets);
+}
+
+} // end namespace morph
@@ -0,0 +1,132 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+namespace morph
+{
+ThreadPool::ThreadPool(size_t _numThreads)
+{
+  if (_numThreads == 0)
+  {
+    auto hw = std::thread::hardware_concurrency();
+    _numThreads = hw > 1 ? hw - 1 : 1;
+  }
+  m_workers.reserve(_numThreads);
+  for (size_t i = 0; i < _numThreads; ++i)
+  {
+    m_workers.emplace_back([this]() { workerLoop(); });
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_wake.notify_all();
+  for (auto &w : m_workers)
+  {
+    w.join();
+  }
+}
+
+ThreadPool &ThreadPool::global()
+{
+  static ThreadPool pool;
+  return pool;
+}
+
+void ThreadPool::enqueue(std::function<void()> _job)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_jobs.push_back(std::move(_job));
+  }
+  m_wake.notify_one();
+}
+
+void ThreadPool::workerLoop()
+{
+  for (;;)
+  {
+    std::function<void()> job;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_wake.wait(lock, [this]() { return m_stop || !m_jobs.empty(); });
+      if (m_stop && m_jobs.empty())
+      {
+        return;
+      }
+      job = std::move(m_jobs.front());
+      m_jobs.pop_front();
+    }
+    job();
+  }
+}
+
+namespace
+{
+// shared between the caller and the helper jobs of one parallelFor, the helpers may still be queued after
+// the caller returns so this is reference counted
+struct ParallelForState
+{
+  size_t m_begin;
+  size_t m_end;
+  size_t m_grain;
+  size_t m_numChunks;
+  std::function<void(size_t, size_t)> m_func;
+  std::atomic<size_t> m_next{0};
+  std::atomic<size_t> m_done{0};
+  std::mutex m_mutex;
+  std::condition_variable m_finished;
+
+  // claim and run chunks until there are none left
+  void run()
+  {
+    size_t chunk;
+    while ((chunk = m_next.fetch_add(1)) < m_numChunks)
+    {
+      size_t b = m_begin + chunk * m_grain;
+      m_func(b, std::min(b + m_grain, m_end));
+      if (m_done.fetch_add(1) + 1 == m_numChunks)
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_finished.notify_all();
+      }
+    }
+  }
+};
+} // end anonymous namespace
+
+void ThreadPool::parallelFor(size_t _begin, size_t _end, size_t _grain, const std::function<void(size_t, size_t)> &_func)
+{
+  if (_end <= _begin)
+  {
+    return;
+  }
+  _grain = std::max<size_t>(_grain, 1);
+  const size_t numChunks = (_end - _begin + _grain - 1) / _grain;
+  if (numChunks == 1)
+  {
+    _func(_begin, _end);
+    return;
+  }
+  auto state = std::make_shared<ParallelForState>();
+  state->m_begin = _begin;
+  state->m_end = _end;
+  state->m_grain = _grain;
+  state->m_numChunks = numChunks;
+  state->m_func = _func;
+  // one helper per worker at most, each helper keeps claiming chunks so we don't need a job per chunk
+  auto helpers = std::min(numChunks - 1, m_workers.size());
+  for (size_t i = 0; i < helpers; ++i)
+  {
+    enqueue([state]() { state->run(); });
+  }
+  state->run();
+  // every chunk has been claimed by now, so we are only waiting on ones that are already running
+  std::unique_lock<std::mutex> lock(state->m_mutex);
+  state->m_finished.wait(lock, [&state]() { return state->m_done.load() == state->m_numChunks; });
+}
+
+} // end namespace morph
@@ -0,0 +1,307 @@
+#include "WeightAnimation.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace morph
+{
+namespace
+{
+// channels per parallelFor job, evaluating one is a handful of loads so only big batches are worth splitting
+constexpr size_t c_grain = 4096;
+} // end anonymous namespace
+
+int WeightAnimation::addCurve(std::vector<Keyframe> _keys, Interpolation _interpolation)
+{
+  if (_keys.empty())
+  {
+    return -1;
+  }
+  std::stable_sort(_keys.begin(), _keys.end(), [](const Keyframe &_a, const Keyframe &_b) { return _a.m_time < _b.m_time; });
+  m_curveFirstKey.push_back(static_cast<uint32_t>(m_keyTimes.size()));
+  m_curveNumKeys.push_back(static_cast<uint32_t>(_keys.size()));
+  m_curveInterpolation.push_back(_interpolation);
+  for (const auto &k : _keys)
+  {
+    m_keyTimes.push_back(k.m_time);
+    m_keyValues.push_back(k.m_value);
+  }
+  return static_cast<int>(m_curveFirstKey.size() - 1);
+}
+
+int WeightAnimation::addChannel(int _curve, size_t _output, bool _loop)
+{
+  if (_curve < 0 || static_cast<size_t>(_curve) >= numCurves())
+  {
+    return -1;
+  }
+  m_channelCurve.push_back(_curve);
+  m_channelOutput.push_back(static_cast<uint32_t>(_output));
+  m_channelStart.push_back(0.0);
+  m_channelCursor.push_back(0);
+  m_channelLoop.push_back(_loop ? 1 : 0);
+  m_channelPlaying.push_back(0);
+  return static_cast<int>(m_channelCurve.size() - 1);
+}
+
+void WeightAnimation::play(int _channel, double _time)
+{
+  m_channelStart[_channel] = _time;
+  m_channelCursor[_channel] = 0;
+  if (!m_channelPlaying[_channel])
+  {
+    m_channelPlaying[_channel] = 1;
+    m_playing.push_back(_channel);
+  }
+}
+
+void WeightAnimation::stop(int _channel)
+{
+  if (!m_channelPlaying[_channel])
+  {
+    return;
+  }
+  m_channelPlaying[_channel] = 0;
+  m_playing.erase(std::find(m_playing.begin(), m_playing.end(), _channel));
+}
+
+bool WeightAnimation::isPlaying(int _channel) const noexcept
+{
+  return _channel >= 0 && static_cast<size_t>(_channel) < numChannels() && m_channelPlaying[_channel];
+}
+
+float WeightAnimation::duration(int _curve) const noexcept
+{
+  return m_keyTimes[m_curveFirstKey[_curve] + m_curveNumKeys[_curve] - 1];
+}
+
+float WeightAnimation::sample(int _curve, float _time) const noexcept
+{
+  uint32_t cursor = 0;
+  return sampleFrom(_curve, _time, cursor);
+}
+
+float WeightAnimation::channelValue(int _channel, double _time, uint32_t &io_cursor) const noexcept
+{
+  const int curve = m_channelCurve[_channel];
+  const float length = duration(curve);
+  // local time is kept in double until it's relative to the start so long running clocks don't lose precision
+  double local = _time - m_channelStart[_channel];
+  if (m_channelLoop[_channel] && length > 0.0f)
+  {
+    local = std::fmod(std::max(local, 0.0), static_cast<double>(length));
+  }
+  return sampleFrom(curve, static_cast<float>(local), io_cursor);
+}
+
+float WeightAnimation::sampleFrom(int _curve, float _time, uint32_t &io_cursor) const noexcept
+{
+  const float *times = &m_keyTimes[m_curveFirstKey[_curve]];
+  const float *values = &m_keyValues[m_curveFirstKey[_curve]];
+  const uint32_t count = m_curveNumKeys[_curve];
+  if (_time <= times[0])
+  {
+    return values[0];
+  }
+  if (_time >= times[count - 1])
+  {
+    return values[count - 1];
+  }
+  // find the segment [times[i], times[i + 1]) holding _time, playback usually moves forward a key at most so
+  // try the last one used first
+  uint32_t i = io_cursor;
+  if (i + 1 >= count || times[i] > _time)
+  {
+    i = static_cast<uint32_t>(std::upper_bound(times, times + count, _time) - times) - 1;
+  }
+  else
+  {
+    while (times[i + 1] <= _time)
+    {
+      ++i;
+    }
+  }
+  io_cursor = i;
+  const float t = (_time - times[i]) / (times[i + 1] - times[i]);
+  switch (m_curveInterpolation[_curve])
+  {
+  case Interpolation::STEP:
+    return values[i];
+  case Interpolation::SMOOTH:
+    return values[i] + (values[i + 1] - values[i]) * (t * t * (3.0f - 2.0f * t));
+  default:
+    return values[i] + (values[i + 1] - values[i]) * t;
+  }
+}
+
+bool WeightAnimation::evaluate(double _time, std::vector<float> &io_weights, ThreadPool *_pool)
+{
+  if (m_playing.empty())
+  {
+    return false;
+  }
+  m_finished.assign(m_playing.size(), 0);
+  std::atomic<bool> changed(false);
+  auto range = [&](size_t _begin, size_t _end)
+  {
+    bool anyChanged = false;
+    for (size_t p = _begin; p < _end; ++p)
+    {
+      const int c = m_playing[p];
+      if (!m_channelLoop[c] && _time - m_channelStart[c] >= duration(m_channelCurve[c]))
+      {
+        m_finished[p] = 1;
+      }
+      const float value = channelValue(c, _time, m_channelCursor[c]);
+      float &w = io_weights[m_channelOutput[c]];
+      if (w != value)
+      {
+        w = value;
+        anyChanged = true;
+      }
+    }
+    if (anyChanged)
+    {
+      changed = true;
+    }
+  };
+  if (_pool != nullptr && m_playing.size() > c_grain)
+  {
+    _pool->parallelFor(0, m_playing.size(), c_grain, range);
+  }
+  else
+  {
+    range(0, m_playing.size());
+  }
+  // drop the channels that ran off the end of their curve
+  size_t kept = 0;
+  for (size_t p = 0; p < m_playing.size(); ++p)
+  {
+    if (m_finished[p])
+    {
+      m_channelPlaying[m_playing[p]] = 0;
+    }
+    else
+    {
+      m_playing[kept++] = m_playing[p];
+    }
+  }
+  m_playing.resize(kept);
+  return changed;
+}
+
+void WeightAnimation::sampleAll(double _time, std::vector<float> &io_weights) const
+{
+  for (size_t c = 0; c < numChannels(); ++c)
+  {
+    uint32_t cursor = 0;
+    io_weights[m_channelOutput[c]] = channelValue(static_cast<int>(c), _time, cursor);
+  }
+}
+
+size_t WeightAnimation::numOutputs() const noexcept
+{
+  size_t count = 0;
+  for (auto o : m_channelOutput)
+  {
+    count = std::max(count, static_cast<size_t>(o) + 1);
+  }
+  return count;
+}
+
+double WeightAnimation::endTime() const noexcept
+{
+  double end = 0.0;
+  for (size_t c = 0; c < numChannels(); ++c)
+  {
+    if (!m_channelLoop[c])
+    {
+      end = std::max(end, m_channelStart[c] + duration(m_channelCurve[c]));
+    }
+  }
+  return end;
+}
+
+bool readWeightCurves(const std::string &_fname, WeightAnimation &o_animation)
+{
+  std::ifstream in(_fname);
+  if (!in)
+  {
+    std::cerr << "readWeightCurves unable to open " << _fname << '\n';
+    return false;
+  }
+  std::string line;
+  size_t lineNumber = 0;
+  while (std::getline(in, line))
+  {
+    ++lineNumber;
+    line = line.substr(0, line.find('#'));
+    std::istringstream tokens(line);
+    int target;
+    std::string mode;
+    if (!(tokens >> target))
+    {
+      // a blank line is fine, anything else isn't
+      if (line.find_first_not_of(" \t\r") == std::string::npos)
+      {
+        continue;
+      }
+      std::cerr << _fname << ':' << lineNumber << " expected a target index\n";
+      return false;
+    }
+    Interpolation interpolation;
+    tokens >> mode;
+    if (mode == "step")
+    {
+      interpolation = Interpolation::STEP;
+    }
+    else if (mode == "linear")
+    {
+      interpolation = Interpolation::LINEAR;
+    }
+    else if (mode == "smooth")
+    {
+      interpolation = Interpolation::SMOOTH;
+    }
+    else
+    {
+      std::cerr << _fname << ':' << lineNumber << " unknown interpolation " << mode << '\n';
+      return false;
+    }
+    std::vector<std::string> rest;
+    for (std::string token; tokens >> token;)
+    {
+      rest.push_back(token);
+    }
+    const bool loop = !rest.empty() && rest.front() == "loop";
+    if (loop)
+    {
+      rest.erase(rest.begin());
+    }
+    std::vector<Keyframe> keys;
+    try
+    {
+      for (size_t i = 0; i + 1 < rest.size(); i += 2)
+      {
+        keys.push_back({std::stof(rest[i]), std::stof(rest[i + 1])});
+      }
+    }
+    catch (const std::exception &)
+    {
+      keys.clear();
+    }
+    if (target < 0 || keys.empty() || rest.size() % 2 != 0)
+    {
+      std::cerr << _fname << ':' << lineNumber << " expected <target> <interpolation> [loop] <time> <value> ...\n";
+      return false;
+    }
+    o_animation.play(o_animation.addChannel(o_animation.addCurve(keys, interpolation), static_cast<size_t>(target), loop),
+                     0.0);
+  }
+  return true;
+}
+
+} // end namespace morph
@@ -2,14 +2,152 @@
 basic OpenGL demo modified from http://qt-project.org/doc/qt-5.0/qtgui/openglwindow.html
 ****************************************************************************/
 #include <QtGui/QGuiApplication>
+#include <QCommandLineParser>
+#include <cstdio>
 #include <iostream>
 #include "NGLScene.h"
+#include "HeadlessRun.h"
 
 
 
 int main(int argc, char **argv)
 {
   QGuiApplication app(argc, argv);
+  QCommandLineParser parser;
+  parser.setApplicationDescription("Morph mesh demo");
+  parser.addHelpOption();
+  QCommandLineOption deltaOption("deltas", "how the morph deltas are stored on the GPU <float|half|int16|int8>", "format", "float");
+  parser.addOption(deltaOption);
+  QCommandLineOption normalOption("normals", "where the shading normals come from <blend|cpu|gpu>, R cycles them at runtime", "mode", "blend");
+  parser.addOption(normalOption);
+  QCommandLineOption crowdOption("crowd", "draw <count> instanced characters and report the frame time", "count", "0");
+  parser.addOption(crowdOption);
+  QCommandLineOption lodOption("lod", "draw the crowd with <levels> levels of detail picked by screen space error", "levels", "0");
+  parser.addOption(lodOption);
+  QCommandLineOption streamOption("stream", "load the targets on demand keeping <MB> of them in memory", "MB");
+  parser.addOption(streamOption);
+  QCommandLineOption streamGpuOption("stream-gpu", "MB of streamed targets kept on the GPU", "MB", "16");
+  parser.addOption(streamGpuOption);
+  QCommandLineOption rigOption("rig", "drive the targets through the in-between and combination shapes in <file>", "file");
+  parser.addOption(rigOption);
+  QCommandLineOption skinOption("skin", "skin the morphed mesh with <influences> joints per vertex <4|8>", "influences");
+  parser.addOption(skinOption);
+  QCommandLineOption skinMethodOption("skin-method", "how the joints are blended <lbs|dqs>, K toggles it at runtime", "method", "lbs");
+  parser.addOption(skinMethodOption);
+  QCommandLineOption morphOption("morph", "where the blend is evaluated <shader|feedback>, M toggles it at runtime", "path", "shader");
+  parser.addOption(morphOption);
+  QCommandLineOption traceOption("trace", "write a Chrome trace (chrome://tracing) of the profiled stages to <file> on exit", "file");
+  parser.addOption(traceOption);
+  QCommandLineOption headlessOption("headless", "render <frames> frames offscreen with no window and report the throughput", "frames");
+  parser.addOption(headlessOption);
+  QCommandLineOption sizeOption("size", "headless framebuffer size", "WxH", "1024x720");
+  parser.addOption(sizeOption);
+  QCommandLineOption curvesOption("curves", "headless weight curve file, see morphbake", "file");
+  parser.addOption(curvesOption);
+  QCommandLineOption orbitOption("orbit", "degrees the headless camera turns over the run", "degrees", "360");
+  parser.addOption(orbitOption);
+  QCommandLineOption fpsOption("fps", "headless script frames per second", "fps", "60");
+  parser.addOption(fpsOption);
+  QCommandLineOption dumpOption("dump", "write every headless frame as a png to <dir>", "dir");
+  parser.addOption(dumpOption);
+  parser.process(app);
+  morph::DeltaFormat deltaFormat;
+  if (!morph::parseDeltaFormat(parser.value(deltaOption).toStdString(), deltaFormat))
+  {
+    std::cerr << "Unknown delta format " << parser.value(deltaOption).toStdString() << '\n';
+    return EXIT_FAILURE;
+  }
+  const auto normalName = parser.value(normalOption).toStdString();
+  NGLScene::NormalMode normalMode = NGLScene::NormalMode::BLEND;
+  if (normalName == "cpu")
+  {
+    normalMode = NGLScene::NormalMode::CPU;
+  }
+  else if (normalName == "gpu")
+  {
+    normalMode = NGLScene::NormalMode::GPU;
+  }
+  else if (normalName != "blend")
+  {
+    std::cerr << "Unknown normal mode " << normalName << '\n';
+    return EXIT_FAILURE;
+  }
+  const auto morphName = parser.value(morphOption).toStdString();
+  if (morphName != "shader" && morphName != "feedback")
+  {
+    std::cerr << "Unknown morph path " << morphName << '\n';
+    return EXIT_FAILURE;
+  }
+  const int crowd = parser.value(crowdOption).toInt();
+  if (crowd < 0)
+  {
+    std::cerr << "The crowd size can't be negative\n";
+    return EXIT_FAILURE;
+  }
+  if (crowd > 0 && deltaFormat != morph::DeltaFormat::FLOAT32)
+  {
+    std::cerr << "The crowd shader reads the float deltas, ignoring --deltas\n";
+    deltaFormat = morph::DeltaFormat::FLOAT32;
+  }
+  const int lod = parser.value(lodOption).toInt();
+  if (lod < 0 || lod > 16)
+  {
+    std::cerr << "The number of LOD levels must be between 0 and 16\n";
+    return EXIT_FAILURE;
+  }
+  if (parser.isSet(rigOption) && crowd > 0)
+  {
+    std::cerr << "The crowd drives its targets directly, ignoring --rig\n";
+  }
+  if (lod > 1 && crowd == 0)
+  {
+    std::cerr << "LOD is only used for the crowd, ignoring --lod\n";
+  }
+  const int skin = parser.isSet(skinOption) ? parser.value(skinOption).toInt() : 0;
+  if (skin != 0 && skin != 4 && skin != 8)
+  {
+    std::cerr << "--skin needs 4 or 8 influences\n";
+    return EXIT_FAILURE;
+  }
+  const auto skinMethodName = parser.value(skinMethodOption).toStdString();
+  if (skinMethodName != "lbs" && skinMethodName != "dqs")
+  {
+    std::cerr << "Unknown skin method " << skinMethodName << '\n';
+    return EXIT_FAILURE;
+  }
+  if (skin > 0)
+  {
+    if (crowd > 0)
+    {
+      std::cerr << "The crowd isn't skinned, ignoring --skin\n";
+    }
+    else if (deltaFormat != morph::DeltaFormat::FLOAT32)
+    {
+      std::cerr << "Skinning uses the float deltas, ignoring --deltas\n";
+      deltaFormat = morph::DeltaFormat::FLOAT32;
+    }
+  }
+  const bool stream = parser.isSet(streamOption);
+  const double streamMB = parser.value(streamOption).toDouble();
+  const double streamGpuMB = parser.value(streamGpuOption).toDouble();
+  if (stream)
+  {
+    if (streamMB < 0.0 || streamGpuMB < 0.0)
+    {
+      std::cerr << "The stream budgets can't be negative\n";
+      return EXIT_FAILURE;
+    }
+    if (crowd > 0)
+    {
+      std::cerr << "The crowd needs every target, ignoring --stream\n";
+    }
+    if (deltaFormat != morph::DeltaFormat::FLOAT32 || normalMode != NGLScene::NormalMode::BLEND)
+    {
+      std::cerr << "Streamed targets use the float deltas and blended normals, ignoring --deltas and --normals\n";
+      deltaFormat = morph::DeltaFormat::FLOAT32;
+      normalMode = NGLScene::NormalMode::BLEND;
+    }
+  }
   // create an OpenGL format specifier
   QSurfaceFormat format;
   // set the number of samples for multisampling
@@ -29,8 +167,49 @@ int main(int argc, char **argv)
   format.setProfile(QSurfaceFormat::CoreProfile);
   // now set the depth buffer to 24 bits
   format.setDepthBufferSize(24);
+  // the same settings for the window and headless runs
+  auto configure = [&](NGLScene &_scene)
+  {
+    _scene.setDeltaFormat(deltaFormat);
+    _scene.setNormalMode(normalMode);
+    _scene.setCrowdSize(static_cast<size_t>(crowd));
+    _scene.setLodLevels(static_cast<size_t>(lod));
+    _scene.setRigFile(crowd > 0 ? std::string() : parser.value(rigOption).toStdString());
+    _scene.setSkinning(crowd > 0 ? 0 : static_cast<size_t>(skin),
+                       skinMethodName == "dqs" ? morph::SkinMethod::DUAL_QUATERNION : morph::SkinMethod::LINEAR);
+    if (stream && crowd == 0)
+    {
+      _scene.setPoseStreaming(static_cast<size_t>(streamMB * 1024.0 * 1024.0), static_cast<size_t>(streamGpuMB * 1024.0 * 1024.0));
+    }
+    _scene.setTraceFile(parser.value(traceOption).toStdString());
+    _scene.setMorphPath(morphName == "feedback" ? NGLScene::MorphPath::FEEDBACK : NGLScene::MorphPath::SHADER);
+  };
+  if (parser.isSet(headlessOption))
+  {
+    HeadlessOptions headless;
+    const int frames = parser.value(headlessOption).toInt();
+    const auto size = parser.value(sizeOption).toStdString();
+    if (frames <= 0 || std::sscanf(size.c_str(), "%dx%d", &headless.m_width, &headless.m_height) != 2 ||
+        headless.m_width <= 0 || headless.m_height <= 0)
+    {
+      std::cerr << "--headless needs a frame count and --size WxH\n";
+      return EXIT_FAILURE;
+    }
+    headless.m_frames = static_cast<size_t>(frames);
+    headless.m_fps = parser.value(fpsOption).toDouble();
+    headless.m_orbit = parser.value(orbitOption).toInt();
+    headless.m_curves = parser.value(curvesOption).toStdString();
+    headless.m_dumpDir = parser.value(dumpOption).toStdString();
+    if (headless.m_fps <= 0.0)
+    {
+      std::cerr << "--fps must be positive\n";
+      return EXIT_FAILURE;
+    }
+    return runHeadless(headless, format, configure);
+  }
   // now we are going to create our scene window
   NGLScene window;
+  configure(window);
   // and set the OpenGL format
   window.setFormat(format);
   // we can now query the version to see if it worked
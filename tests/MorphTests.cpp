@@ -0,0 +1,729 @@
+/****************************************************************************
+unit tests for morphcore, run by ctest. Each test is a function that uses
+CHECK, the exit code is non zero if any check failed
+usage : MorphTests [name]
+****************************************************************************/
+#include "Arena.h"
+#include "MeshOptimizer.h"
+#include "MorphCache.h"
+#include "MorphMesh.h"
+#include "MorphTypes.h"
+#include "NormalRecompute.h"
+#include "ObjReader.h"
+#include "PoseLibrary.h"
+#include "PoseValidator.h"
+#include "QuantizedDeltas.h"
+#include "Skeleton.h"
+#include "Skinning.h"
+#include "SoAMorphMesh.h"
+#include "SparseMorphMesh.h"
+#include "TargetRig.h"
+#include "WeightAnimation.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace
+{
+int s_failures = 0;
+
+void check(bool _ok, const char *_expr, int _line)
+{
+  if (!_ok)
+  {
+    std::fprintf(stderr, "  line %d : CHECK(%s) failed\n", _line, _expr);
+    ++s_failures;
+  }
+}
+#define CHECK(_expr) check((_expr), #_expr, __LINE__)
+
+//----------------------------------------------------------------------------------------------------------------------
+// an _n x _n grid of quads each split a->c, one normal per vertex with the same index
+//----------------------------------------------------------------------------------------------------------------------
+morph::PoseData grid(uint32_t _n)
+{
+  morph::PoseData pose;
+  for (uint32_t y = 0; y <= _n; ++y)
+  {
+    for (uint32_t x = 0; x <= _n; ++x)
+    {
+      pose.m_verts.push_back({static_cast<float>(x), static_cast<float>(y), 0.0f});
+      pose.m_normals.push_back({0.0f, 0.0f, 1.0f + static_cast<float>(x + y * (_n + 1))});
+    }
+  }
+  for (uint32_t y = 0; y < _n; ++y)
+  {
+    for (uint32_t x = 0; x < _n; ++x)
+    {
+      const uint32_t a = y * (_n + 1) + x, b = a + 1, c = a + _n + 2, d = a + _n + 1;
+      pose.m_faces.push_back({{{a, b, c}}, {{a, b, c}}});
+      pose.m_faces.push_back({{{a, c, d}}, {{a, c, d}}});
+    }
+  }
+  return pose;
+}
+
+// the grid as the base pose followed by _targets poses, target t moves every third vertex starting at a different
+// one so the targets are sparse and overlap
+std::vector<morph::PoseData> morphPoses(uint32_t _n, size_t _targets)
+{
+  std::vector<morph::PoseData> poses(_targets + 1, grid(_n));
+  for (size_t t = 1; t <= _targets; ++t)
+  {
+    auto &pose = poses[t];
+    for (size_t v = t % 3; v < pose.m_verts.size(); v += 3)
+    {
+      const float s = std::sin(static_cast<float>(v * 7 + t));
+      pose.m_verts[v] += morph::Vec3(0.1f * s, -0.05f * s, 0.5f + 0.25f * s);
+      pose.m_normals[v] += morph::Vec3(0.2f * s, 0.1f, 0.0f);
+    }
+  }
+  return poses;
+}
+
+// the largest difference of any component, infinite if the sizes differ
+float maxDifference(const std::vector<morph::Vec3> &_a, const std::vector<morph::Vec3> &_b)
+{
+  if (_a.size() != _b.size())
+  {
+    return INFINITY;
+  }
+  float largest = 0.0f;
+  for (size_t i = 0; i < _a.size(); ++i)
+  {
+    const auto d = _a[i] - _b[i];
+    largest = std::max({largest, std::abs(d.m_x), std::abs(d.m_y), std::abs(d.m_z)});
+  }
+  return largest;
+}
+
+void meshEvaluate()
+{
+  // each vertex must be base + w0 * (pose0 - base) + w1 * (pose1 - base), the formula the shader uses, worked out
+  // here straight from the obj data each welded vertex came from
+  const auto poses = morphPoses(6, 2);
+  morph::MorphMesh mesh;
+  std::vector<morph::CornerKey> corners;
+  CHECK(mesh.build(poses, &corners));
+  CHECK(mesh.numTargets() == 2 && mesh.numVertices() == corners.size());
+  CHECK(mesh.indices().size() == poses[0].m_faces.size() * 3);
+  const std::vector<float> weights = {0.75f, -0.5f};
+  std::vector<morph::Vec3> positions, normals;
+  mesh.evaluate(weights, positions, normals);
+  std::vector<morph::Vec3> expectPositions, expectNormals;
+  for (const auto &c : corners)
+  {
+    auto p = poses[0].m_verts[c.m_vert];
+    auto n = poses[0].m_normals[c.m_norm];
+    for (size_t t = 0; t < weights.size(); ++t)
+    {
+      p += (poses[t + 1].m_verts[c.m_vert] - poses[0].m_verts[c.m_vert]) * weights[t];
+      n += (poses[t + 1].m_normals[c.m_norm] - poses[0].m_normals[c.m_norm]) * weights[t];
+    }
+    expectPositions.push_back(p);
+    expectNormals.push_back(n);
+  }
+  CHECK(maxDifference(positions, expectPositions) < 1e-5f);
+  CHECK(maxDifference(normals, expectNormals) < 1e-5f);
+  // all zero weights is the base pose
+  mesh.evaluate(std::vector<float>(2, 0.0f), positions, normals);
+  CHECK(maxDifference(positions, mesh.basePositions()) == 0.0f);
+}
+
+void gatherActive()
+{
+  const std::vector<float> weights = {0.1f, 0.0f, -0.9f, 0.5f, 0.2f};
+  auto active = morph::MorphMesh::gatherActive(weights);
+  CHECK(active.size() == 4 && active[0].m_target == 0 && active[3].m_target == 4);
+  // over the limit the largest magnitudes are kept, still in target order
+  active = morph::MorphMesh::gatherActive(weights, 2);
+  CHECK(active.size() == 2 && active[0].m_target == 2 && active[1].m_target == 3);
+}
+
+void sparseMatchesDense()
+{
+  const auto poses = morphPoses(6, 3);
+  morph::MorphMesh mesh;
+  CHECK(mesh.build(poses));
+  morph::SparseMorphMesh sparse;
+  sparse.build(mesh);
+  // only the vertices a target moves are kept
+  CHECK(sparse.numDeltas() < mesh.numTargets() * mesh.numVertices() / 2);
+  const auto first = morph::MorphMesh::gatherActive({0.3f, -1.0f, 0.6f});
+  std::vector<morph::Vec3> densePositions, denseNormals, positions, normals;
+  mesh.evaluate(first, densePositions, denseNormals);
+  sparse.evaluate(first, positions, normals);
+  CHECK(maxDifference(positions, densePositions) < 1e-6f);
+  CHECK(maxDifference(normals, denseNormals) < 1e-6f);
+  // the incremental form has to undo the vertices only the previous weights moved
+  morph::SparseEvalState state;
+  sparse.initState(state);
+  sparse.evaluate(first, state);
+  CHECK(maxDifference(state.m_positions, densePositions) < 1e-6f);
+  const auto second = morph::MorphMesh::gatherActive({0.0f, 0.5f, 0.0f});
+  sparse.evaluate(second, state);
+  mesh.evaluate(second, densePositions, denseNormals);
+  CHECK(maxDifference(state.m_positions, densePositions) < 1e-6f);
+  CHECK(maxDifference(state.m_normals, denseNormals) < 1e-6f);
+}
+
+// the triangles of an index list, each rotated to start at its smallest index (keeping the winding) and sorted
+std::vector<std::array<uint32_t, 3>> triangleSet(const std::vector<uint32_t> &_indices)
+{
+  std::vector<std::array<uint32_t, 3>> triangles;
+  for (size_t i = 0; i < _indices.size(); i += 3)
+  {
+    std::array<uint32_t, 3> t = {{_indices[i], _indices[i + 1], _indices[i + 2]}};
+    std::rotate(t.begin(), std::min_element(t.begin(), t.end()), t.end());
+    triangles.push_back(t);
+  }
+  std::sort(triangles.begin(), triangles.end());
+  return triangles;
+}
+
+void weldAndReorder()
+{
+  auto pose = grid(16);
+  // a seam, one corner uses another normal so its vertex is split in two
+  pose.m_faces[10].m_norm[0] = 0;
+  std::vector<morph::CornerKey> corners;
+  std::vector<uint32_t> indices(pose.m_faces.size() * 3);
+  morph::weldCorners(pose.m_faces, corners, indices);
+  CHECK(corners.size() == pose.m_verts.size() + 1);
+  bool matches = true;
+  for (size_t i = 0; i < indices.size(); ++i)
+  {
+    const auto &face = pose.m_faces[i / 3];
+    const auto &c = corners[indices[i]];
+    matches &= c.m_vert == face.m_vert[i % 3] && c.m_norm == face.m_norm[i % 3];
+  }
+  CHECK(matches);
+
+  // shuffle the triangles, the cache order must keep every triangle and its winding and do better than the shuffle
+  const size_t numTriangles = indices.size() / 3;
+  std::vector<uint32_t> shuffled(indices.size());
+  for (size_t t = 0; t < numTriangles; ++t)
+  {
+    std::copy_n(&indices[(t * 37) % numTriangles * 3], 3, &shuffled[t * 3]);
+  }
+  auto optimized = shuffled;
+  morph::optimizeVertexCache(optimized, corners.size());
+  CHECK(triangleSet(optimized) == triangleSet(shuffled));
+  CHECK(morph::averageCacheMissRatio(optimized, corners.size()) < morph::averageCacheMissRatio(shuffled, corners.size()));
+
+  // fetch order numbers the vertices by first use and the remap leads back to the old ones
+  auto fetched = optimized;
+  const auto remap = morph::optimizeVertexFetch(fetched, corners.size());
+  CHECK(remap.size() == corners.size());
+  uint32_t next = 0;
+  bool firstUse = true, sameVertices = true;
+  for (size_t i = 0; i < fetched.size(); ++i)
+  {
+    firstUse &= fetched[i] <= next;
+    next = std::max(next, fetched[i] + 1);
+    sameVertices &= remap[fetched[i]] == optimized[i];
+  }
+  CHECK(firstUse && sameVertices);
+}
+
+void cacheRoundTrip()
+{
+  const auto dir = std::filesystem::temp_directory_path();
+  const auto source = (dir / "MorphTestsSource.obj").string();
+  const auto cache = (dir / "MorphTests.morph").string();
+  {
+    std::ofstream out(source, std::ios::binary);
+    out << "v 0 0 0\n";
+  }
+  // the directory isn't part of the stamp so another path to the same file gives the same one
+  const uint64_t stamp = morph::MorphCache::sourceStamp({source});
+  CHECK(stamp == morph::MorphCache::sourceStamp({(dir / "." / "MorphTestsSource.obj").string()}));
+
+  morph::MorphMesh mesh;
+  CHECK(mesh.build(morphPoses(6, 2)));
+  CHECK(morph::MorphCache::write(cache, mesh, stamp));
+  morph::MorphCache file;
+  CHECK(file.open(cache, stamp));
+  CHECK(file.numVertices() == mesh.numVertices() && file.numTargets() == 2 && file.numIndices() == mesh.indices().size());
+  std::vector<morph::Vec3> vertices, deltas;
+  mesh.packVertices(vertices);
+  mesh.packDeltas(deltas);
+  CHECK(file.vertexBytes() == vertices.size() * sizeof(morph::Vec3));
+  CHECK(std::memcmp(file.vertexData(), vertices.data(), file.vertexBytes()) == 0);
+  CHECK(std::memcmp(file.deltaData(), deltas.data(), file.deltaBytes()) == 0);
+  const auto narrow = morph::narrowIndices(mesh.indices());
+  CHECK(file.indexSize() == 2 && std::memcmp(file.indexData(), narrow.data(), narrow.size() * 2) == 0);
+  morph::MorphMesh copy;
+  file.toMorphMesh(copy);
+  std::vector<morph::Vec3> positions, normals, copyPositions, copyNormals;
+  mesh.evaluate({0.5f, 1.0f}, positions, normals);
+  copy.evaluate({0.5f, 1.0f}, copyPositions, copyNormals);
+  CHECK(maxDifference(positions, copyPositions) == 0.0f && maxDifference(normals, copyNormals) == 0.0f);
+  file.close();
+
+  // an edited source makes the cache stale
+  {
+    std::ofstream out(source, std::ios::binary | std::ios::app);
+    out << "v 1 0 0\n";
+  }
+  const uint64_t edited = morph::MorphCache::sourceStamp({source});
+  CHECK(edited != stamp);
+  CHECK(!file.open(cache, edited));
+  CHECK(file.open(cache));
+  file.close();
+  std::filesystem::remove(source);
+  std::filesystem::remove(cache);
+}
+
+bool readObjText(const std::string &_faces, morph::PoseData &o_pose)
+{
+  const auto path = (std::filesystem::temp_directory_path() / "MorphTests.obj").string();
+  {
+    std::ofstream out(path, std::ios::binary);
+    out << "v 0 0 0\nv 1 0 0\nv 0 1 0\nvn 0 0 1\nvn 0 1 0\n" << _faces;
+  }
+  const bool ok = morph::readObj(path, o_pose);
+  std::filesystem::remove(path);
+  return ok;
+}
+
+void objIndices()
+{
+  morph::PoseData pose;
+  CHECK(readObjText("f 1//1 2//1 3//2\n", pose));
+  CHECK(pose.m_faces.size() == 1 && pose.m_faces[0].m_vert[2] == 2 && pose.m_faces[0].m_norm[2] == 1);
+  CHECK(readObjText("f -3//-1 -2//-1 -1//-2\n", pose));
+  CHECK(pose.m_faces[0].m_vert[0] == 0 && pose.m_faces[0].m_norm[0] == 1 && pose.m_faces[0].m_norm[2] == 0);
+  // a face with no normals uses normal 0
+  CHECK(readObjText("f 1 2 3\n", pose));
+  CHECK(pose.m_faces[0].m_norm[1] == 0);
+  CHECK(readObjText("f 1/1 2/1 3/1\n", pose));
+}
+
+void objBadIndices()
+{
+  morph::PoseData pose;
+  CHECK(!readObjText("f 0//1 2//1 3//1\n", pose));
+  CHECK(!readObjText("f 1//0 2//1 3//1\n", pose));
+  CHECK(!readObjText("f -4//1 -2//1 -1//1\n", pose));
+  CHECK(!readObjText("f 1//-3 2//1 3//1\n", pose));
+  CHECK(!readObjText("f 1//1 2//1 4//1\n", pose));
+}
+
+// split quad _quad of a grid along the other diagonal
+void resplit(morph::PoseData &io_pose, size_t _quad)
+{
+  auto &f0 = io_pose.m_faces[_quad * 2];
+  auto &f1 = io_pose.m_faces[_quad * 2 + 1];
+  const uint32_t a = f0.m_vert[0], b = f0.m_vert[1], c = f0.m_vert[2], d = f1.m_vert[2];
+  f0 = {{{a, b, d}}, {{a, b, d}}};
+  f1 = {{{b, c, d}}, {{b, c, d}}};
+}
+
+// swap the numbering of vertex / normal _a and _b as a re-export in another order would
+void swapNumbering(morph::PoseData &io_pose, uint32_t _a, uint32_t _b)
+{
+  std::swap(io_pose.m_verts[_a], io_pose.m_verts[_b]);
+  std::swap(io_pose.m_normals[_a], io_pose.m_normals[_b]);
+  for (auto &f : io_pose.m_faces)
+  {
+    for (unsigned int j = 0; j < 3; ++j)
+    {
+      for (auto *index : {&f.m_vert[j], &f.m_norm[j]})
+      {
+        *index = *index == _a ? _b : (*index == _b ? _a : *index);
+      }
+    }
+  }
+}
+
+void validatorIdenticalAndResplit()
+{
+  const auto base = grid(8);
+  CHECK(morph::validatePose(base, base).m_result == morph::PoseMatch::IDENTICAL);
+  auto pose = base;
+  resplit(pose, 3);
+  resplit(pose, 40);
+  const auto result = morph::validatePose(base, pose);
+  CHECK(result.m_result == morph::PoseMatch::RETRIANGULATED);
+  CHECK(result.m_message.empty());
+}
+
+void validatorRenumbering()
+{
+  // a couple of swapped vertices leave well over 90% of the faces matching but must not pass as re-triangulated
+  const auto base = grid(8);
+  auto pose = base;
+  swapNumbering(pose, 10, 57);
+  auto result = morph::validatePose(base, pose);
+  CHECK(result.m_faceMatch >= 0.9f);
+  CHECK(result.m_result == morph::PoseMatch::REMAPPED);
+  morph::applyRemap(base, pose, result);
+  CHECK(maxDifference(pose.m_verts, base.m_verts) == 0.0f);
+  CHECK(maxDifference(pose.m_normals, base.m_normals) == 0.0f);
+}
+
+void validatorRenumberedResplit()
+{
+  const auto base = grid(8);
+  auto pose = base;
+  resplit(pose, 5);
+  resplit(pose, 60);
+  swapNumbering(pose, 3, 70);
+  swapNumbering(pose, 22, 45);
+  auto result = morph::validatePose(base, pose);
+  CHECK(result.m_result == morph::PoseMatch::REMAPPED);
+  morph::applyRemap(base, pose, result);
+  CHECK(maxDifference(pose.m_verts, base.m_verts) == 0.0f);
+  CHECK(maxDifference(pose.m_normals, base.m_normals) == 0.0f);
+}
+
+void validatorNormalIndices()
+{
+  // one corner using another vertex's normal isn't a renumbering so it can't be remapped, it is accepted and said
+  const auto base = grid(8);
+  auto pose = base;
+  pose.m_faces[20].m_norm[0] = pose.m_faces[90].m_norm[1];
+  const auto result = morph::validatePose(base, pose);
+  CHECK(result.m_result == morph::PoseMatch::RETRIANGULATED);
+  CHECK(!result.m_message.empty());
+}
+
+void validatorMismatch()
+{
+  const auto base = grid(8);
+  auto pose = base;
+  pose.m_faces[7].m_vert[0] = pose.m_faces[100].m_vert[1];
+  CHECK(morph::validatePose(base, pose).m_result == morph::PoseMatch::MISMATCH);
+  pose = base;
+  pose.m_verts.pop_back();
+  CHECK(morph::validatePose(base, pose).m_result == morph::PoseMatch::MISMATCH);
+}
+
+void quantizeBounds()
+{
+  morph::MorphMesh mesh;
+  CHECK(mesh.build(morphPoses(8, 3)));
+  morph::QuantizedMorphMesh quantized;
+  CHECK(!quantized.build(mesh, morph::DeltaFormat::FLOAT32));
+  // the unorm formats round to the nearest of levels steps across each axis of the target's box, half floats keep
+  // 11 significant bits
+  const std::pair<morph::DeltaFormat, float> formats[] = {
+      {morph::DeltaFormat::HALF, 0.0f}, {morph::DeltaFormat::INT16, 65535.0f}, {morph::DeltaFormat::INT8, 255.0f}};
+  for (const auto &f : formats)
+  {
+    CHECK(quantized.build(mesh, f.first));
+    bool inBounds = true;
+    for (size_t t = 0; t < mesh.numTargets(); ++t)
+    {
+      const auto &deltas = mesh.target(t).m_positionDeltas;
+      morph::Vec3 lo = deltas[0], hi = deltas[0];
+      for (const auto &d : deltas)
+      {
+        lo = {std::min(lo.m_x, d.m_x), std::min(lo.m_y, d.m_y), std::min(lo.m_z, d.m_z)};
+        hi = {std::max(hi.m_x, d.m_x), std::max(hi.m_y, d.m_y), std::max(hi.m_z, d.m_z)};
+      }
+      const auto range = hi - lo;
+      for (size_t v = 0; v < mesh.numVertices(); ++v)
+      {
+        const auto &d = deltas[v];
+        const auto e = quantized.positionDelta(t, v) - d;
+        const float slack = 1e-6f;
+        if (f.second == 0.0f)
+        {
+          inBounds &= std::abs(e.m_x) <= std::abs(d.m_x) * 0x1p-11f + slack &&
+                      std::abs(e.m_y) <= std::abs(d.m_y) * 0x1p-11f + slack &&
+                      std::abs(e.m_z) <= std::abs(d.m_z) * 0x1p-11f + slack;
+        }
+        else
+        {
+          inBounds &= std::abs(e.m_x) <= 0.5f * range.m_x / f.second + slack &&
+                      std::abs(e.m_y) <= 0.5f * range.m_y / f.second + slack &&
+                      std::abs(e.m_z) <= 0.5f * range.m_z / f.second + slack;
+        }
+      }
+    }
+    CHECK(inBounds);
+    // the octahedral normals are 16 bits per component whatever the position format
+    CHECK(quantized.measureError(mesh).m_maxNormalDegrees < 0.05f);
+  }
+  // the free conversions on their own
+  CHECK(morph::halfToFloat(morph::floatToHalf(1.0f)) == 1.0f && morph::halfToFloat(morph::floatToHalf(-0.5f)) == -0.5f);
+  const morph::Vec3 n = morph::Vec3(0.3f, -0.8f, 0.2f).normalized();
+  const auto oct = morph::octEncode(n);
+  CHECK((morph::octDecode(oct[0], oct[1]) - n).length() < 1e-4f);
+}
+
+void normalsIncremental()
+{
+  morph::MorphMesh mesh;
+  CHECK(mesh.build(morphPoses(16, 1)));
+  morph::NormalRecompute recompute;
+  recompute.build(mesh.indices(), mesh.numVertices());
+  auto positions = mesh.basePositions();
+  std::vector<morph::Vec3> normals, full;
+  recompute.recompute(positions, normals, nullptr);
+  // a few vertices moving only updates the faces and vertices around them
+  std::vector<uint32_t> changed = {20, 21, 100};
+  for (auto v : changed)
+  {
+    positions[v] += morph::Vec3(0.1f, 0.2f, 0.7f);
+  }
+  recompute.recompute(changed, positions, normals, nullptr);
+  CHECK(recompute.lastRegionSize() > changed.size() && recompute.lastRegionSize() < 50);
+  recompute.recompute(positions, full, nullptr);
+  CHECK(maxDifference(normals, full) < 1e-6f);
+  // moving a third of the vertices touches most of the mesh so it falls back to the full pass
+  changed.clear();
+  for (uint32_t v = 0; v < positions.size(); v += 3)
+  {
+    positions[v] += morph::Vec3(0.0f, 0.1f, 0.3f);
+    changed.push_back(v);
+  }
+  recompute.recompute(changed, positions, normals);
+  CHECK(recompute.lastRegionSize() == recompute.numVertices());
+  recompute.recompute(positions, full);
+  CHECK(maxDifference(normals, full) < 1e-6f);
+}
+
+void animationAfterIdle()
+{
+  // NGLScene's punch, its clock only moves when a frame is drawn so the last tick can be long before the key press
+  morph::WeightAnimation animation;
+  const int punch = animation.addCurve({{0.0f, 0.0f}, {0.1f, 1.2f}, {0.25f, 0.0f}}, morph::Interpolation::SMOOTH);
+  const int channel = animation.addChannel(punch, 0);
+  std::vector<float> weights(1, 0.0f);
+  const double lastTick = 1.0, keyPress = 3.0;
+  // started from the stale time the whole curve is already over on the first frame and the peak never shows
+  animation.play(channel, lastTick);
+  animation.evaluate(keyPress + 0.1, weights, nullptr);
+  CHECK(!animation.isPlaying(channel) && weights[0] == 0.0f);
+  // caught up to the key press it plays out in full
+  animation.play(channel, keyPress);
+  CHECK(animation.evaluate(keyPress + 0.05, weights, nullptr) && weights[0] > 0.0f && weights[0] < 1.2f);
+  animation.evaluate(keyPress + 0.1, weights, nullptr);
+  CHECK(std::abs(weights[0] - 1.2f) < 1e-5f && animation.isPlaying(channel));
+  animation.evaluate(keyPress + 0.3, weights, nullptr);
+  CHECK(!animation.isPlaying(channel) && weights[0] == 0.0f);
+}
+
+void animationLooping()
+{
+  morph::WeightAnimation animation;
+  const int ramp = animation.addCurve({{0.5f, 1.0f}, {0.0f, 0.0f}, {1.0f, 0.0f}});
+  const int steps = animation.addCurve({{0.0f, 0.0f}, {0.5f, 1.0f}}, morph::Interpolation::STEP);
+  CHECK(animation.duration(ramp) == 1.0f);
+  CHECK(animation.sample(ramp, 0.25f) == 0.5f && animation.sample(ramp, -1.0f) == 0.0f && animation.sample(ramp, 2.0f) == 0.0f);
+  CHECK(animation.sample(steps, 0.49f) == 0.0f && animation.sample(steps, 0.5f) == 1.0f);
+  const int looping = animation.addChannel(ramp, 0, true);
+  const int once = animation.addChannel(steps, 1);
+  animation.play(looping, 10.0);
+  animation.play(once, 10.0);
+  std::vector<float> weights(2, 0.0f);
+  // the looping channel keeps its place in the keys across frames, wrapping round has to start again at the front
+  bool matches = true;
+  for (double t = 10.0; t < 13.0; t += 0.15)
+  {
+    animation.evaluate(t, weights, nullptr);
+    matches &= std::abs(weights[0] - animation.sample(ramp, static_cast<float>(std::fmod(t - 10.0, 1.0)))) < 1e-5f;
+  }
+  CHECK(matches);
+  CHECK(animation.isPlaying(looping) && !animation.isPlaying(once) && weights[1] == 1.0f);
+  CHECK(animation.numPlaying() == 1 && animation.endTime() == 10.5);
+  // sampleAll gives the same from the start times without touching the playing state
+  std::vector<float> sampled(2, 0.0f);
+  animation.sampleAll(12.25, sampled);
+  CHECK(sampled[0] == 0.5f && sampled[1] == 1.0f && animation.numPlaying() == 1);
+}
+
+void slotSelection()
+{
+  // the order NGLScene::streamActive hands out the GPU slots in, more targets than slots so the smallest lose out
+  // even though they have the lowest target ids
+  const std::vector<float> weights = {0.1f, 0.2f, 0.9f, -0.8f, 0.05f};
+  auto active = morph::MorphMesh::gatherActive(weights);
+  morph::SlotCache slots;
+  slots.reset(2, weights.size());
+  morph::MorphMesh::strongestFirst(active, slots.numSlots());
+  CHECK(active[0].m_target == 2 && active[1].m_target == 3);
+  bool fresh = false;
+  for (const auto &a : active)
+  {
+    slots.acquire(a.m_target, 1, fresh);
+  }
+  CHECK(slots.find(2) != morph::SlotCache::c_noSlot && slots.find(3) != morph::SlotCache::c_noSlot);
+  CHECK(slots.find(0) == morph::SlotCache::c_noSlot && slots.find(1) == morph::SlotCache::c_noSlot);
+  // a count larger than the list is fine
+  morph::MorphMesh::strongestFirst(active, 100);
+  CHECK(active.front().m_target == 2 && active.back().m_target == 4);
+}
+
+// each weight within _tolerance of the expected one
+bool sameWeights(const std::vector<float> &_weights, const std::vector<float> &_expected, float _tolerance = 1e-6f)
+{
+  if (_weights.size() != _expected.size())
+  {
+    return false;
+  }
+  for (size_t i = 0; i < _weights.size(); ++i)
+  {
+    if (std::abs(_weights[i] - _expected[i]) > _tolerance)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+void rigEvaluate()
+{
+  // smile goes through target 0 at half way to target 1, jaw drives target 2 and target 3 corrects the two together
+  morph::TargetRig rig;
+  const size_t smile = rig.addDriver("smile");
+  const size_t jaw = rig.addDriver("jaw");
+  rig.addInBetween(1, smile);
+  rig.addInBetween(0, smile, 0.5f);
+  rig.addInBetween(2, jaw);
+  rig.addCombination(3, {smile, jaw});
+  CHECK(rig.build(4));
+  CHECK(rig.findDriver("jaw") == static_cast<int>(jaw) && rig.numCombinations() == 1);
+  std::vector<float> weights;
+  rig.evaluate({0.25f, 0.0f}, weights);
+  CHECK(sameWeights(weights, {0.5f, 0.0f, 0.0f, 0.0f}));
+  rig.evaluate({0.5f, 0.0f}, weights);
+  CHECK(sameWeights(weights, {1.0f, 0.0f, 0.0f, 0.0f}));
+  rig.evaluate({0.75f, 0.5f}, weights);
+  CHECK(sameWeights(weights, {0.5f, 0.5f, 0.5f, 0.375f}));
+  // the last segment carries on past the end and below zero the first one does
+  rig.evaluate({1.5f, 1.0f}, weights);
+  CHECK(sameWeights(weights, {-1.0f, 2.0f, 1.0f, 1.5f}));
+  rig.evaluate({-0.25f, -1.0f}, weights);
+  CHECK(sameWeights(weights, {-0.5f, 0.0f, -1.0f, 0.25f}));
+
+  // the identity rig passes the drivers straight through
+  rig.setIdentity(3);
+  rig.evaluate({0.1f, -0.2f, 0.3f}, weights);
+  CHECK(sameWeights(weights, {0.1f, -0.2f, 0.3f}));
+  // a target driven twice or out of range is refused
+  rig.clear();
+  const size_t a = rig.addDriver("a");
+  rig.addInBetween(0, a);
+  rig.addCombination(0, {a});
+  CHECK(!rig.build(2));
+  rig.clear();
+  rig.addInBetween(5, rig.addDriver("a"));
+  CHECK(!rig.build(2));
+}
+
+void skinKnownRotation()
+{
+  // two roots at the origin and one at x = 2, the second and third are turned 90 degrees about z
+  morph::Skeleton skeleton;
+  const morph::RigidTransform identity = {morph::Quat(0.0f, 0.0f, 0.0f, 1.0f), morph::Vec3()};
+  const morph::RigidTransform offset = {identity.m_rotation, morph::Vec3(2.0f, 0.0f, 0.0f)};
+  skeleton.addJoint("still", morph::Skeleton::c_noParent, identity);
+  skeleton.addJoint("turned", morph::Skeleton::c_noParent, identity);
+  skeleton.addJoint("pivot", morph::Skeleton::c_noParent, offset);
+  const auto quarter = morph::Quat::fromAxisAngle(morph::Vec3(0.0f, 0.0f, 1.0f), 1.5707964f);
+  morph::SkinPalette palette;
+  skeleton.computePalette({identity, {quarter, morph::Vec3()}, {quarter, offset.m_translation}}, palette);
+
+  morph::SkinWeights weights;
+  CHECK(weights.reset(3, 4));
+  weights.setVertex(0, {{1, 1.0f}});
+  weights.setVertex(1, {{0, 0.5f}, {1, 0.5f}});
+  weights.setVertex(2, {{2, 1.0f}});
+  const std::vector<morph::Vec3> positions = {{1.0f, 0.0f, 0.0f}, {1.0f, 0.0f, 0.0f}, {3.0f, 0.0f, 0.0f}};
+  const std::vector<morph::Vec3> normals(3, morph::Vec3(1.0f, 0.0f, 0.0f));
+  const float diagonal = std::sqrt(0.5f);
+  for (auto level : {morph::SimdLevel::SCALAR, morph::detectSimdLevel()})
+  {
+    std::vector<morph::Vec3> skinned, skinnedNormals;
+    // a single joint rotates about its own bind position with either method
+    for (auto method : {morph::SkinMethod::LINEAR, morph::SkinMethod::DUAL_QUATERNION})
+    {
+      morph::skinVertices(weights, palette, method, positions, normals, skinned, skinnedNormals, nullptr, level);
+      CHECK((skinned[0] - morph::Vec3(0.0f, 1.0f, 0.0f)).length() < 1e-4f);
+      CHECK((skinnedNormals[0] - morph::Vec3(0.0f, 1.0f, 0.0f)).length() < 1e-4f);
+      CHECK((skinned[2] - morph::Vec3(2.0f, 1.0f, 0.0f)).length() < 1e-4f);
+    }
+    // half way between the two linear blending cuts the corner, dual quaternions stay on the arc
+    morph::skinVertices(weights, palette, morph::SkinMethod::LINEAR, positions, normals, skinned, skinnedNormals, nullptr,
+                        level);
+    CHECK((skinned[1] - morph::Vec3(0.5f, 0.5f, 0.0f)).length() < 1e-4f);
+    morph::skinVertices(weights, palette, morph::SkinMethod::DUAL_QUATERNION, positions, normals, skinned, skinnedNormals,
+                        nullptr, level);
+    CHECK((skinned[1] - morph::Vec3(diagonal, diagonal, 0.0f)).length() < 1e-4f);
+  }
+}
+
+void arenaReset()
+{
+  // after reset the blocks become one block that holds the same use without growing again
+  morph::Arena arena(64);
+  for (size_t i = 0; i < 20; ++i)
+  {
+    arena.allocate<float>(100 + i * 10);
+  }
+  arena.reset();
+  const size_t capacity = arena.capacity();
+  CHECK(capacity == arena.highWater());
+  for (size_t i = 0; i < 20; ++i)
+  {
+    arena.allocate<float>(100 + i * 10);
+  }
+  CHECK(arena.capacity() == capacity);
+  const auto mark = arena.mark();
+  auto values = arena.allocate<int>(8, 7);
+  CHECK(values.size() == 8 && values[0] == 7 && values[7] == 7);
+  arena.rewind(mark);
+}
+
+} // end anonymous namespace
+
+int main(int argc, char **argv)
+{
+  const std::pair<const char *, std::function<void()>> tests[] = {
+      {"meshEvaluate", meshEvaluate},
+      {"gatherActive", gatherActive},
+      {"sparseMatchesDense", sparseMatchesDense},
+      {"weldAndReorder", weldAndReorder},
+      {"cacheRoundTrip", cacheRoundTrip},
+      {"objIndices", objIndices},
+      {"objBadIndices", objBadIndices},
+      {"validatorIdenticalAndResplit", validatorIdenticalAndResplit},
+      {"validatorRenumbering", validatorRenumbering},
+      {"validatorRenumberedResplit", validatorRenumberedResplit},
+      {"validatorNormalIndices", validatorNormalIndices},
+      {"validatorMismatch", validatorMismatch},
+      {"quantizeBounds", quantizeBounds},
+      {"normalsIncremental", normalsIncremental},
+      {"animationAfterIdle", animationAfterIdle},
+      {"animationLooping", animationLooping},
+      {"slotSelection", slotSelection},
+      {"rigEvaluate", rigEvaluate},
+      {"skinKnownRotation", skinKnownRotation},
+      {"arenaReset", arenaReset},
+  };
+  const std::string filter = argc > 1 ? argv[1] : "";
+  for (const auto &t : tests)
+  {
+    if (!filter.empty() && filter != t.first)
+    {
+      continue;
+    }
+    const int before = s_failures;
+    t.second();
+    std::fprintf(stderr, "%-40s %s\n", t.first, s_failures == before ? "ok" : "FAILED");
+  }
+  return s_failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,353 @@
+/****************************************************************************
+offline batch evaluator, blends a base obj and poses with a weight curve file
+and streams every frame out as obj files or a PC2 point cache. Frames are
+evaluated in parallel and written in order through a fixed window of buffers
+so memory use doesn't grow with the length of the sequence
+****************************************************************************/
+#include "MorphMesh.h"
+#include "NormalRecompute.h"
+#include "ObjReader.h"
+#include "PoseValidator.h"
+#include "TargetRig.h"
+#include "ThreadPool.h"
+#include "WeightAnimation.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+enum class Format
+{
+  OBJ,
+  PC2
+};
+
+struct Options
+{
+  std::string m_curves;
+  std::string m_rig;
+  std::string m_output;
+  Format m_format = Format::OBJ;
+  double m_fps = 24.0;
+  double m_start = 0.0;
+  long m_frames = -1;
+  size_t m_threads = 0;
+  std::vector<std::string> m_inputs;
+};
+
+void usage(const char *_exe)
+{
+  std::cerr << "usage : " << _exe << " -c curves.txt -o output [--format obj|pc2] [--fps 24] [--start seconds]\n"
+            << "        [--frames n] [--threads n] [--rig file] base.obj pose1.obj [pose2.obj ...]\n"
+            << "obj writes output.0000.obj, output.0001.obj ... pc2 writes a single point cache to output\n"
+            << "each line of the curve file is <target> <step|linear|smooth> [loop] <time> <value> ...\n"
+            << "with --rig the curves drive the rig drivers instead of the targets (see TargetRig.h)\n";
+}
+
+// everything one frame needs, there is a slot per frame in flight so nothing is allocated per frame
+struct FrameSlot
+{
+  std::vector<float> m_weights;
+  std::vector<float> m_targetWeights;
+  std::vector<morph::Vec3> m_positions;
+  std::vector<morph::Vec3> m_normals;
+  morph::NormalRecompute m_recompute;
+  std::string m_text;
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+// the poses as a MorphMesh in the original obj vertex order, so a point cache lines up with the base obj. The
+// normals are recomputed for each frame so only the position deltas are kept
+//----------------------------------------------------------------------------------------------------------------------
+void buildPointMesh(const std::vector<morph::PoseData> &_poses, morph::MorphMesh &o_mesh, morph::NormalRecompute &o_recompute)
+{
+  const auto &base = _poses[0];
+  const size_t nVerts = base.m_verts.size();
+  std::vector<uint32_t> indices;
+  indices.reserve(base.m_faces.size() * 3);
+  for (const auto &f : base.m_faces)
+  {
+    indices.insert(indices.end(), f.m_vert.begin(), f.m_vert.end());
+  }
+  o_recompute.build(indices, nVerts);
+  std::vector<morph::Vec3> normals(nVerts);
+  o_recompute.recompute(base.m_verts, normals);
+  std::vector<morph::Vec3> vertices(nVerts * 2);
+  for (size_t v = 0; v < nVerts; ++v)
+  {
+    vertices[v * 2] = base.m_verts[v];
+    vertices[v * 2 + 1] = normals[v];
+  }
+  const size_t nTargets = _poses.size() - 1;
+  std::vector<morph::Vec3> deltas(nTargets * nVerts * 2);
+  std::vector<std::string> names;
+  for (size_t t = 0; t < nTargets; ++t)
+  {
+    names.push_back("pose" + std::to_string(t + 1));
+    for (size_t v = 0; v < nVerts; ++v)
+    {
+      deltas[(t * nVerts + v) * 2] = _poses[t + 1].m_verts[v] - base.m_verts[v];
+    }
+  }
+  o_mesh.assign(vertices.data(), nVerts, std::move(indices), deltas.data(), names);
+}
+
+void appendObj(const FrameSlot &_slot, const std::vector<uint32_t> &_indices, std::string &o_text)
+{
+  char line[128];
+  o_text.clear();
+  for (const auto &p : _slot.m_positions)
+  {
+    o_text.append(line, static_cast<size_t>(std::snprintf(line, sizeof(line), "v %.6g %.6g %.6g\n", p.m_x, p.m_y, p.m_z)));
+  }
+  for (const auto &n : _slot.m_normals)
+  {
+    o_text.append(line, static_cast<size_t>(std::snprintf(line, sizeof(line), "vn %.6g %.6g %.6g\n", n.m_x, n.m_y, n.m_z)));
+  }
+  for (size_t i = 0; i < _indices.size(); i += 3)
+  {
+    const uint32_t a = _indices[i] + 1, b = _indices[i + 1] + 1, c = _indices[i + 2] + 1;
+    o_text.append(line, static_cast<size_t>(std::snprintf(line, sizeof(line), "f %u//%u %u//%u %u//%u\n", a, a, b, b, c, c)));
+  }
+}
+
+bool writePC2Header(std::ofstream &_out, size_t _numPoints, double _start, double _fps, size_t _numFrames)
+{
+  // POINTCACHE2 header, the samples follow as numFrames * numPoints float xyz
+  const char signature[12] = "POINTCACHE2";
+  const int32_t version = 1;
+  const int32_t numPoints = static_cast<int32_t>(_numPoints);
+  const float startFrame = static_cast<float>(_start * _fps);
+  const float sampleRate = 1.0f;
+  const int32_t numSamples = static_cast<int32_t>(_numFrames);
+  _out.write(signature, sizeof(signature));
+  _out.write(reinterpret_cast<const char *>(&version), sizeof(version));
+  _out.write(reinterpret_cast<const char *>(&numPoints), sizeof(numPoints));
+  _out.write(reinterpret_cast<const char *>(&startFrame), sizeof(startFrame));
+  _out.write(reinterpret_cast<const char *>(&sampleRate), sizeof(sampleRate));
+  _out.write(reinterpret_cast<const char *>(&numSamples), sizeof(numSamples));
+  return static_cast<bool>(_out);
+}
+
+std::string frameName(const std::string &_prefix, size_t _frame)
+{
+  char number[32];
+  std::snprintf(number, sizeof(number), ".%04zu.obj", _frame);
+  return _prefix + number;
+}
+
+bool parseArgs(int argc, char **argv, Options &o_options)
+{
+  for (int i = 1; i < argc; ++i)
+  {
+    std::string arg = argv[i];
+    const bool hasValue = i + 1 < argc;
+    if (arg == "-c" && hasValue)
+    {
+      o_options.m_curves = argv[++i];
+    }
+    else if (arg == "-o" && hasValue)
+    {
+      o_options.m_output = argv[++i];
+    }
+    else if (arg == "--format" && hasValue)
+    {
+      std::string format = argv[++i];
+      if (format != "obj" && format != "pc2")
+      {
+        std::cerr << "unknown format " << format << '\n';
+        return false;
+      }
+      o_options.m_format = format == "obj" ? Format::OBJ : Format::PC2;
+    }
+    else if (arg == "--fps" && hasValue)
+    {
+      o_options.m_fps = std::atof(argv[++i]);
+    }
+    else if (arg == "--start" && hasValue)
+    {
+      o_options.m_start = std::atof(argv[++i]);
+    }
+    else if (arg == "--frames" && hasValue)
+    {
+      o_options.m_frames = std::atol(argv[++i]);
+    }
+    else if (arg == "--rig" && hasValue)
+    {
+      o_options.m_rig = argv[++i];
+    }
+    else if (arg == "--threads" && hasValue)
+    {
+      o_options.m_threads = static_cast<size_t>(std::atol(argv[++i]));
+    }
+    else if (!arg.empty() && arg[0] == '-')
+    {
+      return false;
+    }
+    else
+    {
+      o_options.m_inputs.push_back(arg);
+    }
+  }
+  return !o_options.m_curves.empty() && !o_options.m_output.empty() && o_options.m_inputs.size() >= 2 &&
+         o_options.m_fps > 0.0;
+}
+
+} // end anonymous namespace
+
+int main(int argc, char **argv)
+{
+  Options options;
+  if (!parseArgs(argc, argv, options))
+  {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+  auto start = std::chrono::steady_clock::now();
+  std::vector<morph::PoseData> poses;
+  if (!morph::readObjs(options.m_inputs, poses) || !morph::validatePoses(poses))
+  {
+    return EXIT_FAILURE;
+  }
+  morph::MorphMesh mesh;
+  morph::NormalRecompute recompute;
+  buildPointMesh(poses, mesh, recompute);
+  poses.clear();
+
+  // without a rig each curve drives a target directly
+  morph::TargetRig rig;
+  if (options.m_rig.empty())
+  {
+    rig.setIdentity(mesh.numTargets());
+  }
+  else if (!morph::readTargetRig(options.m_rig, mesh.numTargets(), rig))
+  {
+    return EXIT_FAILURE;
+  }
+  morph::WeightAnimation animation;
+  if (!morph::readWeightCurves(options.m_curves, animation))
+  {
+    return EXIT_FAILURE;
+  }
+  if (animation.numOutputs() > rig.numDrivers())
+  {
+    std::cerr << options.m_curves << " drives " << animation.numOutputs() - 1 << " but there are only "
+              << rig.numDrivers() << (options.m_rig.empty() ? " poses\n" : " rig drivers\n");
+    return EXIT_FAILURE;
+  }
+  size_t numFrames = 0;
+  if (options.m_frames >= 0)
+  {
+    numFrames = static_cast<size_t>(options.m_frames);
+  }
+  else
+  {
+    // up to the end of the last non looping curve
+    const double length = animation.endTime() - options.m_start;
+    if (length <= 0.0)
+    {
+      std::cerr << "the curves don't end after --start, use --frames to set the length\n";
+      return EXIT_FAILURE;
+    }
+    numFrames = static_cast<size_t>(std::floor(length * options.m_fps + 1e-6)) + 1;
+  }
+
+  std::ofstream pc2;
+  if (options.m_format == Format::PC2)
+  {
+    pc2.open(options.m_output, std::ios::binary);
+    if (!pc2 || !writePC2Header(pc2, mesh.numVertices(), options.m_start, options.m_fps, numFrames))
+    {
+      std::cerr << "unable to write " << options.m_output << '\n';
+      return EXIT_FAILURE;
+    }
+  }
+
+  morph::ThreadPool pool(options.m_threads);
+  // two frames per thread in flight keeps the workers busy while the frames are written in order
+  const size_t window = pool.numThreads() * 2 + 1;
+  std::vector<FrameSlot> slots(window);
+  for (auto &s : slots)
+  {
+    s.m_weights.assign(rig.numDrivers(), 0.0f);
+    s.m_recompute = recompute;
+  }
+  const bool writeObj = options.m_format == Format::OBJ;
+  auto evaluateFrame = [&](size_t _frame)
+  {
+    auto &slot = slots[_frame % window];
+    animation.sampleAll(options.m_start + static_cast<double>(_frame) / options.m_fps, slot.m_weights);
+    rig.evaluate(slot.m_weights, slot.m_targetWeights);
+    mesh.evaluate(morph::MorphMesh::gatherActive(slot.m_targetWeights), slot.m_positions, slot.m_normals);
+    if (writeObj)
+    {
+      slot.m_recompute.recompute(slot.m_positions, slot.m_normals, nullptr);
+      appendObj(slot, mesh.indices(), slot.m_text);
+    }
+  };
+
+  std::deque<std::future<void>> inFlight;
+  size_t nextFrame = 0;
+  size_t written = 0;
+  double bytes = 0.0;
+  // the frames still being evaluated write into slots, which is destroyed before the pool, so they have to finish
+  // before an error returns
+  auto fail = [&inFlight]()
+  {
+    for (auto &f : inFlight)
+    {
+      f.wait();
+    }
+    return EXIT_FAILURE;
+  };
+  while (written < numFrames)
+  {
+    while (nextFrame < numFrames && inFlight.size() < window)
+    {
+      const size_t frame = nextFrame++;
+      inFlight.push_back(pool.submit([&evaluateFrame, frame]() { evaluateFrame(frame); }));
+    }
+    inFlight.front().get();
+    inFlight.pop_front();
+    const auto &slot = slots[written % window];
+    if (writeObj)
+    {
+      const auto name = frameName(options.m_output, written);
+      std::ofstream out(name, std::ios::binary);
+      out.write(slot.m_text.data(), static_cast<std::streamsize>(slot.m_text.size()));
+      if (!out)
+      {
+        std::cerr << "unable to write " << name << '\n';
+        return fail();
+      }
+      bytes += static_cast<double>(slot.m_text.size());
+    }
+    else
+    {
+      static_assert(sizeof(morph::Vec3) == 3 * sizeof(float), "PC2 points are written straight from the Vec3 array");
+      const auto size = slot.m_positions.size() * sizeof(morph::Vec3);
+      pc2.write(reinterpret_cast<const char *>(slot.m_positions.data()), static_cast<std::streamsize>(size));
+      if (!pc2)
+      {
+        std::cerr << "unable to write " << options.m_output << '\n';
+        return fail();
+      }
+      bytes += static_cast<double>(size);
+    }
+    ++written;
+  }
+
+  auto end = std::chrono::steady_clock::now();
+  const double seconds = std::chrono::duration<double>(end - start).count();
+  std::cout << "baked " << numFrames << " frames of " << mesh.numVertices() << " vertices in " << seconds * 1000.0
+            << " ms (" << numFrames / seconds << " frames/s, " << bytes / (1024.0 * 1024.0) << " MB written)\n";
+  return EXIT_SUCCESS;
+}
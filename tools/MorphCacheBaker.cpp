@@ -0,0 +1,71 @@
+/****************************************************************************
+offline baker for the .morph cache, reads a base obj plus pose objs and writes
+the packed binary form loaded by NGLScene
+****************************************************************************/
+#include "MorphCache.h"
+#include "ObjReader.h"
+#include "PoseValidator.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+static void usage(const char *_exe)
+{
+  std::cerr << "usage : " << _exe << " -o output.morph base.obj pose1.obj [pose2.obj ...]\n";
+}
+
+int main(int argc, char **argv)
+{
+  std::string output;
+  std::vector<std::string> inputs;
+  for (int i = 1; i < argc; ++i)
+  {
+    std::string arg = argv[i];
+    if (arg == "-o" && i + 1 < argc)
+    {
+      output = argv[++i];
+    }
+    else if (arg == "-h" || arg == "--help")
+    {
+      usage(argv[0]);
+      return EXIT_SUCCESS;
+    }
+    else
+    {
+      inputs.push_back(arg);
+    }
+  }
+  if (output.empty() || inputs.size() < 2)
+  {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<morph::PoseData> poses;
+  morph::ObjReadStats stats;
+  if (!morph::readObjs(inputs, poses, &stats))
+  {
+    return EXIT_FAILURE;
+  }
+  std::cout << "read " << inputs.size() << " obj files at " << stats.mbPerSecond() << " MB/s\n";
+  if (!morph::validatePoses(poses))
+  {
+    return EXIT_FAILURE;
+  }
+  morph::MorphMesh mesh;
+  if (!mesh.build(poses))
+  {
+    return EXIT_FAILURE;
+  }
+  if (!morph::MorphCache::write(output, mesh, morph::MorphCache::sourceStamp(inputs)))
+  {
+    return EXIT_FAILURE;
+  }
+  auto end = std::chrono::steady_clock::now();
+  std::cout << "wrote " << output << " " << mesh.numVertices() << " vertices " << mesh.numTargets() << " targets in "
+            << std::chrono::duration<double, std::milli>(end - start).count() << " ms\n";
+  return EXIT_SUCCESS;
+}